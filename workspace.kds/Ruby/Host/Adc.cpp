@@ -0,0 +1,273 @@
+/*
+ * Adc.cpp
+ *
+ *  Model of the Analogue to Digital Converter
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include "HostCpu.h"
+#include "Adc.h"
+#include "Dma.h"
+#include "Simulator.h"
+
+namespace Host {
+
+namespace {
+
+/** Offsets of registers */
+constexpr uint32_t SC1_OFFSET = offsetof(ADC_Type, SC1);
+constexpr uint32_t R_OFFSET   = offsetof(ADC_Type, R);
+
+/** Asynchronous clock (ADACK) typical frequency (Hz) */
+constexpr double ADACK_FREQUENCY = 4.0e6;
+
+/** Time taken to calibrate (s) */
+constexpr double CALIBRATION_TIME = 500e-6;
+
+/** Calibration results reported (plus-side, minus-side same) */
+constexpr uint32_t CALIBRATION_VALUES[] = {
+      // CLPD CLPS  CLP4   CLP3  CLP2  CLP1  CLP0
+         0x0A, 0x20, 0x200, 0x100, 0x80, 0x40, 0x20,
+};
+
+/** Internal inputs (ADCH) */
+constexpr unsigned ADCH_TEMPERATURE = 26;
+constexpr unsigned ADCH_BANDGAP     = 27;
+constexpr unsigned ADCH_VREFH       = 29;
+constexpr unsigned ADCH_VREFL       = 30;
+
+}
+
+Adc::Adc(const char *name, uint32_t base, int irqNum, unsigned dmaSlot) :
+      Peripheral(name, base, 0x1000),
+      adc((volatile ADC_Type *)(uintptr_t)base),
+      irqNum(irqNum),
+      dmaSlot(dmaSlot),
+      conversionEvent(*this, &Adc::conversionComplete),
+      calibrationEvent(*this, &Adc::calibrationComplete) {
+   for (unsigned index=0; index<ADC_SC1_COUNT; index++) {
+      adc->SC1[index].value = ADC_SC1_ADCH(ADCH_DISABLED);
+   }
+   adc->PG.value = 0x8200;
+   adc->MG.value = 0x8200;
+   inputs[ADCH_TEMPERATURE] = 0.716;
+   inputs[ADCH_BANDGAP]     = 1.0;
+   inputs[ADCH_VREFH]       = REFERENCE_VOLTAGE;
+   inputs[ADCH_VREFL]       = 0.0;
+}
+
+/**
+ * Time for a conversion with current settings (core cycles)
+ */
+uint64_t Adc::conversionCycles() const {
+   uint32_t cfg1 = adc->CFG1.value;
+   uint32_t cfg2 = adc->CFG2.value;
+   uint32_t sc3  = adc->SC3.value;
+
+   double clock;
+   switch((cfg1&ADC_CFG1_ADICLK_MASK)>>ADC_CFG1_ADICLK_SHIFT) {
+      case 1:  clock = Simulator::BUS_CLOCK/2.0; break;
+      case 3:  clock = ADACK_FREQUENCY;          break;
+      default: clock = Simulator::BUS_CLOCK;     break;
+   }
+   clock /= (1U<<((cfg1&ADC_CFG1_ADIV_MASK)>>ADC_CFG1_ADIV_SHIFT));
+
+   // Base conversion time (ADCK cycles) by resolution
+   static constexpr unsigned baseTimes[] = {17, 20, 20, 25};
+   unsigned adck = baseTimes[(cfg1&ADC_CFG1_MODE_MASK)>>ADC_CFG1_MODE_SHIFT];
+   if (cfg1&ADC_CFG1_ADLSMP_MASK) {
+      static constexpr unsigned longSampleTimes[] = {20, 12, 6, 2};
+      adck += longSampleTimes[(cfg2&ADC_CFG2_ADLSTS_MASK)>>ADC_CFG2_ADLSTS_SHIFT];
+   }
+   if (cfg2&ADC_CFG2_ADHSC_MASK) {
+      adck += 2;
+   }
+   unsigned averages = 1;
+   if (sc3&ADC_SC3_AVGE_MASK) {
+      averages = 4U<<((sc3&ADC_SC3_AVGS_MASK)>>ADC_SC3_AVGS_SHIFT);
+   }
+   // Single conversion adder of 3 ADCK + 5 bus clocks
+   double seconds = (3.0+(double)averages*adck)/clock+5.0/Simulator::BUS_CLOCK;
+   return Simulator::clock().toCycles(seconds);
+}
+
+/**
+ * Calculate result of a conversion
+ *
+ * @param[in] sc1 SC1 value selecting input
+ */
+uint16_t Adc::convert(uint32_t sc1) const {
+   static constexpr unsigned singleEndedBits[] = {8, 12, 10, 16};
+   static constexpr unsigned differentialBits[] = {9, 13, 11, 16};
+
+   unsigned mode  = (adc->CFG1.value&ADC_CFG1_MODE_MASK)>>ADC_CFG1_MODE_SHIFT;
+   double   volts = inputs[sc1&ADC_SC1_ADCH_MASK];
+   if (sc1&ADC_SC1_DIFF_MASK) {
+      // Two's complement result sign-extended to 16 bits
+      double full  = (double)(1<<(differentialBits[mode]-1));
+      double value = round(volts/REFERENCE_VOLTAGE*full);
+      if (value > full-1) {
+         value = full-1;
+      }
+      else if (value < -full) {
+         value = -full;
+      }
+      return (uint16_t)(int16_t)value;
+   }
+   double full  = (double)(1<<singleEndedBits[mode]);
+   double value = round(volts/REFERENCE_VOLTAGE*full);
+   if (value > full-1) {
+      value = full-1;
+   }
+   else if (value < 0) {
+      value = 0;
+   }
+   return (uint16_t)value;
+}
+
+/**
+ * Start conversion
+ *
+ * @param[in] index SC1 register to use
+ */
+void Adc::start(unsigned index) {
+   if ((adc->SC1[index].value&ADC_SC1_ADCH_MASK) == ADCH_DISABLED) {
+      abort();
+      return;
+   }
+   converting = true;
+   active     = index;
+   adc->SC2.value |= ADC_SC2_ADACT_MASK;
+   Simulator::clock().scheduleIn(conversionEvent, conversionCycles());
+}
+
+/**
+ * Abandon conversion in progress
+ */
+void Adc::abort() {
+   converting = false;
+   adc->SC2.value &= ~ADC_SC2_ADACT_MASK;
+   Simulator::clock().cancel(conversionEvent);
+}
+
+void Adc::conversionComplete(unsigned, uint64_t) {
+   converting = false;
+   adc->SC2.value &= ~ADC_SC2_ADACT_MASK;
+   adc->R[active].value    = convert(adc->SC1[active].value);
+   adc->SC1[active].value |= ADC_SC1_COCO_MASK;
+   updateRequests();
+
+   // Continuous conversion restarts software triggered conversions
+   if ((adc->SC3.value&ADC_SC3_ADCO_MASK) && !(adc->SC2.value&ADC_SC2_ADTRG_MASK)) {
+      start(0);
+   }
+}
+
+void Adc::calibrationComplete(unsigned, uint64_t) {
+   converting = false;
+   adc->SC2.value &= ~ADC_SC2_ADACT_MASK;
+   volatile uint32_t *plus  = &adc->CLPD.value;
+   volatile uint32_t *minus = &adc->CLMD.value;
+   for (unsigned index=0; index<(sizeof(CALIBRATION_VALUES)/sizeof(CALIBRATION_VALUES[0])); index++) {
+      plus[index]  = CALIBRATION_VALUES[index];
+      minus[index] = CALIBRATION_VALUES[index];
+   }
+   adc->SC3.value &= ~(ADC_SC3_CAL_MASK|ADC_SC3_CALF_MASK);
+   adc->SC1[0].value |= ADC_SC1_COCO_MASK;
+   updateRequests();
+}
+
+/**
+ * Update interrupt and DMA request from the conversion complete flags
+ */
+void Adc::updateRequests() {
+   bool interrupt = false;
+   bool complete  = false;
+   for (unsigned index=0; index<ADC_SC1_COUNT; index++) {
+      uint32_t sc1 = adc->SC1[index].value;
+      if (sc1&ADC_SC1_COCO_MASK) {
+         complete = true;
+         if (sc1&ADC_SC1_AIEN_MASK) {
+            interrupt = true;
+         }
+      }
+   }
+   Cpu::setIrqLevel(irqNum, interrupt);
+   Simulator::dma().request(dmaSlot, complete && (adc->SC2.value&ADC_SC2_DMAEN_MASK));
+}
+
+uint32_t Adc::read(uint32_t offset, unsigned size) {
+   if ((offset >= R_OFFSET) && (offset < R_OFFSET+ADC_SC1_COUNT*sizeof(uint32_t))) {
+      // Reading the result clears COCO
+      unsigned index = (offset-R_OFFSET)/sizeof(uint32_t);
+      adc->SC1[index].value &= ~ADC_SC1_COCO_MASK;
+      updateRequests();
+      return adc->R[index].value;
+   }
+   return Peripheral::read(offset, size);
+}
+
+void Adc::write(uint32_t offset, uint32_t value, unsigned size) {
+   if ((offset >= SC1_OFFSET) && (offset < SC1_OFFSET+ADC_SC1_COUNT*sizeof(uint32_t))) {
+      unsigned index = (offset-SC1_OFFSET)/sizeof(uint32_t);
+      // Writing SC1 aborts any conversion using it and clears COCO
+      if (converting && (active == index)) {
+         abort();
+      }
+      adc->SC1[index].value = value&~ADC_SC1_COCO_MASK&0xFF;
+      updateRequests();
+      if ((index == 0) && !(adc->SC2.value&ADC_SC2_ADTRG_MASK)) {
+         start(0);
+      }
+      return;
+   }
+   switch(offset) {
+      case offsetof(ADC_Type, SC2):
+         // ADACT is read-only
+         adc->SC2.value = (value&~ADC_SC2_ADACT_MASK)|(adc->SC2.value&ADC_SC2_ADACT_MASK);
+         updateRequests();
+         break;
+      case offsetof(ADC_Type, SC3): {
+         uint32_t sc3 = (value&~(ADC_SC3_CAL_MASK|ADC_SC3_CALF_MASK))|(adc->SC3.value&ADC_SC3_CALF_MASK);
+         if (value&ADC_SC3_CALF_MASK) {
+            // w1c
+            sc3 &= ~ADC_SC3_CALF_MASK;
+         }
+         if (value&ADC_SC3_CAL_MASK) {
+            abort();
+            converting = true;
+            adc->SC2.value |= ADC_SC2_ADACT_MASK;
+            sc3 |= ADC_SC3_CAL_MASK;
+            Simulator::clock().scheduleIn(calibrationEvent, Simulator::clock().toCycles(CALIBRATION_TIME));
+         }
+         adc->SC3.value = sc3;
+         break;
+      }
+      case R_OFFSET:
+      case R_OFFSET+sizeof(uint32_t):
+         // Read-only
+         break;
+      default:
+         Peripheral::write(offset, value, size);
+         break;
+   }
+}
+
+void Adc::setInputVoltage(unsigned channel, double volts) {
+   if (channel < INPUTS) {
+      inputs[channel] = volts;
+   }
+}
+
+void Adc::hardwareTrigger(unsigned index) {
+   if ((index >= ADC_SC1_COUNT) || !(adc->SC2.value&ADC_SC2_ADTRG_MASK)) {
+      return;
+   }
+   if (converting) {
+      abort();
+   }
+   start(index);
+}
+
+}
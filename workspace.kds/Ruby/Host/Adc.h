@@ -0,0 +1,102 @@
+/*
+ * Adc.h
+ *
+ *  Model of the Analogue to Digital Converter
+ */
+
+#ifndef HOST_ADC_H_
+#define HOST_ADC_H_
+
+#include "derivative.h"
+#include "Peripheral.h"
+#include "VirtualClock.h"
+
+namespace Host {
+
+/**
+ * Analogue to Digital Converter
+ *
+ *  - Software (SC1A) and hardware (PDB pre-trigger) started conversions
+ *  - Conversion time from the clock, resolution, sample time and averaging
+ *  - Conversion complete interrupt and DMA request (cleared by reading R[n])
+ *  - Continuous conversion
+ *  - Calibration completes successfully after a delay
+ *  - Compare function and differential input pairs are not modelled - a
+ *    differential conversion uses the voltage set for the channel
+ *
+ * Input voltages are set with setInputVoltage(). The reference is REFERENCE_VOLTAGE volts.
+ */
+class Adc : public Peripheral {
+
+public:
+   /** Reference voltage (V) */
+   static constexpr double REFERENCE_VOLTAGE = 3.3;
+
+   /** Number of input channels (ADCH values) */
+   static constexpr unsigned INPUTS = 32;
+
+   /** ADCH value that disables the converter */
+   static constexpr unsigned ADCH_DISABLED = 0x1F;
+
+private:
+   volatile ADC_Type *const adc;
+
+   /** IRQ number */
+   const int irqNum;
+
+   /** DMA request source (DMAMUX slot) */
+   const unsigned dmaSlot;
+
+   /** Voltage applied to each input (V) */
+   double inputs[INPUTS] = {};
+
+   /** Conversion in progress */
+   bool     converting = false;
+   /** SC1 register of conversion in progress */
+   unsigned active     = 0;
+
+   EventOf<Adc> conversionEvent;
+   EventOf<Adc> calibrationEvent;
+
+   uint64_t conversionCycles() const;
+   uint16_t convert(uint32_t sc1) const;
+   void     start(unsigned index);
+   void     abort();
+   void     conversionComplete(unsigned, uint64_t now);
+   void     calibrationComplete(unsigned, uint64_t now);
+   void     updateRequests();
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] name    Name used in messages
+    * @param[in] base    Base address
+    * @param[in] irqNum  IRQ number
+    * @param[in] dmaSlot DMA request source
+    */
+   Adc(const char *name, uint32_t base, int irqNum, unsigned dmaSlot);
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+
+   /**
+    * Set voltage applied to an input
+    *
+    * @param[in] channel Channel (ADCH value)
+    * @param[in] volts   Voltage (V)
+    */
+   void setInputVoltage(unsigned channel, double volts);
+
+   /**
+    * Hardware trigger (from PDB pre-trigger)\n
+    * Ignored unless SC2.ADTRG is set
+    *
+    * @param[in] index SC1 register to use (0 => A, 1 => B)
+    */
+   void hardwareTrigger(unsigned index);
+};
+
+}
+
+#endif /* HOST_ADC_H_ */
@@ -0,0 +1,251 @@
+/*
+ * Benchmark.cpp
+ *
+ *  Closed-loop benchmark of the position controller against the axis model
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hardware.h"
+#include "pid.h"
+#include "Trajectory.h"
+#include "Benchmark.h"
+
+/*
+ * The controller only reports errors (illegal tunings) through the USBDM error code.
+ * There is no console here so the error is reported on stderr.
+ */
+namespace USBDM {
+
+volatile ErrorCode errorCode = E_NO_ERROR;
+
+ErrorCode checkError() {
+   if (errorCode != E_NO_ERROR) {
+      fprintf(stderr, "Controller error %d\n", errorCode);
+      exit(EXIT_FAILURE);
+   }
+   return errorCode;
+}
+
+}
+
+namespace Host {
+
+namespace {
+
+/** Benchmark being run on this thread - PID_T is connected to its plant through functions */
+thread_local Benchmark *active = nullptr;
+
+/** Monotonic host time (ns) */
+inline uint64_t hostNs() {
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec*1000000000ULL+now.tv_nsec;
+}
+
+}
+
+/**
+ * Controller input - as Motor::getPositionAsFloat()
+ */
+float benchmarkInput() {
+   return (float)(int16_t)(active->encoderSign*active->motor.getTicks());
+}
+
+/**
+ * Controller output - as Motor::setSpeed()
+ *
+ * @param[in] speed Speed -100.0...100.0
+ */
+void benchmarkOutput(float speed) {
+   if (speed<-100.0) {
+      speed = -100.0;
+   }
+   else if (speed>100.0) {
+      speed = 100.0;
+   }
+   if (speed > 0) {
+      active->dutyA = 1.0-speed/100.0;
+      active->dutyB = 1.0;
+   }
+   else if (speed < 0) {
+      active->dutyA = 1.0;
+      active->dutyB = 1.0+speed/100.0;
+   }
+   else {
+      active->dutyA = 1.0;
+      active->dutyB = 1.0;
+   }
+}
+
+using Controller = PID_T<benchmarkInput, benchmarkOutput>;
+
+const Benchmark::Settings Benchmark::DEFAULT_SETTINGS = {
+      /* axis              */ 2,
+      // Configuration::defaults
+      /* kp                */ 5.0,
+      /* ki                */ 0.1,
+      /* kd                */ 0.01,
+      /* outputLimit       */ 30,
+      /* tolerance         */ STEADY_STATE_TOLERANCE,
+      // JamDetector moveTime
+      /* timeout           */ 3.0,
+      /* supply            */ 12.0,
+      // Original controller structure
+      /* antiWindup         */ PID::AntiWindup_Clamp,
+      /* trackingGain       */ 0.0,
+      /* derivativeFilter   */ 0.0,
+      /* proportionalWeight */ 1.0,
+      /* derivativeWeight   */ 0.0,
+      // Not identified
+      /* modelGain         */ 0.0,
+      /* modelTimeConstant */ 0.0,
+      /* modelFriction     */ 0.0,
+      /* plant             */ MotorPlant::DEFAULT_PARAMETERS,
+};
+
+/* The firmware makes larger turns as a series of quarter turns */
+const std::vector<Benchmark::Move> Benchmark::DEFAULT_SEQUENCE = {
+      {+1, false}, {-1, false},
+      {+1, true},  {-1, true},
+      {-1, true},  {+1, true},
+      {+1, false}, {+1, false}, {-1, false}, {-1, false},
+};
+
+Benchmark::Benchmark(const Settings &settings) :
+   settings(settings), motor(settings.plant), encoderSign((settings.axis == 1)?-1:+1) {
+}
+
+Benchmark::Result Benchmark::run(const std::vector<Move> &moves) {
+   Benchmark *previous = active;
+   active = this;
+
+   // As pid1/pid2 in Ruby.cpp
+   Controller pid(settings.kp, settings.ki, settings.kd, PID_INTERVAL,
+         -settings.outputLimit, +settings.outputLimit, settings.axis != 1);
+   pid.setAntiWindup((PID::AntiWindup)settings.antiWindup, settings.trackingGain);
+   pid.setDerivativeFilter(settings.derivativeFilter);
+   pid.setSetpointWeights(settings.proportionalWeight, settings.derivativeWeight);
+   pid.setFeedforward(settings.modelGain, settings.modelTimeConstant, settings.modelFriction);
+   pid.setSetpoint(benchmarkInput());
+   pid.enable(true);
+
+   Trajectory trajectory(PID_INTERVAL);
+   Trajectory::Limits limits = Trajectory::getLimits(
+         settings.modelGain, settings.modelTimeConstant, settings.modelFriction, settings.outputLimit);
+
+   const int stepsPerUpdate = (int)round(PID_INTERVAL/PLANT_STEP);
+   const int updatesPerPoll = (int)round(MOTION_POLL_INTERVAL/PID_INTERVAL);
+   const int maxUpdates     = (int)ceil(settings.timeout/PID_INTERVAL);
+
+   Result result = {};
+   uint64_t updateNs = 0;
+
+   // Clock overhead is removed from the controller timing
+   uint64_t overheadNs = UINT64_MAX;
+   for (int count=0; count<100; count++) {
+      uint64_t start = hostNs();
+      uint64_t ns    = hostNs()-start;
+      if (ns < overheadNs) {
+         overheadNs = ns;
+      }
+   }
+
+   for (const Move &move : moves) {
+      motor.setCubeLoaded(move.cube);
+
+      double target    = pid.getSetpoint()+move.quarterTurns*QUARTERROTATIONTICKS;
+      double direction = (move.quarterTurns >= 0)?1.0:-1.0;
+      if (settings.modelGain > 0) {
+         trajectory.start(pid.getSetpoint(), target, limits);
+      }
+      else {
+         pid.setSetpoint(target);
+      }
+
+      MoveResult moveResult = {};
+      moveResult.move = move;
+
+      double startTime = time;
+      double lastOutsideTolerance = startTime;
+
+      for (int update=1; update<=maxUpdates; update++) {
+         uint64_t start = hostNs();
+         Trajectory::Reference reference;
+         if (trajectory.next(reference)) {
+            pid.setReference(reference.position, reference.velocity, reference.acceleration);
+         }
+         pid.update();
+         uint64_t ns = hostNs()-start;
+         ns = (ns > overheadNs)?ns-overheadNs:0;
+         updateNs += ns;
+         if (ns > result.maxUpdateNs) {
+            result.maxUpdateNs = ns;
+         }
+         result.updates++;
+
+         for (int step=0; step<stepsPerUpdate; step++) {
+            motor.step(PLANT_STEP, settings.supply, dutyA, dutyB);
+         }
+         time += PID_INTERVAL;
+
+         double position = benchmarkInput();
+         double past     = direction*(position-target);
+         if (past > moveResult.overshoot) {
+            moveResult.overshoot = past;
+         }
+         double error = fabs(position-target);
+         if (error > moveResult.followingError) {
+            moveResult.followingError = error;
+         }
+         if (error > settings.tolerance) {
+            lastOutsideTolerance = time;
+         }
+         if (((update%updatesPerPoll) == 0) && !trajectory.isRunning() && pid.getIsSteadyState(settings.tolerance)) {
+            moveResult.completed = true;
+            break;
+         }
+      }
+      moveResult.moveTime   = time-startTime;
+      moveResult.settleTime = lastOutsideTolerance-startTime;
+      moveResult.finalError = target-benchmarkInput();
+      result.moves.push_back(moveResult);
+   }
+
+   unsigned completed = 0;
+   for (const MoveResult &moveResult : result.moves) {
+      if (moveResult.completed) {
+         completed++;
+         result.meanMoveTime   += moveResult.moveTime;
+         result.meanSettleTime += moveResult.settleTime;
+      }
+      else {
+         result.failures++;
+      }
+      if (moveResult.moveTime > result.maxMoveTime) {
+         result.maxMoveTime = moveResult.moveTime;
+      }
+      if (moveResult.overshoot > result.maxOvershoot) {
+         result.maxOvershoot = moveResult.overshoot;
+      }
+      if (moveResult.followingError > result.maxFollowingError) {
+         result.maxFollowingError = moveResult.followingError;
+      }
+      if (fabs(moveResult.finalError) > result.maxFinalError) {
+         result.maxFinalError = fabs(moveResult.finalError);
+      }
+   }
+   if (completed > 0) {
+      result.meanMoveTime   /= completed;
+      result.meanSettleTime /= completed;
+   }
+   if (result.updates > 0) {
+      result.meanUpdateNs = (double)updateNs/result.updates;
+   }
+   active = previous;
+   return result;
+}
+
+}
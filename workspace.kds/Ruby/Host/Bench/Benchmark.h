@@ -0,0 +1,144 @@
+/*
+ * Benchmark.h
+ *
+ *  Closed-loop benchmark of the position controller against the axis model
+ */
+
+#ifndef HOST_BENCH_BENCHMARK_H_
+#define HOST_BENCH_BENCHMARK_H_
+
+#include <vector>
+#include "MotorPlant.h"
+
+namespace Host {
+
+/**
+ * Runs the firmware's position controller (PID_T from pid.h) against a
+ * MotorPlant and measures each move
+ *
+ * The loop is timed as on the target:
+ *  - The controller is updated every PID_INTERVAL (PitChannel<0> in Ruby.cpp)
+ *  - Its output drives the bridge as Motor::setSpeed()
+ *  - With a model the setpoint follows a Trajectory with feedforward as startMove()
+ *  - Completion is polled every MOTION_POLL_INTERVAL with
+ *    PID_T::getIsSteadyState() as motionTask()/ControlUpdate() do
+ *
+ * Plant time is fixed-step and nothing is random so results are identical
+ * from run to run - only the controller execution time depends on the host.
+ *
+ * Each benchmark holds its own controller and plant. Runs on different
+ * threads are independent.
+ */
+class Benchmark {
+
+public:
+   /** Controller update interval (s) - pidInterval in Ruby.cpp */
+   static constexpr double PID_INTERVAL = 500e-6;
+
+   /** Interval at which the motion task checks for completion (s) */
+   static constexpr double MOTION_POLL_INTERVAL = 10e-3;
+
+   /** Plant integration step (s) */
+   static constexpr double PLANT_STEP = 10e-6;
+
+   /** One move of a sequence */
+   struct Move {
+      int  quarterTurns;         //!< Size and direction of move (+ve => setpoint increases)
+      bool cube;                 //!< Gripper holds the cube during the move
+   };
+
+   /** Controller and plant to benchmark */
+   struct Settings {
+      unsigned axis;             //!< 1 or 2 - selects encoder direction as Motor1/Motor2
+      double   kp;               //!< Tunings as passed to PID_T::setTunings()
+      double   ki;
+      double   kd;
+      double   outputLimit;      //!< Controller output limit (percent)
+      int      tolerance;        //!< Steady state tolerance (ticks) - STEADY_STATE_TOLERANCE
+      double   timeout;          //!< Longest time allowed for a move (s)
+      double   supply;           //!< Motor supply (V)
+      unsigned antiWindup;       //!< PID::AntiWindup method
+      double   trackingGain;     //!< Back-calculation tracking gain (1/s)
+      double   derivativeFilter; //!< Derivative filter time constant (s)
+      double   proportionalWeight; //!< Setpoint weight in proportional term
+      double   derivativeWeight; //!< Setpoint weight in derivative term
+      double   modelGain;        //!< Identified model as Configuration - 0 => step moves without feedforward
+      double   modelTimeConstant;//!< (s)
+      double   modelFriction;    //!< (%)
+      MotorPlant::Parameters plant;
+   };
+
+   /** Values used by the firmware */
+   static const Settings DEFAULT_SETTINGS;
+
+   /** Sequence exercising both directions with and without the cube */
+   static const std::vector<Move> DEFAULT_SEQUENCE;
+
+   /** Measurement of one move */
+   struct MoveResult {
+      Move   move;
+      bool   completed;          //!< Controller reported steady state before the timeout
+      double moveTime;           //!< Time from the setpoint change to the controller reporting steady state (s)
+      double settleTime;         //!< Time from the setpoint change until the position stays within the tolerance (s)
+      double overshoot;          //!< Largest travel past the target (ticks)
+      double followingError;     //!< Largest magnitude of the position error during the move (ticks)
+      double finalError;         //!< Position error at completion (ticks)
+   };
+
+   /** Measurement of a sequence */
+   struct Result {
+      std::vector<MoveResult> moves;
+
+      unsigned failures;         //!< Moves that did not complete
+      double   meanMoveTime;     //!< Mean of moveTime over completed moves (s)
+      double   maxMoveTime;      //!< Largest moveTime (s)
+      double   meanSettleTime;   //!< Mean of settleTime over completed moves (s)
+      double   maxOvershoot;     //!< Largest overshoot (ticks)
+      double   maxFollowingError;//!< Largest following error (ticks)
+      double   maxFinalError;    //!< Largest magnitude of finalError (ticks)
+
+      unsigned updates;          //!< Number of controller updates
+      double   meanUpdateNs;     //!< Mean host execution time of PID_T::update() (ns)
+      double   maxUpdateNs;      //!< Longest host execution time of PID_T::update() (ns)
+   };
+
+private:
+   const Settings settings;
+
+   MotorPlant motor;
+
+   /** Encoder direction relative to motor (Motor1 counts backwards) */
+   const int encoderSign;
+
+   /** Duty cycles applied to bridge */
+   double dutyA = 1.0;
+   double dutyB = 1.0;
+
+   /** Time since start (s) */
+   double time = 0.0;
+
+   friend float benchmarkInput();
+   friend void  benchmarkOutput(float speed);
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] settings Controller and plant
+    */
+   Benchmark(const Settings &settings=DEFAULT_SETTINGS);
+
+   /**
+    * Run a sequence of moves\n
+    * Each move starts when the previous one has completed (or timed out).
+    *
+    * @param[in] moves Moves to make - the setpoint must stay within one revolution of the start
+    *
+    * @return Measurements
+    */
+   Result run(const std::vector<Move> &moves=DEFAULT_SEQUENCE);
+};
+
+}
+
+#endif /* HOST_BENCH_BENCHMARK_H_ */
@@ -0,0 +1,168 @@
+/*
+ * RubyBench.cpp
+ *
+ *  ruby_bench - reports the performance of the position controller against the axis model
+ *
+ *  Results (other than the controller execution time) are reproducible so a
+ *  tuning or algorithm change can be judged by comparing runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hardware.h"
+#include "pid.h"
+#include "Benchmark.h"
+
+using namespace Host;
+
+namespace {
+
+void usage(const char *name) {
+   fprintf(stderr,
+         "Usage: %s [--axis=n] [--kp=v] [--ki=v] [--kd=v] [--limit=percent] [--tolerance=ticks] [--supply=volts]\n"
+         "          [--anti-windup=n] [--tracking=v] [--filter=s] [--p-weight=v] [--d-weight=v]\n"
+         "          [--gain=ticks/s/%%] [--time-constant=s] [--friction=percent]\n"
+         "  --axis=n          Axis 1 or 2 (default 2)\n"
+         "  --kp,--ki,--kd    Controller tunings (default Configuration::defaults)\n"
+         "  --limit=p         Controller output limit (default 30)\n"
+         "  --tolerance=t     Steady state tolerance (default STEADY_STATE_TOLERANCE)\n"
+         "  --supply=v        Motor supply voltage (default 12)\n"
+         "  --anti-windup=n   0 clamp, 1 back-calculation, 2 conditional integration (default 0)\n"
+         "  --tracking=v      Back-calculation tracking gain (1/s)\n"
+         "  --filter=s        Derivative filter time constant (default 0 - unfiltered)\n"
+         "  --p-weight,--d-weight\n"
+         "                    Setpoint weights for P and D terms (default 1 and 0)\n"
+         "  --gain,--time-constant,--friction\n"
+         "                    Identified model - moves follow a trajectory with feedforward (default none)\n",
+         name);
+   exit(EXIT_FAILURE);
+}
+
+/**
+ * Get value of option if matched
+ *
+ * @param[in]  arg    Argument
+ * @param[in]  option Option including '='
+ * @param[out] value  Value of option
+ *
+ * @return true => arg is option
+ */
+bool optionValue(const char *arg, const char *option, double &value) {
+   size_t length = strlen(option);
+   if (strncmp(arg, option, length) != 0) {
+      return false;
+   }
+   value = atof(arg+length);
+   return true;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+   Benchmark::Settings settings = Benchmark::DEFAULT_SETTINGS;
+
+   for (int index=1; index<argc; index++) {
+      const char *arg = argv[index];
+      double value;
+      if (optionValue(arg, "--axis=", value)) {
+         if ((value != 1) && (value != 2)) {
+            usage(argv[0]);
+         }
+         settings.axis = (unsigned)value;
+      }
+      else if (optionValue(arg, "--kp=", value)) {
+         settings.kp = value;
+      }
+      else if (optionValue(arg, "--ki=", value)) {
+         settings.ki = value;
+      }
+      else if (optionValue(arg, "--kd=", value)) {
+         settings.kd = value;
+      }
+      else if (optionValue(arg, "--limit=", value)) {
+         settings.outputLimit = value;
+      }
+      else if (optionValue(arg, "--tolerance=", value)) {
+         settings.tolerance = (int)value;
+      }
+      else if (optionValue(arg, "--supply=", value)) {
+         settings.supply = value;
+      }
+      else if (optionValue(arg, "--anti-windup=", value)) {
+         if (value > PID::AntiWindup_Conditional) {
+            usage(argv[0]);
+         }
+         settings.antiWindup = (unsigned)value;
+      }
+      else if (optionValue(arg, "--tracking=", value)) {
+         settings.trackingGain = value;
+      }
+      else if (optionValue(arg, "--filter=", value)) {
+         settings.derivativeFilter = value;
+      }
+      else if (optionValue(arg, "--p-weight=", value)) {
+         if (value > 1) {
+            usage(argv[0]);
+         }
+         settings.proportionalWeight = value;
+      }
+      else if (optionValue(arg, "--d-weight=", value)) {
+         if (value > 1) {
+            usage(argv[0]);
+         }
+         settings.derivativeWeight = value;
+      }
+      else if (optionValue(arg, "--gain=", value)) {
+         settings.modelGain = value;
+      }
+      else if (optionValue(arg, "--time-constant=", value)) {
+         settings.modelTimeConstant = value;
+      }
+      else if (optionValue(arg, "--friction=", value)) {
+         settings.modelFriction = value;
+      }
+      else {
+         usage(argv[0]);
+      }
+      if (value < 0) {
+         usage(argv[0]);
+      }
+   }
+
+   printf("Axis %u: kp=%g, ki=%g, kd=%g, limit=%g%%, tolerance=%d ticks, supply=%g V\n",
+         settings.axis, settings.kp, settings.ki, settings.kd, settings.outputLimit, settings.tolerance, settings.supply);
+   static const char *const antiWindupNames[] = {"clamp", "back-calculation", "conditional"};
+   printf("Anti-windup=%s (tracking %g/s), derivative filter=%g s, setpoint weights=%g/%g\n",
+         antiWindupNames[settings.antiWindup], settings.trackingGain, settings.derivativeFilter,
+         settings.proportionalWeight, settings.derivativeWeight);
+   if (settings.modelGain > 0) {
+      printf("Feedforward: gain=%g ticks/s/%%, time constant=%g s, friction=%g%%\n",
+            settings.modelGain, settings.modelTimeConstant, settings.modelFriction);
+   }
+   printf("\n");
+
+   Benchmark benchmark(settings);
+   Benchmark::Result result = benchmark.run();
+
+   printf("Move  Turns  Cube   Move(ms)  Settle(ms)  Overshoot  Error\n");
+   unsigned number = 1;
+   for (const Benchmark::MoveResult &move : result.moves) {
+      printf("%4u  %+5d  %-4s  %9.1f%s %10.1f  %9.0f  %5.0f\n",
+            number++, move.move.quarterTurns, move.move.cube?"yes":"no",
+            move.moveTime*1000, move.completed?" ":"*", move.settleTime*1000, move.overshoot, move.finalError);
+   }
+   printf("\n");
+   printf("Mean move time   %8.1f ms (max %.1f ms)\n", result.meanMoveTime*1000, result.maxMoveTime*1000);
+   printf("Mean settle time %8.1f ms\n",                result.meanSettleTime*1000);
+   printf("Max overshoot    %8.0f ticks\n",             result.maxOvershoot);
+   printf("Max following    %8.0f ticks\n",             result.maxFollowingError);
+   printf("Max final error  %8.0f ticks\n",             result.maxFinalError);
+   if (result.failures > 0) {
+      printf("Timed out        %8u (marked *)\n",       result.failures);
+   }
+   printf("Controller       %8.1f ns mean, %.0f ns max over %u updates (host)\n",
+         result.meanUpdateNs, result.maxUpdateNs, result.updates);
+
+   return (result.failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,377 @@
+/*
+ * RubyTune.cpp
+ *
+ *  ruby_tune - searches for position controller tunings using the axis model
+ *
+ *  Each candidate (kp, ki, kd and settle tolerance) is benchmarked against a
+ *  set of plants with randomised friction, inertia and supply. The candidate
+ *  with the lowest mean move time that meets the overshoot, following error
+ *  and accuracy limits on every plant is reported as a tuning record.
+ *
+ *  The record is loaded into the firmware by sending it to the console
+ *  (the 'k' command) and saved with 'w'.
+ *
+ *  Benchmarks are run on a pool of worker threads, one benchmark per task.
+ *  The random numbers are drawn on the main thread so the result only depends
+ *  on the options, not on the number of threads.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+#include "hardware.h"
+#include "pid.h"
+#include "Benchmark.h"
+
+using namespace Host;
+
+namespace {
+
+/** Search options */
+struct Options {
+   unsigned threads    = std::thread::hardware_concurrency();
+   unsigned seed       = 1;
+   unsigned plants     = 16;         // Randomised plants each candidate is run against
+   unsigned samples    = 200;        // Random candidates in the initial search
+   unsigned rounds     = 12;         // Refinement rounds
+   unsigned population = 32;         // Candidates in each refinement round
+   double   overshoot  = 2*FULLROTATIONTICKS/360;                     // Overshoot limit (ticks)
+   double   following  = QUARTERROTATIONTICKS+(FULLROTATIONTICKS/16); // Following error limit (ticks) - as jamLimits
+   double   accuracy   = STEADY_STATE_TOLERANCE;                      // Final error limit (ticks)
+   const char *output  = nullptr;    // File for tuning record
+} options;
+
+/** Range of randomised plant variation (scale factor or volts) */
+struct Variation {
+   double low;
+   double high;
+};
+
+constexpr Variation FRICTION_VARIATION = {0.5,  2.0};
+constexpr Variation INERTIA_VARIATION  = {0.8,  1.25};
+constexpr Variation SUPPLY_VARIATION   = {10.5, 13.5};   // MotorSupplySensor requires > 10V
+
+/** Search space - gains are searched on a log scale */
+struct Range {
+   double low;
+   double high;
+};
+
+constexpr Range KP_RANGE        = {0.5,    50.0};
+constexpr Range KI_RANGE        = {0.001,  5.0};
+constexpr Range KD_RANGE        = {0.0005, 0.1};
+constexpr Range TOLERANCE_RANGE = {4,      2*STEADY_STATE_TOLERANCE};
+
+/** Point in the search space */
+struct Candidate {
+   double kp;
+   double ki;
+   double kd;
+   int    tolerance;
+};
+
+/** Performance of a candidate over all plants */
+struct Score {
+   bool     feasible;
+   double   cost;
+   unsigned failures;
+   double   meanMoveTime;
+   double   maxOvershoot;
+   double   maxFollowingError;
+   double   maxFinalError;
+};
+
+void usage(const char *name) {
+   fprintf(stderr,
+         "Usage: %s [options]\n"
+         "  --threads=n       Worker threads (default number of cores)\n"
+         "  --seed=n          Random seed (default 1)\n"
+         "  --plants=n        Randomised plants per candidate (default 16)\n"
+         "  --samples=n       Random candidates in initial search (default 200)\n"
+         "  --rounds=n        Refinement rounds (default 12)\n"
+         "  --population=n    Candidates per refinement round (default 32)\n"
+         "  --overshoot=t     Overshoot limit (ticks, default 2 degrees)\n"
+         "  --following=t     Following error limit (ticks, default as jam detection)\n"
+         "  --accuracy=t      Final position error limit (ticks, default STEADY_STATE_TOLERANCE)\n"
+         "  --output=file     Write tuning record to file\n",
+         name);
+   exit(EXIT_FAILURE);
+}
+
+/**
+ * Get value of option if matched
+ *
+ * @param[in]  arg    Argument
+ * @param[in]  option Option including '='
+ * @param[out] value  Value of option
+ *
+ * @return true => arg is option
+ */
+bool optionValue(const char *arg, const char *option, double &value) {
+   size_t length = strlen(option);
+   if (strncmp(arg, option, length) != 0) {
+      return false;
+   }
+   value = atof(arg+length);
+   return true;
+}
+
+/**
+ * Run tasks on a pool of worker threads\n
+ * Each worker takes the next task until all are done.
+ *
+ * @param[in] count Number of tasks
+ * @param[in] task  Task to run - given the task number
+ */
+void runTasks(unsigned count, const std::function<void(unsigned)> &task) {
+   std::atomic<unsigned> next(0);
+   auto worker = [&]() {
+      for (unsigned index=next++; index<count; index=next++) {
+         task(index);
+      }
+   };
+   std::vector<std::thread> workers;
+   for (unsigned thread=1; thread<options.threads; thread++) {
+      workers.emplace_back(worker);
+   }
+   worker();
+   for (std::thread &thread : workers) {
+      thread.join();
+   }
+}
+
+/**
+ * Create randomised plants\n
+ * Alternate plants use each axis.
+ */
+std::vector<Benchmark::Settings> createPlants(std::mt19937 &random) {
+   auto vary = [&](const Variation &variation) {
+      return std::uniform_real_distribution<double>(variation.low, variation.high)(random);
+   };
+   std::vector<Benchmark::Settings> plants;
+   for (unsigned index=0; index<options.plants; index++) {
+      Benchmark::Settings settings = Benchmark::DEFAULT_SETTINGS;
+      MotorPlant::Parameters &plant = settings.plant;
+      settings.axis          = 1+(index%2);
+      plant.coulombFriction *= vary(FRICTION_VARIATION);
+      plant.cubeFriction    *= vary(FRICTION_VARIATION);
+      plant.viscousFriction *= vary(FRICTION_VARIATION);
+      plant.inertia         *= vary(INERTIA_VARIATION);
+      plant.cubeInertia     *= vary(INERTIA_VARIATION);
+      settings.supply        = vary(SUPPLY_VARIATION);
+      plants.push_back(settings);
+   }
+   return plants;
+}
+
+/**
+ * Benchmark candidates against all plants
+ *
+ * @param[in] candidates Candidates
+ * @param[in] plants     Plants
+ *
+ * @return Score of each candidate
+ */
+std::vector<Score> evaluate(const std::vector<Candidate> &candidates, const std::vector<Benchmark::Settings> &plants) {
+   std::vector<Benchmark::Result> results(candidates.size()*plants.size());
+
+   runTasks(results.size(), [&](unsigned index) {
+      const Candidate &candidate = candidates[index/plants.size()];
+      Benchmark::Settings settings = plants[index%plants.size()];
+      settings.kp        = candidate.kp;
+      settings.ki        = candidate.ki;
+      settings.kd        = candidate.kd;
+      settings.tolerance = candidate.tolerance;
+      results[index] = Benchmark(settings).run();
+   });
+
+   std::vector<Score> scores;
+   for (unsigned candidate=0; candidate<candidates.size(); candidate++) {
+      Score    score = {};
+      unsigned moves = 0;
+      for (unsigned plant=0; plant<plants.size(); plant++) {
+         const Benchmark::Result &result = results[candidate*plants.size()+plant];
+         for (const Benchmark::MoveResult &move : result.moves) {
+            score.meanMoveTime += move.moveTime;
+            moves++;
+         }
+         score.failures += result.failures;
+         score.maxOvershoot      = fmax(score.maxOvershoot,      result.maxOvershoot);
+         score.maxFollowingError = fmax(score.maxFollowingError, result.maxFollowingError);
+         score.maxFinalError     = fmax(score.maxFinalError,     result.maxFinalError);
+      }
+      score.meanMoveTime /= moves;
+
+      // Infeasible candidates are ranked by how far they are outside the limits
+      double violation = score.failures+
+            fmax(0, score.maxOvershoot/options.overshoot-1)+
+            fmax(0, score.maxFollowingError/options.following-1)+
+            fmax(0, score.maxFinalError/options.accuracy-1);
+      score.feasible = (violation == 0);
+      score.cost     = score.feasible?score.meanMoveTime:(1000+violation);
+      scores.push_back(score);
+   }
+   return scores;
+}
+
+/**
+ * Map a value on a log scale within a range
+ */
+double logScale(const Range &range, double fraction) {
+   return range.low*pow(range.high/range.low, fraction);
+}
+
+/**
+ * Limit a value to a range
+ */
+double limit(const Range &range, double value) {
+   return fmin(range.high, fmax(range.low, value));
+}
+
+void report(const char *title, const Candidate &candidate, const Score &score) {
+   printf("%s: kp=%.6g, ki=%.6g, kd=%.6g, settle=%d\n", title, candidate.kp, candidate.ki, candidate.kd, candidate.tolerance);
+   printf("   Mean move time %.1f ms, max overshoot %.0f, max following error %.0f, max final error %.0f ticks",
+         score.meanMoveTime*1000, score.maxOvershoot, score.maxFollowingError, score.maxFinalError);
+   if (score.failures > 0) {
+      printf(", %u moves timed out", score.failures);
+   }
+   printf("%s\n", score.feasible?"":" - outside limits");
+}
+
+}
+
+int main(int argc, char *argv[]) {
+   for (int index=1; index<argc; index++) {
+      const char *arg = argv[index];
+      double value = 1;
+      if (strncmp(arg, "--output=", 9) == 0) {
+         options.output = arg+9;
+      }
+      else if (optionValue(arg, "--threads=", value)) {
+         options.threads = (unsigned)value;
+      }
+      else if (optionValue(arg, "--seed=", value)) {
+         options.seed = (unsigned)value;
+      }
+      else if (optionValue(arg, "--plants=", value)) {
+         options.plants = (unsigned)value;
+      }
+      else if (optionValue(arg, "--samples=", value)) {
+         options.samples = (unsigned)value;
+      }
+      else if (optionValue(arg, "--rounds=", value)) {
+         options.rounds = (unsigned)value;
+      }
+      else if (optionValue(arg, "--population=", value)) {
+         options.population = (unsigned)value;
+      }
+      else if (optionValue(arg, "--overshoot=", value)) {
+         options.overshoot = value;
+      }
+      else if (optionValue(arg, "--following=", value)) {
+         options.following = value;
+      }
+      else if (optionValue(arg, "--accuracy=", value)) {
+         options.accuracy = value;
+      }
+      else {
+         usage(argv[0]);
+      }
+      if (value <= 0) {
+         usage(argv[0]);
+      }
+   }
+   if (options.threads == 0) {
+      options.threads = 1;
+   }
+
+   std::mt19937 random(options.seed);
+   std::uniform_real_distribution<double> uniform(0.0, 1.0);
+   std::normal_distribution<double>       normal(0.0, 1.0);
+
+   const std::vector<Benchmark::Settings> plants = createPlants(random);
+
+   printf("%u plants, %u threads\n", options.plants, options.threads);
+   printf("Limits: overshoot %.0f, following error %.0f, final error %.0f ticks\n\n",
+         options.overshoot, options.following, options.accuracy);
+
+   // Current tuning is the first candidate so the result is never worse
+   const Benchmark::Settings &defaults = Benchmark::DEFAULT_SETTINGS;
+   std::vector<Candidate> candidates = {
+         {defaults.kp, defaults.ki, defaults.kd, defaults.tolerance},
+   };
+   for (unsigned sample=0; sample<options.samples; sample++) {
+      Candidate candidate;
+      candidate.kp        = logScale(KP_RANGE, uniform(random));
+      candidate.ki        = logScale(KI_RANGE, uniform(random));
+      candidate.kd        = logScale(KD_RANGE, uniform(random));
+      candidate.tolerance = (int)round(TOLERANCE_RANGE.low+(TOLERANCE_RANGE.high-TOLERANCE_RANGE.low)*uniform(random));
+      candidates.push_back(candidate);
+   }
+   std::vector<Score> scores = evaluate(candidates, plants);
+
+   const Candidate baseline      = candidates[0];
+   const Score     baselineScore = scores[0];
+
+   Candidate best      = candidates[0];
+   Score     bestScore = scores[0];
+   for (unsigned index=1; index<candidates.size(); index++) {
+      if (scores[index].cost < bestScore.cost) {
+         best      = candidates[index];
+         bestScore = scores[index];
+      }
+   }
+   printf("Initial search: %.1f ms\n", bestScore.cost*1000);
+
+   // Refine about the best so far with a shrinking step (log scale)
+   for (unsigned pass=0; pass<options.rounds; pass++) {
+      double step = 0.5*pow(0.1, (double)pass/(options.rounds>1?options.rounds-1:1));
+      candidates.clear();
+      for (unsigned member=0; member<options.population; member++) {
+         Candidate candidate;
+         candidate.kp        = limit(KP_RANGE, best.kp*exp(step*normal(random)));
+         candidate.ki        = limit(KI_RANGE, best.ki*exp(step*normal(random)));
+         candidate.kd        = limit(KD_RANGE, best.kd*exp(step*normal(random)));
+         candidate.tolerance = (int)limit(TOLERANCE_RANGE, round(best.tolerance+8*step*normal(random)));
+         candidates.push_back(candidate);
+      }
+      scores = evaluate(candidates, plants);
+      for (unsigned index=0; index<candidates.size(); index++) {
+         if (scores[index].cost < bestScore.cost) {
+            best      = candidates[index];
+            bestScore = scores[index];
+         }
+      }
+      printf("Round %2u: %.1f ms\n", pass+1, bestScore.cost*1000);
+   }
+   printf("\n");
+
+   report("Current", baseline, baselineScore);
+   report("Tuned  ", best, bestScore);
+   if (!bestScore.feasible) {
+      printf("\nNo tuning meets the limits\n");
+      return EXIT_FAILURE;
+   }
+
+   // Send to the console ('k' command) then save with 'w'
+   char record[200];
+   snprintf(record, sizeof(record), "k1 %.6g %.6g %.6g %d\nk2 %.6g %.6g %.6g %d\n",
+         best.kp, best.ki, best.kd, best.tolerance,
+         best.kp, best.ki, best.kd, best.tolerance);
+   printf("\nTuning record:\n%s", record);
+
+   if (options.output != nullptr) {
+      FILE *file = fopen(options.output, "w");
+      if ((file == nullptr) || (fputs(record, file) < 0) || (fclose(file) != 0)) {
+         fprintf(stderr, "Failed to write %s\n", options.output);
+         return EXIT_FAILURE;
+      }
+   }
+   return EXIT_SUCCESS;
+}
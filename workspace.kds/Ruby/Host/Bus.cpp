@@ -0,0 +1,213 @@
+/*
+ * Bus.cpp
+ *
+ *  Routes firmware register accesses to the peripheral models
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "HostRegister.h"
+#include "HostCpu.h"
+#include "Peripheral.h"
+#include "Simulator.h"
+
+namespace Host {
+
+namespace {
+
+/** Region of the address space decoded in pages */
+struct Region {
+   uint32_t    start;      //!< Start address
+   uint32_t    size;       //!< Size in bytes
+   bool        decoded;    //!< Peripheral models may be attached
+   const char *name;       //!< Name used in messages
+};
+
+/** Memory mapped for the firmware */
+constexpr Region regions[] = {
+      {0x00080000, 0x00080000, false, "Program flash (block 1)" },
+      {0x40000000, 0x00100000, true,  "Peripherals (AIPS, GPIO)" },
+      {0xE0000000, 0x00100000, true,  "Private peripheral bus" },
+};
+
+/** Pages in a decoded region */
+constexpr unsigned PAGES = 0x00100000>>Peripheral::PAGE_SHIFT;
+
+/** Models attached to the pages of the decoded regions */
+Peripheral *aipsPages[PAGES];
+Peripheral *ppbPages[PAGES];
+
+/**
+ * Get page table entry for address
+ *
+ * @param[in] address Address
+ *
+ * @return Entry or nullptr if not in a decoded region
+ */
+Peripheral **pageEntry(uint32_t address) {
+   if ((address-0x40000000) < 0x00100000) {
+      return &aipsPages[(address-0x40000000)>>Peripheral::PAGE_SHIFT];
+   }
+   if ((address-0xE0000000) < 0x00100000) {
+      return &ppbPages[(address-0xE0000000)>>Peripheral::PAGE_SHIFT];
+   }
+   return nullptr;
+}
+
+/**
+ * Read memory through a host pointer
+ */
+uint32_t pointerRead(const volatile void *p, unsigned size) {
+   switch(size) {
+      case 1:  return *(const volatile uint8_t  *)p;
+      case 2:  return *(const volatile uint16_t *)p;
+      default: return *(const volatile uint32_t *)p;
+   }
+}
+
+/**
+ * Write memory through a host pointer
+ */
+void pointerWrite(volatile void *p, uint32_t value, unsigned size) {
+   switch(size) {
+      case 1:  *(volatile uint8_t  *)p = (uint8_t)value;  break;
+      case 2:  *(volatile uint16_t *)p = (uint16_t)value; break;
+      default: *(volatile uint32_t *)p = value;           break;
+   }
+}
+
+/** Consecutive reads by the core without a write */
+unsigned readsWithoutWrite = 0;
+
+/**
+ * Check if a pointer is in the 32-bit target address space\n
+ * Host stack and heap are above 4 GiB - accesses there are plain memory
+ */
+inline bool isTargetAddress(const volatile void *address) {
+   return ((uintptr_t)address>>32) == 0;
+}
+
+/**
+ * Called on each access by the core
+ * Time passes and a long run of reads with no writes is treated as a polling loop
+ */
+inline void accessTime(bool isWrite) {
+   VirtualClock &clock = Simulator::clock();
+   clock.advance(Simulator::ACCESS_CYCLES);
+   if (isWrite) {
+      readsWithoutWrite = 0;
+      return;
+   }
+   if (++readsWithoutWrite >= Simulator::POLL_THRESHOLD) {
+      // Nothing can change until an event fires - skip ahead (limited so timeouts stay accurate)
+      uint64_t target = clock.now()+Simulator::POLL_SKIP_CYCLES;
+      if (clock.nextEvent() < target) {
+         target = clock.nextEvent();
+      }
+      clock.advanceTo(target);
+   }
+}
+
+}
+
+Peripheral::Peripheral(const char *name, uint32_t base, uint32_t size) : name(name), base(base) {
+   for (uint32_t address=base; address<(base+size); address += (1<<PAGE_SHIFT)) {
+      Peripheral **entry = pageEntry(address);
+      if ((entry == nullptr) || (*entry != nullptr)) {
+         fprintf(stderr, "%s: Can't attach model at 0x%08X\n", name, address);
+         abort();
+      }
+      *entry = this;
+   }
+}
+
+Peripheral *Peripheral::find(uint32_t address) {
+   Peripheral **entry = pageEntry(address);
+   return (entry == nullptr)?nullptr:*entry;
+}
+
+uint32_t Peripheral::rawRead(uint32_t address, unsigned size) {
+   return pointerRead((const volatile void *)(uintptr_t)address, size);
+}
+
+void Peripheral::rawWrite(uint32_t address, uint32_t value, unsigned size) {
+   pointerWrite((volatile void *)(uintptr_t)address, value, size);
+}
+
+uint32_t Peripheral::busRead(uint32_t address, unsigned size) {
+   Peripheral *peripheral = find(address);
+   if (peripheral == nullptr) {
+      return rawRead(address, size);
+   }
+   return peripheral->read(address-peripheral->base, size);
+}
+
+void Peripheral::busWrite(uint32_t address, uint32_t value, unsigned size) {
+   Peripheral *peripheral = find(address);
+   if (peripheral == nullptr) {
+      rawWrite(address, value, size);
+      return;
+   }
+   peripheral->write(address-peripheral->base, value, size);
+}
+
+void Peripheral::mapMemory() {
+   for (const Region &region : regions) {
+      void *address = (void *)(uintptr_t)region.start;
+      void *p = mmap(address, region.size, PROT_READ|PROT_WRITE,
+            MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED_NOREPLACE, -1, 0);
+      if (p != address) {
+         fprintf(stderr, "Failed to map %s at 0x%08X (%s)\n", region.name, region.start, strerror(errno));
+         fprintf(stderr, "The host executable must be linked without PIE\n");
+         exit(EXIT_FAILURE);
+      }
+      if (!region.decoded) {
+         // Erased flash
+         memset(p, 0xFF, region.size);
+      }
+   }
+}
+
+uint32_t Bus::read(const volatile void *address, unsigned size) {
+   if (!isTargetAddress(address)) {
+      return pointerRead(address, size);
+   }
+   accessTime(false);
+   uint32_t value = Peripheral::busRead((uint32_t)(uintptr_t)address, size);
+   Cpu::service();
+   return value;
+}
+
+void Bus::write(volatile void *address, uint32_t value, unsigned size) {
+   if (!isTargetAddress(address)) {
+      pointerWrite(address, value, size);
+      return;
+   }
+   accessTime(true);
+   Peripheral::busWrite((uint32_t)(uintptr_t)address, value, size);
+   Cpu::service();
+}
+
+void Bus::writeBit(volatile void *address, unsigned bitNum, bool value, unsigned size) {
+   uint32_t mask = (1U<<bitNum);
+   if (!isTargetAddress(address)) {
+      uint32_t data = pointerRead(address, size);
+      pointerWrite(address, value?(data|mask):(data&~mask), size);
+      return;
+   }
+   // The bit-band unit performs a locked read-modify-write on the bus
+   uint32_t target = (uint32_t)(uintptr_t)address;
+   accessTime(true);
+   uint32_t data = Peripheral::busRead(target, size);
+   Peripheral::busWrite(target, value?(data|mask):(data&~mask), size);
+   Cpu::service();
+}
+
+bool Bus::readBit(const volatile void *address, unsigned bitNum, unsigned size) {
+   return (read(address, size)>>bitNum)&1;
+}
+
+}
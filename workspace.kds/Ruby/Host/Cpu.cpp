@@ -0,0 +1,318 @@
+/*
+ * Cpu.cpp
+ *
+ *  Processor state and exception dispatch for the host build
+ */
+
+#include <stdio.h>
+#include "HostCpu.h"
+#include "Simulator.h"
+
+extern "C" {
+/* Nominal stack region (see Simulator.cpp) */
+extern uint32_t __StackLimit[];
+extern uint32_t __StackTop[];
+}
+
+namespace Host {
+
+namespace {
+
+/** Implemented priority bits (upper bits of the 8-bit priority fields) */
+constexpr uint8_t PRIORITY_MASK = 0xF0;
+
+/** Execution priority of thread mode - lower than any exception */
+constexpr int THREAD_PRIORITY = 256;
+
+/** Exceptions with fixed priority */
+constexpr int NMI_EXCEPTION       = 2;
+constexpr int HARDFAULT_EXCEPTION = 3;
+
+uint32_t primask   = 0;
+uint32_t basepri   = 0;
+uint32_t faultmask = 0;
+
+/** Per exception state (indexed by exception number i.e. IRQ number + 16) */
+bool          pending[Cpu::EXCEPTIONS];
+bool          level[Cpu::EXCEPTIONS];
+bool          enabled[Cpu::EXCEPTIONS];
+bool          active[Cpu::EXCEPTIONS];
+int           priority[Cpu::EXCEPTIONS];
+Cpu::Handler  handlers[Cpu::EXCEPTIONS];
+
+/** Number of pending exceptions - avoids scanning on each access */
+unsigned pendingCount = 0;
+
+/** Exceptions being handled (innermost last) */
+int      activeStack[Cpu::EXCEPTIONS];
+unsigned activeDepth = 0;
+
+/** Host stack pointer when first sampled - taken as the top of the nominal stack */
+uintptr_t stackBase = 0;
+
+/**
+ * Convert IRQ number to exception number
+ */
+inline int exceptionNumber(int irqNum) {
+   return irqNum+16;
+}
+
+/**
+ * Check exception number is valid
+ */
+inline bool isValid(int exception) {
+   return (exception > 0) && (exception < (int)Cpu::EXCEPTIONS);
+}
+
+void setPendingState(int exception, bool value) {
+   if (pending[exception] != value) {
+      pending[exception] = value;
+      if (value) {
+         pendingCount++;
+      }
+      else {
+         pendingCount--;
+      }
+   }
+}
+
+/**
+ * Get execution priority
+ *
+ * @param[in] ignorePrimask Ignore PRIMASK (used to decide if WFI wakes)
+ *
+ * @return Priority (lower value is higher priority)
+ */
+int executionPriority(bool ignorePrimask) {
+   int current = THREAD_PRIORITY;
+   if (activeDepth > 0) {
+      current = priority[activeStack[activeDepth-1]];
+   }
+   if ((basepri&PRIORITY_MASK) != 0) {
+      if ((int)(basepri&PRIORITY_MASK) < current) {
+         current = basepri&PRIORITY_MASK;
+      }
+   }
+   if (faultmask) {
+      current = -1;
+   }
+   else if (primask && !ignorePrimask) {
+      if (current > 0) {
+         current = 0;
+      }
+   }
+   return current;
+}
+
+/**
+ * Find pending exception that may preempt
+ *
+ * @param[in] ignorePrimask Ignore PRIMASK
+ *
+ * @return Exception number or 0 if none
+ */
+int findEligible(bool ignorePrimask) {
+   if (pendingCount == 0) {
+      return 0;
+   }
+   int best         = 0;
+   int bestPriority = executionPriority(ignorePrimask);
+   for (int exception=1; exception<(int)Cpu::EXCEPTIONS; exception++) {
+      if (!pending[exception] || active[exception]) {
+         continue;
+      }
+      if ((exception >= 16) && !enabled[exception]) {
+         continue;
+      }
+      if (priority[exception] < bestPriority) {
+         best         = exception;
+         bestPriority = priority[exception];
+      }
+   }
+   return best;
+}
+
+/**
+ * Run handler for exception
+ *
+ * @param[in] exception Exception number
+ */
+void dispatch(int exception) {
+   if (handlers[exception] == nullptr) {
+      char reason[60];
+      snprintf(reason, sizeof(reason), "Unhandled exception %d (IRQ %d)", exception, exception-16);
+      Simulator::exit(Simulator::Exit_Fault, reason);
+   }
+   setPendingState(exception, false);
+   active[exception] = true;
+   activeStack[activeDepth++] = exception;
+
+   handlers[exception]();
+
+   activeDepth--;
+   active[exception] = false;
+
+   // A level-sensitive request still asserted on return pends again
+   if (level[exception]) {
+      setPendingState(exception, true);
+   }
+}
+
+/**
+ * Reset state
+ */
+__attribute__((constructor(101)))
+void initialise() {
+   for (int exception=0; exception<(int)Cpu::EXCEPTIONS; exception++) {
+      priority[exception] = 0;
+   }
+   priority[NMI_EXCEPTION]       = -2;
+   priority[HARDFAULT_EXCEPTION] = -1;
+   stackBase = (uintptr_t)__builtin_frame_address(0);
+}
+
+}
+
+uint32_t Cpu::getPrimask() {
+   return primask;
+}
+
+void Cpu::setPrimask(uint32_t value) {
+   primask = value&1;
+   if (!primask) {
+      service();
+   }
+}
+
+uint32_t Cpu::getBasepri() {
+   return basepri;
+}
+
+void Cpu::setBasepri(uint32_t value) {
+   basepri = value&0xFF;
+   service();
+}
+
+void Cpu::setBasepriMax(uint32_t value) {
+   value &= 0xFF;
+   // Only raises the priority level
+   if ((value != 0) && ((basepri == 0) || ((value&PRIORITY_MASK) < (basepri&PRIORITY_MASK)))) {
+      basepri = value;
+   }
+}
+
+uint32_t Cpu::getFaultmask() {
+   return faultmask;
+}
+
+void Cpu::setFaultmask(uint32_t value) {
+   faultmask = value&1;
+   if (!faultmask) {
+      service();
+   }
+}
+
+uint32_t Cpu::getIpsr() {
+   return (activeDepth == 0)?0:activeStack[activeDepth-1];
+}
+
+uint32_t Cpu::getStackPointer() {
+   // Report the depth of the host stack within the nominal stack
+   uintptr_t sp    = (uintptr_t)__builtin_frame_address(0);
+   uintptr_t size  = (uintptr_t)__StackTop-(uintptr_t)__StackLimit;
+   uintptr_t depth = (stackBase > sp)?(stackBase-sp):0;
+   if (depth >= size) {
+      depth = size-sizeof(uint32_t);
+   }
+   return (uint32_t)((uintptr_t)__StackTop-depth);
+}
+
+void Cpu::waitForInterrupt() {
+   VirtualClock &clock = Simulator::clock();
+   while (findEligible(true) == 0) {
+      if (!clock.advanceToNextEvent()) {
+         Simulator::exit(Simulator::Exit_Deadlock, "WFI with no events pending");
+      }
+   }
+   service();
+}
+
+void Cpu::breakpoint(unsigned value) {
+   char reason[40];
+   snprintf(reason, sizeof(reason), "Breakpoint (BKPT #%u)", value);
+   Simulator::exit(Simulator::Exit_Success, reason);
+}
+
+void Cpu::service() {
+   for(;;) {
+      int exception = findEligible(false);
+      if (exception == 0) {
+         return;
+      }
+      dispatch(exception);
+   }
+}
+
+void Cpu::setIrqLevel(int irqNum, bool asserted) {
+   int exception = exceptionNumber(irqNum);
+   if (!isValid(exception)) {
+      return;
+   }
+   level[exception] = asserted;
+   if (asserted && !active[exception]) {
+      setPendingState(exception, true);
+   }
+}
+
+void Cpu::setPending(int irqNum) {
+   int exception = exceptionNumber(irqNum);
+   if (isValid(exception)) {
+      setPendingState(exception, true);
+   }
+}
+
+void Cpu::clearPending(int irqNum) {
+   int exception = exceptionNumber(irqNum);
+   if (isValid(exception)) {
+      setPendingState(exception, false);
+   }
+}
+
+bool Cpu::isPending(int irqNum) {
+   int exception = exceptionNumber(irqNum);
+   return isValid(exception) && pending[exception];
+}
+
+bool Cpu::isActive(int irqNum) {
+   int exception = exceptionNumber(irqNum);
+   return isValid(exception) && active[exception];
+}
+
+void Cpu::setEnabled(int irqNum, bool enable) {
+   int exception = exceptionNumber(irqNum);
+   if ((exception >= 16) && isValid(exception)) {
+      enabled[exception] = enable;
+   }
+}
+
+bool Cpu::isEnabled(int irqNum) {
+   int exception = exceptionNumber(irqNum);
+   return (exception >= 16) && isValid(exception) && enabled[exception];
+}
+
+void Cpu::setPriority(int irqNum, uint8_t value) {
+   int exception = exceptionNumber(irqNum);
+   // Reset, NMI and HardFault have fixed priority
+   if (isValid(exception) && (exception > HARDFAULT_EXCEPTION)) {
+      priority[exception] = value&PRIORITY_MASK;
+   }
+}
+
+void Cpu::setHandler(int irqNum, Handler handler) {
+   int exception = exceptionNumber(irqNum);
+   if (isValid(exception)) {
+      handlers[exception] = handler;
+   }
+}
+
+}
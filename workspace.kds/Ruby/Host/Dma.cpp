@@ -0,0 +1,368 @@
+/*
+ * Dma.cpp
+ *
+ *  Model of the eDMA controller and DMA channel multiplexor
+ */
+
+#include <stddef.h>
+#include <vector>
+#include "HostCpu.h"
+#include "Dma.h"
+#include "Simulator.h"
+
+namespace Host {
+
+namespace {
+
+/** Offsets of channel TCDs */
+constexpr uint32_t TCD_OFFSET = offsetof(DMA_Type, TCD);
+constexpr uint32_t TCD_SIZE   = sizeof(DMA_Type::TCD[0]);
+
+/** Offset of CSR within a TCD */
+constexpr uint32_t TCD_CSR = offsetof(DMA_Type, TCD[0].CSR)-TCD_OFFSET;
+
+/** Byte wide set/clear registers */
+constexpr uint32_t CEEI_OFFSET = offsetof(DMA_Type, CEEI);
+constexpr uint32_t CINT_OFFSET = offsetof(DMA_Type, CINT);
+
+/** Channel number field and 'all channels' bit of the set/clear registers */
+constexpr uint32_t CHANNEL_FIELD_MASK = 0x0F;
+constexpr uint32_t ALL_CHANNELS_MASK  = DMA_SERQ_SAER_MASK;
+
+/**
+ * Size of transfer in bytes from ATTR size code
+ */
+unsigned transferSize(unsigned code) {
+   static constexpr unsigned sizes[] = {1, 2, 4, 0, 16, 32, 0, 0};
+   return sizes[code&7];
+}
+
+/**
+ * Step an address with optional modulo
+ *
+ * @param[in] address Address
+ * @param[in] offset  Offset to add
+ * @param[in] modulo  Number of low address bits that change (0 => no modulo)
+ */
+uint32_t step(uint32_t address, int32_t offset, unsigned modulo) {
+   if (modulo == 0) {
+      return address+offset;
+   }
+   uint32_t mask = (1U<<modulo)-1;
+   return (address&~mask)|((address+offset)&mask);
+}
+
+}
+
+Dma::Dma() : Peripheral("DMA0", DMA0_BasePtr, 0x2000) {
+   // Channel priority registers reset to the channel number
+   for (unsigned channel=0; channel<CHANNELS; channel++) {
+      dma->DCHPRI[channel^3].value = channel;
+   }
+}
+
+/**
+ * Request source routed to a channel
+ *
+ * @return Source or SLOTS if channel is disabled in the multiplexor
+ */
+unsigned Dma::channelSource(unsigned channel) const {
+   uint32_t chcfg = rawRead(DMAMUX0_BasePtr+channel, sizeof(uint8_t));
+   if (!(chcfg&DMAMUX_CHCFG_ENBL_MASK)) {
+      return SLOTS;
+   }
+   return (chcfg&DMAMUX_CHCFG_SOURCE_MASK)>>DMAMUX_CHCFG_SOURCE_SHIFT;
+}
+
+/**
+ * Check if a hardware request is asserted and enabled for a channel
+ */
+bool Dma::isRequested(unsigned channel) const {
+   if (!(dma->ERQ.value&(1U<<channel))) {
+      return false;
+   }
+   unsigned source = channelSource(channel);
+   if (source >= SLOTS) {
+      return false;
+   }
+   return (source >= ALWAYS_ENABLED_SLOT) || (requests&(1ULL<<source));
+}
+
+/**
+ * Queue a minor loop for a channel and perform any waiting
+ */
+void Dma::start(unsigned channel) {
+   queue.push_back(channel);
+   runQueue();
+}
+
+/**
+ * Perform queued minor loops\n
+ * Transfers may cause further requests and links - these are queued rather
+ * than performed recursively.
+ */
+void Dma::runQueue() {
+   if (servicing) {
+      return;
+   }
+   servicing = true;
+   while (!queue.empty()) {
+      unsigned channel = queue.front();
+      queue.pop_front();
+      bool complete = serviceChannel(channel);
+      // A request that remains asserted is serviced again (up to the end of the major loop)
+      if (!complete && isRequested(channel)) {
+         queue.push_back(channel);
+      }
+   }
+   servicing = false;
+}
+
+/**
+ * Move data for one minor loop
+ *
+ * @param[in]     channel     Channel
+ * @param[in,out] source      Source address
+ * @param[in,out] destination Destination address
+ * @param[in]     bytes       Number of bytes
+ */
+void Dma::transfer(unsigned channel, uint32_t &source, uint32_t &destination, uint32_t bytes) {
+   volatile auto &tcd = dma->TCD[channel];
+   uint32_t attr        = tcd.ATTR.value;
+   unsigned sourceSize  = transferSize((attr&DMA_ATTR_SSIZE_MASK)>>DMA_ATTR_SSIZE_SHIFT);
+   unsigned destSize    = transferSize((attr&DMA_ATTR_DSIZE_MASK)>>DMA_ATTR_DSIZE_SHIFT);
+   unsigned sourceMod   = (attr&DMA_ATTR_SMOD_MASK)>>DMA_ATTR_SMOD_SHIFT;
+   unsigned destMod     = (attr&DMA_ATTR_DMOD_MASK)>>DMA_ATTR_DMOD_SHIFT;
+   int32_t  sourceStep  = (int16_t)tcd.SOFF.value;
+   int32_t  destStep    = (int16_t)tcd.DOFF.value;
+
+   if ((sourceSize == 0) || (destSize == 0)) {
+      Simulator::log("DMA channel %u: Illegal transfer size (ATTR=0x%04X)", channel, attr);
+      return;
+   }
+   std::vector<uint8_t> buffer(bytes);
+   for (uint32_t offset=0; offset<bytes; offset+=sourceSize) {
+      // 16 and 32 byte transfers are bursts of 32-bit accesses
+      unsigned access = (sourceSize > 4)?4:sourceSize;
+      for (unsigned part=0; (part<sourceSize) && (offset+part<bytes); part+=access) {
+         uint32_t value = busRead(source+part, access);
+         for (unsigned byte=0; (byte<access) && (offset+part+byte<bytes); byte++) {
+            buffer[offset+part+byte] = (uint8_t)(value>>(8*byte));
+         }
+      }
+      source = step(source, sourceStep, sourceMod);
+   }
+   for (uint32_t offset=0; offset<bytes; offset+=destSize) {
+      unsigned access = (destSize > 4)?4:destSize;
+      for (unsigned part=0; (part<destSize) && (offset+part<bytes); part+=access) {
+         uint32_t value = 0;
+         for (unsigned byte=0; (byte<access) && (offset+part+byte<bytes); byte++) {
+            value |= (uint32_t)buffer[offset+part+byte]<<(8*byte);
+         }
+         busWrite(destination+part, value, access);
+      }
+      destination = step(destination, destStep, destMod);
+   }
+}
+
+/**
+ * Perform one minor loop of a channel
+ *
+ * @return true if the major loop completed
+ */
+bool Dma::serviceChannel(unsigned channel) {
+   volatile auto &tcd = dma->TCD[channel];
+   uint32_t mask = (1U<<channel);
+
+   // Minor loop size and offset
+   uint32_t nbytes        = tcd.NBYTES_MLNO.value;
+   int32_t  loopOffset    = 0;
+   bool     sourceOffset  = false;
+   bool     destOffset    = false;
+   if (dma->CR.value&DMA_CR_EMLM_MASK) {
+      sourceOffset = nbytes&DMA_NBYTES_MLOFFYES_SMLOE_MASK;
+      destOffset   = nbytes&DMA_NBYTES_MLOFFYES_DMLOE_MASK;
+      if (sourceOffset || destOffset) {
+         // Sign-extend 20-bit offset
+         loopOffset = ((int32_t)(nbytes<<2))>>(DMA_NBYTES_MLOFFYES_MLOFF_SHIFT+2);
+         nbytes     = nbytes&DMA_NBYTES_MLOFFYES_NBYTES_MASK;
+      }
+      else {
+         nbytes = nbytes&~(DMA_NBYTES_MLOFFYES_SMLOE_MASK|DMA_NBYTES_MLOFFYES_DMLOE_MASK);
+      }
+   }
+   tcd.CSR.value = (tcd.CSR.value&~(DMA_CSR_START_MASK|DMA_CSR_DONE_MASK))|DMA_CSR_ACTIVE_MASK;
+
+   uint32_t source      = tcd.SADDR.value;
+   uint32_t destination = tcd.DADDR.value;
+   transfer(channel, source, destination, nbytes);
+   if (sourceOffset) {
+      source += loopOffset;
+   }
+   if (destOffset) {
+      destination += loopOffset;
+   }
+
+   // Major loop count
+   uint16_t citerReg  = tcd.CITER_ELINKYES.value;
+   bool     minorLink = citerReg&DMA_CITER_ELINKYES_ELINK_MASK;
+   uint16_t citerMask = minorLink?DMA_CITER_ELINKYES_CITER_MASK:DMA_CITER_ELINKNO_CITER_MASK;
+   uint16_t citer     = (citerReg-1)&citerMask;
+
+   uint16_t csr = tcd.CSR.value&~DMA_CSR_ACTIVE_MASK;
+   if (citer != 0) {
+      tcd.SADDR.value          = source;
+      tcd.DADDR.value          = destination;
+      tcd.CITER_ELINKYES.value = (citerReg&~citerMask)|citer;
+      tcd.CSR.value            = csr;
+      if ((csr&DMA_CSR_INTHALF_MASK) && (citer == ((tcd.BITER_ELINKYES.value&citerMask)/2))) {
+         dma->INT.value |= mask;
+         updateIrq(channel);
+      }
+      if (minorLink) {
+         queue.push_back((citerReg&DMA_CITER_ELINKYES_LINKCH_MASK)>>DMA_CITER_ELINKYES_LINKCH_SHIFT);
+      }
+      return false;
+   }
+
+   // Major loop complete
+   tcd.SADDR.value          = source+tcd.SLAST.value;
+   tcd.CITER_ELINKYES.value = tcd.BITER_ELINKYES.value;
+   if (csr&DMA_CSR_ESG_MASK) {
+      // Load next TCD from memory
+      uint32_t next = tcd.DLASTSGA.value;
+      for (uint32_t offset=0; offset<TCD_SIZE; offset+=sizeof(uint32_t)) {
+         rawWrite(DMA0_BasePtr+TCD_OFFSET+channel*TCD_SIZE+offset, rawRead(next+offset, sizeof(uint32_t)), sizeof(uint32_t));
+      }
+   }
+   else {
+      tcd.DADDR.value = destination+tcd.DLASTSGA.value;
+      tcd.CSR.value   = csr|DMA_CSR_DONE_MASK;
+   }
+   if (csr&DMA_CSR_INTMAJOR_MASK) {
+      dma->INT.value |= mask;
+      updateIrq(channel);
+   }
+   if (csr&DMA_CSR_DREQ_MASK) {
+      dma->ERQ.value &= ~mask;
+   }
+   if (csr&DMA_CSR_MAJORELINK_MASK) {
+      queue.push_back((csr&DMA_CSR_MAJORLINKCH_MASK)>>DMA_CSR_MAJORLINKCH_SHIFT);
+   }
+   if ((csr&DMA_CSR_ESG_MASK) && (tcd.CSR.value&DMA_CSR_START_MASK)) {
+      queue.push_back(channel);
+   }
+   return true;
+}
+
+void Dma::updateIrq(unsigned channel) {
+   Cpu::setIrqLevel(DMA0_IRQn+channel, dma->INT.value&(1U<<channel));
+}
+
+uint32_t Dma::read(uint32_t offset, unsigned size) {
+   if (offset == offsetof(DMA_Type, HRS)) {
+      uint32_t hrs = 0;
+      for (unsigned channel=0; channel<CHANNELS; channel++) {
+         unsigned source = channelSource(channel);
+         if ((source < SLOTS) && ((source >= ALWAYS_ENABLED_SLOT) || (requests&(1ULL<<source)))) {
+            hrs |= (1U<<channel);
+         }
+      }
+      return hrs;
+   }
+   return Peripheral::read(offset, size);
+}
+
+void Dma::write(uint32_t offset, uint32_t value, unsigned size) {
+   if ((offset >= CEEI_OFFSET) && (offset <= CINT_OFFSET) && (size == sizeof(uint8_t))) {
+      uint32_t mask = (value&ALL_CHANNELS_MASK)?0xFFFF:(1U<<(value&CHANNEL_FIELD_MASK));
+      switch(offset) {
+         case offsetof(DMA_Type, CEEI): dma->EEI.value &= ~mask; break;
+         case offsetof(DMA_Type, SEEI): dma->EEI.value |= mask;  break;
+         case offsetof(DMA_Type, CERQ): dma->ERQ.value &= ~mask; break;
+         case offsetof(DMA_Type, SERQ):
+            dma->ERQ.value |= mask;
+            for (unsigned channel=0; channel<CHANNELS; channel++) {
+               if ((mask&(1U<<channel)) && isRequested(channel)) {
+                  start(channel);
+               }
+            }
+            break;
+         case offsetof(DMA_Type, CDNE):
+            for (unsigned channel=0; channel<CHANNELS; channel++) {
+               if (mask&(1U<<channel)) {
+                  dma->TCD[channel].CSR.value &= ~DMA_CSR_DONE_MASK;
+               }
+            }
+            break;
+         case offsetof(DMA_Type, SSRT):
+            for (unsigned channel=0; channel<CHANNELS; channel++) {
+               if (mask&(1U<<channel)) {
+                  dma->TCD[channel].CSR.value |= DMA_CSR_START_MASK;
+                  start(channel);
+               }
+            }
+            break;
+         case offsetof(DMA_Type, CERR): dma->ERR.value &= ~mask; break;
+         case offsetof(DMA_Type, CINT):
+            dma->INT.value &= ~mask;
+            for (unsigned channel=0; channel<CHANNELS; channel++) {
+               updateIrq(channel);
+            }
+            break;
+      }
+      return;
+   }
+   switch(offset) {
+      case offsetof(DMA_Type, ES):
+      case offsetof(DMA_Type, HRS):
+         // Read-only
+         return;
+      case offsetof(DMA_Type, INT):
+         // w1c
+         dma->INT.value &= ~value;
+         for (unsigned channel=0; channel<CHANNELS; channel++) {
+            updateIrq(channel);
+         }
+         return;
+      case offsetof(DMA_Type, ERR):
+         dma->ERR.value &= ~value;
+         return;
+      case offsetof(DMA_Type, ERQ): {
+         uint32_t enabled = value&~dma->ERQ.value;
+         dma->ERQ.value = value;
+         for (unsigned channel=0; channel<CHANNELS; channel++) {
+            if ((enabled&(1U<<channel)) && isRequested(channel)) {
+               start(channel);
+            }
+         }
+         return;
+      }
+   }
+   Peripheral::write(offset, value, size);
+   if ((offset >= TCD_OFFSET) && (offset < TCD_OFFSET+CHANNELS*TCD_SIZE)) {
+      unsigned channel = (offset-TCD_OFFSET)/TCD_SIZE;
+      uint32_t reg     = (offset-TCD_OFFSET)%TCD_SIZE;
+      if ((reg <= TCD_CSR) && (reg+size > TCD_CSR) && (dma->TCD[channel].CSR.value&DMA_CSR_START_MASK)) {
+         start(channel);
+      }
+   }
+}
+
+void Dma::request(unsigned slot, bool asserted) {
+   if (slot >= SLOTS) {
+      return;
+   }
+   if (!asserted) {
+      requests &= ~(1ULL<<slot);
+      return;
+   }
+   requests |= (1ULL<<slot);
+   for (unsigned channel=0; channel<CHANNELS; channel++) {
+      if ((channelSource(channel) == slot) && isRequested(channel)) {
+         start(channel);
+      }
+   }
+}
+
+}
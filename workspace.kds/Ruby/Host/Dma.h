@@ -0,0 +1,82 @@
+/*
+ * Dma.h
+ *
+ *  Model of the eDMA controller and DMA channel multiplexor
+ */
+
+#ifndef HOST_DMA_H_
+#define HOST_DMA_H_
+
+#include <deque>
+#include "derivative.h"
+#include "Peripheral.h"
+
+namespace Host {
+
+/**
+ * eDMA controller (DMA0) with DMAMUX0 routing
+ *
+ *  - Minor loops with source/destination sizes, offsets, modulo and
+ *    minor loop offsets (CR.EMLM)
+ *  - Major loop completion with last address adjustments, scatter-gather,
+ *    interrupts (major and half) and DREQ
+ *  - Minor and major loop channel linking
+ *  - Software start (CSR.START, SSRT) and hardware requests routed through
+ *    DMAMUX0 CHCFG (PIT triggering is not modelled)
+ *
+ * Transfers take no simulated time and are performed as soon as they are
+ * requested. Accesses go through the peripheral models so e.g. reading an ADC
+ * result clears its conversion complete flag. DMAMUX0 is plain memory that is
+ * read when a request arrives. Arbitration, bandwidth control and error
+ * checking are not modelled.
+ */
+class Dma : public Peripheral {
+
+public:
+   /** Number of channels */
+   static constexpr unsigned CHANNELS = 16;
+
+   /** Number of request sources (DMAMUX slots) */
+   static constexpr unsigned SLOTS = 64;
+
+   /** First request source that is always asserted */
+   static constexpr unsigned ALWAYS_ENABLED_SLOT = Dma0Slot_AlwaysEnabled54;
+
+private:
+   volatile DMA_Type *const dma = (volatile DMA_Type *)DMA0_BasePtr;
+
+   /** Request sources currently asserted */
+   uint64_t requests = 0;
+
+   /** Minor loops waiting to be performed (channel numbers) */
+   std::deque<unsigned> queue;
+
+   /** Currently servicing channels - further starts are queued */
+   bool servicing = false;
+
+   unsigned channelSource(unsigned channel) const;
+   bool     isRequested(unsigned channel) const;
+   void     start(unsigned channel);
+   void     runQueue();
+   bool     serviceChannel(unsigned channel);
+   void     transfer(unsigned channel, uint32_t &source, uint32_t &destination, uint32_t bytes);
+   void     updateIrq(unsigned channel);
+
+public:
+   Dma();
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+
+   /**
+    * Set state of a hardware DMA request
+    *
+    * @param[in] slot     Request source (DMAMUX slot e.g. Dma0Slot_ADC0)
+    * @param[in] asserted Request level
+    */
+   void request(unsigned slot, bool asserted);
+};
+
+}
+
+#endif /* HOST_DMA_H_ */
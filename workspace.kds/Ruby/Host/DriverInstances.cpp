@@ -0,0 +1,23 @@
+/*
+ * DriverInstances.cpp
+ *
+ *  Host build - instantiates driver templates the firmware doesn't use yet
+ *
+ *  Members of a class template are only compiled when used. The drivers below
+ *  have no users in Sources/ so they are instantiated here to keep them compiling
+ *  (against the 64-bit host headers as well as the target).
+ */
+
+#include "hardware.h"
+#include "dma.h"
+#include "spi.h"
+
+namespace USBDM {
+
+// DMA queued transfers - SpiBase_T::transferAsync()
+template class SpiBase_T<Spi0Info>;
+
+// Continuous peripheral to memory ring - DmaTcdBuilder::destinationArray()
+template class DmaPingPong<uint16_t, 16>;
+
+} // End namespace USBDM
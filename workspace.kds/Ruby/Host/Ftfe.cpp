@@ -0,0 +1,168 @@
+/*
+ * Ftfe.cpp
+ *
+ *  Model of the Flash Memory Module
+ */
+
+#include <stddef.h>
+#include "HostCpu.h"
+#include "Ftfe.h"
+#include "Simulator.h"
+
+namespace Host {
+
+namespace {
+
+/** Flash commands (FCCOB0) */
+constexpr uint8_t F_RD1SEC  = 0x01;
+constexpr uint8_t F_RDRSRC  = 0x03;
+constexpr uint8_t F_PGM8    = 0x07;
+constexpr uint8_t F_ERSSCR  = 0x09;
+constexpr uint8_t F_PGMPART = 0x80;
+constexpr uint8_t F_SETRAM  = 0x81;
+
+/** FSTAT error flags (w1c) */
+constexpr uint8_t FSTAT_ERRORS = FTFE_FSTAT_RDCOLERR_MASK|FTFE_FSTAT_ACCERR_MASK|FTFE_FSTAT_FPVIOL_MASK;
+
+/** SETRAM function codes */
+constexpr uint8_t SETRAM_EEPROM   = 0x00;
+constexpr uint8_t SETRAM_RAM      = 0xFF;
+
+}
+
+Ftfe::Ftfe() :
+      Peripheral("FTFE", FTFE_BasePtr, 0x1000),
+      completeEvent(*this, &Ftfe::complete) {
+   ftfe->FSTAT.value = FTFE_FSTAT_CCIF_MASK;
+   ftfe->FCNFG.value = FTFE_FCNFG_RAMRDY_MASK;
+}
+
+/**
+ * Flash address from FCCOB1-3
+ */
+uint32_t Ftfe::commandAddress() const {
+   return (ftfe->FCCOB1.value<<16)|(ftfe->FCCOB2.value<<8)|ftfe->FCCOB3.value;
+}
+
+/**
+ * Carry out command in FCCOB
+ *
+ * @return Duration of command (s)
+ */
+double Ftfe::execute() {
+   uint32_t address = commandAddress();
+
+   switch(ftfe->FCCOB0.value) {
+      case F_PGM8: {
+         if (((address%PHRASE_SIZE) != 0) || (address < FLASH_START) || (address >= FLASH_END)) {
+            result = FTFE_FSTAT_ACCERR_MASK;
+            return COMMAND_TIME;
+         }
+         // Byte order as loaded by Flash::loadProgramPhrase()
+         const uint8_t data[PHRASE_SIZE] = {
+               ftfe->FCCOB7.value, ftfe->FCCOB6.value, ftfe->FCCOB5.value, ftfe->FCCOB4.value,
+               ftfe->FCCOBB.value, ftfe->FCCOBA.value, ftfe->FCCOB9.value, ftfe->FCCOB8.value,
+         };
+         for (unsigned index=0; index<PHRASE_SIZE; index++) {
+            // Programming only clears bits
+            rawWrite(address+index, rawRead(address+index, 1)&data[index], 1);
+         }
+         return PROGRAM_TIME;
+      }
+      case F_ERSSCR:
+         if (((address%SECTOR_SIZE) != 0) || (address < FLASH_START) || (address >= FLASH_END)) {
+            result = FTFE_FSTAT_ACCERR_MASK;
+            return COMMAND_TIME;
+         }
+         for (unsigned index=0; index<SECTOR_SIZE; index+=sizeof(uint32_t)) {
+            rawWrite(address+index, 0xFFFFFFFF, sizeof(uint32_t));
+         }
+         return ERASE_TIME;
+      case F_RD1SEC:
+         if ((address >= FLASH_START) && (address < FLASH_END)) {
+            unsigned count = ((ftfe->FCCOB4.value<<8)|ftfe->FCCOB5.value)*(2*PHRASE_SIZE);
+            for (unsigned index=0; (index<count) && (address+index<FLASH_END); index++) {
+               if (rawRead(address+index, 1) != 0xFF) {
+                  result = FTFE_FSTAT_MGSTAT0_MASK;
+                  break;
+               }
+            }
+         }
+         return COMMAND_TIME;
+      case F_RDRSRC:
+         ftfe->FCCOB4.value = 0;
+         ftfe->FCCOB5.value = 0;
+         ftfe->FCCOB6.value = 0;
+         ftfe->FCCOB7.value = 0;
+         return COMMAND_TIME;
+      case F_PGMPART:
+         return COMMAND_TIME;
+      case F_SETRAM:
+         if (ftfe->FCCOB1.value == SETRAM_EEPROM) {
+            ftfe->FCNFG.value = (ftfe->FCNFG.value&~FTFE_FCNFG_RAMRDY_MASK)|FTFE_FCNFG_EEERDY_MASK;
+         }
+         else if (ftfe->FCCOB1.value == SETRAM_RAM) {
+            ftfe->FCNFG.value = (ftfe->FCNFG.value&~FTFE_FCNFG_EEERDY_MASK)|FTFE_FCNFG_RAMRDY_MASK;
+         }
+         return COMMAND_TIME;
+      default:
+         Simulator::log("FTFE: Unsupported command 0x%02X", ftfe->FCCOB0.value);
+         result = FTFE_FSTAT_ACCERR_MASK;
+         return COMMAND_TIME;
+   }
+}
+
+/**
+ * Command has completed
+ */
+void Ftfe::complete(unsigned, uint64_t) {
+   ftfe->FSTAT.value |= FTFE_FSTAT_CCIF_MASK|result;
+   updateIrq();
+}
+
+void Ftfe::updateIrq() {
+   Cpu::setIrqLevel(FTF_Command_IRQn,
+         (ftfe->FSTAT.value&FTFE_FSTAT_CCIF_MASK) && (ftfe->FCNFG.value&FTFE_FCNFG_CCIE_MASK));
+}
+
+void Ftfe::write(uint32_t offset, uint32_t value, unsigned size) {
+   if (!(ftfe->FSTAT.value&FTFE_FSTAT_CCIF_MASK) &&
+         (offset >= offsetof(FTFE_Type, FCCOB3)) && (offset <= offsetof(FTFE_Type, FCCOB8))) {
+      // FCCOB can't be changed while a command is running
+      return;
+   }
+   switch(offset) {
+      case offsetof(FTFE_Type, FSTAT): {
+         uint8_t fstat = ftfe->FSTAT.value;
+         fstat &= ~(value&FSTAT_ERRORS);
+         if ((value&FTFE_FSTAT_CCIF_MASK) && (fstat&FTFE_FSTAT_CCIF_MASK)) {
+            if (fstat&(FTFE_FSTAT_ACCERR_MASK|FTFE_FSTAT_FPVIOL_MASK)) {
+               // Launch is ignored while an error flag is set
+               ftfe->FSTAT.value = fstat;
+               return;
+            }
+            fstat  &= ~(FTFE_FSTAT_CCIF_MASK|FTFE_FSTAT_MGSTAT0_MASK);
+            result  = 0;
+            ftfe->FSTAT.value = fstat;
+            Simulator::clock().scheduleIn(completeEvent, Simulator::clock().toCycles(execute()));
+         }
+         else {
+            ftfe->FSTAT.value = fstat;
+         }
+         updateIrq();
+         return;
+      }
+      case offsetof(FTFE_Type, FCNFG):
+         // Only interrupt enables are writable
+         ftfe->FCNFG.value = (ftfe->FCNFG.value&~(FTFE_FCNFG_CCIE_MASK|FTFE_FCNFG_RDCOLLIE_MASK))|
+               (value&(FTFE_FCNFG_CCIE_MASK|FTFE_FCNFG_RDCOLLIE_MASK));
+         updateIrq();
+         return;
+      case offsetof(FTFE_Type, FSEC):
+      case offsetof(FTFE_Type, FOPT):
+         return;
+   }
+   Peripheral::write(offset, value, size);
+}
+
+}
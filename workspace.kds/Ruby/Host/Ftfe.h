@@ -0,0 +1,68 @@
+/*
+ * Ftfe.h
+ *
+ *  Model of the Flash Memory Module
+ */
+
+#ifndef HOST_FTFE_H_
+#define HOST_FTFE_H_
+
+#include "derivative.h"
+#include "Peripheral.h"
+#include "VirtualClock.h"
+
+namespace Host {
+
+/**
+ * Flash Memory Module (FTFE)
+ *
+ *  - Program phrase (PGM8) and erase sector (ERSSCR) in program flash block 1
+ *    (the block that doesn't hold the code)
+ *  - Read 1s section, read resource, program partition and set FlexRAM are
+ *    accepted and complete without effect
+ *  - Commands take a typical time during which CCIF is clear
+ *  - Command complete interrupt
+ *
+ * Programming can only clear bits, as on the device. Protection and security
+ * are not modelled. Other commands fail with ACCERR.
+ */
+class Ftfe : public Peripheral {
+
+public:
+   /** Range of program flash that may be programmed */
+   static constexpr uint32_t FLASH_START = 0x00080000;
+   static constexpr uint32_t FLASH_END   = 0x00100000;
+
+   /** Program phrase size (bytes) */
+   static constexpr uint32_t PHRASE_SIZE = 8;
+
+   /** Program flash sector size (bytes) */
+   static constexpr uint32_t SECTOR_SIZE = 4096;
+
+   /** Typical command times (s) */
+   static constexpr double PROGRAM_TIME = 70e-6;
+   static constexpr double ERASE_TIME   = 15e-3;
+   static constexpr double COMMAND_TIME = 10e-6;
+
+private:
+   volatile FTFE_Type *const ftfe = (volatile FTFE_Type *)FTFE_BasePtr;
+
+   EventOf<Ftfe> completeEvent;
+
+   /** FSTAT error flags of the command in progress */
+   uint8_t result = 0;
+
+   uint32_t commandAddress() const;
+   double   execute();
+   void     complete(unsigned, uint64_t now);
+   void     updateIrq();
+
+public:
+   Ftfe();
+
+   virtual void write(uint32_t offset, uint32_t value, unsigned size) override;
+};
+
+}
+
+#endif /* HOST_FTFE_H_ */
@@ -0,0 +1,449 @@
+/*
+ * Ftm.cpp
+ *
+ *  Model of the FlexTimer Module
+ */
+
+#include <stddef.h>
+#include "HostCpu.h"
+#include "Ftm.h"
+#include "Simulator.h"
+
+namespace Host {
+
+namespace {
+
+/** Offsets of channel registers */
+constexpr uint32_t CONTROLS_OFFSET = offsetof(FTM_Type, CONTROLS);
+constexpr uint32_t CONTROLS_SIZE   = sizeof(FTM_Type::CONTROLS[0]);
+
+/** Counter is 16 bits */
+constexpr uint32_t COUNTER_MASK = 0xFFFF;
+
+/** Channel mode bits - channel is in use if any are set */
+constexpr uint32_t CnSC_MODE_MASK = FTM_CnSC_MS_MASK|FTM_CnSC_ELS_MASK;
+
+/** Read-only status bits of QDCTRL */
+constexpr uint32_t QDCTRL_STATUS_MASK = FTM_QDCTRL_TOFDIR_MASK|FTM_QDCTRL_QUADIR_MASK;
+
+/** Fault flags for individual inputs */
+constexpr uint32_t FMS_INPUT_FLAGS_MASK =
+      FTM_FMS_FAULTF0_MASK|FTM_FMS_FAULTF1_MASK|FTM_FMS_FAULTF2_MASK|FTM_FMS_FAULTF3_MASK;
+
+/** Fault control modes (MODE.FAULTM) */
+constexpr unsigned FAULTM_DISABLED  = 0;
+constexpr unsigned FAULTM_AUTOMATIC = 3;
+
+}
+
+Ftm::Ftm(const char *name, uint32_t base, int irqNum, unsigned channels) :
+      Peripheral(name, base, 0x1000),
+      ftm((volatile FTM_Type *)(uintptr_t)base),
+      irqNum(irqNum),
+      channels(channels),
+      overflowEvent(*this, &Ftm::overflow) {
+}
+
+bool Ftm::isQuadrature() const {
+   return ftm->QDCTRL.value&FTM_QDCTRL_QUADEN_MASK;
+}
+
+/**
+ * Counter maximum (MOD = 0 => free running)
+ */
+uint32_t Ftm::modulo() const {
+   uint32_t mod = ftm->MOD.value&COUNTER_MASK;
+   return (mod == 0)?COUNTER_MASK:mod;
+}
+
+/**
+ * Counter period (ticks)
+ */
+uint32_t Ftm::period() const {
+   uint32_t cntin = ftm->CNTIN.value&COUNTER_MASK;
+   if (cntin >= modulo()) {
+      return 1;
+   }
+   if (ftm->SC.value&FTM_SC_CPWMS_MASK) {
+      return 2*(modulo()-cntin);
+   }
+   return modulo()-cntin+1;
+}
+
+/**
+ * Duration of a counter tick (core cycles)
+ *
+ * @return Cycles or 0 if the counter is not clocked
+ */
+uint64_t Ftm::tickCycles() const {
+   unsigned prescale = 1U<<((ftm->SC.value&FTM_SC_PS_MASK)>>FTM_SC_PS_SHIFT);
+   switch((ftm->SC.value&FTM_SC_CLKS_MASK)>>FTM_SC_CLKS_SHIFT) {
+      case 1:  return (uint64_t)(Simulator::CORE_CLOCK/Simulator::BUS_CLOCK)*prescale;
+      case 2:  return (uint64_t)(Simulator::CORE_CLOCK/FIXED_CLOCK)*prescale;
+      default: return 0;
+   }
+}
+
+/**
+ * Counter value
+ *
+ * @param[in] now Current time (cycles)
+ */
+uint32_t Ftm::counterAt(uint64_t now) const {
+   if (!counting) {
+      return ftm->CNT.value;
+   }
+   uint32_t cntin = ftm->CNTIN.value&COUNTER_MASK;
+   uint32_t phase = (uint32_t)((startPhase+(now-countStart)/tickCycles())%period());
+   if (ftm->SC.value&FTM_SC_CPWMS_MASK) {
+      uint32_t half = modulo()-cntin;
+      return (phase <= half)?cntin+phase:modulo()-(phase-half);
+   }
+   return cntin+phase;
+}
+
+/**
+ * Continue counting from a value after the configuration changes
+ *
+ * @param[in] count Counter value
+ */
+void Ftm::restart(uint32_t count) {
+   VirtualClock &clock = Simulator::clock();
+   counting = !isQuadrature() && (tickCycles() != 0);
+   if (!counting) {
+      clock.cancel(overflowEvent);
+      ftm->CNT.value = count&COUNTER_MASK;
+      return;
+   }
+   uint32_t cntin = ftm->CNTIN.value&COUNTER_MASK;
+   startPhase = (count > cntin)?(count-cntin):0;
+   if (startPhase >= period()) {
+      startPhase = 0;
+   }
+   countStart = clock.now();
+   clock.schedule(overflowEvent, countStart+(period()-startPhase)*tickCycles());
+}
+
+void Ftm::overflow(unsigned, uint64_t now) {
+   countStart = now;
+   startPhase = 0;
+   for (unsigned channel=0; channel<channels; channel++) {
+      volatile uint32_t &cnsc = ftm->CONTROLS[channel].CnSC.value;
+      if (cnsc&CnSC_MODE_MASK) {
+         cnsc |= FTM_CnSC_CHF_MASK;
+         ftm->STATUS.value |= (1U<<channel);
+         chfRead &= ~(1U<<channel);
+      }
+   }
+   if (overflows++ >= (ftm->CONF.value&FTM_CONF_NUMTOF_MASK)) {
+      overflows = 0;
+      setTimerOverflow(false);
+   }
+   Simulator::clock().schedule(overflowEvent, now+period()*tickCycles());
+}
+
+/**
+ * Set TOF
+ *
+ * @param[in] direction Quadrature counter overflowed at the top (MOD => CNTIN)
+ */
+void Ftm::setTimerOverflow(bool direction) {
+   ftm->SC.value |= FTM_SC_TOF_MASK;
+   tofRead = false;
+   if (direction) {
+      ftm->QDCTRL.value |= FTM_QDCTRL_TOFDIR_MASK;
+   }
+   else {
+      ftm->QDCTRL.value &= ~FTM_QDCTRL_TOFDIR_MASK;
+   }
+   updateIrq();
+}
+
+/**
+ * Check if a fault input is asserted (enabled and at its active level)
+ *
+ * @param[in] input Fault input (0..3)
+ */
+bool Ftm::isFaultInputActive(unsigned input) const {
+   if (!(ftm->FLTCTRL.value&(1U<<input))) {
+      return false;
+   }
+   bool level = faultPins[input];
+   if ((base == FTM0_BasePtr) && (input < 3) &&
+         (rawRead(SIM_BasePtr+offsetof(SIM_Type, SOPT4), sizeof(uint32_t))&(SIM_SOPT4_FTM0FLT0_MASK<<input))) {
+      level = comparators[input];
+   }
+   // FLTPOL set => active low
+   return (ftm->FLTPOL.value&(1U<<input))?!level:level;
+}
+
+/**
+ * Update fault flags from the fault inputs
+ */
+void Ftm::updateFaults() {
+   uint32_t fms = ftm->FMS.value&~FTM_FMS_FAULTIN_MASK;
+   if (((ftm->MODE.value&FTM_MODE_FAULTM_MASK)>>FTM_MODE_FAULTM_SHIFT) != FAULTM_DISABLED) {
+      for (unsigned input=0; input<FAULT_INPUTS; input++) {
+         if (isFaultInputActive(input)) {
+            fms |= (1U<<input)|FTM_FMS_FAULTIN_MASK|FTM_FMS_FAULTF_MASK;
+         }
+      }
+   }
+   ftm->FMS.value = fms;
+   updateIrq();
+}
+
+/**
+ * Check if fault control has forced a channel to its safe state
+ *
+ * @param[in] channel Channel number
+ */
+bool Ftm::isOutputDisabled(unsigned channel) const {
+   if (!(ftm->COMBINE.value&(FTM_COMBINE_FAULTEN0_MASK<<(8*(channel/2))))) {
+      return false;
+   }
+   switch((ftm->MODE.value&FTM_MODE_FAULTM_MASK)>>FTM_MODE_FAULTM_SHIFT) {
+      case FAULTM_DISABLED:
+         return false;
+      case FAULTM_AUTOMATIC:
+         return ftm->FMS.value&FTM_FMS_FAULTIN_MASK;
+      default:
+         return ftm->FMS.value&FTM_FMS_FAULTF_MASK;
+   }
+}
+
+void Ftm::updateIrq() {
+   bool asserted =
+         ((ftm->SC.value&FTM_SC_TOF_MASK) && (ftm->SC.value&FTM_SC_TOIE_MASK)) ||
+         ((ftm->FMS.value&FTM_FMS_FAULTF_MASK) && (ftm->MODE.value&FTM_MODE_FAULTIE_MASK));
+   for (unsigned channel=0; channel<channels; channel++) {
+      uint32_t cnsc = ftm->CONTROLS[channel].CnSC.value;
+      if ((cnsc&FTM_CnSC_CHF_MASK) && (cnsc&FTM_CnSC_CHIE_MASK)) {
+         asserted = true;
+      }
+   }
+   Cpu::setIrqLevel(irqNum, asserted);
+}
+
+uint32_t Ftm::read(uint32_t offset, unsigned size) {
+   if ((offset >= CONTROLS_OFFSET) && (offset < CONTROLS_OFFSET+channels*CONTROLS_SIZE) &&
+         (((offset-CONTROLS_OFFSET)%CONTROLS_SIZE) == 0)) {
+      unsigned channel = (offset-CONTROLS_OFFSET)/CONTROLS_SIZE;
+      if (ftm->CONTROLS[channel].CnSC.value&FTM_CnSC_CHF_MASK) {
+         chfRead |= (1U<<channel);
+      }
+      return ftm->CONTROLS[channel].CnSC.value;
+   }
+   switch(offset) {
+      case offsetof(FTM_Type, SC):
+         if (ftm->SC.value&FTM_SC_TOF_MASK) {
+            tofRead = true;
+         }
+         return ftm->SC.value;
+      case offsetof(FTM_Type, CNT):
+         return counterAt(Simulator::clock().now());
+      case offsetof(FTM_Type, STATUS):
+         chfRead |= ftm->STATUS.value;
+         return ftm->STATUS.value;
+      default:
+         return Peripheral::read(offset, size);
+   }
+}
+
+void Ftm::write(uint32_t offset, uint32_t value, unsigned size) {
+   uint64_t now = Simulator::clock().now();
+
+   if ((offset >= CONTROLS_OFFSET) && (offset < CONTROLS_OFFSET+channels*CONTROLS_SIZE)) {
+      unsigned channel = (offset-CONTROLS_OFFSET)/CONTROLS_SIZE;
+      uint32_t mask    = (1U<<channel);
+      if (((offset-CONTROLS_OFFSET)%CONTROLS_SIZE) != 0) {
+         // CnV
+         ftm->CONTROLS[channel].CnV.value = value&COUNTER_MASK;
+         return;
+      }
+      uint32_t chf = ftm->CONTROLS[channel].CnSC.value&FTM_CnSC_CHF_MASK;
+      if (!(value&FTM_CnSC_CHF_MASK) && (chfRead&mask)) {
+         chf                = 0;
+         chfRead           &= ~mask;
+         ftm->STATUS.value &= ~mask;
+      }
+      ftm->CONTROLS[channel].CnSC.value = (value&~FTM_CnSC_CHF_MASK&0x7F)|chf;
+      updateIrq();
+      return;
+   }
+   switch(offset) {
+      case offsetof(FTM_Type, SC): {
+         uint32_t count = counterAt(now);
+         uint32_t tof   = ftm->SC.value&FTM_SC_TOF_MASK;
+         // TOF is cleared by writing 0 after reading it as 1
+         if (!(value&FTM_SC_TOF_MASK) && tofRead) {
+            tof     = 0;
+            tofRead = false;
+         }
+         ftm->SC.value = (value&~FTM_SC_TOF_MASK&0x7F)|tof;
+         restart(count);
+         updateIrq();
+         break;
+      }
+      case offsetof(FTM_Type, CNT):
+         // Writing any value loads CNTIN
+         restart(ftm->CNTIN.value&COUNTER_MASK);
+         break;
+      case offsetof(FTM_Type, MOD):
+      case offsetof(FTM_Type, CNTIN): {
+         uint32_t count = counterAt(now);
+         rawWrite(base+offset, value&COUNTER_MASK, sizeof(uint32_t));
+         restart(count);
+         break;
+      }
+      case offsetof(FTM_Type, STATUS):
+         for (unsigned channel=0; channel<channels; channel++) {
+            uint32_t mask = (1U<<channel);
+            if ((ftm->STATUS.value&mask) && !(value&mask) && (chfRead&mask)) {
+               ftm->STATUS.value                 &= ~mask;
+               ftm->CONTROLS[channel].CnSC.value &= ~FTM_CnSC_CHF_MASK;
+               chfRead                           &= ~mask;
+            }
+         }
+         updateIrq();
+         break;
+      case offsetof(FTM_Type, FMS): {
+         // Flags are cleared by writing 0 only once the input is inactive
+         uint32_t fms = (ftm->FMS.value&~FTM_FMS_WPEN_MASK)|(value&FTM_FMS_WPEN_MASK);
+         for (unsigned input=0; input<FAULT_INPUTS; input++) {
+            if (!(value&(1U<<input)) && !isFaultInputActive(input)) {
+               fms &= ~(1U<<input);
+            }
+         }
+         if (!(value&FTM_FMS_FAULTF_MASK) && !(fms&FMS_INPUT_FLAGS_MASK)) {
+            fms &= ~FTM_FMS_FAULTF_MASK;
+         }
+         ftm->FMS.value = fms;
+         updateFaults();
+         break;
+      }
+      case offsetof(FTM_Type, MODE):
+      case offsetof(FTM_Type, COMBINE):
+      case offsetof(FTM_Type, FLTCTRL):
+      case offsetof(FTM_Type, FLTPOL):
+         rawWrite(base+offset, value, sizeof(uint32_t));
+         updateFaults();
+         break;
+      case offsetof(FTM_Type, QDCTRL): {
+         uint32_t count = counterAt(now);
+         ftm->QDCTRL.value = (value&~QDCTRL_STATUS_MASK)|(ftm->QDCTRL.value&QDCTRL_STATUS_MASK);
+         restart(count);
+         break;
+      }
+      default:
+         Peripheral::write(offset, value, size);
+         break;
+   }
+}
+
+void Ftm::setFaultInput(unsigned input, bool level) {
+   if (input < FAULT_INPUTS) {
+      faultPins[input] = level;
+      updateFaults();
+   }
+}
+
+void Ftm::setComparatorOutput(unsigned input, bool level) {
+   if (input < FAULT_INPUTS) {
+      comparators[input] = level;
+      updateFaults();
+   }
+}
+
+void Ftm::setEncoderCount(int64_t count) {
+   int64_t delta = count-encoderCount;
+   encoderCount  = count;
+   if (!isQuadrature() || (delta == 0)) {
+      return;
+   }
+   int64_t cntin = ftm->CNTIN.value&COUNTER_MASK;
+   int64_t span  = (int64_t)modulo()-cntin+1;
+   if (span <= 0) {
+      return;
+   }
+   int64_t position = (int64_t)(ftm->CNT.value&COUNTER_MASK)-cntin+delta;
+   if (delta > 0) {
+      ftm->QDCTRL.value |= FTM_QDCTRL_QUADIR_MASK;
+   }
+   else {
+      ftm->QDCTRL.value &= ~FTM_QDCTRL_QUADIR_MASK;
+   }
+   if (position >= span) {
+      setTimerOverflow(true);
+   }
+   else if (position < 0) {
+      setTimerOverflow(false);
+   }
+   position %= span;
+   if (position < 0) {
+      position += span;
+   }
+   ftm->CNT.value = (uint32_t)(cntin+position);
+}
+
+double Ftm::getDutyCycle(unsigned channel, double undriven) const {
+   if (channel >= channels) {
+      return 0.0;
+   }
+   uint32_t mask     = (1U<<channel);
+   bool     inverted = ftm->POL.value&mask;
+
+   // Masked or faulted channels are forced to the inactive state
+   if ((ftm->OUTMASK.value&mask) || isOutputDisabled(channel)) {
+      return inverted?1.0:0.0;
+   }
+   uint32_t cnsc = ftm->CONTROLS[channel].CnSC.value;
+   if ((cnsc&FTM_CnSC_ELS_MASK) == 0) {
+      // Pin not controlled by channel
+      return undriven;
+   }
+   double high;
+   if (tickCycles() == 0) {
+      // Counter stopped - output holds its initial value
+      high = (ftm->OUTINIT.value&mask)?1.0:0.0;
+   }
+   else {
+      double   cntin   = ftm->CNTIN.value&COUNTER_MASK;
+      double   mod     = modulo();
+      unsigned pair    = channel/2;
+      uint32_t combine = ftm->COMBINE.value>>(8*pair);
+      if (combine&FTM_COMBINE_COMBINE0_MASK) {
+         // Combined PWM - high between the matches of the even and odd channels
+         double start = ftm->CONTROLS[2*pair].CnV.value&COUNTER_MASK;
+         double end   = ftm->CONTROLS[2*pair+1].CnV.value&COUNTER_MASK;
+         high = (end-start)/(mod-cntin+1);
+         if ((channel&1) && (combine&FTM_COMBINE_COMP0_MASK)) {
+            high = 1.0-high;
+         }
+         cnsc = ftm->CONTROLS[2*pair].CnSC.value;
+      }
+      else if (ftm->SC.value&FTM_SC_CPWMS_MASK) {
+         high = ((ftm->CONTROLS[channel].CnV.value&COUNTER_MASK)-cntin)/(mod-cntin);
+      }
+      else if (cnsc&FTM_CnSC_MSB_MASK) {
+         high = ((ftm->CONTROLS[channel].CnV.value&COUNTER_MASK)-cntin)/(mod-cntin+1);
+      }
+      else {
+         // Output compare etc. - not a steady duty cycle
+         high = 0.0;
+      }
+      if (high < 0.0) {
+         high = 0.0;
+      }
+      else if (high > 1.0) {
+         high = 1.0;
+      }
+      // ELSB:ELSA = 01 => low-true pulses
+      if ((cnsc&FTM_CnSC_ELS_MASK) == FTM_CnSC_ELSA_MASK) {
+         high = 1.0-high;
+      }
+   }
+   return inverted?(1.0-high):high;
+}
+
+}
@@ -0,0 +1,140 @@
+/*
+ * Ftm.h
+ *
+ *  Model of the FlexTimer Module
+ */
+
+#ifndef HOST_FTM_H_
+#define HOST_FTM_H_
+
+#include "derivative.h"
+#include "Peripheral.h"
+#include "VirtualClock.h"
+
+namespace Host {
+
+/**
+ * FlexTimer Module
+ *
+ *  - Up counting (edge-aligned) and up-down counting (CPWMS) from the
+ *    system or fixed frequency clock with prescaler
+ *  - Timer overflow flag and interrupt (every CONF.NUMTOF+1 counter overflows)
+ *  - Channel flags are set at each overflow for channels in use (the match
+ *    time within the period is not modelled)
+ *  - Quadrature decoder counting driven by setEncoderCount()
+ *  - Fault inputs driven by setFaultInput()/setComparatorOutput() with
+ *    manual and automatic fault clearing
+ *  - Register buffering, synchronisation, dead-time and input capture are not
+ *    modelled - writes take effect immediately
+ *
+ * The output of a channel can be observed with getDutyCycle().
+ */
+class Ftm : public Peripheral {
+
+public:
+   /** Number of fault inputs */
+   static constexpr unsigned FAULT_INPUTS = 4;
+
+   /** Fixed frequency clock (MCGFFCLK) */
+   static constexpr uint32_t FIXED_CLOCK = 32768;
+
+private:
+   volatile FTM_Type *const ftm;
+
+   /** IRQ number */
+   const int irqNum;
+
+   /** Number of channels implemented */
+   const unsigned channels;
+
+   /** Counter is being clocked (not in quadrature mode) */
+   bool     counting   = false;
+   /** Time of last counter reload or restart */
+   uint64_t countStart = 0;
+   /** Position in the counter period at countStart (ticks) */
+   uint32_t startPhase = 0;
+
+   /** Counter reaching the end of its period */
+   EventOf<Ftm> overflowEvent;
+
+   /** Counter overflows since TOF was last set (see CONF.NUMTOF) */
+   unsigned overflows = 0;
+
+   /** TOF was read as set (required before it may be cleared) */
+   bool    tofRead = false;
+   /** Channel flags read as set */
+   uint8_t chfRead = 0;
+
+   /** Levels of fault input pins */
+   bool faultPins[FAULT_INPUTS]   = {true, true, true, true};
+   /** Outputs of comparators that may be used as fault inputs (FTM0 only) */
+   bool comparators[FAULT_INPUTS] = {};
+
+   /** Last count from the encoder */
+   int64_t encoderCount = 0;
+
+   bool     isQuadrature() const;
+   uint32_t modulo() const;
+   uint32_t period() const;
+   uint64_t tickCycles() const;
+   uint32_t counterAt(uint64_t now) const;
+   void     restart(uint32_t count);
+   void     overflow(unsigned, uint64_t now);
+   void     setTimerOverflow(bool direction);
+   bool     isFaultInputActive(unsigned input) const;
+   void     updateFaults();
+   bool     isOutputDisabled(unsigned channel) const;
+   void     updateIrq();
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] name     Name used in messages
+    * @param[in] base     Base address
+    * @param[in] irqNum   IRQ number
+    * @param[in] channels Number of channels implemented
+    */
+   Ftm(const char *name, uint32_t base, int irqNum, unsigned channels);
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+
+   /**
+    * Set level of a fault input pin
+    *
+    * @param[in] input Fault input (0..3)
+    * @param[in] level Pin level
+    */
+   void setFaultInput(unsigned input, bool level);
+
+   /**
+    * Set output of the comparator that may drive a fault input (see SIM_SOPT4)
+    *
+    * @param[in] input Fault input (0..2)
+    * @param[in] level Comparator output
+    */
+   void setComparatorOutput(unsigned input, bool level);
+
+   /**
+    * Move the encoder (quadrature decoder mode)\n
+    * The counter changes by the difference from the previous count.
+    *
+    * @param[in] count Encoder position (counts)
+    */
+   void setEncoderCount(int64_t count);
+
+   /**
+    * Fraction of time a channel output is high
+    *
+    * @param[in] channel  Channel number
+    * @param[in] undriven Level of the pin when the channel is not driving it e.g. 1.0 with a pull-up
+    *
+    * @return Duty cycle 0.0..1.0 as seen on the pin (after polarity, masking and fault control)
+    */
+   double getDutyCycle(unsigned channel, double undriven=0.0) const;
+};
+
+}
+
+#endif /* HOST_FTM_H_ */
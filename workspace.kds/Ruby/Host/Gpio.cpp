@@ -0,0 +1,57 @@
+/*
+ * Gpio.cpp
+ *
+ *  Model of the GPIO ports
+ */
+
+#include <stddef.h>
+#include "Gpio.h"
+
+namespace Host {
+
+Gpio::Gpio() : Peripheral("GPIO", GPIOA_BasePtr, 0x1000) {
+}
+
+uint32_t Gpio::read(uint32_t offset, unsigned size) {
+   unsigned portNum = offset/PORT_STRIDE;
+   if ((portNum < PORTS) && ((offset%PORT_STRIDE) == offsetof(GPIO_Type, PDIR))) {
+      volatile GPIO_Type *gpio = port(portNum);
+      return (gpio->PDOR.value&gpio->PDDR.value)|(inputs[portNum]&~gpio->PDDR.value);
+   }
+   return Peripheral::read(offset, size);
+}
+
+void Gpio::write(uint32_t offset, uint32_t value, unsigned size) {
+   unsigned portNum = offset/PORT_STRIDE;
+   if (portNum >= PORTS) {
+      Peripheral::write(offset, value, size);
+      return;
+   }
+   volatile GPIO_Type *gpio = port(portNum);
+   switch(offset%PORT_STRIDE) {
+      case offsetof(GPIO_Type, PSOR): gpio->PDOR.value |= value;  break;
+      case offsetof(GPIO_Type, PCOR): gpio->PDOR.value &= ~value; break;
+      case offsetof(GPIO_Type, PTOR): gpio->PDOR.value ^= value;  break;
+      case offsetof(GPIO_Type, PDIR):                             break;
+      default:
+         Peripheral::write(offset, value, size);
+         break;
+   }
+}
+
+void Gpio::setInput(unsigned portNum, unsigned pin, bool level) {
+   if (level) {
+      inputs[portNum] |= (1U<<pin);
+   }
+   else {
+      inputs[portNum] &= ~(1U<<pin);
+   }
+}
+
+bool Gpio::getPin(unsigned portNum, unsigned pin) const {
+   volatile GPIO_Type *gpio = port(portNum);
+   uint32_t levels = (gpio->PDOR.value&gpio->PDDR.value)|(inputs[portNum]&~gpio->PDDR.value);
+   return (levels>>pin)&1;
+}
+
+}
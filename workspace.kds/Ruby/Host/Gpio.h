@@ -0,0 +1,71 @@
+/*
+ * Gpio.h
+ *
+ *  Model of the GPIO ports
+ */
+
+#ifndef HOST_GPIO_H_
+#define HOST_GPIO_H_
+
+#include "derivative.h"
+#include "Peripheral.h"
+
+namespace Host {
+
+/**
+ * GPIO ports A-E
+ *
+ * Pins configured as inputs read the levels set with setInput() (default low).
+ * Pins configured as outputs read back PDOR. Pin interrupts (PORT) are not
+ * modelled.
+ */
+class Gpio : public Peripheral {
+
+public:
+   /** Number of ports */
+   static constexpr unsigned PORTS = 5;
+
+   /** Port numbers */
+   enum Port {
+      PortA, PortB, PortC, PortD, PortE,
+   };
+
+private:
+   /** Spacing of port registers */
+   static constexpr uint32_t PORT_STRIDE = GPIOB_BasePtr-GPIOA_BasePtr;
+
+   /** Levels applied to the pins */
+   uint32_t inputs[PORTS] = {};
+
+   volatile GPIO_Type *port(unsigned portNum) const {
+      return (volatile GPIO_Type *)(uintptr_t)(GPIOA_BasePtr+portNum*PORT_STRIDE);
+   }
+
+public:
+   Gpio();
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+
+   /**
+    * Set level applied to a pin
+    *
+    * @param[in] portNum Port
+    * @param[in] pin     Pin number within port
+    * @param[in] level   Level
+    */
+   void setInput(unsigned portNum, unsigned pin, bool level);
+
+   /**
+    * Get level of a pin\n
+    * Output pins report the level driven, input pins the level applied
+    *
+    * @param[in] portNum Port
+    * @param[in] pin     Pin number within port
+    */
+   bool getPin(unsigned portNum, unsigned pin) const;
+};
+
+}
+
+#endif /* HOST_GPIO_H_ */
@@ -0,0 +1,63 @@
+#
+# HostHeaders.cmake
+#
+#  Generates the host copy of Project_Headers
+#
+#  Each header is copied to the output directory with the changes needed to
+#  compile it for the host:
+#   - Peripheral register members (__IO uint32_t etc.) become HostRegister<> so
+#     every access is routed through the peripheral models
+#   - constexpr pointers to peripherals become inline constants as the
+#     integer to pointer conversion is not a constant expression on the host.
+#     Inline variables are C++17 so these headers are marked as system headers
+#     to build the gnu++11 firmware without warnings.
+#  A header of the same name in Host/include replaces the original completely.
+#
+#  The copies are only rewritten when their content changes so editing one
+#  header does not rebuild everything.
+#
+
+function(host_generate_headers sourceDir overrideDir outputDir)
+   file(GLOB headers RELATIVE ${sourceDir} ${sourceDir}/*.h)
+   file(MAKE_DIRECTORY ${outputDir})
+
+   foreach(header ${headers})
+      if (EXISTS ${overrideDir}/${header})
+         set(source ${overrideDir}/${header})
+         file(READ ${source} content)
+      else()
+         set(source ${sourceDir}/${header})
+         file(READ ${source} content)
+
+         # Register members
+         string(REGEX REPLACE
+            "(__IOM|__IO|__IM|__I|__OM|__O)([ \t]+)(uint8_t|uint16_t|uint32_t)([ \t])"
+            "\\1\\2HostRegister<\\3>\\4" content "${content}")
+
+         # Register wrapper must be declared before any extern "C" block
+         if (content MATCHES "HostRegister<")
+            string(REGEX REPLACE
+               "#include <stdint.h>"
+               "#include <stdint.h>\n#include \"HostRegister.h\"" content "${content}")
+         endif()
+
+         # Pointers to peripherals
+         string(REGEX REPLACE
+            "static constexpr[ \t]+(volatile[ \t]+[A-Za-z0-9_]+)[ \t]*\\*[ \t]*([A-Za-z0-9_]+)"
+            "static inline \\1 *const \\2" content "${content}")
+         string(REGEX REPLACE
+            "constexpr[ \t]+(volatile[ \t]+[A-Za-z0-9_]+)[ \t]*\\*[ \t]*([A-Za-z0-9_]+)[ \t]*=[ \t]*&"
+            "\\1 *const \\2 = (\\1 *)&" content "${content}")
+
+         # The pointers are now inline variables (C++17) - the firmware is built as gnu++11
+         if (content MATCHES "static inline volatile")
+            set(content "#pragma GCC system_header\n${content}")
+         endif()
+      endif()
+
+      file(WRITE ${outputDir}/${header}.tmp "${content}")
+      configure_file(${outputDir}/${header}.tmp ${outputDir}/${header} COPYONLY)
+      file(REMOVE ${outputDir}/${header}.tmp)
+      set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${source})
+   endforeach()
+endfunction()
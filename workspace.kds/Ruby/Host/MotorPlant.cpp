@@ -0,0 +1,62 @@
+/*
+ * MotorPlant.cpp
+ *
+ *  Model of one axis of the robot - DC motor, gearbox and (optionally) the cube
+ */
+
+#include <math.h>
+#include "MotorPlant.h"
+
+namespace Host {
+
+/*
+ * Geared 12V motor with the encoder on the output shaft
+ * (no-load ~330 rpm, stall ~6A, mechanical time constant ~8 ms unloaded)
+ */
+const MotorPlant::Parameters MotorPlant::DEFAULT_PARAMETERS = {
+      /* resistance      */ 2.0,
+      /* inductance      */ 1.0e-3,
+      /* torqueConstant  */ 0.35,
+      /* inertia         */ 5.0e-4,
+      /* cubeInertia     */ 4.0e-4,
+      /* coulombFriction */ 0.02,
+      /* cubeFriction    */ 0.08,
+      /* staticFriction  */ 1.3,
+      /* viscousFriction */ 2.0e-3,
+};
+
+void MotorPlant::step(double dt, double voltage) {
+   const Parameters &p = parameters;
+
+   // Armature - backward Euler as L/R may be close to the step
+   current = (current+dt/p.inductance*(voltage-p.torqueConstant*speed))/(1+dt*p.resistance/p.inductance);
+
+   double torque   = p.torqueConstant*current;
+   double inertia  = p.inertia;
+   double friction = p.coulombFriction;
+   if (cubeLoaded) {
+      inertia  += p.cubeInertia;
+      friction += p.cubeFriction;
+   }
+   if (speed == 0.0) {
+      if (fabs(torque) <= friction*p.staticFriction) {
+         // Held by static friction
+         return;
+      }
+      speed = (torque > 0)?+1e-12:-1e-12;
+   }
+   double direction = (speed > 0)?1.0:-1.0;
+   double newSpeed  = (speed+dt/inertia*(torque-direction*friction))/(1+dt*p.viscousFriction/inertia);
+   if ((newSpeed*speed <= 0) && (fabs(torque) <= friction*p.staticFriction)) {
+      // Friction has stopped the shaft and the motor can't break it away
+      newSpeed = 0.0;
+   }
+   speed  = newSpeed;
+   angle += speed*dt;
+}
+
+int64_t MotorPlant::getTicks() const {
+   return (int64_t)floor(angle*(TICKS_PER_REVOLUTION/(2*M_PI)));
+}
+
+}
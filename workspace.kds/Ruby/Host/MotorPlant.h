@@ -0,0 +1,178 @@
+/*
+ * MotorPlant.h
+ *
+ *  Model of one axis of the robot - DC motor, gearbox and (optionally) the cube
+ */
+
+#ifndef HOST_MOTORPLANT_H_
+#define HOST_MOTORPLANT_H_
+
+#include <stdint.h>
+
+namespace Host {
+
+/**
+ * One axis of the robot
+ *
+ * A permanent magnet DC motor driven by an H-bridge turning a gripper which,
+ * when closed, also turns a face of the cube. All quantities are referred to
+ * the output shaft, which carries the encoder.
+ *
+ *  - Armature: L.di/dt = v - R.i - Ke.w (Ke = Kt in SI units)
+ *  - Shaft:    J.dw/dt = Kt.i - B.w - Tc.sgn(w)
+ *    A stopped shaft stays stopped until the motor torque exceeds the
+ *    break-away (static) friction.
+ *  - The bridge is treated as an average over the PWM period. Each half of the
+ *    bridge connects its motor terminal to the supply for the fraction of the
+ *    period that the FTM channel output is high.
+ *  - The encoder count is the shaft angle quantised to FULLROTATIONTICKS per
+ *    revolution.
+ *
+ * The model does not depend on the peripheral models so it can be stepped
+ * directly by a benchmark (see Host/Bench) or driven from the simulated
+ * FTM by RubyPlant.
+ */
+class MotorPlant {
+
+public:
+   /** Encoder counts in one revolution of the output shaft (FULLROTATIONTICKS) */
+   static constexpr int TICKS_PER_REVOLUTION = 8192;
+
+   /** Physical parameters */
+   struct Parameters {
+      double resistance;         //!< Armature resistance (ohm)
+      double inductance;         //!< Armature inductance (H)
+      double torqueConstant;     //!< Torque constant at output shaft (N.m/A) - also back-emf constant (V.s/rad)
+      double inertia;            //!< Inertia of motor, gearbox and gripper at output shaft (kg.m^2)
+      double cubeInertia;        //!< Additional inertia when the gripper holds the cube (kg.m^2)
+      double coulombFriction;    //!< Dynamic friction torque (N.m)
+      double cubeFriction;       //!< Additional friction torque turning a cube face (N.m)
+      double staticFriction;     //!< Ratio of break-away to dynamic friction
+      double viscousFriction;    //!< Viscous friction (N.m.s/rad)
+   };
+
+   /** Nominal values for the robot's motors */
+   static const Parameters DEFAULT_PARAMETERS;
+
+private:
+   Parameters parameters;
+
+   /** Armature current (A) */
+   double current  = 0.0;
+   /** Shaft speed (rad/s) */
+   double speed    = 0.0;
+   /** Shaft angle (rad) */
+   double angle    = 0.0;
+
+   /** Gripper is holding the cube */
+   bool   cubeLoaded = false;
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] parameters Physical parameters
+    * @param[in] angle      Initial shaft angle (rad)
+    */
+   MotorPlant(const Parameters &parameters=DEFAULT_PARAMETERS, double angle=0.0) :
+      parameters(parameters), angle(angle) {
+   }
+
+   /**
+    * Change the physical parameters\n
+    * The state (current, speed, position) is kept.
+    *
+    * @param[in] parameters New parameters
+    */
+   void setParameters(const Parameters &parameters) {
+      this->parameters = parameters;
+   }
+
+   /**
+    * Get the physical parameters
+    */
+   const Parameters &getParameters() const {
+      return parameters;
+   }
+
+   /**
+    * Indicate whether the gripper is holding the cube (adds the cube's inertia and friction)
+    *
+    * @param[in] loaded true => Turning the cube
+    */
+   void setCubeLoaded(bool loaded) {
+      cubeLoaded = loaded;
+   }
+
+   /**
+    * Indicates the gripper is holding the cube
+    */
+   bool isCubeLoaded() const {
+      return cubeLoaded;
+   }
+
+   /**
+    * Advance the model
+    *
+    * @param[in] dt      Time step (s) - should be well below L/R
+    * @param[in] voltage Average voltage across the motor terminals (V)
+    */
+   void step(double dt, double voltage);
+
+   /**
+    * Advance the model driven by the H-bridge
+    *
+    * @param[in] dt     Time step (s)
+    * @param[in] supply Bridge supply voltage (V)
+    * @param[in] dutyA  Fraction of time terminal A is connected to the supply (0..1)
+    * @param[in] dutyB  Fraction of time terminal B is connected to the supply (0..1)
+    */
+   void step(double dt, double supply, double dutyA, double dutyB) {
+      // A positive speed from Motor::setSpeed() holds B high and modulates A
+      step(dt, supply*(dutyB-dutyA));
+   }
+
+   /**
+    * Armature current (A)
+    */
+   double getCurrent() const {
+      return current;
+   }
+
+   /**
+    * Current drawn from the supply by the bridge (A)
+    *
+    * @param[in] dutyA Fraction of time terminal A is connected to the supply (0..1)
+    * @param[in] dutyB Fraction of time terminal B is connected to the supply (0..1)
+    */
+   double getSupplyCurrent(double dutyA, double dutyB) const {
+      double duty = dutyB-dutyA;
+      return (duty*current > 0)?duty*current:-duty*current;
+   }
+
+   /**
+    * Shaft speed (rad/s)
+    */
+   double getSpeed() const {
+      return speed;
+   }
+
+   /**
+    * Shaft angle (rad)
+    */
+   double getAngle() const {
+      return angle;
+   }
+
+   /**
+    * Encoder position\n
+    * The shaft angle quantised to TICKS_PER_REVOLUTION per revolution
+    *
+    * @return Position (counts)
+    */
+   int64_t getTicks() const;
+};
+
+}
+
+#endif /* HOST_MOTORPLANT_H_ */
@@ -0,0 +1,172 @@
+/*
+ * Pdb.cpp
+ *
+ *  Model of the Programmable Delay Block
+ */
+
+#include <stddef.h>
+#include "HostCpu.h"
+#include "Adc.h"
+#include "Pdb.h"
+#include "Simulator.h"
+
+namespace Host {
+
+namespace {
+
+/** Offsets of channel registers */
+constexpr uint32_t CH_OFFSET = offsetof(PDB_Type, CH);
+constexpr uint32_t CH_SIZE   = sizeof(PDB_Type::CH[0]);
+
+/** Software trigger source (TRGSEL) */
+constexpr unsigned TRGSEL_SOFTWARE = 15;
+
+/** Prescaler multiplication factors (MULT) */
+constexpr unsigned MULTIPLIERS[] = {1, 10, 20, 40};
+
+/** Counter is 16 bits */
+constexpr uint32_t COUNTER_MASK = 0xFFFF;
+
+}
+
+Pdb::Pdb() :
+      Peripheral("PDB0", PDB0_BasePtr, 0x1000),
+      delayEvent(*this, &Pdb::interruptDelay),
+      periodEvent(*this, &Pdb::periodEnd) {
+   pdb->MOD.value  = COUNTER_MASK;
+   pdb->IDLY.value = COUNTER_MASK;
+}
+
+/**
+ * Duration of counter tick (core cycles)
+ */
+uint64_t Pdb::tickCycles() const {
+   uint32_t sc       = pdb->SC.value;
+   unsigned prescale = 1U<<((sc&PDB_SC_PRESCALER_MASK)>>PDB_SC_PRESCALER_SHIFT);
+   return (uint64_t)(Simulator::CORE_CLOCK/Simulator::BUS_CLOCK)*prescale*MULTIPLIERS[(sc&PDB_SC_MULT_MASK)>>PDB_SC_MULT_SHIFT];
+}
+
+/**
+ * Start counter from zero and schedule the triggers for this period
+ */
+void Pdb::startSequence(uint64_t now) {
+   VirtualClock &clock = Simulator::clock();
+   uint64_t      tick  = tickCycles();
+   uint32_t      mod   = pdb->MOD.value&COUNTER_MASK;
+
+   running       = true;
+   sequenceStart = now;
+   for (unsigned channel=0; channel<CHANNELS; channel++) {
+      uint32_t c1 = pdb->CH[channel].C1.value;
+      for (unsigned pretrigger=0; pretrigger<PRETRIGGERS; pretrigger++) {
+         EventOf<Pdb> &event = pretriggerEvents[channel*PRETRIGGERS+pretrigger];
+         uint32_t      mask  = 1U<<pretrigger;
+         if (!(c1&(mask<<PDB_C1_EN_SHIFT))) {
+            clock.cancel(event);
+            continue;
+         }
+         if (c1&(mask<<PDB_C1_TOS_SHIFT)) {
+            uint32_t delay = pdb->CH[channel].DLY[pretrigger].value&COUNTER_MASK;
+            if (delay > mod) {
+               // Counter never reaches the delay
+               clock.cancel(event);
+               continue;
+            }
+            clock.schedule(event, now+delay*tick);
+         }
+         else {
+            // Bypassed - asserted one clock after the trigger
+            clock.schedule(event, now+tick);
+         }
+      }
+   }
+   uint32_t idly = pdb->IDLY.value&COUNTER_MASK;
+   if (idly <= mod) {
+      clock.schedule(delayEvent, now+idly*tick);
+   }
+   else {
+      clock.cancel(delayEvent);
+   }
+   clock.schedule(periodEvent, now+((uint64_t)mod+1)*tick);
+}
+
+/**
+ * Stop counter and cancel pending triggers
+ */
+void Pdb::stop() {
+   VirtualClock &clock = Simulator::clock();
+   running = false;
+   for (EventOf<Pdb> &event : pretriggerEvents) {
+      clock.cancel(event);
+   }
+   clock.cancel(delayEvent);
+   clock.cancel(periodEvent);
+}
+
+void Pdb::pretrigger(unsigned index, uint64_t) {
+   unsigned channel    = index/PRETRIGGERS;
+   unsigned pretrigger = index%PRETRIGGERS;
+   pdb->CH[channel].S.value |= (1U<<(pretrigger+PDB_S_CF_SHIFT));
+   Simulator::adc(channel).hardwareTrigger(pretrigger);
+}
+
+void Pdb::interruptDelay(unsigned, uint64_t) {
+   pdb->SC.value |= PDB_SC_PDBIF_MASK;
+   updateIrq();
+}
+
+void Pdb::periodEnd(unsigned, uint64_t now) {
+   if (pdb->SC.value&PDB_SC_CONT_MASK) {
+      startSequence(now);
+   }
+   else {
+      stop();
+      pdb->CNT.value = 0;
+   }
+}
+
+void Pdb::updateIrq() {
+   uint32_t sc = pdb->SC.value;
+   Cpu::setIrqLevel(PDB0_IRQn, (sc&PDB_SC_PDBIF_MASK) && (sc&PDB_SC_PDBIE_MASK) && !(sc&PDB_SC_DMAEN_MASK));
+}
+
+uint32_t Pdb::read(uint32_t offset, unsigned size) {
+   if ((offset == offsetof(PDB_Type, CNT)) && running) {
+      return (uint32_t)((Simulator::clock().now()-sequenceStart)/tickCycles());
+   }
+   return Peripheral::read(offset, size);
+}
+
+void Pdb::write(uint32_t offset, uint32_t value, unsigned size) {
+   if (offset == offsetof(PDB_Type, SC)) {
+      uint32_t sc = value&~(PDB_SC_SWTRIG_MASK|PDB_SC_LDOK_MASK|PDB_SC_PDBIF_MASK);
+      // PDBIF is cleared by writing 0
+      if (value&PDB_SC_PDBIF_MASK) {
+         sc |= pdb->SC.value&PDB_SC_PDBIF_MASK;
+      }
+      pdb->SC.value = sc;
+      if (!(sc&PDB_SC_PDBEN_MASK)) {
+         stop();
+         pdb->CNT.value = 0;
+      }
+      else if ((value&PDB_SC_SWTRIG_MASK) &&
+            (((sc&PDB_SC_TRGSEL_MASK)>>PDB_SC_TRGSEL_SHIFT) == TRGSEL_SOFTWARE)) {
+         startSequence(Simulator::clock().now());
+      }
+      updateIrq();
+      return;
+   }
+   if ((offset >= CH_OFFSET) && (offset < CH_OFFSET+CHANNELS*CH_SIZE) &&
+         (((offset-CH_OFFSET)%CH_SIZE) == offsetof(PDB_Type, CH[0].S)-CH_OFFSET)) {
+      // CF bits are cleared by writing 0, ERR bits by writing 1
+      volatile uint32_t &s = pdb->CH[(offset-CH_OFFSET)/CH_SIZE].S.value;
+      s &= (value|~PDB_S_CF_MASK)&~(value&PDB_S_ERR_MASK);
+      return;
+   }
+   if (offset == offsetof(PDB_Type, CNT)) {
+      return;
+   }
+   Peripheral::write(offset, value, size);
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+ * Pdb.h
+ *
+ *  Model of the Programmable Delay Block
+ */
+
+#ifndef HOST_PDB_H_
+#define HOST_PDB_H_
+
+#include "derivative.h"
+#include "Peripheral.h"
+#include "VirtualClock.h"
+
+namespace Host {
+
+/**
+ * Programmable Delay Block
+ *
+ *  - Software trigger only (TRGSEL = 15)
+ *  - One-shot and continuous modes
+ *  - ADC pre-triggers (delayed or bypassed) start conversions on ADC0/ADC1
+ *  - Interrupt delay flag and interrupt
+ *  - LDOK loads the buffered registers immediately whatever LDMOD
+ *  - DAC interval triggers, pulse-outs and sequence errors are not modelled
+ */
+class Pdb : public Peripheral {
+
+public:
+   /** Number of ADC channels */
+   static constexpr unsigned CHANNELS = PDB_CH_COUNT;
+
+   /** Number of pre-triggers per channel */
+   static constexpr unsigned PRETRIGGERS = PDB_DLY_COUNT;
+
+private:
+   volatile PDB_Type *const pdb = (volatile PDB_Type *)PDB0_BasePtr;
+
+   /** Counter running */
+   bool     running       = false;
+   /** Time counter was started (cycles) */
+   uint64_t sequenceStart = 0;
+
+   /** Pre-trigger events (index is channel*PRETRIGGERS+pretrigger) */
+   EventOf<Pdb> pretriggerEvents[CHANNELS*PRETRIGGERS] = {
+         {*this, &Pdb::pretrigger, 0},
+         {*this, &Pdb::pretrigger, 1},
+         {*this, &Pdb::pretrigger, 2},
+         {*this, &Pdb::pretrigger, 3},
+   };
+   EventOf<Pdb> delayEvent;
+   EventOf<Pdb> periodEvent;
+
+   uint64_t tickCycles() const;
+   void     startSequence(uint64_t now);
+   void     stop();
+   void     pretrigger(unsigned index, uint64_t now);
+   void     interruptDelay(unsigned, uint64_t now);
+   void     periodEnd(unsigned, uint64_t now);
+   void     updateIrq();
+
+public:
+   Pdb();
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+};
+
+}
+
+#endif /* HOST_PDB_H_ */
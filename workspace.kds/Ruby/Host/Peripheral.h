@@ -0,0 +1,144 @@
+/*
+ * Peripheral.h
+ *
+ *  Base for peripheral models in the host build
+ */
+
+#ifndef HOST_PERIPHERAL_H_
+#define HOST_PERIPHERAL_H_
+
+#include <stdint.h>
+
+namespace Host {
+
+/**
+ * Model of a memory mapped peripheral
+ *
+ * The register storage is the memory at the peripheral's real address (mapped
+ * by the simulator) so the firmware structures (FTM_Type etc.) can be used by
+ * the model directly. Reading or writing HostRegister::value in a model does
+ * not go through the bus, i.e. it has no side effects and takes no time.
+ *
+ * Each model occupies one or more 4 KiB pages of the peripheral address space.
+ * Accesses to pages without a model read and write the memory directly.
+ */
+class Peripheral {
+
+public:
+   /** Address space decoded in pages */
+   static constexpr unsigned PAGE_SHIFT = 12;
+
+private:
+   /** Name used in messages */
+   const char *const name;
+
+   /**
+    * Find model for an address
+    *
+    * @param[in] address Address being accessed
+    *
+    * @return Model or nullptr if none
+    */
+   static Peripheral *find(uint32_t address);
+
+protected:
+   /** Base address */
+   const uint32_t base;
+
+   /**
+    * Constructor\n
+    * Attaches the model to the address range [base, base+size)
+    *
+    * @param[in] name Name used in messages
+    * @param[in] base Base address (page aligned)
+    * @param[in] size Size of address range (multiple of page size)
+    */
+   Peripheral(const char *name, uint32_t base, uint32_t size);
+
+   /**
+    * Read memory directly
+    *
+    * @param[in] address Address to read
+    * @param[in] size    Size of access (1, 2 or 4 bytes)
+    *
+    * @return Value read
+    */
+   static uint32_t rawRead(uint32_t address, unsigned size);
+
+   /**
+    * Write memory directly
+    *
+    * @param[in] address Address to write
+    * @param[in] value   Value to write
+    * @param[in] size    Size of access (1, 2 or 4 bytes)
+    */
+   static void rawWrite(uint32_t address, uint32_t value, unsigned size);
+
+public:
+   virtual ~Peripheral() = default;
+
+   Peripheral(const Peripheral&) = delete;
+   Peripheral &operator=(const Peripheral&) = delete;
+
+   /**
+    * Name of peripheral
+    */
+   const char *getName() const {
+      return name;
+   }
+
+   /**
+    * Read a register (default is plain memory)
+    *
+    * @param[in] offset Offset of register from base
+    * @param[in] size   Size of access (1, 2 or 4 bytes)
+    *
+    * @return Value read
+    */
+   virtual uint32_t read(uint32_t offset, unsigned size) {
+      return rawRead(base+offset, size);
+   }
+
+   /**
+    * Write a register (default is plain memory)
+    *
+    * @param[in] offset Offset of register from base
+    * @param[in] value  Value to write
+    * @param[in] size   Size of access (1, 2 or 4 bytes)
+    */
+   virtual void write(uint32_t offset, uint32_t value, unsigned size) {
+      rawWrite(base+offset, value, size);
+   }
+
+   /**
+    * Read from the address space as a bus master other than the core (e.g. DMA)\n
+    * Peripheral side effects occur but no time passes.
+    *
+    * @param[in] address Address to read
+    * @param[in] size    Size of access (1, 2 or 4 bytes)
+    *
+    * @return Value read
+    */
+   static uint32_t busRead(uint32_t address, unsigned size);
+
+   /**
+    * Write to the address space as a bus master other than the core (e.g. DMA)\n
+    * Peripheral side effects occur but no time passes.
+    *
+    * @param[in] address Address to write
+    * @param[in] value   Value to write
+    * @param[in] size    Size of access (1, 2 or 4 bytes)
+    */
+   static void busWrite(uint32_t address, uint32_t value, unsigned size);
+
+   /**
+    * Map the peripheral and memory regions used by the firmware
+    *
+    * @note Must be called before any model is constructed
+    */
+   static void mapMemory();
+};
+
+}
+
+#endif /* HOST_PERIPHERAL_H_ */
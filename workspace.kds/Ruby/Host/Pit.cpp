@@ -0,0 +1,116 @@
+/*
+ * Pit.cpp
+ *
+ *  Model of the Periodic Interrupt Timer
+ */
+
+#include <stddef.h>
+#include "HostCpu.h"
+#include "Pit.h"
+#include "Simulator.h"
+
+namespace Host {
+
+namespace {
+
+/** Offset of channel registers */
+constexpr uint32_t CHANNEL_OFFSET = offsetof(PIT_Type, CHANNEL);
+
+/** Size of channel registers */
+constexpr uint32_t CHANNEL_SIZE = sizeof(PIT_Type::CHANNEL[0]);
+
+}
+
+Pit::Pit() : Peripheral("PIT", PIT_BasePtr, 0x1000) {
+   pit->MCR.value = PIT_MCR_MDIS_MASK;
+}
+
+uint64_t Pit::period(unsigned channel) const {
+   return ((uint64_t)pit->CHANNEL[channel].LDVAL.value+1)*(Simulator::CORE_CLOCK/Simulator::BUS_CLOCK);
+}
+
+void Pit::expired(unsigned channel, uint64_t now) {
+   (void)now;
+   pit->CHANNEL[channel].TFLG.value = PIT_TFLG_TIF_MASK;
+   updateIrq(channel);
+   // Reload from the current LDVAL
+   Simulator::clock().schedule(timeout[channel], timeout[channel].getDue()+period(channel));
+}
+
+/**
+ * Start or stop channel to reflect MCR and TCTRL
+ */
+void Pit::update(unsigned channel) {
+   VirtualClock &clock = Simulator::clock();
+   bool enable = !(pit->MCR.value&PIT_MCR_MDIS_MASK) && (pit->CHANNEL[channel].TCTRL.value&PIT_TCTRL_TEN_MASK);
+   if (enable && !running[channel]) {
+      clock.scheduleIn(timeout[channel], period(channel));
+   }
+   else if (!enable && running[channel]) {
+      clock.cancel(timeout[channel]);
+   }
+   running[channel] = enable;
+}
+
+void Pit::updateIrq(unsigned channel) {
+   Cpu::setIrqLevel(PIT0_IRQn+channel,
+         (pit->CHANNEL[channel].TFLG.value&PIT_TFLG_TIF_MASK) &&
+         (pit->CHANNEL[channel].TCTRL.value&PIT_TCTRL_TIE_MASK));
+}
+
+uint32_t Pit::read(uint32_t offset, unsigned size) {
+   if ((offset >= CHANNEL_OFFSET) && (offset < CHANNEL_OFFSET+CHANNELS*CHANNEL_SIZE)) {
+      unsigned channel = (offset-CHANNEL_OFFSET)/CHANNEL_SIZE;
+      if (((offset-CHANNEL_OFFSET)%CHANNEL_SIZE) == offsetof(PIT_Type, CHANNEL[0].CVAL)-CHANNEL_OFFSET) {
+         if (!running[channel]) {
+            return pit->CHANNEL[channel].CVAL.value;
+         }
+         uint64_t remaining = (timeout[channel].getDue()-Simulator::clock().now())/(Simulator::CORE_CLOCK/Simulator::BUS_CLOCK);
+         return (remaining == 0)?0:(uint32_t)(remaining-1);
+      }
+   }
+   return Peripheral::read(offset, size);
+}
+
+void Pit::write(uint32_t offset, uint32_t value, unsigned size) {
+   if (offset == offsetof(PIT_Type, MCR)) {
+      pit->MCR.value = value&(PIT_MCR_MDIS_MASK|PIT_MCR_FRZ_MASK);
+      for (unsigned channel=0; channel<CHANNELS; channel++) {
+         update(channel);
+      }
+      return;
+   }
+   if ((offset < CHANNEL_OFFSET) || (offset >= CHANNEL_OFFSET+CHANNELS*CHANNEL_SIZE)) {
+      Peripheral::write(offset, value, size);
+      return;
+   }
+   unsigned channel  = (offset-CHANNEL_OFFSET)/CHANNEL_SIZE;
+   uint32_t reg      = CHANNEL_OFFSET+(offset-CHANNEL_OFFSET)%CHANNEL_SIZE;
+   volatile auto &ch = pit->CHANNEL[channel];
+   switch(reg) {
+      case offsetof(PIT_Type, CHANNEL[0].LDVAL):
+         ch.LDVAL.value = value;
+         break;
+      case offsetof(PIT_Type, CHANNEL[0].TCTRL):
+         if (running[channel] && !(value&PIT_TCTRL_TEN_MASK)) {
+            // Counter holds its value while disabled
+            ch.CVAL.value = read(offset-offsetof(PIT_Type, CHANNEL[0].TCTRL)+offsetof(PIT_Type, CHANNEL[0].CVAL), sizeof(uint32_t));
+         }
+         ch.TCTRL.value = value&(PIT_TCTRL_TEN_MASK|PIT_TCTRL_TIE_MASK|PIT_TCTRL_CHN_MASK);
+         update(channel);
+         updateIrq(channel);
+         break;
+      case offsetof(PIT_Type, CHANNEL[0].TFLG):
+         // Write 1 to clear
+         if (value&PIT_TFLG_TIF_MASK) {
+            ch.TFLG.value = 0;
+         }
+         updateIrq(channel);
+         break;
+      default:
+         // CVAL is read-only
+         break;
+   }
+}
+
+}
@@ -0,0 +1,59 @@
+/*
+ * Pit.h
+ *
+ *  Model of the Periodic Interrupt Timer
+ */
+
+#ifndef HOST_PIT_H_
+#define HOST_PIT_H_
+
+#include "derivative.h"
+#include "Peripheral.h"
+#include "VirtualClock.h"
+
+namespace Host {
+
+/**
+ * Periodic Interrupt Timer
+ *
+ *  - Channels count LDVAL+1 bus clocks between flags
+ *  - A new LDVAL takes effect at the next reload
+ *  - Chained mode and the lifetime timer are not modelled
+ */
+class Pit : public Peripheral {
+
+public:
+   /** Number of channels */
+   static constexpr unsigned CHANNELS = PIT_TMR_COUNT;
+
+private:
+   volatile PIT_Type *const pit = (volatile PIT_Type *)PIT_BasePtr;
+
+   /** Channel is counting */
+   bool running[CHANNELS] = {};
+
+   /** Timeout of each channel */
+   EventOf<Pit> timeout[CHANNELS] = {
+         {*this, &Pit::expired, 0},
+         {*this, &Pit::expired, 1},
+         {*this, &Pit::expired, 2},
+         {*this, &Pit::expired, 3},
+   };
+
+   /** Counter period from LDVAL (core cycles) */
+   uint64_t period(unsigned channel) const;
+
+   void expired(unsigned channel, uint64_t now);
+   void update(unsigned channel);
+   void updateIrq(unsigned channel);
+
+public:
+   Pit();
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+};
+
+}
+
+#endif /* HOST_PIT_H_ */
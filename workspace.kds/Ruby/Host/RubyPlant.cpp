@@ -0,0 +1,98 @@
+/*
+ * RubyPlant.cpp
+ *
+ *  The robot as seen by the firmware - motors, encoders, grippers and motor supply
+ */
+
+#include <math.h>
+#include "RubyPlant.h"
+#include "Adc.h"
+#include "Ftm.h"
+#include "Simulator.h"
+
+namespace Host {
+
+namespace {
+
+/** ADC1 channel with the motor supply divider */
+constexpr unsigned SUPPLY_ADC_CHANNEL = 4;
+
+/** Hall effect sensor output with magnet present */
+constexpr bool SENSOR_ACTIVE = false;
+
+}
+
+RubyPlant::RubyPlant() :
+   axes {
+      // name      chA chB fault ftm sign  index                 indexPos  solenoid  sensors
+      {"Motor1",    2,  3,   3,   1,  -1,  Gpio::PortA, 5,  -700,    7, Gpio::PortE, 0, 1,
+            MotorPlant(), 0.0, false},
+      {"Motor2",    4,  5,   0,   2,  +1,  Gpio::PortB, 3,   900,    1, Gpio::PortC, 0, 1,
+            MotorPlant(), 0.0, false},
+   },
+   stepEvent(*this, &RubyPlant::update) {
+   VirtualClock &clock = Simulator::clock();
+   clock.scheduleIn(stepEvent, clock.toCycles(STEP_TIME));
+}
+
+void RubyPlant::updateAxis(Axis &axis) {
+   Ftm  &pwm  = Simulator::ftm(0);
+   Gpio &gpio = Simulator::gpio();
+
+   double dutyA = pwm.getDutyCycle(axis.channelA);
+   double dutyB = pwm.getDutyCycle(axis.channelB);
+   axis.motor.step(STEP_TIME, loadedSupply, dutyA, dutyB);
+
+   int64_t ticks = axis.encoderSign*axis.motor.getTicks();
+   Simulator::ftm(axis.encoderFtm).setEncoderCount(ticks);
+
+   int64_t fromIndex = (ticks-axis.indexPosition)%MotorPlant::TICKS_PER_REVOLUTION;
+   if (fromIndex < 0) {
+      fromIndex += MotorPlant::TICKS_PER_REVOLUTION;
+   }
+   gpio.setInput(axis.indexPort, axis.indexPin, fromIndex < INDEX_WIDTH);
+
+   bool tripped = fabs(axis.motor.getCurrent()) > TRIP_CURRENT;
+   if (tripped != axis.tripped) {
+      axis.tripped = tripped;
+      Simulator::log("%s: Bridge error flag %s (%.2f A)", axis.name, tripped?"set":"cleared", axis.motor.getCurrent());
+      pwm.setFaultInput(axis.faultInput, !tripped);
+   }
+
+   // Solenoid pulls the gripper closed while energised
+   bool energised = pwm.getDutyCycle(axis.solenoidChannel, 1.0) > 0.5;
+   if (energised) {
+      axis.gripperTravel += STEP_TIME/GRIPPER_CLOSE_TIME;
+   }
+   else {
+      axis.gripperTravel -= STEP_TIME/GRIPPER_OPEN_TIME;
+   }
+   if (axis.gripperTravel > 1.0) {
+      axis.gripperTravel = 1.0;
+   }
+   else if (axis.gripperTravel < 0.0) {
+      axis.gripperTravel = 0.0;
+   }
+   axis.motor.setCubeLoaded(axis.gripperTravel >= 1.0);
+   gpio.setInput(axis.sensorPort, axis.openSensorPin,  (axis.gripperTravel <= 0.0)?SENSOR_ACTIVE:!SENSOR_ACTIVE);
+   gpio.setInput(axis.sensorPort, axis.closeSensorPin, (axis.gripperTravel >= 1.0)?SENSOR_ACTIVE:!SENSOR_ACTIVE);
+}
+
+void RubyPlant::update(unsigned, uint64_t) {
+   for (Axis &axis : axes) {
+      updateAxis(axis);
+   }
+   // Supply seen on the next step
+   Ftm   &pwm     = Simulator::ftm(0);
+   double current = 0.0;
+   for (Axis &axis : axes) {
+      current += axis.motor.getSupplyCurrent(pwm.getDutyCycle(axis.channelA), pwm.getDutyCycle(axis.channelB));
+   }
+   loadedSupply = supplyVoltage-SUPPLY_RESISTANCE*current;
+   Simulator::adc(1).setInputVoltage(SUPPLY_ADC_CHANNEL, loadedSupply/SUPPLY_DIVIDER);
+
+   VirtualClock &clock = Simulator::clock();
+   clock.scheduleIn(stepEvent, clock.toCycles(STEP_TIME));
+}
+
+}
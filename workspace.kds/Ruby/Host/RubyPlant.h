@@ -0,0 +1,142 @@
+/*
+ * RubyPlant.h
+ *
+ *  The robot as seen by the firmware - motors, encoders, grippers and motor supply
+ */
+
+#ifndef HOST_RUBYPLANT_H_
+#define HOST_RUBYPLANT_H_
+
+#include "Gpio.h"
+#include "MotorPlant.h"
+#include "VirtualClock.h"
+
+namespace Host {
+
+/**
+ * Model of the robot connected to the peripheral models
+ *
+ * Wiring follows Sources/Ruby.h:
+ *  - Motor 1: bridge on FTM0 ch2/ch3, error flag on FTM0 fault 3, encoder FTM1, index PTA5
+ *  - Motor 2: bridge on FTM0 ch4/ch5, error flag on FTM0 fault 0, encoder FTM2, index PTB3
+ *  - Gripper 1: solenoid on FTM0 ch7, sensors PTE0 (open) PTE1 (closed)
+ *  - Gripper 2: solenoid on FTM0 ch1, sensors PTC0 (open) PTC1 (closed)
+ *  - Motor supply: 10K:1K divider to ADC1 channel 4
+ *
+ * The model is stepped every STEP_TIME on the virtual clock:
+ *  - Bridge outputs are sampled (average over the PWM period) and each axis
+ *    (MotorPlant) is advanced
+ *  - The encoder counters follow the shaft. The encoder of motor 1 counts
+ *    opposite to the motor direction (see pid1 in Ruby.cpp)
+ *  - The index output is high for INDEX_WIDTH counts once per revolution
+ *  - A bridge asserts its (active-low) error flag while the armature current
+ *    exceeds TRIP_CURRENT
+ *  - A solenoid is energised while its pin is high. The pins are open-drain
+ *    with a pull-up so a disabled channel also energises the solenoid.
+ *    The gripper holds the cube (adding its load to the axis) once fully closed.
+ *  - The supply sags with the current drawn through its source resistance
+ */
+class RubyPlant {
+
+public:
+   /** Interval between model updates (s) */
+   static constexpr double STEP_TIME = 10e-6;
+
+   /** Nominal motor supply (V) */
+   static constexpr double DEFAULT_SUPPLY = 12.0;
+
+   /** Source resistance of motor supply (ohm) */
+   static constexpr double SUPPLY_RESISTANCE = 0.2;
+
+   /** Ratio of motor supply to ADC input */
+   static constexpr double SUPPLY_DIVIDER = 11.0;
+
+   /** Armature current at which the bridge driver flags an error (A) */
+   static constexpr double TRIP_CURRENT = 5.0;
+
+   /** Width of index pulse (counts) */
+   static constexpr int INDEX_WIDTH = 4;
+
+   /** Time for a gripper to close when energised (s) */
+   static constexpr double GRIPPER_CLOSE_TIME = 40e-3;
+
+   /** Time for a gripper to open when released (s) */
+   static constexpr double GRIPPER_OPEN_TIME = 30e-3;
+
+   /** Number of axes */
+   static constexpr unsigned AXES = 2;
+
+private:
+   /** Motor, encoder and gripper of one axis */
+   struct Axis {
+      const char    *name;
+      unsigned       channelA;         // FTM0 channels driving the bridge
+      unsigned       channelB;
+      unsigned       faultInput;       // FTM0 fault input for bridge error flag
+      unsigned       encoderFtm;       // FTM counting the encoder
+      int            encoderSign;      // Encoder direction relative to motor
+      Gpio::Port     indexPort;
+      unsigned       indexPin;
+      int            indexPosition;    // Encoder position of index (counts)
+      unsigned       solenoidChannel;  // FTM0 channel driving gripper solenoid
+      Gpio::Port     sensorPort;
+      unsigned       openSensorPin;
+      unsigned       closeSensorPin;
+
+      MotorPlant     motor;
+      double         gripperTravel;    // 0 => open, 1 => closed
+      bool           tripped;
+   };
+
+   Axis axes[AXES];
+
+   /** Nominal supply voltage (V) */
+   double supplyVoltage = DEFAULT_SUPPLY;
+
+   /** Supply voltage at last update (V) */
+   double loadedSupply  = DEFAULT_SUPPLY;
+
+   /** Periodic update */
+   EventOf<RubyPlant> stepEvent;
+
+   void update(unsigned, uint64_t now);
+   void updateAxis(Axis &axis);
+
+public:
+   RubyPlant();
+
+   RubyPlant(const RubyPlant&) = delete;
+   RubyPlant &operator=(const RubyPlant&) = delete;
+
+   /**
+    * Set the nominal motor supply
+    *
+    * @param[in] volts Supply voltage with no load (V)
+    */
+   void setSupplyVoltage(double volts) {
+      supplyVoltage = volts;
+   }
+
+   /**
+    * Motor supply at the last update including sag under load
+    *
+    * @return Voltage (V)
+    */
+   double getSupplyVoltage() const {
+      return loadedSupply;
+   }
+
+   /**
+    * Model of an axis\n
+    * May be used to change parameters or observe the motor
+    *
+    * @param[in] axis Axis (1 or 2, as Motor1/Motor2)
+    */
+   MotorPlant &motor(unsigned axis) {
+      return axes[axis-1].motor;
+   }
+};
+
+}
+
+#endif /* HOST_RUBYPLANT_H_ */
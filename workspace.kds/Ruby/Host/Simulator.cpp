@@ -0,0 +1,388 @@
+/*
+ * Simulator.cpp
+ *
+ *  Host build - start-up, options and the peripheral model instances
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hardware.h"
+#include "dma.h"
+#include "ftm.h"
+#include "pit.h"
+#include "uart.h"
+#include "console.h"
+#include "HostCpu.h"
+#include "Simulator.h"
+#include "Adc.h"
+#include "Dma.h"
+#include "Ftfe.h"
+#include "Ftm.h"
+#include "Gpio.h"
+#include "Pdb.h"
+#include "Pit.h"
+#include "RubyPlant.h"
+#include "SystemControl.h"
+#include "Uart.h"
+
+// After the device headers - defines names used for registers (CR0 etc.)
+#include <termios.h>
+#include <unistd.h>
+
+/*
+ * Clock variables normally maintained by the clock initialisation (mcg.cpp, system.cpp)
+ * The simulated device always runs at the nominal frequencies.
+ */
+namespace USBDM {
+volatile uint32_t SystemMcgffClock  = 32768;
+volatile uint32_t SystemMcgOutClock = Host::Simulator::CORE_CLOCK;
+volatile uint32_t SystemMcgFllClock = 0;
+volatile uint32_t SystemMcgPllClock = Host::Simulator::CORE_CLOCK;
+volatile uint32_t SystemCoreClock   = Host::Simulator::CORE_CLOCK;
+volatile uint32_t SystemBusClock    = Host::Simulator::BUS_CLOCK;
+volatile uint32_t SystemLpoClock    = 1000;
+}
+
+extern "C" {
+uint32_t SystemCoreClock = Host::Simulator::CORE_CLOCK;
+uint32_t SystemBusClock  = Host::Simulator::BUS_CLOCK;
+
+/* Only defined when a SysTick handler is linked */
+void SysTick_Handler(void) __attribute__((weak));
+
+/** Heap use isn't tracked on the host (see MemoryMonitor) */
+uint32_t heap_getHighWaterMark(void) {
+   return 0;
+}
+
+/*
+ * Nominal stack reported by MemoryMonitor\n
+ * The firmware runs on the host stack - this region is painted but not used.
+ */
+uint32_t hostStack[1024] = {};
+__asm__(
+      "  .globl __StackLimit           \n"
+      "  .set   __StackLimit, hostStack \n"
+      "  .globl __StackTop             \n"
+      "  .set   __StackTop, hostStack+4096 \n");
+
+/** Nesting count for interrupt disable (as system.cpp) */
+static int disableInterruptCount = 0;
+
+int areInterruptsEnabled() {
+   return disableInterruptCount == 0;
+}
+
+void disableInterrupts() {
+   __disable_irq();
+   disableInterruptCount++;
+}
+
+int enableInterrupts() {
+   if (disableInterruptCount>0) {
+      disableInterruptCount--;
+   }
+   if (disableInterruptCount == 0) {
+      __enable_irq();
+      return 1;
+   }
+   return 0;
+}
+}
+
+namespace Host {
+
+namespace {
+
+/** Value used to paint the nominal stack (MemoryMonitor) */
+constexpr uint32_t STACK_PAINT_VALUE = 0xCDCDCDCD;
+
+/** Reset status - power on reset */
+constexpr uint32_t RCM_SRS0_ADDRESS = 0x4007F000;
+constexpr uint8_t  RCM_SRS0_POR     = 0x80;
+
+/** Command line options */
+struct Options {
+   bool   stdio     = false;
+   double realtime  = 0;
+   double timeLimit = 0;
+   double supply    = RubyPlant::DEFAULT_SUPPLY;
+} options;
+
+/** Clock in use */
+VirtualClock *currentClock = nullptr;
+
+/** Functions to call on exit */
+constexpr unsigned MAX_EXIT_HANDLERS = 8;
+Simulator::ExitHandler exitHandlers[MAX_EXIT_HANDLERS];
+unsigned               exitHandlerCount = 0;
+
+/** Terminal settings of stdin to restore on exit */
+struct termios savedTerminal;
+bool           terminalSaved = false;
+
+/** Ends the simulation at the time limit */
+class TimeLimit : public Event {
+public:
+   virtual void fire(uint64_t) override {
+      Simulator::exit(Simulator::Exit_TimeLimit, "Time limit reached");
+   }
+} timeLimit;
+
+void usage(const char *name) {
+   fprintf(stderr,
+         "Usage: %s [--stdio] [--realtime[=factor]] [--time=seconds] [--supply=volts]\n"
+         "  --stdio           UART0 uses stdin/stdout rather than a pseudo-terminal\n"
+         "  --realtime[=f]    Pace simulated time at f times real time (default 1)\n"
+         "  --time=s          Stop after s seconds of simulated time\n"
+         "  --supply=v        Motor supply voltage (default 12)\n",
+         name);
+   exit(EXIT_FAILURE);
+}
+
+/**
+ * Map memory and parse options\n
+ * Runs before any other constructor (the firmware has constructors that touch peripherals)
+ */
+__attribute__((constructor(101)))
+void initialise(int argc, char *argv[]) {
+   Peripheral::mapMemory();
+
+   for (int index=1; index<argc; index++) {
+      const char *arg = argv[index];
+      if (strcmp(arg, "--stdio") == 0) {
+         options.stdio = true;
+      }
+      else if (strcmp(arg, "--realtime") == 0) {
+         options.realtime = 1.0;
+      }
+      else if (strncmp(arg, "--realtime=", 11) == 0) {
+         options.realtime = atof(arg+11);
+         if (options.realtime <= 0) {
+            usage(argv[0]);
+         }
+      }
+      else if (strncmp(arg, "--time=", 7) == 0) {
+         options.timeLimit = atof(arg+7);
+         if (options.timeLimit <= 0) {
+            usage(argv[0]);
+         }
+      }
+      else if (strncmp(arg, "--supply=", 9) == 0) {
+         options.supply = atof(arg+9);
+         if (options.supply < 0) {
+            usage(argv[0]);
+         }
+      }
+      else {
+         usage(argv[0]);
+      }
+   }
+   for (uint32_t &word : hostStack) {
+      word = STACK_PAINT_VALUE;
+   }
+}
+
+/**
+ * Create the clock - models are constructed after this
+ */
+__attribute__((constructor(102)))
+void createClock() {
+   if (options.realtime > 0) {
+      currentClock = new RealTimeClock(Simulator::CORE_CLOCK, options.realtime);
+   }
+   else {
+      currentClock = new VirtualClock(Simulator::CORE_CLOCK);
+   }
+   if (options.timeLimit > 0) {
+      Simulator::setTimeLimit(options.timeLimit);
+   }
+}
+
+/** Peripheral models */
+Pit           pit           __attribute__((init_priority(103)));
+Ftm           ftm0          __attribute__((init_priority(103))) {"FTM0", FTM0_BasePtr, FTM0_IRQn, 8};
+Ftm           ftm1          __attribute__((init_priority(103))) {"FTM1", FTM1_BasePtr, FTM1_IRQn, 2};
+Ftm           ftm2          __attribute__((init_priority(103))) {"FTM2", FTM2_BasePtr, FTM2_IRQn, 2};
+Gpio          gpio          __attribute__((init_priority(103)));
+Adc           adc0          __attribute__((init_priority(103))) {"ADC0", ADC0_BasePtr, ADC0_IRQn, Dma0Slot_ADC0};
+Adc           adc1          __attribute__((init_priority(103))) {"ADC1", ADC1_BasePtr, ADC1_IRQn, Dma0Slot_ADC1};
+Pdb           pdb           __attribute__((init_priority(103)));
+Dma           dma           __attribute__((init_priority(103)));
+Uart          uart0         __attribute__((init_priority(103))) {"UART0", UART0_BasePtr, UART0_RxTx_IRQn};
+Ftfe          ftfe          __attribute__((init_priority(103)));
+SystemControl systemControl __attribute__((init_priority(103)));
+Dwt           dwt           __attribute__((init_priority(103)));
+
+/** Robot - after the models it drives */
+RubyPlant     plant         __attribute__((init_priority(103)));
+
+void restoreTerminal() {
+   if (terminalSaved) {
+      tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+      terminalSaved = false;
+   }
+}
+
+/**
+ * Reset - installs the vector table and connects UART0
+ */
+__attribute__((constructor(104)))
+void reset() {
+   using namespace USBDM;
+
+   // As vectors.cpp
+   static constexpr Cpu::Handler dmaHandlers[] = {
+         Dma0::irq0Handler,  Dma0::irq1Handler,  Dma0::irq2Handler,  Dma0::irq3Handler,
+         Dma0::irq4Handler,  Dma0::irq5Handler,  Dma0::irq6Handler,  Dma0::irq7Handler,
+         Dma0::irq8Handler,  Dma0::irq9Handler,  Dma0::irq10Handler, Dma0::irq11Handler,
+         Dma0::irq12Handler, Dma0::irq13Handler, Dma0::irq14Handler, Dma0::irq15Handler,
+   };
+   for (unsigned channel=0; channel<Dma::CHANNELS; channel++) {
+      Cpu::setHandler(DMA0_IRQn+channel, dmaHandlers[channel]);
+   }
+   Cpu::setHandler(DMA_Error_IRQn,  Dma0::irqErrorHandler);
+   Cpu::setHandler(UART0_RxTx_IRQn, Uart0::irqRxTxHandler);
+   Cpu::setHandler(FTM0_IRQn,       Ftm0::irqHandler);
+   Cpu::setHandler(FTM1_IRQn,       Ftm1::irqHandler);
+   Cpu::setHandler(FTM2_IRQn,       Ftm2::irqHandler);
+   Cpu::setHandler(PIT0_IRQn,       PitChannel<0>::irqHandler);
+   Cpu::setHandler(PIT1_IRQn,       PitChannel<1>::irqHandler);
+   Cpu::setHandler(PIT2_IRQn,       PitChannel<2>::irqHandler);
+   Cpu::setHandler(PIT3_IRQn,       PitChannel<3>::irqHandler);
+   if (SysTick_Handler != nullptr) {
+      Cpu::setHandler(SysTick_IRQn, SysTick_Handler);
+   }
+
+   *(volatile uint8_t *)RCM_SRS0_ADDRESS = RCM_SRS0_POR;
+
+   plant.setSupplyVoltage(options.supply);
+
+   if (options.stdio) {
+      if (isatty(STDIN_FILENO) && (tcgetattr(STDIN_FILENO, &savedTerminal) == 0)) {
+         // Characters are passed on as typed
+         struct termios settings = savedTerminal;
+         settings.c_lflag &= ~(ICANON|ECHO);
+         tcsetattr(STDIN_FILENO, TCSANOW, &settings);
+         terminalSaved = true;
+      }
+      uart0.connect(STDIN_FILENO, STDOUT_FILENO);
+   }
+   else if (!uart0.openPseudoTerminal()) {
+      exit(EXIT_FAILURE);
+   }
+}
+
+/**
+ * Firmware returned from main()
+ */
+__attribute__((destructor))
+void finish() {
+   restoreTerminal();
+}
+
+}
+
+}
+
+extern "C" {
+int __real_main();
+
+/**
+ * Entry point (linked with --wrap=main)\n
+ * The console is brought up here rather than in a constructor as the console
+ * object is constructed after the constructors with a priority.
+ */
+int __wrap_main() {
+   console_initialise();
+   return __real_main();
+}
+}
+
+namespace Host {
+
+VirtualClock &Simulator::clock() {
+   return *currentClock;
+}
+
+void Simulator::setClock(VirtualClock &clock) {
+   currentClock = &clock;
+}
+
+void Simulator::setTimeLimit(double seconds) {
+   clock().schedule(timeLimit, clock().toCycles(seconds));
+}
+
+void Simulator::addExitHandler(ExitHandler handler) {
+   if (exitHandlerCount >= MAX_EXIT_HANDLERS) {
+      fprintf(stderr, "Too many exit handlers\n");
+      abort();
+   }
+   exitHandlers[exitHandlerCount++] = handler;
+}
+
+void Simulator::exit(int exitCode, const char *reason) {
+   static bool exiting = false;
+   if (!exiting) {
+      exiting = true;
+      for (unsigned index=0; index<exitHandlerCount; index++) {
+         exitHandlers[index](exitCode);
+      }
+   }
+   restoreTerminal();
+   fflush(stdout);
+   if (reason != nullptr) {
+      log("%s", reason);
+   }
+   _Exit(exitCode);
+}
+
+void Simulator::log(const char *format, ...) {
+   va_list args;
+   va_start(args, format);
+   fprintf(stderr, "[%12.6f] ", time());
+   vfprintf(stderr, format, args);
+   fputc('\n', stderr);
+   va_end(args);
+}
+
+Pit &Simulator::pit() {
+   return Host::pit;
+}
+
+Ftm &Simulator::ftm(unsigned instance) {
+   static Ftm *const ftms[] = {&ftm0, &ftm1, &ftm2};
+   return *ftms[instance];
+}
+
+Gpio &Simulator::gpio() {
+   return Host::gpio;
+}
+
+Adc &Simulator::adc(unsigned instance) {
+   return (instance == 0)?adc0:adc1;
+}
+
+Pdb &Simulator::pdb() {
+   return Host::pdb;
+}
+
+Dma &Simulator::dma() {
+   return Host::dma;
+}
+
+Uart &Simulator::uart() {
+   return uart0;
+}
+
+Ftfe &Simulator::ftfe() {
+   return Host::ftfe;
+}
+
+RubyPlant &Simulator::plant() {
+   return Host::plant;
+}
+
+}
@@ -0,0 +1,152 @@
+/*
+ * Simulator.h
+ *
+ *  Host build - runs the firmware against register-level peripheral models
+ */
+
+#ifndef HOST_SIMULATOR_H_
+#define HOST_SIMULATOR_H_
+
+#include <stdint.h>
+#include "VirtualClock.h"
+
+namespace Host {
+
+class Pit;
+class Ftm;
+class Gpio;
+class Adc;
+class Pdb;
+class Dma;
+class Uart;
+class Ftfe;
+class RubyPlant;
+
+/**
+ * Simulation of the MK22FN1M0 running the firmware
+ *
+ * The firmware is compiled unchanged for the host. The device headers are
+ * rewritten so each register access is passed to a model of the peripheral
+ * (see HostRegister.h and HostHeaders.cmake). Time is virtual and only moves
+ * on register accesses and WFI so the firmware runs much faster than real time
+ * and a run is reproducible.
+ *
+ * Interrupts are taken at register accesses, WFI and when they are unmasked.
+ *
+ * Models provided:
+ *  - PIT, FTM0-2 (PWM, quadrature decoder, fault inputs), GPIOA-E
+ *  - ADC0-1, PDB0, DMA0/DMAMUX0
+ *  - UART0 connected to a pseudo-terminal or stdin/stdout
+ *  - FTFE (program/erase of the upper program flash block)
+ *  - SysTick, NVIC, SCB and the DWT cycle counter
+ * Other peripherals behave as plain memory.
+ *
+ * The robot (motors, encoders, grippers and motor supply) is modelled by
+ * RubyPlant which drives the models through their interfaces on the virtual
+ * clock.
+ *
+ * Command line options:
+ *  - --stdio           UART0 uses stdin/stdout rather than a pseudo-terminal
+ *  - --realtime[=f]    Pace simulated time at f times real time (default 1)
+ *  - --time=s          Stop after s seconds of simulated time
+ *  - --supply=v        Motor supply voltage (default 12)
+ */
+class Simulator {
+
+public:
+   /** Core clock frequency (Hz) - unit of virtual time */
+   static constexpr uint32_t CORE_CLOCK = 60000000;
+
+   /** Bus clock frequency (Hz) */
+   static constexpr uint32_t BUS_CLOCK  = 60000000;
+
+   /** Time taken by each register access by the core (core cycles) */
+   static constexpr unsigned ACCESS_CYCLES = 4;
+
+   /** Consecutive register reads without a write that are taken to be a polling loop */
+   static constexpr unsigned POLL_THRESHOLD = 32;
+
+   /** Largest step taken when skipping ahead in a polling loop (core cycles) */
+   static constexpr unsigned POLL_SKIP_CYCLES = CORE_CLOCK/100000;
+
+   /** Process exit codes */
+   enum ExitCode {
+      Exit_Success    = 0,  //!< Firmware stopped normally (breakpoint)
+      Exit_Failure    = 1,  //!< Simulation error
+      Exit_Deadlock   = 2,  //!< WFI with nothing left to wake it
+      Exit_TimeLimit  = 3,  //!< Time limit reached
+      Exit_Fault      = 4,  //!< Unhandled exception
+   };
+
+   /** Called when the simulation ends */
+   typedef void (*ExitHandler)(int exitCode);
+
+   /**
+    * Virtual clock
+    */
+   static VirtualClock &clock();
+
+   /**
+    * Replace the virtual clock
+    *
+    * @param[in] clock Clock to use (must remain valid)
+    *
+    * @note Must be called before the firmware runs e.g. from a constructor
+    */
+   static void setClock(VirtualClock &clock);
+
+   /**
+    * Current simulated time
+    *
+    * @return Time since reset (s)
+    */
+   static double time() {
+      return clock().seconds();
+   }
+
+   /**
+    * Stop the simulation after a time
+    *
+    * @param[in] seconds Simulated time (s)
+    */
+   static void setTimeLimit(double seconds);
+
+   /**
+    * Add a function to call when the simulation ends
+    *
+    * @param[in] handler Function to call
+    */
+   static void addExitHandler(ExitHandler handler);
+
+   /**
+    * End the simulation
+    *
+    * @param[in] exitCode Process exit code
+    * @param[in] reason   Reason reported on stderr (may be nullptr)
+    */
+   [[noreturn]] static void exit(int exitCode, const char *reason);
+
+   /**
+    * Write message to stderr with simulated time stamp
+    *
+    * @param[in] format printf() style format
+    */
+   static void log(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+   /** Peripheral models */
+   static Pit  &pit();
+   static Ftm  &ftm(unsigned instance);
+   static Gpio &gpio();
+   static Adc  &adc(unsigned instance);
+   static Pdb  &pdb();
+   static Dma  &dma();
+   static Uart &uart();
+   static Ftfe &ftfe();
+
+   /** Model of the robot */
+   static RubyPlant &plant();
+};
+
+}
+
+#endif /* HOST_SIMULATOR_H_ */
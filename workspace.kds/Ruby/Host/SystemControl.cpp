@@ -0,0 +1,380 @@
+/*
+ * SystemControl.cpp
+ *
+ *  Models of the Cortex-M4 system control space (SysTick, NVIC, SCB) and DWT
+ */
+
+#include <stddef.h>
+#include "HostCpu.h"
+#include "Simulator.h"
+#include "SystemControl.h"
+
+namespace Host {
+
+namespace {
+
+/** Offsets of register blocks within the system control space */
+constexpr uint32_t SYSTICK_OFFSET = SysTick_BASE-SCS_BASE;
+constexpr uint32_t NVIC_OFFSET    = NVIC_BASE-SCS_BASE;
+constexpr uint32_t SCB_OFFSET     = SCB_BASE-SCS_BASE;
+
+/** Offsets of registers within NVIC */
+constexpr uint32_t NVIC_ISER = 0x000;
+constexpr uint32_t NVIC_ICER = 0x080;
+constexpr uint32_t NVIC_ISPR = 0x100;
+constexpr uint32_t NVIC_ICPR = 0x180;
+constexpr uint32_t NVIC_IABR = 0x200;
+constexpr uint32_t NVIC_IP   = 0x300;
+constexpr uint32_t NVIC_STIR = 0xE00;
+constexpr uint32_t NVIC_SIZE = 0xC00;
+
+/** Offsets of registers within SCB */
+constexpr uint32_t SCB_CPUID = 0x00;
+constexpr uint32_t SCB_ICSR  = 0x04;
+constexpr uint32_t SCB_AIRCR = 0x0C;
+constexpr uint32_t SCB_SHP   = 0x18;
+constexpr uint32_t SCB_SIZE  = 0x90;
+
+/** Cortex-M4 r0p1 */
+constexpr uint32_t CPUID_VALUE = 0x410FC241;
+
+/** Key required for AIRCR writes */
+constexpr uint32_t AIRCR_VECTKEY = 0x05FA;
+
+/** Offsets of registers within DWT */
+constexpr uint32_t DWT_CTRL   = 0x00;
+constexpr uint32_t DWT_CYCCNT = 0x04;
+
+/** DWT CTRL reset value (4 comparators) */
+constexpr uint32_t DWT_CTRL_RESET = 0x40000000;
+
+/** Interrupts covered by each word of the NVIC bit registers */
+inline int firstIrq(uint32_t offset) {
+   return ((offset&0x7F)/4)*32;
+}
+
+}
+
+SystemControl::SystemControl() :
+      Peripheral("SCS", SCS_BASE, 0x1000),
+      tickEvent(*this, &SystemControl::tick) {
+   // CPUID is read-only in SCB_Type
+   rawWrite(SCB_BASE+offsetof(SCB_Type, CPUID), CPUID_VALUE, sizeof(uint32_t));
+   rawWrite(SCB_BASE+offsetof(SCB_Type, AIRCR), 0xFA050000, sizeof(uint32_t));
+   rawWrite(SysTick_BASE+offsetof(SysTick_Type, CALIB), SysTick_CALIB_NOREF_Msk|(Simulator::CORE_CLOCK/100-1), sizeof(uint32_t));
+}
+
+/**
+ * Value of counter
+ *
+ * @param[in] now Current time (cycles)
+ */
+uint32_t SystemControl::counterAt(uint64_t now) const {
+   if (!tickRunning) {
+      return systick->VAL.value;
+   }
+   uint64_t elapsed = now-tickStart;
+   if (elapsed <= tickStartValue) {
+      return tickStartValue-elapsed;
+   }
+   if (reload() == 0) {
+      // Counter stops at zero
+      return 0;
+   }
+   return reload()-(uint32_t)((elapsed-tickStartValue-1)%((uint64_t)reload()+1));
+}
+
+/**
+ * Number of times the counter has reached zero since it was started
+ *
+ * @param[in] now Current time (cycles)
+ */
+uint64_t SystemControl::zerosAt(uint64_t now) const {
+   if (!tickRunning || (reload() == 0)) {
+      return 0;
+   }
+   uint64_t elapsed = now-tickStart;
+   if (elapsed < firstZero()) {
+      return 0;
+   }
+   return 1+(elapsed-firstZero())/((uint64_t)reload()+1);
+}
+
+/**
+ * Latch COUNTFLAG if the counter has reached zero
+ *
+ * @param[in] now Current time (cycles)
+ */
+void SystemControl::updateCountFlag(uint64_t now) {
+   uint64_t zeros = zerosAt(now);
+   if (zeros > zerosReported) {
+      countFlag = true;
+   }
+   zerosReported = zeros;
+}
+
+/**
+ * Continue counting from a new value
+ *
+ * @param[in] now   Current time (cycles)
+ * @param[in] value Counter value
+ */
+void SystemControl::restartCounter(uint64_t now, uint32_t value) {
+   tickStart      = now;
+   tickStartValue = value;
+   zerosReported  = 0;
+}
+
+/**
+ * Schedule interrupt for the next time the counter reaches zero
+ */
+void SystemControl::scheduleTick() {
+   VirtualClock &clock = Simulator::clock();
+   if (!tickRunning || !(systick->CTRL.value&SysTick_CTRL_TICKINT_Msk) || (reload() == 0)) {
+      clock.cancel(tickEvent);
+      return;
+   }
+   uint64_t zeros = zerosAt(clock.now());
+   clock.schedule(tickEvent, tickStart+firstZero()+zeros*((uint64_t)reload()+1));
+}
+
+void SystemControl::tick(unsigned, uint64_t) {
+   Cpu::setPending(SysTick_IRQn);
+   scheduleTick();
+}
+
+uint32_t SystemControl::readSysTick(uint32_t offset) {
+   uint64_t now = Simulator::clock().now();
+   switch(offset) {
+      case offsetof(SysTick_Type, CTRL): {
+         // COUNTFLAG is cleared by reading
+         updateCountFlag(now);
+         uint32_t value = systick->CTRL.value;
+         if (countFlag) {
+            value |= SysTick_CTRL_COUNTFLAG_Msk;
+         }
+         countFlag = false;
+         return value;
+      }
+      case offsetof(SysTick_Type, VAL):
+         return counterAt(now);
+      default:
+         return rawRead(SysTick_BASE+offset, sizeof(uint32_t));
+   }
+}
+
+void SystemControl::writeSysTick(uint32_t offset, uint32_t value) {
+   uint64_t now = Simulator::clock().now();
+   switch(offset) {
+      case offsetof(SysTick_Type, CTRL): {
+         bool enable = value&SysTick_CTRL_ENABLE_Msk;
+         updateCountFlag(now);
+         if (tickRunning && !enable) {
+            systick->VAL.value = counterAt(now);
+            tickRunning = false;
+         }
+         else if (!tickRunning && enable) {
+            restartCounter(now, systick->VAL.value);
+            tickRunning = true;
+         }
+         systick->CTRL.value = value&(SysTick_CTRL_ENABLE_Msk|SysTick_CTRL_TICKINT_Msk|SysTick_CTRL_CLKSOURCE_Msk);
+         if (!(value&SysTick_CTRL_TICKINT_Msk)) {
+            Cpu::clearPending(SysTick_IRQn);
+         }
+         break;
+      }
+      case offsetof(SysTick_Type, LOAD):
+         // Takes effect on the next reload - approximated by restarting from the current value
+         updateCountFlag(now);
+         if (tickRunning) {
+            restartCounter(now, counterAt(now));
+         }
+         systick->LOAD.value = value&SysTick_LOAD_RELOAD_Msk;
+         break;
+      case offsetof(SysTick_Type, VAL):
+         // Any write clears the counter and COUNTFLAG
+         systick->VAL.value = 0;
+         countFlag = false;
+         if (tickRunning) {
+            restartCounter(now, 0);
+         }
+         break;
+      default:
+         // CALIB is read-only
+         break;
+   }
+   scheduleTick();
+}
+
+uint32_t SystemControl::readNvic(uint32_t offset, unsigned size) {
+   if ((offset < NVIC_IP) && (size == sizeof(uint32_t))) {
+      uint32_t value = 0;
+      int      irq   = firstIrq(offset);
+      for (unsigned bit=0; bit<32; bit++) {
+         bool state;
+         if (offset < NVIC_ISPR) {
+            state = Cpu::isEnabled(irq+bit);
+         }
+         else if (offset < NVIC_IABR) {
+            state = Cpu::isPending(irq+bit);
+         }
+         else {
+            state = Cpu::isActive(irq+bit);
+         }
+         if (state) {
+            value |= (1U<<bit);
+         }
+      }
+      return value;
+   }
+   return rawRead(NVIC_BASE+offset, size);
+}
+
+void SystemControl::writeNvic(uint32_t offset, uint32_t value, unsigned size) {
+   if (offset < NVIC_IABR) {
+      int irq = firstIrq(offset);
+      for (unsigned bit=0; bit<32; bit++) {
+         if (!(value&(1U<<bit))) {
+            continue;
+         }
+         switch(offset&~0x7F) {
+            case NVIC_ISER: Cpu::setEnabled(irq+bit, true);  break;
+            case NVIC_ICER: Cpu::setEnabled(irq+bit, false); break;
+            case NVIC_ISPR: Cpu::setPending(irq+bit);        break;
+            case NVIC_ICPR: Cpu::clearPending(irq+bit);      break;
+         }
+      }
+      return;
+   }
+   if ((offset >= NVIC_IP) && (offset < NVIC_SIZE)) {
+      rawWrite(NVIC_BASE+offset, value, size);
+      for (unsigned index=0; index<size; index++) {
+         Cpu::setPriority(offset-NVIC_IP+index, (uint8_t)(value>>(8*index)));
+      }
+      return;
+   }
+   if (offset == NVIC_STIR) {
+      Cpu::setPending(value&NVIC_STIR_INTID_Msk);
+   }
+}
+
+uint32_t SystemControl::readScb(uint32_t offset, unsigned size) {
+   if (offset == SCB_ICSR) {
+      uint32_t value = Cpu::getIpsr()&SCB_ICSR_VECTACTIVE_Msk;
+      if (Cpu::isPending(SysTick_IRQn)) {
+         value |= SCB_ICSR_PENDSTSET_Msk;
+      }
+      if (Cpu::isPending(PendSV_IRQn)) {
+         value |= SCB_ICSR_PENDSVSET_Msk;
+      }
+      return value;
+   }
+   return rawRead(SCB_BASE+offset, size);
+}
+
+void SystemControl::writeScb(uint32_t offset, uint32_t value, unsigned size) {
+   switch(offset) {
+      case SCB_CPUID:
+         return;
+      case SCB_ICSR:
+         if (value&SCB_ICSR_PENDSTSET_Msk) {
+            Cpu::setPending(SysTick_IRQn);
+         }
+         if (value&SCB_ICSR_PENDSTCLR_Msk) {
+            Cpu::clearPending(SysTick_IRQn);
+         }
+         if (value&SCB_ICSR_PENDSVSET_Msk) {
+            Cpu::setPending(PendSV_IRQn);
+         }
+         if (value&SCB_ICSR_PENDSVCLR_Msk) {
+            Cpu::clearPending(PendSV_IRQn);
+         }
+         return;
+      case SCB_AIRCR:
+         if (((value&SCB_AIRCR_VECTKEY_Msk)>>SCB_AIRCR_VECTKEY_Pos) != AIRCR_VECTKEY) {
+            return;
+         }
+         if (value&SCB_AIRCR_SYSRESETREQ_Msk) {
+            Simulator::exit(Simulator::Exit_Success, "System reset requested");
+         }
+         rawWrite(SCB_BASE+offset, 0xFA050000|(value&SCB_AIRCR_PRIGROUP_Msk), sizeof(uint32_t));
+         return;
+   }
+   rawWrite(SCB_BASE+offset, value, size);
+   if ((offset >= SCB_SHP) && (offset < SCB_SHP+12)) {
+      // System handler priorities start at MemoryManagement (exception 4)
+      for (unsigned index=0; (index<size) && (offset+index < SCB_SHP+12); index++) {
+         Cpu::setPriority(offset-SCB_SHP+index+4-16, (uint8_t)(value>>(8*index)));
+      }
+   }
+}
+
+uint32_t SystemControl::read(uint32_t offset, unsigned size) {
+   if ((offset >= SYSTICK_OFFSET) && (offset < SYSTICK_OFFSET+sizeof(SysTick_Type))) {
+      return readSysTick(offset-SYSTICK_OFFSET);
+   }
+   if ((offset >= NVIC_OFFSET) && (offset < NVIC_OFFSET+NVIC_STIR)) {
+      return readNvic(offset-NVIC_OFFSET, size);
+   }
+   if ((offset >= SCB_OFFSET) && (offset < SCB_OFFSET+SCB_SIZE)) {
+      return readScb(offset-SCB_OFFSET, size);
+   }
+   return Peripheral::read(offset, size);
+}
+
+void SystemControl::write(uint32_t offset, uint32_t value, unsigned size) {
+   if ((offset >= SYSTICK_OFFSET) && (offset < SYSTICK_OFFSET+sizeof(SysTick_Type))) {
+      writeSysTick(offset-SYSTICK_OFFSET, value);
+      return;
+   }
+   if ((offset >= NVIC_OFFSET) && (offset <= NVIC_OFFSET+NVIC_STIR)) {
+      writeNvic(offset-NVIC_OFFSET, value, size);
+      return;
+   }
+   if ((offset >= SCB_OFFSET) && (offset < SCB_OFFSET+SCB_SIZE)) {
+      writeScb(offset-SCB_OFFSET, value, size);
+      return;
+   }
+   Peripheral::write(offset, value, size);
+}
+
+Dwt::Dwt() : Peripheral("DWT", DWT_BASE, 0x1000) {
+   dwt->CTRL.value = DWT_CTRL_RESET;
+}
+
+/**
+ * Current value of cycle counter
+ */
+uint32_t Dwt::cycleCount() const {
+   if (!isCounting()) {
+      return countBase;
+   }
+   return countBase+(uint32_t)(Simulator::clock().now()-countStart);
+}
+
+uint32_t Dwt::read(uint32_t offset, unsigned size) {
+   if (offset == DWT_CYCCNT) {
+      return cycleCount();
+   }
+   return Peripheral::read(offset, size);
+}
+
+void Dwt::write(uint32_t offset, uint32_t value, unsigned size) {
+   switch(offset) {
+      case DWT_CTRL:
+         countBase  = cycleCount();
+         countStart = Simulator::clock().now();
+         // Only the enables are writable
+         dwt->CTRL.value = (dwt->CTRL.value&0xFFFF0000)|(value&0x0000FFFF);
+         break;
+      case DWT_CYCCNT:
+         countBase  = value;
+         countStart = Simulator::clock().now();
+         break;
+      default:
+         Peripheral::write(offset, value, size);
+         break;
+   }
+}
+
+}
@@ -0,0 +1,103 @@
+/*
+ * SystemControl.h
+ *
+ *  Models of the Cortex-M4 system control space (SysTick, NVIC, SCB) and DWT
+ */
+
+#ifndef HOST_SYSTEMCONTROL_H_
+#define HOST_SYSTEMCONTROL_H_
+
+#include "derivative.h"
+#include "Peripheral.h"
+#include "VirtualClock.h"
+
+namespace Host {
+
+/**
+ * System control space
+ *
+ *  - SysTick counts core clock cycles (the reference clock option is treated the same)
+ *  - NVIC and SCB priority/enable/pending registers are routed to Cpu
+ *  - Other registers are plain memory
+ */
+class SystemControl : public Peripheral {
+
+private:
+   /** SysTick counter running */
+   bool     tickRunning    = false;
+   /** Time counter was started or last changed (cycles) */
+   uint64_t tickStart      = 0;
+   /** Counter value at tickStart */
+   uint32_t tickStartValue = 0;
+   /** Zero counts already accounted for in countFlag */
+   uint64_t zerosReported  = 0;
+   /** COUNTFLAG - counter has reached zero since CTRL was last read */
+   bool     countFlag      = false;
+
+   /** SysTick reaching zero with TICKINT set */
+   EventOf<SystemControl> tickEvent;
+
+   /** SysTick registers */
+   volatile SysTick_Type *const systick = (volatile SysTick_Type *)SysTick_BASE;
+
+   /** Reload value */
+   uint32_t reload() const {
+      return systick->LOAD.value&SysTick_LOAD_RELOAD_Msk;
+   }
+
+   /** Time from tickStart to first zero */
+   uint64_t firstZero() const {
+      return (tickStartValue != 0)?tickStartValue:(uint64_t)reload()+1;
+   }
+
+   uint32_t counterAt(uint64_t now) const;
+   uint64_t zerosAt(uint64_t now) const;
+   void     updateCountFlag(uint64_t now);
+   void     restartCounter(uint64_t now, uint32_t value);
+   void     scheduleTick();
+   void     tick(unsigned, uint64_t now);
+
+   uint32_t readSysTick(uint32_t offset);
+   void     writeSysTick(uint32_t offset, uint32_t value);
+   uint32_t readNvic(uint32_t offset, unsigned size);
+   void     writeNvic(uint32_t offset, uint32_t value, unsigned size);
+   uint32_t readScb(uint32_t offset, unsigned size);
+   void     writeScb(uint32_t offset, uint32_t value, unsigned size);
+
+public:
+   SystemControl();
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+};
+
+/**
+ * Data watchpoint and trace unit - only the cycle counter is modelled
+ */
+class Dwt : public Peripheral {
+
+private:
+   /** CYCCNT at countStart */
+   uint32_t countBase  = 0;
+   /** Time CYCCNT was last written or enabled */
+   uint64_t countStart = 0;
+
+   volatile DWT_Type *const dwt = (volatile DWT_Type *)DWT_BASE;
+
+   /** Counter is running */
+   bool isCounting() const {
+      return dwt->CTRL.value&DWT_CTRL_CYCCNTENA_Msk;
+   }
+
+   uint32_t cycleCount() const;
+
+public:
+   Dwt();
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+};
+
+}
+
+#endif /* HOST_SYSTEMCONTROL_H_ */
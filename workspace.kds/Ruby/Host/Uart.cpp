@@ -0,0 +1,197 @@
+/*
+ * Uart.cpp
+ *
+ *  Model of the Universal Asynchronous Receiver/Transmitter
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "HostCpu.h"
+#include "Uart.h"
+#include "Simulator.h"
+
+// After the device headers - defines names used for registers (CR0 etc.)
+#include <termios.h>
+#include <unistd.h>
+
+namespace Host {
+
+namespace {
+
+/** Fractional part of divider is in 1/32 */
+constexpr unsigned BRFA_SCALE = 32;
+
+/** Fixed over-sampling ratio */
+constexpr unsigned OVER_SAMPLE = 16;
+
+}
+
+Uart::Uart(const char *name, uint32_t base, int irqNum) :
+      Peripheral(name, base, 0x1000),
+      uart((volatile UART_Type *)(uintptr_t)base),
+      irqNum(irqNum),
+      txEvent(*this, &Uart::transmitted),
+      rxEvent(*this, &Uart::receivePoll) {
+   uart->BDL.value = 0x04;
+   uart->S1.value  = UART_S1_TDRE_MASK|UART_S1_TC_MASK;
+}
+
+/**
+ * Duration of a character (core cycles)
+ */
+uint64_t Uart::characterCycles() const {
+   unsigned sbr  = ((uart->BDH.value&UART_BDH_SBR_MASK)<<8)|uart->BDL.value;
+   unsigned brfa = (uart->C4.value&UART_C4_BRFA_MASK)>>UART_C4_BRFA_SHIFT;
+   uint64_t divider = sbr*BRFA_SCALE+brfa;
+   if (divider == 0) {
+      // Baud rate generator is off - use slowest rate
+      divider = ((UART_BDH_SBR_MASK<<8)|0xFF)*BRFA_SCALE;
+   }
+   // UART0 is clocked by the core clock
+   return (CHARACTER_BITS*OVER_SAMPLE*divider)/BRFA_SCALE;
+}
+
+/**
+ * Move character to shift register and start transmission
+ */
+void Uart::startShifting(uint8_t data) {
+   shifting = true;
+   shifter  = data;
+   uart->S1.value &= ~UART_S1_TC_MASK;
+   Simulator::clock().scheduleIn(txEvent, characterCycles());
+}
+
+/**
+ * Character has been shifted out
+ */
+void Uart::transmitted(unsigned, uint64_t) {
+   if ((outFd >= 0) && (::write(outFd, &shifter, 1) < 0) && (errno != EAGAIN)) {
+      Simulator::log("%s: Write failed", getName());
+      outFd = -1;
+   }
+   shifting = false;
+   if (!(uart->S1.value&UART_S1_TDRE_MASK)) {
+      // Next character from holding register
+      uart->S1.value |= UART_S1_TDRE_MASK;
+      startShifting(txData);
+   }
+   else {
+      uart->S1.value |= UART_S1_TC_MASK;
+   }
+   updateIrq();
+}
+
+/**
+ * Sample host input
+ */
+void Uart::receivePoll(unsigned, uint64_t) {
+   bool enabled = uart->C2.value&UART_C2_RE_MASK;
+   if (enabled && !(uart->S1.value&UART_S1_RDRF_MASK) && (inFd >= 0)) {
+      struct pollfd fds = {inFd, POLLIN, 0};
+      if (poll(&fds, 1, 0) > 0) {
+         uint8_t data;
+         ssize_t rc = ::read(inFd, &data, 1);
+         if (rc == 1) {
+            rxData = data;
+            uart->S1.value |= UART_S1_RDRF_MASK;
+            updateIrq();
+         }
+         else if ((rc == 0) || ((errno != EAGAIN) && (errno != EINTR))) {
+            // End of file (or pseudo-terminal closed)
+            if (!endOfInput) {
+               Simulator::log("%s: End of input", getName());
+            }
+            endOfInput = true;
+         }
+      }
+   }
+   if (!endOfInput) {
+      Simulator::clock().scheduleIn(rxEvent, enabled?characterCycles():IDLE_POLL_CYCLES);
+   }
+}
+
+void Uart::updateIrq() {
+   uint8_t c2 = uart->C2.value;
+   uint8_t s1 = uart->S1.value;
+   bool asserted =
+         ((c2&UART_C2_TIE_MASK)  && (s1&UART_S1_TDRE_MASK)) ||
+         ((c2&UART_C2_TCIE_MASK) && (s1&UART_S1_TC_MASK))   ||
+         ((c2&UART_C2_RIE_MASK)  && (s1&UART_S1_RDRF_MASK));
+   Cpu::setIrqLevel(irqNum, asserted);
+}
+
+uint32_t Uart::read(uint32_t offset, unsigned size) {
+   if (offset == offsetof(UART_Type, D)) {
+      uart->S1.value &= ~UART_S1_RDRF_MASK;
+      updateIrq();
+      return rxData;
+   }
+   return Peripheral::read(offset, size);
+}
+
+void Uart::write(uint32_t offset, uint32_t value, unsigned size) {
+   switch(offset) {
+      case offsetof(UART_Type, S1):
+         // Read-only
+         return;
+      case offsetof(UART_Type, D):
+         if (!(uart->C2.value&UART_C2_TE_MASK)) {
+            return;
+         }
+         if (!shifting) {
+            startShifting((uint8_t)value);
+         }
+         else if (uart->S1.value&UART_S1_TDRE_MASK) {
+            txData = (uint8_t)value;
+            uart->S1.value &= ~UART_S1_TDRE_MASK;
+         }
+         // else overwrites character being held - lost
+         updateIrq();
+         return;
+      case offsetof(UART_Type, C2):
+         Peripheral::write(offset, value, size);
+         if (!rxEvent.isScheduled() && !endOfInput && (value&UART_C2_RE_MASK)) {
+            Simulator::clock().scheduleIn(rxEvent, characterCycles());
+         }
+         updateIrq();
+         return;
+   }
+   Peripheral::write(offset, value, size);
+}
+
+void Uart::connect(int in, int out) {
+   inFd  = in;
+   outFd = out;
+   if (inFd >= 0) {
+      fcntl(inFd, F_SETFL, fcntl(inFd, F_GETFL)|O_NONBLOCK);
+   }
+   endOfInput = false;
+   Simulator::clock().scheduleIn(rxEvent, IDLE_POLL_CYCLES);
+}
+
+bool Uart::openPseudoTerminal() {
+   int master = posix_openpt(O_RDWR|O_NOCTTY);
+   if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0)) {
+      perror("posix_openpt");
+      return false;
+   }
+   const char *slaveName = ptsname(master);
+   // Keep the slave open so output isn't lost before a terminal program connects
+   int slave = open(slaveName, O_RDWR|O_NOCTTY);
+   if (slave >= 0) {
+      struct termios settings;
+      tcgetattr(slave, &settings);
+      cfmakeraw(&settings);
+      tcsetattr(slave, TCSANOW, &settings);
+   }
+   fcntl(master, F_SETFL, fcntl(master, F_GETFL)|O_NONBLOCK);
+   fprintf(stderr, "%s: Connected to %s\n", getName(), slaveName);
+   connect(master, master);
+   return true;
+}
+
+}
@@ -0,0 +1,102 @@
+/*
+ * Uart.h
+ *
+ *  Model of the Universal Asynchronous Receiver/Transmitter
+ */
+
+#ifndef HOST_UART_H_
+#define HOST_UART_H_
+
+#include "derivative.h"
+#include "Peripheral.h"
+#include "VirtualClock.h"
+
+namespace Host {
+
+/**
+ * UART connected to a host file descriptor
+ *
+ *  - Transmit holding register and shift register with TDRE/TC flags
+ *  - Receive data register with RDRF flag - the host input is sampled once per
+ *    character time so input is never overrun
+ *  - Character time from SBR/BRFA (8N1, 16x over-sampling of the core clock)
+ *  - Transmit, transmit complete and receive interrupts
+ *  - FIFOs, DMA, parity, 9-bit data, break and idle detection are not modelled
+ *
+ * The UART is connected to a pseudo-terminal (connect with e.g. screen or
+ * picocom) or to stdin/stdout.
+ */
+class Uart : public Peripheral {
+
+public:
+   /** Bits per character (start + 8 data + stop) */
+   static constexpr unsigned CHARACTER_BITS = 10;
+
+   /** Host input is sampled at this interval while the receiver is disabled (core cycles) */
+   static constexpr unsigned IDLE_POLL_CYCLES = 60000;
+
+private:
+   volatile UART_Type *const uart;
+
+   /** IRQ number */
+   const int irqNum;
+
+   /** Host file descriptors */
+   int inFd  = -1;
+   int outFd = -1;
+
+   /** Character in transmit shift register */
+   bool    shifting = false;
+   uint8_t shifter  = 0;
+
+   /** Character in transmit holding register */
+   uint8_t txData = 0;
+
+   /** Character in receive data register */
+   uint8_t rxData = 0;
+
+   /** Host input has ended */
+   bool endOfInput = false;
+
+   EventOf<Uart> txEvent;
+   EventOf<Uart> rxEvent;
+
+   uint64_t characterCycles() const;
+   void     startShifting(uint8_t data);
+   void     transmitted(unsigned, uint64_t now);
+   void     receivePoll(unsigned, uint64_t now);
+   void     updateIrq();
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] name   Name used in messages
+    * @param[in] base   Base address
+    * @param[in] irqNum IRQ number
+    */
+   Uart(const char *name, uint32_t base, int irqNum);
+
+   virtual uint32_t read(uint32_t offset, unsigned size) override;
+   virtual void     write(uint32_t offset, uint32_t value, unsigned size) override;
+
+   /**
+    * Connect to host file descriptors
+    *
+    * @param[in] in  Descriptor read for received characters (made non-blocking)
+    * @param[in] out Descriptor transmitted characters are written to
+    */
+   void connect(int in, int out);
+
+   /**
+    * Connect to a new pseudo-terminal\n
+    * The name of the terminal is reported on stderr.
+    *
+    * @return false on failure
+    */
+   bool openPseudoTerminal();
+};
+
+}
+
+#endif /* HOST_UART_H_ */
@@ -0,0 +1,97 @@
+/*
+ * VirtualClock.cpp
+ *
+ *  Simulated time for the host build
+ */
+
+#include <algorithm>
+#include <time.h>
+#include "VirtualClock.h"
+
+namespace Host {
+
+void VirtualClock::advanceTo(uint64_t target) {
+   // Events may schedule further events (including at the current time)
+   while (!events.empty() && (events.front()->due <= target)) {
+      Event *event = events.front();
+      events.erase(events.begin());
+      event->scheduled = false;
+      if (event->due > time) {
+         time = event->due;
+      }
+      event->fire(time);
+   }
+   if (target > time) {
+      time = target;
+   }
+   advanced(time);
+}
+
+bool VirtualClock::advanceToNextEvent() {
+   if (events.empty()) {
+      return false;
+   }
+   advanceTo(events.front()->due);
+   return true;
+}
+
+void VirtualClock::schedule(Event &event, uint64_t due) {
+   if (event.scheduled) {
+      cancel(event);
+   }
+   event.due       = due;
+   event.scheduled = true;
+
+   // After any events due at the same time so they fire in order of scheduling
+   auto position = std::upper_bound(events.begin(), events.end(), due,
+         [](uint64_t due, const Event *other) { return due < other->due; });
+   events.insert(position, &event);
+}
+
+void VirtualClock::cancel(Event &event) {
+   if (!event.scheduled) {
+      return;
+   }
+   auto position = std::find(events.begin(), events.end(), &event);
+   if (position != events.end()) {
+      events.erase(position);
+   }
+   event.scheduled = false;
+}
+
+namespace {
+
+/**
+ * Wall-clock time
+ *
+ * @return Monotonic time (ns)
+ */
+uint64_t wallClockNs() {
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec*1000000000ULL+now.tv_nsec;
+}
+
+}
+
+RealTimeClock::RealTimeClock(uint32_t frequency, double factor) :
+      VirtualClock(frequency), factor(factor), startNs(wallClockNs()) {
+}
+
+void RealTimeClock::advanced(uint64_t now) {
+   // Only check each simulated millisecond to keep the overhead low
+   if ((now-lastCheck) < (getFrequency()/1000)) {
+      return;
+   }
+   lastCheck = now;
+
+   uint64_t dueNs     = startNs+(uint64_t)(seconds()*1e9/factor);
+   uint64_t currentNs = wallClockNs();
+   if (dueNs > currentNs) {
+      uint64_t delayNs = dueNs-currentNs;
+      timespec delay = {(time_t)(delayNs/1000000000ULL), (long)(delayNs%1000000000ULL)};
+      nanosleep(&delay, nullptr);
+   }
+}
+
+}
@@ -0,0 +1,282 @@
+/*
+ * VirtualClock.h
+ *
+ *  Simulated time for the host build
+ */
+
+#ifndef HOST_VIRTUALCLOCK_H_
+#define HOST_VIRTUALCLOCK_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace Host {
+
+class VirtualClock;
+
+/**
+ * Something that happens at a point in simulated time
+ *
+ * Peripheral models (and plant models) derive from this and schedule
+ * themselves on the clock. An event is scheduled at most once - scheduling
+ * again moves it.
+ */
+class Event {
+
+   friend class VirtualClock;
+
+private:
+   /** Time event is due (cycles) */
+   uint64_t due = 0;
+
+   /** Event is in the queue */
+   bool scheduled = false;
+
+public:
+   virtual ~Event() = default;
+
+   /**
+    * Called when simulated time reaches the event
+    *
+    * @param[in] now Current time (cycles)
+    */
+   virtual void fire(uint64_t now) = 0;
+
+   /**
+    * Indicates the event is waiting to fire
+    */
+   bool isScheduled() const {
+      return scheduled;
+   }
+
+   /**
+    * Time the event is due
+    *
+    * @return Time (cycles) - only meaningful when scheduled
+    */
+   uint64_t getDue() const {
+      return due;
+   }
+};
+
+/**
+ * Event that calls a member function of its owner
+ *
+ * Allows a model with several timers (e.g. one per channel) to hold an event
+ * for each without a separate class.
+ *
+ * @tparam Owner Class of owner
+ */
+template<class Owner>
+class EventOf : public Event {
+
+public:
+   /**
+    * Action when the event fires
+    *
+    * @param[in] index Index given to the constructor e.g. channel number
+    * @param[in] now   Current time (cycles)
+    */
+   typedef void (Owner::*Action)(unsigned index, uint64_t now);
+
+private:
+   Owner        &owner;
+   const Action  action;
+   const unsigned index;
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] owner  Object to call
+    * @param[in] action Member to call
+    * @param[in] index  Passed to action
+    */
+   EventOf(Owner &owner, Action action, unsigned index=0) : owner(owner), action(action), index(index) {
+   }
+
+   virtual void fire(uint64_t now) override {
+      (owner.*action)(index, now);
+   }
+};
+
+/**
+ * Source of simulated time
+ *
+ * Time is counted in cycles of the core clock and only moves when the
+ * simulation advances it:
+ *  - Each peripheral register access costs Bus::ACCESS_CYCLES
+ *  - WFI skips directly to the next event
+ * Code that does not touch a peripheral takes no time, so the firmware runs as
+ * fast as the host allows and results are reproducible.
+ *
+ * The clock is injectable (see Simulator::setClock()) so a harness can supply a
+ * derived clock that e.g. paces the simulation against wall-clock time or
+ * records each step.
+ */
+class VirtualClock {
+
+private:
+   /** Current time (cycles) */
+   uint64_t time = 0;
+
+   /** Clock frequency (Hz) */
+   const uint32_t frequency;
+
+   /** Scheduled events (in due order) */
+   std::vector<Event*> events;
+
+protected:
+   /**
+    * Hook called after time has moved\n
+    * Override to pace or observe the simulation.
+    *
+    * @param[in] now Current time (cycles)
+    */
+   virtual void advanced(uint64_t now) {
+      (void)now;
+   }
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] frequency Frequency of the core clock (Hz)
+    */
+   VirtualClock(uint32_t frequency) : frequency(frequency) {
+   }
+
+   virtual ~VirtualClock() = default;
+
+   /**
+    * Current time
+    *
+    * @return Time since reset (cycles)
+    */
+   uint64_t now() const {
+      return time;
+   }
+
+   /**
+    * Current time
+    *
+    * @return Time since reset (s)
+    */
+   double seconds() const {
+      return (double)time/frequency;
+   }
+
+   /**
+    * Frequency of the core clock
+    *
+    * @return Frequency (Hz)
+    */
+   uint32_t getFrequency() const {
+      return frequency;
+   }
+
+   /**
+    * Convert a duration to cycles
+    *
+    * @param[in] seconds Duration (s)
+    *
+    * @return Cycles (rounded)
+    */
+   uint64_t toCycles(double seconds) const {
+      return (uint64_t)(seconds*frequency+0.5);
+   }
+
+   /**
+    * Move time forward firing any events that fall due
+    *
+    * @param[in] cycles Time to advance
+    */
+   void advance(uint64_t cycles) {
+      advanceTo(time+cycles);
+   }
+
+   /**
+    * Move time forward firing any events that fall due
+    *
+    * @param[in] target Time to advance to (cycles)
+    */
+   void advanceTo(uint64_t target);
+
+   /**
+    * Move time forward to the next event and fire it
+    *
+    * @return false if there are no events
+    */
+   bool advanceToNextEvent();
+
+   /**
+    * Time of the next event
+    *
+    * @return Time (cycles) or UINT64_MAX if none
+    */
+   uint64_t nextEvent() const {
+      return events.empty()?UINT64_MAX:events.front()->due;
+   }
+
+   /**
+    * Schedule an event (moves it if already scheduled)
+    *
+    * @param[in] event Event
+    * @param[in] due   Time to fire (cycles) - an earlier time fires on the next advance
+    */
+   void schedule(Event &event, uint64_t due);
+
+   /**
+    * Schedule an event relative to now
+    *
+    * @param[in] event Event
+    * @param[in] delay Cycles from now
+    */
+   void scheduleIn(Event &event, uint64_t delay) {
+      schedule(event, time+delay);
+   }
+
+   /**
+    * Remove an event from the queue
+    *
+    * @param[in] event Event
+    */
+   void cancel(Event &event);
+};
+
+/**
+ * Virtual clock paced against wall-clock time
+ *
+ * Simulated time is not allowed to run ahead of (scaled) real time. This is
+ * useful when a person or another program is talking to the firmware over the
+ * UART. The simulation may still run slower than real time if the host can't
+ * keep up.
+ */
+class RealTimeClock : public VirtualClock {
+
+private:
+   /** Ratio of simulated time to real time */
+   const double factor;
+
+   /** Simulated time of last check */
+   uint64_t lastCheck = 0;
+
+   /** Wall-clock time at start (ns) */
+   uint64_t startNs;
+
+protected:
+   virtual void advanced(uint64_t now) override;
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] frequency Frequency of the core clock (Hz)
+    * @param[in] factor    Ratio of simulated time to real time e.g. 0.1 => 10 times slower than real time
+    */
+   RealTimeClock(uint32_t frequency, double factor=1.0);
+};
+
+}
+
+#endif /* HOST_VIRTUALCLOCK_H_ */
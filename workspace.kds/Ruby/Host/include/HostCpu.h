@@ -0,0 +1,152 @@
+/*
+ * HostCpu.h
+ *
+ *  Processor state for the host build
+ *
+ *  Included by the host cmsis_gcc.h which may be inside an extern "C" block
+ *  so only plain declarations are allowed here.
+ */
+
+#ifndef HOST_HOSTCPU_H_
+#define HOST_HOSTCPU_H_
+
+#include <stdint.h>
+
+namespace Host {
+
+/**
+ * Stands in for the Cortex-M4 core
+ *
+ * Holds the interrupt masks and NVIC state and runs the exception handlers
+ * when an enabled interrupt of sufficient priority is pending. Handlers run
+ * nested on the host stack at the point of the register access, WFI or
+ * unmasking that made them eligible, so the firmware sees them preempt it
+ * between accesses as it would on the target.
+ */
+class Cpu {
+
+public:
+   /** Number of exceptions (16 system + 82 external) */
+   static constexpr unsigned EXCEPTIONS = 16+82;
+
+   /** Exception handler */
+   typedef void (*Handler)();
+
+   /** PRIMASK */
+   static uint32_t getPrimask();
+   static void     setPrimask(uint32_t value);
+
+   /** BASEPRI */
+   static uint32_t getBasepri();
+   static void     setBasepri(uint32_t value);
+   static void     setBasepriMax(uint32_t value);
+
+   /** FAULTMASK */
+   static uint32_t getFaultmask();
+   static void     setFaultmask(uint32_t value);
+
+   /**
+    * Exception number of the active handler (IPSR)
+    *
+    * @return 0 in thread mode
+    */
+   static uint32_t getIpsr();
+
+   /**
+    * Nominal stack pointer for MSP/PSP reads
+    *
+    * @return Address within the stack region reported to the firmware
+    */
+   static uint32_t getStackPointer();
+
+   /**
+    * Wait for an interrupt (WFI/WFE)\n
+    * Advances the virtual clock to the next event until an enabled interrupt is pending.
+    * Masking by PRIMASK delays the handler but not the wake-up, as on the target.
+    */
+   static void waitForInterrupt();
+
+   /**
+    * Breakpoint (BKPT) - there is no debugger so the simulation ends
+    *
+    * @param[in] value Immediate value of the instruction
+    */
+   static void breakpoint(unsigned value=0);
+
+   /**
+    * Run any pending interrupts that may preempt the current execution priority
+    */
+   static void service();
+
+   /**
+    * Set the level of an interrupt request line\n
+    * An asserted line makes the interrupt pending.
+    *
+    * @param[in] irqNum   IRQ number (as IRQn_Type, negative for system exceptions)
+    * @param[in] asserted Level of request
+    */
+   static void setIrqLevel(int irqNum, bool asserted);
+
+   /**
+    * Make an interrupt pending (as NVIC ISPR)
+    *
+    * @param[in] irqNum IRQ number (as IRQn_Type, negative for system exceptions)
+    */
+   static void setPending(int irqNum);
+
+   /**
+    * Clear a pending interrupt (as NVIC ICPR)
+    *
+    * @param[in] irqNum IRQ number (as IRQn_Type, negative for system exceptions)
+    */
+   static void clearPending(int irqNum);
+
+   /**
+    * Check if an interrupt is pending
+    *
+    * @param[in] irqNum IRQ number (as IRQn_Type, negative for system exceptions)
+    */
+   static bool isPending(int irqNum);
+
+   /**
+    * Check if an exception handler is executing (possibly preempted)
+    *
+    * @param[in] irqNum IRQ number (as IRQn_Type, negative for system exceptions)
+    */
+   static bool isActive(int irqNum);
+
+   /**
+    * Enable or disable an external interrupt in the NVIC
+    *
+    * @param[in] irqNum IRQ number (as IRQn_Type)
+    * @param[in] enable True to enable
+    */
+   static void setEnabled(int irqNum, bool enable);
+
+   /**
+    * Check if an external interrupt is enabled in the NVIC
+    *
+    * @param[in] irqNum IRQ number (as IRQn_Type)
+    */
+   static bool isEnabled(int irqNum);
+
+   /**
+    * Set priority of exception
+    *
+    * @param[in] irqNum   IRQ number (as IRQn_Type, negative for system exceptions)
+    * @param[in] priority Priority as in the NVIC IP/SCB SHP registers (upper bits significant)
+    */
+   static void setPriority(int irqNum, uint8_t priority);
+
+   /**
+    * Install the handler for an exception
+    *
+    * @param[in] irqNum  IRQ number (as IRQn_Type, negative for system exceptions)
+    * @param[in] handler Handler
+    */
+   static void setHandler(int irqNum, Handler handler);
+};
+
+}
+
+#endif /* HOST_HOSTCPU_H_ */
@@ -0,0 +1,100 @@
+/*
+ * HostRegister.h
+ *
+ *  Peripheral register for the host build
+ */
+
+#ifndef HOST_HOSTREGISTER_H_
+#define HOST_HOSTREGISTER_H_
+
+#include <stdint.h>
+
+namespace Host {
+
+/**
+ * Routes register accesses to the peripheral models (see Bus.cpp)
+ */
+class Bus {
+public:
+   /**
+    * Read a register
+    *
+    * @param[in] address Address of register
+    * @param[in] size    Size of access (1, 2 or 4 bytes)
+    *
+    * @return Value read
+    */
+   static uint32_t read(const volatile void *address, unsigned size);
+
+   /**
+    * Write a register
+    *
+    * @param[in] address Address of register
+    * @param[in] value   Value to write
+    * @param[in] size    Size of access (1, 2 or 4 bytes)
+    */
+   static void write(volatile void *address, uint32_t value, unsigned size);
+
+   /**
+    * Atomically modify a single bit of a register (bit-band alias access)
+    *
+    * @param[in] address Address of register
+    * @param[in] bitNum  Bit to change
+    * @param[in] value   New value of bit
+    * @param[in] size    Size of register (1, 2 or 4 bytes)
+    */
+   static void writeBit(volatile void *address, unsigned bitNum, bool value, unsigned size);
+
+   /**
+    * Read a single bit of a register (bit-band alias access)
+    *
+    * @param[in] address Address of register
+    * @param[in] bitNum  Bit to read
+    * @param[in] size    Size of register (1, 2 or 4 bytes)
+    *
+    * @return Value of bit
+    */
+   static bool readBit(const volatile void *address, unsigned bitNum, unsigned size);
+};
+
+}
+
+/**
+ * Stands in for a device register in the host copy of the device header
+ *
+ * The layout is identical to the register it replaces so the peripheral
+ * structures keep their offsets. Every read and write by the firmware is
+ * passed to the model of the peripheral through Host::Bus. The models access
+ * the underlying storage directly.
+ *
+ * @tparam T Register type (uint8_t, uint16_t or uint32_t)
+ */
+template<typename T>
+struct HostRegister {
+   T value;
+
+   operator T() const volatile {
+      return (T)Host::Bus::read(this, sizeof(T));
+   }
+   T operator=(T data) volatile {
+      Host::Bus::write(this, data, sizeof(T));
+      return data;
+   }
+   void operator|=(T data) volatile {
+      Host::Bus::write(this, (T)(*this)|data, sizeof(T));
+   }
+   void operator&=(T data) volatile {
+      Host::Bus::write(this, (T)(*this)&data, sizeof(T));
+   }
+   void operator^=(T data) volatile {
+      Host::Bus::write(this, (T)(*this)^data, sizeof(T));
+   }
+   void operator+=(T data) volatile {
+      Host::Bus::write(this, (T)(*this)+data, sizeof(T));
+   }
+   void operator-=(T data) volatile {
+      Host::Bus::write(this, (T)(*this)-data, sizeof(T));
+   }
+};
+
+#endif /* HOST_HOSTREGISTER_H_ */
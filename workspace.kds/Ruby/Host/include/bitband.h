@@ -0,0 +1,69 @@
+/**
+ * @file     bitband.h
+ * @brief    Bit-band access for the host build
+ *
+ * Replaces Project_Headers/bitband.h. There is no alias region on the host
+ * so each access is passed to Host::Bus as a single bit operation which keeps
+ * it atomic with respect to the simulated interrupts.
+ */
+#ifndef INCLUDE_CPP_BITBAND_H_
+#define INCLUDE_CPP_BITBAND_H_
+
+#include "HostRegister.h"
+
+namespace USBDM {
+
+/**
+ * @brief Write a value to a bit.
+ * Only the referenced bit is modified.
+ *
+ * @param[out] ref     Object to manipulate e.g. a register
+ * @param[in]  bitNum  Bit number
+ * @param[in]  value   Value to modify 0 or 1. Only the LSB is used
+ */
+template <typename T>
+static __attribute__((always_inline)) inline void bitbandWrite(T &ref, const int bitNum, uint32_t value) {
+   Host::Bus::writeBit(&ref, bitNum, value&1, sizeof(T));
+}
+
+/**
+ * @brief Read a bit.
+ * Only the referenced bit is returned.
+ *
+ * @param[out] ref     Object to examine e.g. a register
+ * @param[in]  bitNum  Bit number
+ *
+ * @return Bit read as boolean value
+ */
+template <typename T>
+static __attribute__((always_inline)) inline uint32_t bitbandRead(T &ref, const int bitNum) {
+   return Host::Bus::readBit(&ref, bitNum, sizeof(T));
+}
+
+/**
+ * @brief Set a bit.
+ * Only the referenced bit is modified.
+ *
+ * @param[out] ref     Object to manipulate e.g. a register
+ * @param[in]  bitNum  Bit number
+ */
+template <typename T>
+static __attribute__((always_inline)) inline void bitbandSet(T &ref, const int bitNum) {
+   bitbandWrite(ref, bitNum, true);
+}
+
+/**
+ * @brief Clear a bit.
+ * Only the referenced bit is modified.
+ *
+ * @param[out] ref     Object to manipulate e.g. a register
+ * @param[in]  bitNum  Bit number
+ */
+template <typename T>
+static __attribute__((always_inline)) inline void bitbandClear(T &ref, const int bitNum) {
+   bitbandWrite(ref, bitNum, false);
+}
+
+} // End namespace USBDM
+
+#endif /* INCLUDE_CPP_BITBAND_H_ */
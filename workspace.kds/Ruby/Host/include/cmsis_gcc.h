@@ -0,0 +1,321 @@
+/*
+ * cmsis_gcc.h
+ *
+ *  CMSIS core intrinsics for the host build
+ *
+ *  Replaces Project_Headers/cmsis_gcc.h. Instructions that change processor
+ *  state are passed to Host::Cpu and the rest are written in portable C.
+ */
+
+#ifndef __CMSIS_GCC_H
+#define __CMSIS_GCC_H
+
+#include "HostCpu.h"
+
+/* ###########################  Core Function Access  ########################### */
+
+__attribute__((always_inline)) __STATIC_INLINE void __enable_irq(void) {
+   Host::Cpu::setPrimask(0);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __disable_irq(void) {
+   Host::Cpu::setPrimask(1);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_CONTROL(void) {
+   return 0;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __set_CONTROL(uint32_t) {
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_IPSR(void) {
+   return Host::Cpu::getIpsr();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_APSR(void) {
+   return 0;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_xPSR(void) {
+   return Host::Cpu::getIpsr();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_PSP(void) {
+   return Host::Cpu::getStackPointer();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __set_PSP(uint32_t) {
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_MSP(void) {
+   return Host::Cpu::getStackPointer();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __set_MSP(uint32_t) {
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_PRIMASK(void) {
+   return Host::Cpu::getPrimask();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __set_PRIMASK(uint32_t priMask) {
+   Host::Cpu::setPrimask(priMask);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __enable_fault_irq(void) {
+   Host::Cpu::setFaultmask(0);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __disable_fault_irq(void) {
+   Host::Cpu::setFaultmask(1);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_BASEPRI(void) {
+   return Host::Cpu::getBasepri();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __set_BASEPRI(uint32_t value) {
+   Host::Cpu::setBasepri(value);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __set_BASEPRI_MAX(uint32_t value) {
+   Host::Cpu::setBasepriMax(value);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_FAULTMASK(void) {
+   return Host::Cpu::getFaultmask();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __set_FAULTMASK(uint32_t faultMask) {
+   Host::Cpu::setFaultmask(faultMask);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_FPSCR(void) {
+   return 0;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __set_FPSCR(uint32_t) {
+}
+
+/* ##########################  Core Instruction Access  ######################### */
+
+#define __CMSIS_GCC_OUT_REG(r) "=r" (r)
+#define __CMSIS_GCC_USE_REG(r) "r" (r)
+
+__attribute__((always_inline)) __STATIC_INLINE void __NOP(void) {
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __WFI(void) {
+   Host::Cpu::waitForInterrupt();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __WFE(void) {
+   Host::Cpu::waitForInterrupt();
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __SEV(void) {
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __ISB(void) {
+   __asm__ volatile ("" : : : "memory");
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __DSB(void) {
+   __asm__ volatile ("" : : : "memory");
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __DMB(void) {
+   __asm__ volatile ("" : : : "memory");
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __REV(uint32_t value) {
+   return __builtin_bswap32(value);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __REV16(uint32_t value) {
+   return ((value&0xFF00FF00UL)>>8)|((value&0x00FF00FFUL)<<8);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE int32_t __REVSH(int32_t value) {
+   return (int16_t)__builtin_bswap16((uint16_t)value);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __ROR(uint32_t op1, uint32_t op2) {
+   op2 &= 31;
+   return (op2==0)?op1:((op1 >> op2) | (op1 << (32U - op2)));
+}
+
+#define __BKPT(value) Host::Cpu::breakpoint(value)
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __RBIT(uint32_t value) {
+   uint32_t result = 0;
+   for (unsigned bit=0; bit<32; bit++) {
+      result = (result<<1)|(value&1);
+      value >>= 1;
+   }
+   return result;
+}
+
+#define __CLZ(value) (((value)==0)?32U:(uint8_t)__builtin_clz(value))
+
+/* Single processor - exclusive accesses always succeed */
+
+__attribute__((always_inline)) __STATIC_INLINE uint8_t __LDREXB(volatile uint8_t *addr) {
+   return *addr;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint16_t __LDREXH(volatile uint16_t *addr) {
+   return *addr;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __LDREXW(volatile uint32_t *addr) {
+   return *addr;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __STREXB(uint8_t value, volatile uint8_t *addr) {
+   *addr = value;
+   return 0;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __STREXH(uint16_t value, volatile uint16_t *addr) {
+   *addr = value;
+   return 0;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) {
+   *addr = value;
+   return 0;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __CLREX(void) {
+}
+
+__attribute__((always_inline)) __STATIC_INLINE int32_t __SSAT_(int32_t value, uint32_t bits) {
+   const int32_t max = (int32_t)((1UL<<(bits-1))-1);
+   const int32_t min = -max-1;
+   return (value>max)?max:(value<min)?min:value;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __USAT_(int32_t value, uint32_t bits) {
+   const int32_t max = (int32_t)((1UL<<bits)-1);
+   return (value>max)?(uint32_t)max:(value<0)?0U:(uint32_t)value;
+}
+
+#define __SSAT(ARG1,ARG2) __SSAT_((ARG1),(ARG2))
+#define __USAT(ARG1,ARG2) __USAT_((ARG1),(ARG2))
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __RRX(uint32_t value) {
+   return value>>1;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint8_t __LDRBT(volatile uint8_t *addr) {
+   return *addr;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint16_t __LDRHT(volatile uint16_t *addr) {
+   return *addr;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __LDRT(volatile uint32_t *addr) {
+   return *addr;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __STRBT(uint8_t value, volatile uint8_t *addr) {
+   *addr = value;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __STRHT(uint16_t value, volatile uint16_t *addr) {
+   *addr = value;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void __STRT(uint32_t value, volatile uint32_t *addr) {
+   *addr = value;
+}
+
+/* ###################  Compiler specific Intrinsics  ########################### */
+
+/* Halfword helpers */
+#define __CMSIS_LO(x) ((int32_t)(int16_t)(x))
+#define __CMSIS_HI(x) ((int32_t)(int16_t)((x)>>16))
+#define __CMSIS_PACK16(hi,lo) ((((uint32_t)(hi))<<16)|(((uint32_t)(lo))&0xFFFFU))
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SADD16(uint32_t op1, uint32_t op2) {
+   return __CMSIS_PACK16(__CMSIS_HI(op1)+__CMSIS_HI(op2), __CMSIS_LO(op1)+__CMSIS_LO(op2));
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __QADD16(uint32_t op1, uint32_t op2) {
+   return __CMSIS_PACK16(__SSAT_(__CMSIS_HI(op1)+__CMSIS_HI(op2), 16), __SSAT_(__CMSIS_LO(op1)+__CMSIS_LO(op2), 16));
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SHADD16(uint32_t op1, uint32_t op2) {
+   return __CMSIS_PACK16((__CMSIS_HI(op1)+__CMSIS_HI(op2))>>1, (__CMSIS_LO(op1)+__CMSIS_LO(op2))>>1);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SSUB16(uint32_t op1, uint32_t op2) {
+   return __CMSIS_PACK16(__CMSIS_HI(op1)-__CMSIS_HI(op2), __CMSIS_LO(op1)-__CMSIS_LO(op2));
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __QSUB16(uint32_t op1, uint32_t op2) {
+   return __CMSIS_PACK16(__SSAT_(__CMSIS_HI(op1)-__CMSIS_HI(op2), 16), __SSAT_(__CMSIS_LO(op1)-__CMSIS_LO(op2), 16));
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SHSUB16(uint32_t op1, uint32_t op2) {
+   return __CMSIS_PACK16((__CMSIS_HI(op1)-__CMSIS_HI(op2))>>1, (__CMSIS_LO(op1)-__CMSIS_LO(op2))>>1);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SSAT16_(int32_t op1, uint32_t bits) {
+   return __CMSIS_PACK16(__SSAT_(__CMSIS_HI(op1), bits), __SSAT_(__CMSIS_LO(op1), bits));
+}
+
+#define __SSAT16(ARG1,ARG2) __SSAT16_((ARG1),(ARG2))
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SMUAD(uint32_t op1, uint32_t op2) {
+   return (uint32_t)(__CMSIS_HI(op1)*__CMSIS_HI(op2) + __CMSIS_LO(op1)*__CMSIS_LO(op2));
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SMUADX(uint32_t op1, uint32_t op2) {
+   return (uint32_t)(__CMSIS_HI(op1)*__CMSIS_LO(op2) + __CMSIS_LO(op1)*__CMSIS_HI(op2));
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SMUSD(uint32_t op1, uint32_t op2) {
+   return (uint32_t)(__CMSIS_LO(op1)*__CMSIS_LO(op2) - __CMSIS_HI(op1)*__CMSIS_HI(op2));
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SMLAD(uint32_t op1, uint32_t op2, uint32_t op3) {
+   return (uint32_t)(__CMSIS_HI(op1)*__CMSIS_HI(op2) + __CMSIS_LO(op1)*__CMSIS_LO(op2) + (int32_t)op3);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint64_t __SMLALD(uint32_t op1, uint32_t op2, uint64_t acc) {
+   return (uint64_t)((int64_t)__CMSIS_HI(op1)*__CMSIS_HI(op2) + (int64_t)__CMSIS_LO(op1)*__CMSIS_LO(op2) + (int64_t)acc);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SMLSD(uint32_t op1, uint32_t op2, uint32_t op3) {
+   return (uint32_t)(__CMSIS_LO(op1)*__CMSIS_LO(op2) - __CMSIS_HI(op1)*__CMSIS_HI(op2) + (int32_t)op3);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __SXTB16(uint32_t op1) {
+   return __CMSIS_PACK16((int8_t)(op1>>16), (int8_t)op1);
+}
+
+__attribute__((always_inline)) __STATIC_INLINE int32_t __QADD(int32_t op1, int32_t op2) {
+   int64_t result = (int64_t)op1+op2;
+   return (result>INT32_MAX)?INT32_MAX:(result<INT32_MIN)?INT32_MIN:(int32_t)result;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE int32_t __QSUB(int32_t op1, int32_t op2) {
+   int64_t result = (int64_t)op1-op2;
+   return (result>INT32_MAX)?INT32_MAX:(result<INT32_MIN)?INT32_MIN:(int32_t)result;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE int32_t __SMMLA(int32_t op1, int32_t op2, int32_t op3) {
+   return (int32_t)(((((int64_t)op3)<<32) + (int64_t)op1*op2) >> 32);
+}
+
+#define __PKHBT(ARG1,ARG2,ARG3) ( ((((uint32_t)(ARG1))          ) & 0x0000FFFFUL) |  \
+                                  ((((uint32_t)(ARG2)) << (ARG3)) & 0xFFFF0000UL)  )
+
+#define __PKHTB(ARG1,ARG2,ARG3) ( ((((uint32_t)(ARG1))          ) & 0xFFFF0000UL) |  \
+                                  ((((uint32_t)(ARG2)) >> (ARG3)) & 0x0000FFFFUL)  )
+
+#endif /* __CMSIS_GCC_H */
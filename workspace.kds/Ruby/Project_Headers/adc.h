@@ -666,6 +666,9 @@ public:
    /** Channel number */
    static constexpr int CHANNEL=channel;
 
+   /** SC1 register value to convert this channel */
+   static constexpr int SC1_VALUE=channel;
+
    /**
     * Configure the pin associated with this ADC channel.
     * The pin is in analogue mode so no PCR settings are active.
@@ -757,6 +760,9 @@ public:
    /** Channel number */
    static constexpr int CHANNEL=channel;
 
+   /** SC1 register value to convert this channel (differential) */
+   static constexpr int SC1_VALUE=channel|ADC_SC1_DIFF_MASK;
+
    /**
     * Configure the pins associated with this ADC channel.
     * The pins are in analogue mode so no PCR settings are active.
@@ -11,6 +11,7 @@
 
 #include "derivative.h"
 #include "hardware.h"
+#include "system.h"
 
  /*
  * *****************************
@@ -132,6 +133,7 @@ enum DmaChannelNum {
    DmaChannelNum_31,     //!< Channel 31
 
    DmaChannelNum_All = (1<<6),  //!< All channels, some operations may be applied to all channels
+   DmaChannelNum_None = (1<<7), //!< No channel e.g. allocation failed
 };
 
 /**
@@ -274,6 +276,267 @@ struct DmaTcd {
    uint16_t  CSR;      //!< Control and Status
 };
 
+/**
+ * TCD in memory for scatter-gather\n
+ * Layout matches the hardware TCD so the DMA controller can load it directly
+ * when the preceding transfer completes (DMA_CSR_ESG).
+ *
+ * @note Must be 32-byte aligned and must remain valid while the chain is in use
+ */
+struct __attribute__((aligned(32))) DmaScatterGatherTcd {
+   uint32_t  SADDR;    //!< Source address
+   uint16_t  SOFF;     //!< SADDR offset
+   uint16_t  ATTR;     //!< Transfer attributes
+   uint32_t  NBYTES;   //!< Minor loop byte count
+   uint32_t  SLAST;    //!< Last SADDR adjustment
+   uint32_t  DADDR;    //!< Destination address
+   uint16_t  DOFF;     //!< DADDR offset
+   uint16_t  CITER;    //!< Major loop count
+   uint32_t  DLASTSGA; //!< Last DADDR adjustment or address of next TCD
+   uint16_t  CSR;      //!< Control and Status
+   uint16_t  BITER;    //!< Major loop count (reload value)
+
+   DmaScatterGatherTcd() = default;
+
+   /**
+    * Construct from transfer description
+    *
+    * @param[in] tcd Transfer description e.g. from DmaTcdBuilder
+    */
+   DmaScatterGatherTcd(const DmaTcd &tcd) :
+      SADDR(tcd.SADDR), SOFF(tcd.SOFF), ATTR(tcd.ATTR), NBYTES(tcd.NBYTES), SLAST(tcd.SLAST),
+      DADDR(tcd.DADDR), DOFF(tcd.DOFF), CITER(tcd.CITER), DLASTSGA(tcd.DLAST), CSR(tcd.CSR), BITER(tcd.CITER) {
+   }
+};
+
+static_assert(sizeof(DmaScatterGatherTcd) == 32, "DmaScatterGatherTcd must match hardware TCD");
+
+/**
+ * Helper to construct a DmaTcd
+ *
+ * Defaults to a single software-started major loop with no address changes.
+ *
+ * @code
+ *  // Copy 16 ADC results into a buffer, interrupt and stop when done
+ *  static uint16_t results[16];
+ *
+ *  DmaTcd tcd = DmaTcdBuilder().
+ *     sourceRegister(ADC0->R[0]).
+ *     destinationArray(results).
+ *     minorLoopBytes(sizeof(results[0])).
+ *     majorLoopCount(16).
+ *     afterMajorLoop(0, -sizeof(results)).
+ *     interruptOnComplete().
+ *     disableRequestsOnComplete();
+ * @endcode
+ */
+class DmaTcdBuilder {
+
+private:
+   /** TCD being built */
+   DmaTcd tcd;
+
+   /** Major loop count */
+   uint16_t count;
+
+   /** Channel started on completion of each minor loop */
+   DmaChannelNum minorLink;
+
+public:
+   DmaTcdBuilder() : tcd{0,0,0,0,0,0,0,0,0,0}, count(1), minorLink(DmaChannelNum_None) {
+   }
+
+   /**
+    * Set source
+    *
+    * @param[in] address Source address
+    * @param[in] offset  Adjustment applied to address after each read
+    * @param[in] size    Size of each read
+    */
+   DmaTcdBuilder &source(uint32_t address, int16_t offset, DmaSize size) {
+      tcd.SADDR = address;
+      tcd.SOFF  = offset;
+      tcd.ATTR  = (tcd.ATTR&~DMA_ATTR_SSIZE_MASK)|DMA_ATTR_SSIZE(size);
+      return *this;
+   }
+
+   /**
+    * Set destination
+    *
+    * @param[in] address Destination address
+    * @param[in] offset  Adjustment applied to address after each write
+    * @param[in] size    Size of each write
+    */
+   DmaTcdBuilder &destination(uint32_t address, int16_t offset, DmaSize size) {
+      tcd.DADDR = address;
+      tcd.DOFF  = offset;
+      tcd.ATTR  = (tcd.ATTR&~DMA_ATTR_DSIZE_MASK)|DMA_ATTR_DSIZE(size);
+      return *this;
+   }
+
+   /**
+    * Set source to a peripheral register (address does not change)
+    *
+    * @param[in] reg Register to read
+    */
+   template<typename T>
+   DmaTcdBuilder &sourceRegister(const volatile T &reg) {
+      return source((uint32_t)(uintptr_t)&reg, 0, getDmaSize(reg));
+   }
+
+   /**
+    * Set source to an array (address advances by element size)
+    *
+    * @param[in] array Array to read
+    */
+   template<typename T>
+   DmaTcdBuilder &sourceArray(const T *array) {
+      return source((uint32_t)(uintptr_t)array, sizeof(T), getDmaSize(*array));
+   }
+
+   /**
+    * Set destination to a peripheral register (address does not change)
+    *
+    * @param[in] reg Register to write
+    */
+   template<typename T>
+   DmaTcdBuilder &destinationRegister(volatile T &reg) {
+      return destination((uint32_t)(uintptr_t)&reg, 0, getDmaSize(reg));
+   }
+
+   /**
+    * Set destination to an array (address advances by element size)
+    *
+    * @param[in] array Array to write
+    */
+   template<typename T>
+   DmaTcdBuilder &destinationArray(T *array) {
+      return destination((uint32_t)(uintptr_t)array, sizeof(T), getDmaSize(*array));
+   }
+
+   /**
+    * Set number of bytes transferred for each request (minor loop)
+    *
+    * @param[in] bytes Number of bytes - multiple of source and destination sizes
+    */
+   DmaTcdBuilder &minorLoopBytes(uint32_t bytes) {
+      tcd.NBYTES = bytes;
+      return *this;
+   }
+
+   /**
+    * Set number of requests (minor loops) in the major loop
+    *
+    * @param[in] majorCount Number of minor loops (1-32767, 1-511 if linkOnMinorLoop() is used)
+    */
+   DmaTcdBuilder &majorLoopCount(uint16_t majorCount) {
+      count = majorCount;
+      return *this;
+   }
+
+   /**
+    * Set adjustments applied to addresses at the end of the major loop\n
+    * Usually used to return to the start of a buffer.
+    *
+    * @param[in] sourceAdjust      Adjustment to source address
+    * @param[in] destinationAdjust Adjustment to destination address
+    *
+    * @note Not available with scatterGather() which uses the destination adjustment
+    */
+   DmaTcdBuilder &afterMajorLoop(int32_t sourceAdjust, int32_t destinationAdjust) {
+      tcd.SLAST = sourceAdjust;
+      tcd.DLAST = destinationAdjust;
+      tcd.CSR  &= ~DMA_CSR_ESG_MASK;
+      return *this;
+   }
+
+   /**
+    * Generate interrupt when the major loop is half complete
+    */
+   DmaTcdBuilder &interruptOnHalf() {
+      tcd.CSR |= DMA_CSR_INTHALF(1);
+      return *this;
+   }
+
+   /**
+    * Generate interrupt when the major loop completes
+    */
+   DmaTcdBuilder &interruptOnComplete() {
+      tcd.CSR |= DMA_CSR_INTMAJOR(1);
+      return *this;
+   }
+
+   /**
+    * Disable hardware requests when the major loop completes
+    */
+   DmaTcdBuilder &disableRequestsOnComplete() {
+      tcd.CSR |= DMA_CSR_DREQ(1);
+      return *this;
+   }
+
+   /**
+    * Start the transfer by software when the TCD is loaded
+    */
+   DmaTcdBuilder &startOnLoad() {
+      tcd.CSR |= DMA_CSR_START(1);
+      return *this;
+   }
+
+   /**
+    * Start another channel after each minor loop (except the last)
+    *
+    * @param[in] channel Channel to start
+    */
+   DmaTcdBuilder &linkOnMinorLoop(DmaChannelNum channel) {
+      minorLink = channel;
+      return *this;
+   }
+
+   /**
+    * Start another channel when the major loop completes
+    *
+    * @param[in] channel Channel to start
+    */
+   DmaTcdBuilder &linkOnMajorLoop(DmaChannelNum channel) {
+      tcd.CSR = (tcd.CSR&~DMA_CSR_MAJORLINKCH_MASK)|DMA_CSR_MAJORELINK(1)|DMA_CSR_MAJORLINKCH(channel);
+      return *this;
+   }
+
+   /**
+    * Load another TCD when the major loop completes
+    *
+    * @param[in] next TCD to load (may be a TCD earlier in the chain to form a ring)
+    */
+   DmaTcdBuilder &scatterGather(const DmaScatterGatherTcd &next) {
+      tcd.DLAST = (uint32_t)(uintptr_t)&next;
+      tcd.CSR  |= DMA_CSR_ESG(1);
+      return *this;
+   }
+
+   /**
+    * Get the completed TCD
+    *
+    * @return TCD for Dma::configureTransfer() or DmaScatterGatherTcd
+    */
+   DmaTcd build() const {
+      DmaTcd result = tcd;
+      if (minorLink == DmaChannelNum_None) {
+         result.CITER = DMA_CITER_ELINKNO_ELINK(0)|DMA_CITER_ELINKNO_CITER(count);
+      }
+      else {
+         result.CITER = DMA_CITER_ELINKYES_ELINK(1)|DMA_CITER_ELINKYES_LINKCH(minorLink)|DMA_CITER_ELINKYES_CITER(count);
+      }
+      return result;
+   }
+
+   /**
+    * Get the completed TCD
+    */
+   operator DmaTcd() const {
+      return build();
+   }
+};
+
 /**
  * Template class providing interface to DMA Multiplexor
  *
@@ -356,6 +619,12 @@ protected:
    /** Callback functions for errors */
    static DmaErrorCallbackFunction errorCallback;
 
+   /** Channels in use (bit mask) */
+   static volatile uint32_t allocatedChannels;
+
+   /** Indicates configure() has been called */
+   static bool configured;
+
    /** Callback to catch unhandled interrupt */
    static void noHandlerCallback() {
       setAndCheckErrorCode(E_NO_HANDLER);
@@ -513,12 +782,125 @@ public:
       // Set shared control options
       dmac->CR = dmaArbitration|dmaOnError|dmaLink|dmaMinorLoopMapping|dmaGroupArbitration|DMA_CR_EDBG(1);
 
-      // Clear call-backs and TCDs
+      // Clear call-backs and TCDs of channels not already in use
       for (unsigned channel=0; channel<Info::NumVectors; channel++) {
+         if (allocatedChannels & (1U<<channel)) {
+            continue;
+         }
          static const DmaTcd emptyTcd {0,0,0,0,0,0,0,0,0,0};
          callbacks[channel] = noHandlerCallback;
          configureTransfer((DmaChannelNum)channel, emptyTcd);
       }
+      configured = true;
+   }
+
+   /**
+    * Allocate a free DMA channel\n
+    * The DMAC is configured with default settings if configure() has not been called.
+    *
+    * @return Channel number
+    * @return DmaChannelNum_None if no channel is available (error code set to E_NO_RESOURCE)
+    *
+    * @note Channels are allocated from the highest number which has the highest priority
+    *       for fixed arbitration. Use allocateChannel(channel) for PIT triggered channels.
+    */
+   static DmaChannelNum allocateChannel() {
+      CriticalSection cs;
+      if (!configured) {
+         configure();
+      }
+      for (int channel=Info::NumChannels-1; channel>=0; channel--) {
+         if ((allocatedChannels & (1U<<channel)) == 0) {
+            allocatedChannels = allocatedChannels | (1U<<channel);
+            return (DmaChannelNum)channel;
+         }
+      }
+      setErrorCode(E_NO_RESOURCE);
+      return DmaChannelNum_None;
+   }
+
+   /**
+    * Allocate a particular DMA channel\n
+    * For channels that must be fixed e.g. PIT triggered channels.
+    * The DMAC is configured with default settings if configure() has not been called.
+    *
+    * @param[in] channel Channel to reserve
+    *
+    * @return Channel number
+    * @return DmaChannelNum_None if the channel is already in use (error code set to E_NO_RESOURCE)
+    */
+   static DmaChannelNum allocateChannel(DmaChannelNum channel) {
+      if ((unsigned)channel >= Info::NumChannels) {
+         setErrorCode(E_ILLEGAL_PARAM);
+         return DmaChannelNum_None;
+      }
+      CriticalSection cs;
+      if (!configured) {
+         configure();
+      }
+      if (allocatedChannels & (1U<<channel)) {
+         setErrorCode(E_NO_RESOURCE);
+         return DmaChannelNum_None;
+      }
+      allocatedChannels = allocatedChannels | (1U<<channel);
+      return channel;
+   }
+
+   /**
+    * Release a channel obtained from allocateChannel()\n
+    * Hardware requests, interrupts and the DMA-MUX slot are disabled.
+    *
+    * @param[in] channel Channel to release
+    *
+    * @return E_NO_ERROR      on success
+    * @return E_ILLEGAL_PARAM if the channel is not allocated
+    */
+   static ErrorCode freeChannel(DmaChannelNum channel) {
+      CriticalSection cs;
+      if (!isAllocated(channel)) {
+         return setErrorCode(E_ILLEGAL_PARAM);
+      }
+      enableRequests(channel, false);
+      enableNvicInterrupts(channel, false);
+      DmaMux_T<MuxInfo, Info::NumChannels>::disable(channel);
+      callbacks[channel] = noHandlerCallback;
+      allocatedChannels  = allocatedChannels & ~(1U<<channel);
+      return E_NO_ERROR;
+   }
+
+   /**
+    * Check if a channel has been allocated
+    *
+    * @param[in] channel Channel to check
+    *
+    * @return true => channel is in use
+    */
+   static bool isAllocated(DmaChannelNum channel) {
+      return ((unsigned)channel < Info::NumChannels) && (allocatedChannels & (1U<<channel));
+   }
+
+   /**
+    * Allocate a channel and connect it to a DMA-MUX slot\n
+    * Combines allocateChannel(), DmaMux::configure(), setCallback() and enableNvicInterrupts().
+    *
+    * @param[in]  dmaSlot      The DMA slot (source) to connect to the channel
+    * @param[in]  callback     Channel interrupt callback (nullptr => interrupts not used)
+    * @param[in]  nvicPriority Interrupt priority
+    *
+    * @return Channel number
+    * @return DmaChannelNum_None if no channel is available
+    */
+   static DmaChannelNum allocateChannel(DmaSlot dmaSlot, DmaCallbackFunction callback, uint32_t nvicPriority=NvicPriority_Normal) {
+      DmaChannelNum channel = allocateChannel();
+      if (channel == DmaChannelNum_None) {
+         return channel;
+      }
+      DmaMux_T<MuxInfo, Info::NumChannels>::configure(channel, dmaSlot, DmaMuxEnable_Continuous);
+      if (callback != nullptr) {
+         setCallback(channel, callback);
+         enableNvicInterrupts(channel, true, nvicPriority);
+      }
+      return channel;
    }
 
    /**
@@ -763,6 +1145,16 @@ template<class Info> DmaCallbackFunction DmaBase_T<Info>::callbacks[];
  */
 template<class Info> DmaErrorCallbackFunction DmaBase_T<Info>::errorCallback = noHandlerErrorCallback;
 
+/**
+ * Channels in use
+ */
+template<class Info> volatile uint32_t DmaBase_T<Info>::allocatedChannels = 0;
+
+/**
+ * Indicates DMAC has been configured
+ */
+template<class Info> bool DmaBase_T<Info>::configured = false;
+
 #ifdef USBDM_DMAMUX0_IS_DEFINED
 using DmaMux0 = DmaMux_T<Dmamux0Info, Dma0Info::NumChannels>;
 #endif
@@ -773,6 +1165,114 @@ using DmaMux1 = DmaMux_T<Dmamux1Info>;
 
 #ifdef USBDM_DMA0_IS_DEFINED
 using Dma0 = DmaBase_T<Dma0Info>;
+
+/**
+ * Continuous peripheral to memory transfer into a double (ping-pong) buffer
+ *
+ * The channel fills the buffer repeatedly. The callback is executed each time
+ * one half is filled and getCompletedHalf() identifies the half that may be processed
+ * while the DMA fills the other.
+ *
+ * @code
+ *  DmaPingPong<uint16_t, 32> samples;
+ *
+ *  void samplesReady() {
+ *     const uint16_t *data = samples.getCompletedHalf();
+ *     // Process data[0..31] within the time to fill the other half
+ *  }
+ *
+ *  samples.configure(Dma0Slot_ADC0, ADC0->R[0], samplesReady);
+ *  samples.start();
+ * @endcode
+ *
+ * @tparam T Element type
+ * @tparam N Number of elements in each half
+ */
+template<typename T, unsigned N>
+class DmaPingPong {
+
+   static_assert((2*N) <= 32767, "Buffer too large for DMA major loop");
+
+private:
+   /** Both halves of the buffer */
+   T buffer[2*N];
+
+   /** Channel in use */
+   DmaChannelNum channel = DmaChannelNum_None;
+
+public:
+   /**
+    * Allocate a channel and configure the transfer
+    *
+    * @param[in] dmaSlot  DMA-MUX slot for the peripheral request
+    * @param[in] source   Peripheral register to read on each request
+    * @param[in] callback Executed (in interrupt context) when each half is filled
+    *
+    * @return E_NO_ERROR    on success
+    * @return E_NO_RESOURCE if no channel is available
+    */
+   ErrorCode configure(DmaSlot dmaSlot, const volatile T &source, DmaCallbackFunction callback) {
+      channel = Dma0::allocateChannel(dmaSlot, callback);
+      if (channel == DmaChannelNum_None) {
+         return E_NO_RESOURCE;
+      }
+      DmaTcd tcd = DmaTcdBuilder().
+            sourceRegister(source).
+            destinationArray(buffer).
+            minorLoopBytes(sizeof(T)).
+            majorLoopCount(2*N).
+            afterMajorLoop(0, -(int32_t)sizeof(buffer)).
+            interruptOnHalf().
+            interruptOnComplete();
+      Dma0::configureTransfer(channel, tcd);
+      return E_NO_ERROR;
+   }
+
+   /**
+    * Release the channel
+    */
+   void release() {
+      if (channel != DmaChannelNum_None) {
+         Dma0::freeChannel(channel);
+         channel = DmaChannelNum_None;
+      }
+   }
+
+   /**
+    * Enable hardware requests
+    */
+   void start() {
+      Dma0::enableRequests(channel);
+   }
+
+   /**
+    * Disable hardware requests
+    */
+   void stop() {
+      Dma0::enableRequests(channel, false);
+   }
+
+   /**
+    * Get the half most recently filled\n
+    * Valid in the callback until the DMA fills the other half.
+    *
+    * @return Pointer to N elements
+    */
+   const T *getCompletedHalf() const {
+      // CITER counts down from 2N and reloads at the end of the major loop
+      unsigned remaining = Dma0Info::dma->TCD[channel].CITER_ELINKNO&DMA_CITER_ELINKNO_CITER_MASK;
+      return (remaining > N)?&buffer[N]:&buffer[0];
+   }
+
+   /**
+    * Get the channel in use
+    *
+    * @return Channel number or DmaChannelNum_None if not configured
+    */
+   DmaChannelNum getChannel() const {
+      return channel;
+   }
+};
 #endif
 
 #ifdef USBDM_DMA1_IS_DEFINED
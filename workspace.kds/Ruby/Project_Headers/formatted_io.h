@@ -254,7 +254,7 @@ public:
 
          if(ch < 0)
          {
-        	 ch = NULL;
+        	 ch = 0;
          }
 
          return ch;
@@ -10,9 +10,11 @@
 #define SOURCES_FLASH_H_
 
 #include <assert.h>
+#include <string.h>
 #include "derivative.h"
 #include "hardware.h"
 #include "delay.h"
+#include "system.h"
 
 namespace USBDM {
 /**
@@ -74,6 +76,11 @@ protected:
     */
    static FlashDriverError_t executeFlashCommand();
 
+   /**
+    * Launch Flash command without waiting for completion
+    */
+   static void launchFlashCommand();
+
    /**
     * Read Flash Resource (IFR etc)
     * This command reads 4 bytes from the selected flash resource
@@ -194,6 +201,16 @@ public:
       return false;
    }
 
+   /**
+    * Check if flash is ready without waiting\n
+    * A FlexRAM (EEPROM) write is in progress while this is false.
+    *
+    * @return true => ready for next command or FlexRAM write
+    */
+   static bool isReady() {
+      return (FTFE->FSTAT&FTFE_FSTAT_CCIF_MASK) != 0;
+   }
+
 private:
    /**
     * Program a phrase to Flash memory
@@ -214,7 +231,54 @@ private:
     */
    static FlashDriverError_t eraseSector(uint8_t *address);
 
+   /**
+    * Load command registers to program phrase
+    *
+    * @param[in]  data       Location of data to program
+    * @param[out] address    Memory address to program - must be phrase boundary
+    */
+   static void loadProgramPhrase(const uint8_t *data, uint8_t *address);
+
+   /**
+    * Load command registers to erase sector
+    *
+    * @param[in]  address    Memory address to erase - must be sector boundary
+    */
+   static void loadEraseSector(uint8_t *address);
+
 public:
+   /**
+    * Start programming a phrase to Flash memory\n
+    * Returns immediately. Completion is indicated by isReady() and the result by getCommandResult().
+    *
+    * @param[in]  data       Location of data to program (copied before return)
+    * @param[out] address    Memory address to program - must be phrase boundary
+    *
+    * @return Error code
+    *
+    * @note The address must be in a different flash block from the executing code (read-while-write)
+    */
+   static FlashDriverError_t startProgramPhrase(const uint8_t *data, uint8_t *address);
+
+   /**
+    * Start erasing a sector of Flash memory\n
+    * Returns immediately. Completion is indicated by isReady() and the result by getCommandResult().
+    *
+    * @param[in]  address    Memory address to erase - must be sector boundary
+    *
+    * @return Error code
+    *
+    * @note The address must be in a different flash block from the executing code (read-while-write)
+    */
+   static FlashDriverError_t startEraseSector(uint8_t *address);
+
+   /**
+    * Get result of last Flash command
+    *
+    * @return Error code, 0 => no error
+    */
+   static FlashDriverError_t getCommandResult();
+
    /**
     * Program a range of bytes to Flash memory
     *
@@ -456,6 +520,311 @@ public:
          Flash::waitForFlashReady();
       }
    }
+
+   /**
+    * Start setting an element of the array without waiting for the EEPROM update
+    *
+    * @param[in]  index Array index of element to change
+    * @param[in]  value Value to write
+    *
+    * @note Flash::isReady() must be true before calling
+    */
+   void startSet(int index, T value) {
+      data[index] = value;
+   }
+};
+
+/**
+ * Typed record held in FlexRAM with a RAM shadow
+ *
+ * Reads and updates use the RAM copy and do not wait for the Flash.\n
+ * Words changed since the last commit are tracked and commit() writes only those
+ * words to the EEPROM, one word per FlexRAM update, without blocking.\n
+ * poll() must be called regularly (e.g. from a task) to advance a commit.
+ * The call-back is executed from poll() when all changed words have been written.
+ *
+ * @tparam T Trivially copyable type for record
+ *
+ * Example:
+ * @code
+ * struct Settings {
+ *    float    gain;
+ *    uint32_t count;
+ * };
+ *
+ * __attribute__ ((section(".flexRAM")))
+ * USBDM::NonvolatileRecord<Settings>::Storage settingsStorage;
+ *
+ * USBDM::NonvolatileRecord<Settings> settings(settingsStorage);
+ *
+ * settings.load();
+ * settings.set(&Settings::gain, 2.5f);
+ * settings.set(&Settings::count, settings.get().count+1);
+ * settings.commit(savedCallback);
+ * ...
+ * while (settings.poll()) {
+ *    // Other work
+ * }
+ * @endcode
+ */
+template <typename T>
+class NonvolatileRecord {
+
+   static_assert(__has_trivial_copy(T), "T must be trivially copyable");
+
+public:
+   /** Number of 32-bit words used for record */
+   static constexpr int WORDS = (sizeof(T)+sizeof(uint32_t)-1)/sizeof(uint32_t);
+
+   /** FlexRAM storage for record - should be placed in the .flexRAM segment */
+   using Storage = NonvolatileArray<uint32_t, WORDS>;
+
+   /**
+    * Type for call-back executed on completion of commit()
+    *
+    * @param[in] rc FLASH_ERR_OK or FLASH_ERR_VERIFY_FAILED
+    */
+   typedef void (*CommitCallback)(FlashDriverError_t rc);
+
+private:
+   /** Number of words in dirty bit-mask */
+   static constexpr int DIRTY_WORDS = (WORDS+31)/32;
+
+   /** Record in FlexRAM */
+   Storage &storage;
+
+   /** RAM copy of record */
+   union {
+      T        value;
+      uint32_t words[WORDS];
+   } shadow;
+
+   /** Words changed in shadow but not yet written to FlexRAM */
+   volatile uint32_t dirty[DIRTY_WORDS];
+
+   /** Word being written to FlexRAM (-1 => none) */
+   int writeIndex;
+
+   /** Result of current commit */
+   FlashDriverError_t status;
+
+   /** Indicates a commit is in progress */
+   volatile bool committing;
+
+   /** Call-back for current commit */
+   CommitCallback callback;
+
+   /**
+    * Update bytes in the shadow and mark the words that changed
+    *
+    * @param[in]  offset Byte offset in record
+    * @param[in]  data   Data to copy
+    * @param[in]  size   Number of bytes
+    */
+   void write(unsigned offset, const void *data, unsigned size) {
+      const uint8_t *src = static_cast<const uint8_t *>(data);
+      while (size > 0) {
+         unsigned index = offset/sizeof(uint32_t);
+         unsigned first = offset%sizeof(uint32_t);
+         unsigned count = sizeof(uint32_t)-first;
+         if (count > size) {
+            count = size;
+         }
+         CriticalSection cs;
+         uint32_t word = shadow.words[index];
+         memcpy(reinterpret_cast<uint8_t *>(&word)+first, src, count);
+         if (word != shadow.words[index]) {
+            shadow.words[index] = word;
+            dirty[index/32] |= (1U<<(index%32));
+         }
+         src    += count;
+         offset += count;
+         size   -= count;
+      }
+   }
+
+   /**
+    * Remove and return the lowest dirty word
+    *
+    * @param[out] value Value to write
+    *
+    * @return Index of word or -1 if none
+    */
+   int takeDirtyWord(uint32_t &value) {
+      CriticalSection cs;
+      for (int group=0; group<DIRTY_WORDS; group++) {
+         if (dirty[group] != 0) {
+            int bit = __builtin_ctz(dirty[group]);
+            dirty[group] &= ~(1U<<bit);
+            int index = 32*group+bit;
+            value = shadow.words[index];
+            return index;
+         }
+      }
+      return -1;
+   }
+
+   /**
+    * Check if a word is marked dirty
+    *
+    * @param[in] index Index of word
+    *
+    * @return true => word has changed since being written
+    */
+   bool isDirty(int index) const {
+      return (dirty[index/32] & (1U<<(index%32))) != 0;
+   }
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in]  storage Record in FlexRAM
+    */
+   NonvolatileRecord(Storage &storage) :
+      storage(storage), shadow(), dirty(), writeIndex(-1), status(FLASH_ERR_OK), committing(false), callback(nullptr) {
+   }
+
+   /**
+    * Copy the record from FlexRAM to the RAM shadow\n
+    * Discards any uncommitted changes.
+    *
+    * @note Waits for the Flash to be ready
+    */
+   void load() {
+      Flash::waitForFlashReady();
+      CriticalSection cs;
+      storage.copyTo(shadow.words);
+      for (int group=0; group<DIRTY_WORDS; group++) {
+         dirty[group] = 0;
+      }
+   }
+
+   /**
+    * Get RAM copy of record
+    *
+    * @return Reference to record - read-only!
+    */
+   const T &get() const {
+      return shadow.value;
+   }
+
+   /**
+    * Update entire record\n
+    * Only words that differ are marked for writing.
+    *
+    * @param[in]  value Value for record
+    */
+   void set(const T &value) {
+      write(0, &value, sizeof(T));
+   }
+
+   /**
+    * Update a member of the record\n
+    * Only words that differ are marked for writing.
+    *
+    * @tparam M Type of member
+    *
+    * @param[in]  member Pointer to member e.g. &Settings::gain
+    * @param[in]  value  Value for member
+    */
+   template <typename M>
+   void set(M T::*member, const M &value) {
+      const uint8_t *base  = reinterpret_cast<const uint8_t *>(&shadow.value);
+      const uint8_t *field = reinterpret_cast<const uint8_t *>(&(shadow.value.*member));
+      write(field-base, &value, sizeof(M));
+   }
+
+   /**
+    * Indicates changes that have not been written to FlexRAM
+    *
+    * @return true => commit() required
+    */
+   bool isModified() const {
+      for (int group=0; group<DIRTY_WORDS; group++) {
+         if (dirty[group] != 0) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   /**
+    * Indicates a commit is in progress
+    *
+    * @return true => busy
+    */
+   bool isBusy() const {
+      return committing;
+   }
+
+   /**
+    * Start writing changed words to FlexRAM\n
+    * Returns immediately. Use poll() to complete the operation.
+    *
+    * @param[in]  callback Call-back executed from poll() on completion (may be nullptr)
+    *
+    * @note Changes made while a commit is in progress are included in that commit
+    */
+   void commit(CommitCallback callback=nullptr) {
+      if (!committing) {
+         status = FLASH_ERR_OK;
+      }
+      this->callback = callback;
+      committing     = true;
+      poll();
+   }
+
+   /**
+    * Advance a commit\n
+    * Starts the next word write when the previous FlexRAM update has completed.
+    *
+    * @return true  => Commit still in progress
+    * @return false => Idle
+    */
+   bool poll() {
+      if (!committing) {
+         return false;
+      }
+      while (Flash::isReady()) {
+         if ((writeIndex >= 0) && !isDirty(writeIndex) && (storage[writeIndex] != shadow.words[writeIndex])) {
+            // Read-back of completed write failed
+            status = FLASH_ERR_VERIFY_FAILED;
+         }
+         writeIndex = -1;
+         uint32_t value;
+         int index = takeDirtyWord(value);
+         if (index < 0) {
+            committing = false;
+            if (callback != nullptr) {
+               callback(status);
+            }
+            return false;
+         }
+         if (storage[index] != value) {
+            storage.startSet(index, value);
+            writeIndex = index;
+         }
+      }
+      return true;
+   }
+
+   /**
+    * Complete any commit in progress
+    *
+    * @return Result of commit
+    *
+    * @note Blocks until all changes have been written
+    */
+   FlashDriverError_t flush() {
+      if (isModified() && !committing) {
+         commit();
+      }
+      while (poll()) {
+         __asm__("nop");
+      }
+      return status;
+   }
 };
 /**
  * @}
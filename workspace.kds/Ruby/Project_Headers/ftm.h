@@ -202,6 +202,18 @@ protected:
    static void unhandledCallback() {
       setAndCheckErrorCode(E_NO_HANDLER);
    }
+
+public:
+   /**
+    * Channel callback that ignores the flags\n
+    * For a timer whose interrupt is only used for overflow or fault - the handler passes on
+    * the channel flags set by every PWM match.
+    *
+    * @param mask Mask identifying channel
+    */
+   static void ignoreChannelCallback(uint8_t mask) {
+      (void)mask;
+   }
 };
 
 /**
@@ -247,7 +259,7 @@ public:
     */
    static void irqHandler() {
       if ((tmr->MODE&FTM_MODE_FAULTIE_MASK) && (tmr->FMS&FTM_FMS_FAULTF_MASK)) {
-         tmr->FMS &= ~FTM_FMS_FAULTF_MASK;
+         // Flag is left set - outputs stay disabled (manual fault clearing) until the callback clears it
          sFaultCallback();
       }
 
@@ -310,6 +322,9 @@ public:
     *
     * @param[in] theCallback Callback function to execute on fault interrupt.\n
     *                        nullptr to indicate none
+    *
+    * @note The callback must clear FMS.FAULTF (read FMS then write 0) or disable the
+    *       fault interrupt otherwise the interrupt is immediately re-entered.
     */
    static void INLINE_RELEASE setFaultCallback(FtmCallbackFunction theCallback) {
       if (theCallback == nullptr) {
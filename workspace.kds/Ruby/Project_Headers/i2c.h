@@ -44,6 +44,69 @@ enum I2cMode {
    I2cMode_Interrupt = I2C_C1_IICIE(1),   //!< Operate in Interrupt mode
 };
 
+/**
+ * Descriptor for a queued I2C transaction
+ *
+ * A transaction transmits txSize bytes and then (using repeated-start) receives rxSize bytes.
+ * Either size may be zero. The descriptor and buffers must remain valid until complete.
+ *
+ * Example:
+ * @code
+ *  uint8_t reg = 0x0D;
+ *  uint8_t whoAmI;
+ *
+ *  void whoAmIDone(I2cTransaction &transaction) {
+ *     if (transaction.errorCode == E_NO_ERROR) {
+ *        ...
+ *     }
+ *  }
+ *
+ *  I2cTransaction readWhoAmI(0x1D<<1, 1, &reg, 1, &whoAmI, whoAmIDone);
+ *
+ *  i2c.submit(readWhoAmI);
+ * @endcode
+ */
+class I2cTransaction {
+
+public:
+   /**
+    * Type definition for transaction completion call back\n
+    * Executed from I2c::poll() (usually interrupt context)
+    *
+    * @param transaction The completed transaction
+    */
+   typedef void (*Callback)(I2cTransaction &transaction);
+
+   uint8_t             address;    //!< Address of slave (LSB = R/W bit = 0)
+   uint16_t            txSize;     //!< Size of transmission data
+   const uint8_t      *txData;     //!< Data for transmission
+   uint16_t            rxSize;     //!< Size of reception data
+   uint8_t            *rxData;     //!< Buffer for reception
+   Callback            callback;   //!< Executed on completion (may be nullptr)
+   void               *context;    //!< For use by owner e.g. to identify the device in callback
+   volatile ErrorCode  errorCode;  //!< Result - E_NO_ERROR, E_NO_ACK or E_LOST_ARBITRATION
+   volatile bool       complete;   //!< Indicates transaction is not queued or in progress
+   I2cTransaction     *next;       //!< Link to following transaction in queue
+
+   /**
+    * Construct transaction descriptor
+    *
+    * @param[in]  address  Address of slave to communicate with (should include LSB = R/W bit = 0)
+    * @param[in]  txSize   Size of transmission data
+    * @param[in]  txData   Data for transmission
+    * @param[in]  rxSize   Size of reception data
+    * @param[out] rxData   Buffer for reception
+    * @param[in]  callback Executed on completion (may be nullptr)
+    * @param[in]  context  For use by owner
+    */
+   I2cTransaction(
+         uint8_t address=0, uint16_t txSize=0, const uint8_t *txData=nullptr, uint16_t rxSize=0, uint8_t *rxData=nullptr,
+         Callback callback=nullptr, void *context=nullptr) :
+      address(address), txSize(txSize), txData(txData), rxSize(rxSize), rxData(rxData),
+      callback(callback), context(context), errorCode(E_NO_ERROR), complete(true), next(nullptr) {
+   }
+};
+
 /**
  * Virtual Base class for I2C interface
  */
@@ -51,9 +114,9 @@ class I2c {
 
 public:
    /** States for the I2C state machine */
-   enum I2C_State { i2c_idle, i2c_txData, i2c_rxData, i2c_rxAddress };
+   enum I2C_State { i2c_idle, i2c_txData, i2c_rxData, i2c_rxAddress, i2c_waitBusFree };
 
-   I2C_State           state;               //!< State of current transaction
+   volatile I2C_State  state;               //!< State of current transaction
 
 protected:
    /** Callback to catch unhandled interrupt */
@@ -69,6 +132,8 @@ protected:
    const uint8_t      *txDataPtr;           //!< Pointer to transmit data for current transaction
    uint8_t             addressedDevice;     //!< Address of device being communicated with
    ErrorCode           errorCode;           //!< Error code from last transaction
+   I2cTransaction     *queueHead;           //!< Transaction in progress followed by queued transactions
+   I2cTransaction     *queueTail;           //!< Last queued transaction
 
    /** I2C baud rate divisor table */
    static const uint16_t I2C_DIVISORS[4*16];
@@ -82,7 +147,7 @@ protected:
    I2c(volatile I2C_Type *i2c, I2cMode i2cMode) :
       state(i2c_idle), i2c(i2c), i2cMode(i2cMode), rxBytesRemaining(0),
       txBytesRemaining(0), rxDataPtr(0), txDataPtr(0), addressedDevice(0),
-      errorCode(E_NO_ERROR) {
+      errorCode(E_NO_ERROR), queueHead(nullptr), queueTail(nullptr) {
    }
 
    /**
@@ -106,9 +171,39 @@ protected:
     * Start Rx/Tx sequence by sending address byte
     *
     * @param[in]  address - address of slave to access
+    *
+    * @note The bus must be idle
     */
    void sendAddress(uint8_t address);
 
+   /**
+    * Set up state machine for the transaction at the head of the queue
+    *
+    * @return Address byte to send (including R/W bit)
+    */
+   uint8_t loadTransaction();
+
+   /**
+    * Start the transaction at the head of the queue with a START\n
+    * If the bus is busy the START is deferred until a STOP is detected.
+    */
+   void startQueue();
+
+   /**
+    * End the bus phase of the current transaction\n
+    * Generates a REPEATED-START if another transaction is queued otherwise a STOP.
+    *
+    * @return true => REPEATED-START generated
+    */
+   bool stopOrRestart();
+
+   /**
+    * Complete the transaction at the head of the queue and execute its callback
+    *
+    * @param[in]  restarted Indicates a REPEATED-START has been generated for the next transaction
+    */
+   void completeTransaction(bool restarted);
+
    /**
     * Set baud factor value for interface
     *
@@ -166,15 +261,31 @@ public:
    virtual void busHangReset() = 0;
 
    /**
-    * Wait for current sequence to complete
+    * Wait for current sequence and all queued transactions to complete
     */
    void waitWhileBusy(void) {
-      while (state != i2c_idle) {
+      while ((state != i2c_idle) || (queueHead != nullptr)) {
          if ((i2c->C1&I2C_C1_IICIE_MASK) == 0) {
             poll();
          }
          else {
-            __asm__("wfi");
+            __WFI();
+         }
+      }
+   }
+
+   /**
+    * Wait for a transaction to complete
+    *
+    * @param[in]  transaction Transaction to wait for
+    */
+   void waitForTransaction(I2cTransaction &transaction) {
+      while (!transaction.complete) {
+         if ((i2c->C1&I2C_C1_IICIE_MASK) == 0) {
+            poll();
+         }
+         else {
+            __WFI();
          }
       }
    }
@@ -182,11 +293,35 @@ public:
    /**
     * I2C state-machine poll function.
     * May be called by polling loop or interrupt handler.
+    *
+    * Queued transactions are chained using REPEATED-START.
     */
    virtual void poll(void);
 
    /**
-    * Transmit message
+    * Queue a transaction\n
+    * Returns immediately. The transaction is started when those ahead of it have completed.
+    * In polled mode poll() must be called regularly.
+    *
+    * @param[in]  transaction Transaction to queue
+    *
+    * @return E_NO_ERROR on success
+    * @return E_ILLEGAL_PARAM if the transaction is already queued
+    */
+   ErrorCode submit(I2cTransaction &transaction);
+
+   /**
+    * Indicates transactions are queued or in progress
+    *
+    * @return true => busy
+    */
+   bool isBusy() const {
+      return queueHead != nullptr;
+   }
+
+   /**
+    * Transmit message\n
+    * Waits for queued transactions and this transaction to complete.
     *
     * @param[in]  address  Address of slave to communicate with (should include LSB = R/W bit = 0)
     * @param[in]  size     Size of transmission data
@@ -414,7 +549,7 @@ public:
       // Default options
       i2c->C2  = I2C_C2_AD(myAddress>>8);
       i2c->A1  = myAddress&~1;
-      i2c->FLT = I2C_FLT_FLT(2);
+      i2c->FLT = I2C_FLT_FLT(2)|I2C_FLT_STOPF_MASK|I2C_FLT_STARTF_MASK;
    }
 
    /**
@@ -448,6 +583,9 @@ public:
       }
    }
 
+   /**
+    * Interrupt handler - call from I2Cx_IRQHandler
+    */
    static void irqHandler() {
       thisPtr->poll();
       if (thisPtr->state == I2C_State::i2c_idle) {
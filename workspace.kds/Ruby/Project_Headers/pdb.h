@@ -563,7 +563,7 @@ public:
     */
    static void setPretriggersInTicks(int channel,
          PdbPretrigger0 pdbPretrigger0=PdbPretrigger0_Bypass,  uint16_t delay0=0,
-         PdbPretrigger1 pdbPretrigger1=PdbPretrigger0_Disable, uint16_t delay1=0) {
+         PdbPretrigger1 pdbPretrigger1=PdbPretrigger1_Disable, uint16_t delay1=0) {
 
       pdb->CH[channel].C1     = pdbPretrigger0|pdbPretrigger1;
       pdb->CH[channel].DLY[0] = delay0;
@@ -1987,7 +1987,7 @@ public:
    // Template:dma0_16ch_ears4
 
    //! Class based callback handler has been installed in vector table
-   static constexpr bool irqHandlerInstalled = (0 == 1);
+   static constexpr bool irqHandlerInstalled = (1 == 1);
 
    //! Default IRQ level
    static constexpr uint32_t irqLevel =  7;
@@ -20,6 +20,8 @@
 #include <stdint.h>
 #include "derivative.h"
 #include "hardware.h"
+#include "system.h"
+#include "dma.h"
 #ifdef __CMSIS_RTOS
 #include "cmsis.h"
 #endif
@@ -140,6 +142,72 @@ struct SpiConfig {
    uint32_t ctar;  //!<  CTAR register value e.g. Baud, number of bits, timing
 };
 
+/**
+ * Descriptor for a queued DMA SPI transfer
+ *
+ * Frames of up to 8 bits (from config.ctar) use uint8_t buffers, larger frames use uint16_t buffers.
+ * The descriptor and buffers must remain valid until complete.
+ *
+ * Example:
+ * @code
+ *  uint8_t command[3] = {0x01, 0x80, 0x00};
+ *  uint8_t reply[3];
+ *
+ *  void adcDone(SpiTransfer &transfer) {
+ *     uint16_t value = ((reply[1]&0x03)<<8)|reply[2];
+ *     ...
+ *  }
+ *
+ *  SpiTransfer adcRead(adcConfig, sizeof(command), command, reply, adcDone);
+ *
+ *  spi.transferAsync(adcRead);
+ * @endcode
+ */
+struct SpiTransfer {
+   /**
+    * Type definition for transfer completion call back\n
+    * Executed from the DMA interrupt
+    *
+    * @param transfer The completed transfer
+    */
+   typedef void (*Callback)(SpiTransfer &transfer);
+
+   SpiConfig      config;    //!< CTAR0 and PUSHR (peripheral select, select mode) for this transfer
+   uint16_t       size;      //!< Number of frames to transfer
+   const void    *txData;    //!< Transmit frames (nullptr => send all ones)
+   void          *rxData;    //!< Receive buffer (nullptr => discard)
+   Callback       callback;  //!< Executed on completion (may be nullptr)
+   void          *context;   //!< For use by owner e.g. to identify the device in callback
+   volatile bool  complete;  //!< Indicates transfer is not queued or in progress
+   SpiTransfer   *next;      //!< Link to following transfer in queue
+
+   /**
+    * Construct transfer descriptor
+    *
+    * @param[in]  config   CTAR0 and PUSHR values for the target peripheral
+    * @param[in]  size     Number of frames to transfer
+    * @param[in]  txData   Transmit frames (nullptr => send all ones)
+    * @param[out] rxData   Receive buffer (nullptr => discard)
+    * @param[in]  callback Executed on completion (may be nullptr)
+    * @param[in]  context  For use by owner
+    */
+   SpiTransfer(
+         const SpiConfig &config, uint16_t size, const void *txData, void *rxData,
+         Callback callback=nullptr, void *context=nullptr) :
+      config(config), size(size), txData(txData), rxData(rxData),
+      callback(callback), context(context), complete(true), next(nullptr) {
+   }
+
+   /**
+    * Indicates frames are larger than 8 bits (uint16_t buffers)
+    *
+    * @return true => 16-bit buffer elements
+    */
+   bool isWide() const {
+      return ((config.ctar&SPI_CTAR_FMSZ_MASK)>>SPI_CTAR_FMSZ_SHIFT) >= 8;
+   }
+};
+
 /**
  * @brief Base class for representing an SPI interface
  */
@@ -812,6 +880,96 @@ public:
       return status;
    }
 
+#ifdef USBDM_DMA0_IS_DEFINED
+   /** Maximum frames in a single DMA transfer (size of command word buffer) */
+   static constexpr unsigned MAX_DMA_FRAMES = 64;
+
+private:
+   /** DMA channel writing PUSHR */
+   static DmaChannelNum dmaTxChannel;
+
+   /** DMA channel reading POPR */
+   static DmaChannelNum dmaRxChannel;
+
+   /** Transfer in progress followed by queued transfers */
+   static SpiTransfer *queueHead;
+
+   /** Last queued transfer */
+   static SpiTransfer *queueTail;
+
+   /** PUSHR command words for transfer in progress */
+   static uint32_t commandWords[MAX_DMA_FRAMES];
+
+   /** Destination for receive data that is not required */
+   static uint16_t discard;
+
+   /**
+    * Start the transfer at the head of the queue
+    */
+   static void startDmaTransfer();
+
+   /**
+    * DMA receive channel complete - all frames have been transferred
+    */
+   static void dmaCompleteHandler();
+
+public:
+   /**
+    * Allocate DMA channels and configure the SPI for transferAsync()
+    *
+    * @param[in]  txSlot       DMA-MUX slot for SPI transmit request e.g. Dma0Slot_SPI0_Tx
+    * @param[in]  rxSlot       DMA-MUX slot for SPI receive request e.g. Dma0Slot_SPI0_Rx
+    * @param[in]  nvicPriority Priority of the DMA complete interrupt
+    *
+    * @return E_NO_ERROR    on success
+    * @return E_NO_RESOURCE if DMA channels are not available
+    */
+   static ErrorCode configureDma(DmaSlot txSlot, DmaSlot rxSlot, uint32_t nvicPriority=NvicPriority_Normal) {
+      Info::spi->MCR |= SPI_MCR_HALT_MASK;
+
+      dmaRxChannel = Dma0::allocateChannel(rxSlot, dmaCompleteHandler, nvicPriority);
+      if (dmaRxChannel == DmaChannelNum_None) {
+         return E_NO_RESOURCE;
+      }
+      dmaTxChannel = Dma0::allocateChannel(txSlot, nullptr);
+      if (dmaTxChannel == DmaChannelNum_None) {
+         Dma0::freeChannel(dmaRxChannel);
+         dmaRxChannel = DmaChannelNum_None;
+         return E_NO_RESOURCE;
+      }
+      // TFFF and RFDF generate DMA requests
+      Info::spi->RSER = (Info::spi->RSER&~(SPI_RSER_TFFF_DIRS(1)|SPI_RSER_TFFF_RE(1)|SPI_RSER_RFDF_DIRS(1)|SPI_RSER_RFDF_RE(1)))|
+            SpiFifoTxRequest_Dma|SpiFifoRxRequest_Dma;
+      return E_NO_ERROR;
+   }
+
+   /**
+    * Queue a DMA transfer\n
+    * Returns immediately. PUSHR command words are built when the transfer starts and
+    * the frames are moved by DMA without CPU involvement.
+    * Queued transfers are started back-to-back from the DMA complete interrupt
+    * and may use different configurations (peripheral select, speed, frame size).
+    *
+    * @param[in]  transfer Transfer to queue
+    *
+    * @return E_NO_ERROR      on success
+    * @return E_TOO_LARGE     if size is 0 or larger than MAX_DMA_FRAMES
+    * @return E_ILLEGAL_PARAM if the transfer is already queued
+    *
+    * @note configureDma() must be called first
+    * @note Do not mix with the polled txRx() functions while transfers are queued
+    */
+   static ErrorCode transferAsync(SpiTransfer &transfer);
+
+   /**
+    * Indicates DMA transfers are queued or in progress
+    *
+    * @return true => busy
+    */
+   static bool isDmaBusy() {
+      return queueHead != nullptr;
+   }
+#endif
 };
 
 /**
@@ -861,6 +1019,132 @@ void __attribute__((noinline)) Spi::txRx(uint32_t dataSize, const T *txData, T *
 
 template<class Info> SpiCallbackFunction SpiBase_T<Info>::callback = Spi::unhandledCallback;
 
+#ifdef USBDM_DMA0_IS_DEFINED
+template<class Info> DmaChannelNum SpiBase_T<Info>::dmaTxChannel = DmaChannelNum_None;
+template<class Info> DmaChannelNum SpiBase_T<Info>::dmaRxChannel = DmaChannelNum_None;
+template<class Info> SpiTransfer  *SpiBase_T<Info>::queueHead    = nullptr;
+template<class Info> SpiTransfer  *SpiBase_T<Info>::queueTail    = nullptr;
+template<class Info> uint32_t      SpiBase_T<Info>::commandWords[SpiBase_T<Info>::MAX_DMA_FRAMES];
+template<class Info> uint16_t      SpiBase_T<Info>::discard      = 0;
+
+/**
+ * Start the transfer at the head of the queue
+ */
+template<class Info>
+void SpiBase_T<Info>::startDmaTransfer() {
+   const SpiTransfer &transfer = *queueHead;
+
+   // Stop and flush the FIFOs before changing configuration
+   Info::spi->MCR |= SPI_MCR_HALT_MASK|SPI_MCR_CLR_TXF_MASK|SPI_MCR_CLR_RXF_MASK;
+   Info::spi->CTAR[0] = transfer.config.ctar;
+
+   // Build PUSHR command words - PCS remains asserted until the last frame
+   const uint32_t  command = (transfer.config.pushr&~(SPI_PUSHR_CTAS_MASK|SPI_PUSHR_EOQ_MASK|SPI_PUSHR_TXDATA_MASK))|SPI_PUSHR_CONT_MASK;
+   const bool      wide    = transfer.isWide();
+   const uint8_t  *tx8     = static_cast<const uint8_t *>(transfer.txData);
+   const uint16_t *tx16    = static_cast<const uint16_t *>(transfer.txData);
+   for (unsigned index=0; index<transfer.size; index++) {
+      uint32_t data = 0xFFFF;
+      if (transfer.txData != nullptr) {
+         data = wide?tx16[index]:tx8[index];
+      }
+      commandWords[index] = command|SPI_PUSHR_TXDATA(data);
+   }
+   commandWords[transfer.size-1] = (commandWords[transfer.size-1]&~SPI_PUSHR_CONT_MASK)|SPI_PUSHR_EOQ_MASK;
+
+   const unsigned elementSize = wide?sizeof(uint16_t):sizeof(uint8_t);
+   const uint16_t elementAttr = wide?(DMA_ATTR_SSIZE(DmaSize_16bit)|DMA_ATTR_DSIZE(DmaSize_16bit)):
+                                     (DMA_ATTR_SSIZE(DmaSize_8bit)|DMA_ATTR_DSIZE(DmaSize_8bit));
+
+   const DmaTcd txTcd {
+      /* uint32_t  SADDR  Source address        */ (uint32_t)(uintptr_t)commandWords,     // Command words
+      /* uint16_t  SOFF   SADDR offset          */ sizeof(commandWords[0]),               // SADDR advances 1 word for each request
+      /* uint16_t  ATTR   Transfer attributes   */ (uint16_t)(dmaSSize(commandWords[0])|dmaDSize(Info::spi->PUSHR)),
+      /* uint32_t  NBYTES Minor loop byte count */ sizeof(commandWords[0]),               // 1 word for each request
+      /* uint32_t  SLAST  Last SADDR adjustment */ 0,
+      /* uint32_t  DADDR  Destination address   */ (uint32_t)(uintptr_t)&Info::spi->PUSHR, // SPI PUSH register
+      /* uint16_t  DOFF   DADDR offset          */ 0,                                     // DADDR doesn't change
+      /* uint16_t  CITER  Major loop count      */ (uint16_t)(DMA_CITER_ELINKNO_ELINK(0)|transfer.size),
+      /* uint32_t  DLAST  Last DADDR adjustment */ 0,
+      /* uint16_t  CSR    Control and Status    */ DMA_CSR_INTMAJOR(0)|DMA_CSR_DREQ(1)|DMA_CSR_START(0),
+   };
+
+   const DmaTcd rxTcd {
+      /* uint32_t  SADDR  Source address        */ (uint32_t)(uintptr_t)&Info::spi->POPR,  // SPI POP register (low bytes)
+      /* uint16_t  SOFF   SADDR offset          */ 0,                                     // SADDR doesn't change
+      /* uint16_t  ATTR   Transfer attributes   */ elementAttr,
+      /* uint32_t  NBYTES Minor loop byte count */ elementSize,                           // 1 frame for each request
+      /* uint32_t  SLAST  Last SADDR adjustment */ 0,
+      /* uint32_t  DADDR  Destination address   */ (transfer.rxData != nullptr)?(uint32_t)(uintptr_t)transfer.rxData:(uint32_t)(uintptr_t)&discard,
+      /* uint16_t  DOFF   DADDR offset          */ (uint16_t)((transfer.rxData != nullptr)?elementSize:0),
+      /* uint16_t  CITER  Major loop count      */ (uint16_t)(DMA_CITER_ELINKNO_ELINK(0)|transfer.size),
+      /* uint32_t  DLAST  Last DADDR adjustment */ 0,
+      /* uint16_t  CSR    Control and Status    */ DMA_CSR_INTMAJOR(1)|DMA_CSR_DREQ(1)|DMA_CSR_START(0),
+   };
+   Dma0::configureTransfer(dmaTxChannel, txTcd);
+   Dma0::configureTransfer(dmaRxChannel, rxTcd);
+
+   // Clear status flags and start
+   Info::spi->SR = Info::spi->SR;
+   Dma0::enableRequests(dmaRxChannel);
+   Dma0::enableRequests(dmaTxChannel);
+   Info::spi->MCR &= ~SPI_MCR_HALT_MASK;
+}
+
+/**
+ * DMA receive channel complete - all frames have been transferred
+ */
+template<class Info>
+void SpiBase_T<Info>::dmaCompleteHandler() {
+   SpiTransfer *transfer = queueHead;
+   if (transfer == nullptr) {
+      return;
+   }
+   queueHead = transfer->next;
+   if (queueHead == nullptr) {
+      queueTail = nullptr;
+      Info::spi->MCR |= SPI_MCR_HALT_MASK;
+   }
+   else {
+      // Start next transfer before executing callback
+      startDmaTransfer();
+   }
+   transfer->next     = nullptr;
+   transfer->complete = true;
+   if (transfer->callback != nullptr) {
+      transfer->callback(*transfer);
+   }
+}
+
+/**
+ * Queue a DMA transfer
+ */
+template<class Info>
+ErrorCode SpiBase_T<Info>::transferAsync(SpiTransfer &transfer) {
+   if ((transfer.size == 0) || (transfer.size > MAX_DMA_FRAMES)) {
+      return E_TOO_LARGE;
+   }
+   CriticalSection cs;
+
+   if (!transfer.complete) {
+      return E_ILLEGAL_PARAM;
+   }
+   transfer.complete = false;
+   transfer.next     = nullptr;
+
+   if (queueHead == nullptr) {
+      queueHead = &transfer;
+      queueTail = &transfer;
+      startDmaTransfer();
+   }
+   else {
+      queueTail->next = &transfer;
+      queueTail       = &transfer;
+   }
+   return E_NO_ERROR;
+}
+#endif
+
 #if defined(USBDM_SPI0_IS_DEFINED)
 /**
  * @brief Template class representing a SPI0 interface
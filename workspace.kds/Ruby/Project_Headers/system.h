@@ -8,6 +8,7 @@
 #define SYSTEM_H_
 
 #include <stdint.h>
+#include "derivative.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -102,13 +103,12 @@ static inline void unlock(uint32_t * dummy) {(void)dummy;}
  * @param cpuSR Variable to hold interrupt state so it can be restored
  */
 static inline void enterCriticalSection(uint8_t *cpuSR) {
-   __asm__ volatile (
-         "  MRS   r0, PRIMASK       \n"   // Copy flags
-         // It may be possible for a ISR to run here but it
-         // would save/restore PRIMASK so this code is OK
-         "  CPSID I                 \n"   // Disable interrupts
-         "  STRB  r0, %[output]     \n"   // Save flags
-         : [output] "=m" (*cpuSR) : : "r0");
+   // Copy flags
+   // It may be possible for a ISR to run here but it
+   // would save/restore PRIMASK so this code is OK
+   *cpuSR = (uint8_t)__get_PRIMASK();
+   // Disable interrupts
+   __disable_irq();
 }
 
 /**
@@ -119,10 +119,8 @@ static inline void enterCriticalSection(uint8_t *cpuSR) {
  * @param cpuSR Variable to holding interrupt state to be restored
  */
 static inline void exitCriticalSection(uint8_t *cpuSR) {
-   __asm__ volatile (
-         "  LDRB r0, %[input]    \n"  // Retrieve original flags
-         "  MSR  PRIMASK,r0;     \n"  // Restore
-         : :[input] "m" (*cpuSR) : "r0");
+   // Restore original flags
+   __set_PRIMASK(*cpuSR);
 }
 
 #ifdef __cplusplus
@@ -167,13 +165,12 @@ public:
     * This would be from the declaration of the object until end of enclosing block.
     */
    CriticalSection() {
-      __asm__ volatile (
-            "  MRS   r0, PRIMASK       \n"   // Copy flags
-            // It may be possible for a ISR to run here but it
-            // would save/restore PRIMASK so this code is OK
-            "  CPSID I                 \n"   // Disable interrupts
-            "  STRB  r0, %[output]     \n"   // Save flags
-            : [output] "=m" (cpuSR) : : "r0");
+      // Copy flags
+      // It may be possible for a ISR to run here but it
+      // would save/restore PRIMASK so this code is OK
+      cpuSR = (uint8_t)__get_PRIMASK();
+      // Disable interrupts
+      __disable_irq();
    }
 
    /**
@@ -183,10 +180,8 @@ public:
     * This would be done implicitly by exiting the enclosing block.
     */
    ~CriticalSection() {
-      __asm__ volatile (
-            "  LDRB r0, %[input]    \n"  // Retrieve original flags
-            "  MSR  PRIMASK,r0;     \n"  // Restore
-            : :[input] "m" (cpuSR) : "r0");
+      // Restore original flags
+      __set_PRIMASK(cpuSR);
    }
 };
 
@@ -0,0 +1,349 @@
+/*
+ * AdcScan.h
+ *
+ *  Background conversion of a list of ADC channels using PDB and DMA
+ */
+
+#ifndef SOURCES_ADCSCAN_H_
+#define SOURCES_ADCSCAN_H_
+
+#include <stdint.h>
+#include <type_traits>
+#include "hardware.h"
+#include "adc.h"
+#include "pdb.h"
+#include "dma.h"
+
+namespace AdcScanHelpers {
+
+/**
+ * Check that all channels belong to the same ADC
+ */
+template<class Info>
+constexpr bool sameAdc() {
+   return true;
+}
+
+template<class Info, class Channel, class... Channels>
+constexpr bool sameAdc() {
+   return std::is_same<Info, typename Channel::AdcInfo>::value && sameAdc<Info, Channels...>();
+}
+
+/**
+ * First type in a list
+ */
+template<class First, class... Rest>
+struct FirstOf {
+   using Type = First;
+};
+
+}
+
+/**
+ * Converts a compile-time list of channels on one ADC continuously without CPU involvement
+ *
+ * - PDB channel n pretrigger A (ADCn SC1A) starts one conversion each PDB period.
+ * - On completion the ADC requests DMA. The result channel moves R[0] into a circular
+ *   buffer of DEPTH scans and links to a command channel that writes the SC1A value
+ *   for the next channel in the list ready for the next pretrigger.
+ * - Each channel is therefore converted every N PDB periods.
+ *
+ * Samples are read lock-free from any context using the DMA major loop count to
+ * locate the most recent completed conversion. A sample is not overwritten until
+ * the whole buffer has been refilled (DEPTH scans).
+ *
+ * Example:
+ * @code
+ *  using Inputs = AdcScan<8, Adc1Channel<4>, Adc1Channel<5>, Adc1DiffChannel<0>>;
+ *
+ *  Adc1::configure(AdcResolution_10bit_se, AdcClockSource_Bus, AdcClockDivider_8);
+ *  Adc1::calibrate();
+ *  Inputs::start(250*us);   // Each channel converted every 750 us
+ *
+ *  uint16_t supply  = Inputs::latest(0);
+ *  uint32_t average = Inputs::average(1);
+ * @endcode
+ *
+ * @tparam DEPTH     Number of scans held in the buffer (used by average())
+ * @tparam Channels  ADC channel classes e.g. Adc0Channel<8>, Adc0DiffChannel<0> - all on the same ADC
+ *
+ * @note The ADC must be configured and calibrated before start().
+ *       The PDB period must exceed the conversion time including hardware averaging.
+ * @note ADC0 and ADC1 scans may run together and share the PDB period.
+ */
+template<unsigned DEPTH, class... Channels>
+class AdcScan {
+
+public:
+   /** Number of channels in each scan */
+   static constexpr unsigned CHANNELS = sizeof...(Channels);
+
+   /** Number of samples in buffer */
+   static constexpr unsigned SIZE = CHANNELS*DEPTH;
+
+private:
+   AdcScan() = delete;
+   AdcScan(const AdcScan&) = delete;
+
+   using Info = typename AdcScanHelpers::FirstOf<Channels...>::Type::AdcInfo;
+
+   static_assert(CHANNELS > 0, "AdcScan requires at least one channel");
+   static_assert(DEPTH > 0, "AdcScan requires a depth of at least one scan");
+   static_assert(AdcScanHelpers::sameAdc<Info, Channels...>(), "AdcScan channels must all be on the same ADC");
+
+   // Major loop count is limited to 9 bits when minor loop linking is used
+   static_assert(SIZE <= 511, "AdcScan buffer too large (CHANNELS*DEPTH must be <= 511)");
+
+   /** PDB channel that triggers this ADC */
+   static constexpr int PDB_CHANNEL = std::is_same<Info, USBDM::Adc0Info>::value?0:1;
+
+   /** DMA-MUX slot for this ADC */
+   static constexpr DmaSlot DMA_SLOT = std::is_same<Info, USBDM::Adc0Info>::value?Dma0Slot_ADC0:Dma0Slot_ADC1;
+
+   /** Conversion results (written by DMA) */
+   static volatile uint16_t samples[SIZE];
+
+   /** SC1A value for the following channel, indexed by channel just converted */
+   static uint32_t commands[CHANNELS];
+
+   /** DMA channel moving results */
+   static USBDM::DmaChannelNum resultChannel;
+
+   /** DMA channel writing SC1A */
+   static USBDM::DmaChannelNum commandChannel;
+
+public:
+   /**
+    * Allocate DMA channels and start conversions
+    *
+    * @param[in] period PDB period i.e. interval between conversions (each channel is converted every CHANNELS*period)
+    *
+    * @return E_NO_ERROR    on success
+    * @return E_NO_RESOURCE if DMA channels are not available
+    * @return E_ERROR       if the period cannot be achieved
+    */
+   static USBDM::ErrorCode start(float period) {
+      using namespace USBDM;
+
+      static constexpr int sc1Values[] = {Channels::SC1_VALUE...};
+
+      // Configure pins
+      int dummy[] = {(Channels::setInput(), 0)...};
+      (void)dummy;
+
+      for (unsigned index=0; index<CHANNELS; index++) {
+         commands[index] = sc1Values[(index+1)%CHANNELS];
+      }
+      for (unsigned index=0; index<SIZE; index++) {
+         samples[index] = 0;
+      }
+      commandChannel = Dma0::allocateChannel();
+      if (commandChannel == DmaChannelNum_None) {
+         return E_NO_RESOURCE;
+      }
+      resultChannel = Dma0::allocateChannel(DMA_SLOT, nullptr);
+      if (resultChannel == DmaChannelNum_None) {
+         Dma0::freeChannel(commandChannel);
+         commandChannel = DmaChannelNum_None;
+         return E_NO_RESOURCE;
+      }
+      // Writes the next SC1A value each time it is linked
+      DmaTcd commandTcd = DmaTcdBuilder().
+            sourceArray(commands).
+            destinationRegister(Info::adc->SC1[0]).
+            minorLoopBytes(sizeof(commands[0])).
+            majorLoopCount(CHANNELS).
+            afterMajorLoop(-(int32_t)sizeof(commands), 0);
+
+      // Moves each result then links to the command channel
+      DmaTcd resultTcd = DmaTcdBuilder().
+            source((uint32_t)(uintptr_t)&Info::adc->R[0], 0, DmaSize_16bit).
+            destination((uint32_t)(uintptr_t)samples, sizeof(samples[0]), DmaSize_16bit).
+            minorLoopBytes(sizeof(samples[0])).
+            majorLoopCount(SIZE).
+            afterMajorLoop(0, -(int32_t)sizeof(samples)).
+            linkOnMinorLoop(commandChannel).
+            linkOnMajorLoop(commandChannel);
+
+      Dma0::configureTransfer(commandChannel, commandTcd);
+      Dma0::configureTransfer(resultChannel,  resultTcd);
+      Dma0::enableRequests(resultChannel);
+
+      // First channel, hardware triggered, DMA on completion
+      Info::adc->SC1[0] = sc1Values[0];
+      Info::adc->SC2    = Info::adc->SC2|ADC_SC2_ADTRG(1)|AdcDma_Enable;
+
+      ErrorCode rc = E_NO_ERROR;
+      if ((USBDM::Pdb0Info::pdb->SC & PDB_SC_PDBEN_MASK) == 0) {
+         // PDB not yet running (may be shared with the other ADC)
+         Pdb0::enable();
+         rc = Pdb0::setPeriod(period);
+         Pdb0::setTriggerSource(PdbTrigger_Software, PdbMode_Continuous);
+      }
+      Pdb0::setPretriggersInTicks(PDB_CHANNEL, PdbPretrigger0_Bypass, 0);
+      Pdb0::triggerRegisterLoad(PdbLoadMode_Immediate);
+      Pdb0::softwareTrigger();
+      return rc;
+   }
+
+   /**
+    * Get index in buffer of the next sample to be written
+    *
+    * @return Index 0..SIZE-1
+    */
+   static unsigned writeIndex() {
+      unsigned remaining = USBDM::Dma0Info::dma->TCD[resultChannel].CITER_ELINKYES&DMA_CITER_ELINKYES_CITER_MASK;
+      return SIZE-remaining;
+   }
+
+   /**
+    * Get raw sample from buffer
+    *
+    * @param[in] position Index in buffer (channel = position%CHANNELS)
+    *
+    * @return Conversion result (treat as int16_t for differential channels)
+    */
+   static uint16_t sample(unsigned position) {
+      return samples[position];
+   }
+
+   /**
+    * Get the most recent completed conversion for a channel
+    *
+    * @param[in] index Index of channel in Channels list
+    *
+    * @return Conversion result (treat as int16_t for differential channels)
+    *
+    * @note May be called from any context
+    */
+   static uint16_t latest(unsigned index) {
+      unsigned next = writeIndex();
+      unsigned back = (next+SIZE-1-index)%CHANNELS;
+      return samples[(next+SIZE-1-back)%SIZE];
+   }
+
+   /**
+    * Get the most recent completed conversion of every channel
+    *
+    * @param[out] values Results in Channels order
+    */
+   static void snapshot(uint16_t (&values)[CHANNELS]) {
+      unsigned next = writeIndex();
+      for (unsigned count=1; count<=CHANNELS; count++) {
+         unsigned position = (next+SIZE-count)%SIZE;
+         values[position%CHANNELS] = samples[position];
+      }
+   }
+
+   /**
+    * Get the sum of all buffered conversions for a channel
+    *
+    * @param[in] index Index of channel in Channels list
+    *
+    * @return Sum of DEPTH samples
+    */
+   static uint32_t sum(unsigned index) {
+      uint32_t total = 0;
+      for (unsigned position=index; position<SIZE; position+=CHANNELS) {
+         total += samples[position];
+      }
+      return total;
+   }
+
+   /**
+    * Get the average of all buffered conversions for a channel
+    *
+    * @param[in] index Index of channel in Channels list
+    *
+    * @return Average of DEPTH samples (single-ended channels)
+    */
+   static uint16_t average(unsigned index) {
+      return (sum(index)+DEPTH/2)/DEPTH;
+   }
+};
+
+template<unsigned DEPTH, class... Channels>
+volatile uint16_t AdcScan<DEPTH, Channels...>::samples[AdcScan<DEPTH, Channels...>::SIZE];
+
+template<unsigned DEPTH, class... Channels>
+uint32_t AdcScan<DEPTH, Channels...>::commands[AdcScan<DEPTH, Channels...>::CHANNELS];
+
+template<unsigned DEPTH, class... Channels>
+USBDM::DmaChannelNum AdcScan<DEPTH, Channels...>::resultChannel = USBDM::DmaChannelNum_None;
+
+template<unsigned DEPTH, class... Channels>
+USBDM::DmaChannelNum AdcScan<DEPTH, Channels...>::commandChannel = USBDM::DmaChannelNum_None;
+
+/**
+ * Decimating filter for one channel of an AdcScan
+ *
+ * Each call to poll() consumes the conversions made since the previous call and
+ * produces one output for every FACTOR conversions (boxcar average).
+ *
+ * @tparam Scan   AdcScan providing samples
+ * @tparam FACTOR Decimation factor
+ *
+ * @note poll() must be called at least once every Scan::DEPTH scans or samples are lost
+ */
+template<class Scan, unsigned FACTOR>
+class AdcDecimator {
+
+private:
+   /** Channel index in scan */
+   const unsigned index;
+
+   /** Next buffer position to examine */
+   unsigned readPosition = 0;
+
+   /** Accumulated samples */
+   uint32_t total = 0;
+
+   /** Number of accumulated samples */
+   unsigned count = 0;
+
+   /** Last output */
+   volatile uint16_t output = 0;
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] index Index of channel in the scan's channel list
+    */
+   constexpr AdcDecimator(unsigned index) : index(index) {
+   }
+
+   /**
+    * Consume new conversions
+    *
+    * @return true => A new output is available
+    */
+   bool poll() {
+      bool updated = false;
+      unsigned next = Scan::writeIndex();
+      while (readPosition != next) {
+         if ((readPosition%Scan::CHANNELS) == index) {
+            total += Scan::sample(readPosition);
+            if (++count >= FACTOR) {
+               output  = (total+FACTOR/2)/FACTOR;
+               total   = 0;
+               count   = 0;
+               updated = true;
+            }
+         }
+         readPosition = (readPosition+1)%Scan::SIZE;
+      }
+      return updated;
+   }
+
+   /**
+    * Get last output
+    *
+    * @return Average of FACTOR conversions
+    */
+   uint16_t getValue() const {
+      return output;
+   }
+};
+
+#endif /* SOURCES_ADCSCAN_H_ */
@@ -0,0 +1,73 @@
+/*
+ * Async.cpp
+ *
+ *  Stackless coroutines run by the Scheduler
+ */
+
+#include "Async.h"
+#include "system.h"
+
+using namespace USBDM;
+
+Coroutine         *Async::activeList = nullptr;
+Scheduler::TaskId  Async::taskId     = Scheduler::NO_TASK;
+
+/*
+ * Add the coroutine task to the Scheduler
+ */
+void Async::initialise(uint8_t priority) {
+   taskId = Scheduler::addTask(task, "async", priority);
+}
+
+/*
+ * Start a coroutine
+ */
+void Async::start(Coroutine *coroutine, CoroutineAllocator *allocator) {
+   usbdm_assert(taskId != Scheduler::NO_TASK, "Async not initialised");
+
+   coroutine->allocator   = allocator;
+   coroutine->resumePoint = 0;
+   coroutine->next        = activeList;
+   activeList             = coroutine;
+
+   // Poll waiting coroutines on every Scheduler tick
+   Scheduler::setTimer(taskId, 1, 1);
+   notify();
+}
+
+/*
+ * Indicates if a coroutine is still running
+ */
+bool Async::isActive(const Coroutine *coroutine) {
+   for (Coroutine *current=activeList; current!=nullptr; current=current->next) {
+      if (current == coroutine) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/*
+ * Scheduler task function
+ * Resumes each active coroutine once and removes those that complete
+ */
+void Async::task(Scheduler::EventFlags) {
+   Coroutine **link = &activeList;
+   while (*link != nullptr) {
+      Coroutine *coroutine = *link;
+      if (coroutine->resume()) {
+         // Completed - unlink before releasing the frame
+         *link = coroutine->next;
+         if (coroutine->allocator != nullptr) {
+            coroutine->allocator->release(coroutine);
+         }
+      }
+      else {
+         link = &coroutine->next;
+      }
+   }
+   if (activeList == nullptr) {
+      // Nothing waiting - stop polling
+      Scheduler::setTimer(taskId, 0);
+   }
+}
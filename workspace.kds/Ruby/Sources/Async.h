@@ -0,0 +1,254 @@
+/*
+ * Async.h
+ *
+ *  Stackless coroutines run by the Scheduler
+ */
+
+#ifndef SOURCES_ASYNC_H_
+#define SOURCES_ASYNC_H_
+
+#include <new>
+#include <stdint.h>
+#include "Scheduler.h"
+
+class Coroutine;
+
+/**
+ * Interface used to return the frame of a completed coroutine
+ */
+class CoroutineAllocator {
+public:
+   /**
+    * Release frame
+    *
+    * @param[in] coroutine Coroutine that has completed
+    */
+   virtual void release(Coroutine *coroutine) = 0;
+};
+
+/**
+ * Base class for a stackless coroutine
+ *
+ * The body is written linearly in resume() between CO_BEGIN() and CO_END().
+ * Each CO_xxx() suspension point returns to the Scheduler and execution continues
+ * from the same point when the coroutine is next resumed.
+ * Local variables do not survive a suspension - use data members instead.
+ * The object itself is the coroutine frame.
+ *
+ * Example:
+ * @code
+ * class Regrip : public Coroutine {
+ *    virtual bool resume() override {
+ *       CO_BEGIN();
+ *       Gripper1::startOpen();
+ *       CO_AWAIT(!Gripper1::isMoving());
+ *       pid1.setSetpoint(pid1.getSetpoint()+QUARTERROTATIONTICKS);
+ *       CO_AWAIT(pid1.getIsSteadyState(STEADY_STATE_TOLERANCE));
+ *       CO_DELAY(50);
+ *       Gripper1::startClose();
+ *       CO_AWAIT(!Gripper1::isMoving());
+ *       CO_END();
+ *    }
+ * };
+ * @endcode
+ */
+class Coroutine {
+
+   friend class Async;
+
+private:
+   /** Link in list of active coroutines */
+   Coroutine *next = nullptr;
+
+   /** Owner of frame or nullptr if statically allocated */
+   CoroutineAllocator *allocator = nullptr;
+
+protected:
+   /** Resume point (source line of last suspension, 0 => start) */
+   int resumePoint = 0;
+
+   /** Wake-up time for CO_DELAY()/CO_AWAIT_TIMEOUT() (Scheduler time in ms) */
+   uint32_t wakeTime = 0;
+
+   /**
+    * Start a delay used by CO_DELAY()/CO_AWAIT_TIMEOUT()
+    *
+    * @param[in] delayMs Delay in milliseconds
+    */
+   void startDelay(uint32_t delayMs) {
+      wakeTime = Scheduler::getTime() + delayMs;
+   }
+
+   /**
+    * Indicates if the delay started by startDelay() has expired
+    *
+    * @return true => expired
+    */
+   bool delayExpired() const {
+      return (int32_t)(Scheduler::getTime() - wakeTime) >= 0;
+   }
+
+   Coroutine() {}
+   ~Coroutine() {}
+
+public:
+   /**
+    * Run coroutine until the next suspension point or completion
+    *
+    * @return true  => Completed
+    * @return false => Suspended
+    */
+   virtual bool resume() = 0;
+};
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#define CO_FALLTHROUGH __attribute__((fallthrough))
+#else
+#define CO_FALLTHROUGH ((void)0)
+#endif
+
+/** Start of coroutine body */
+#define CO_BEGIN()      switch(resumePoint) { case 0:
+
+/** End of coroutine body */
+#define CO_END()        } resumePoint = 0; return true
+
+/** Suspend until condition is true (condition is re-evaluated each time the coroutine is resumed) */
+#define CO_AWAIT(condition) \
+   do { resumePoint = __LINE__; CO_FALLTHROUGH; case __LINE__: if (!(condition)) { return false; } } while(false)
+
+/** Suspend once */
+#define CO_YIELD() \
+   do { resumePoint = __LINE__; return false; case __LINE__: ; } while(false)
+
+/** Suspend for given number of milliseconds */
+#define CO_DELAY(delayMs) \
+   do { startDelay(delayMs); CO_AWAIT(delayExpired()); } while(false)
+
+/** Suspend until condition is true or timeout (ms) expires. Check condition afterwards to determine which. */
+#define CO_AWAIT_TIMEOUT(condition, timeoutMs) \
+   do { startDelay(timeoutMs); CO_AWAIT((condition) || delayExpired()); } while(false)
+
+/**
+ * Runs active coroutines from a Scheduler task
+ *
+ * Coroutines are resumed on the 1 ms Scheduler tick while any are active
+ * and immediately when notify() is called e.g. from a UART or PIT ISR.
+ */
+class Async {
+
+private:
+   Async() = delete;
+   Async(const Async&) = delete;
+
+   /** List of active coroutines */
+   static Coroutine *activeList;
+
+   /** Scheduler task running the coroutines */
+   static Scheduler::TaskId taskId;
+
+   /** Scheduler task function */
+   static void task(Scheduler::EventFlags events);
+
+public:
+   /**
+    * Add the coroutine task to the Scheduler
+    *
+    * @param[in] priority Scheduler priority for coroutines
+    */
+   static void initialise(uint8_t priority);
+
+   /**
+    * Start a coroutine
+    *
+    * @param[in] coroutine  Coroutine to start (must not already be active)
+    * @param[in] allocator  Owner of the frame (nullptr if statically allocated)
+    */
+   static void start(Coroutine *coroutine, CoroutineAllocator *allocator=nullptr);
+
+   /**
+    * Indicates if a coroutine is still running
+    *
+    * @param[in] coroutine Coroutine to check
+    *
+    * @return true => coroutine is active
+    */
+   static bool isActive(const Coroutine *coroutine);
+
+   /**
+    * Resume coroutines as soon as possible
+    *
+    * @note May be called from an ISR
+    */
+   static void notify() {
+      if (taskId != Scheduler::NO_TASK) {
+         Scheduler::postEvent(taskId, Scheduler::EVENT_USER);
+      }
+   }
+};
+
+/**
+ * Fixed pool of coroutine frames (no heap)
+ *
+ * @tparam T  Coroutine type
+ * @tparam N  Maximum number of concurrent instances
+ */
+template<class T, int N>
+class CoroutinePool : public CoroutineAllocator {
+
+private:
+   /** Storage for frames */
+   alignas(T) uint8_t frames[N][sizeof(T)];
+
+   /** Indicates frame is in use */
+   volatile bool inUse[N] = {};
+
+public:
+   /**
+    * Construct a coroutine in a free frame and start it
+    *
+    * @param[in] args Arguments for constructor of T
+    *
+    * @return Pointer to coroutine or nullptr if no frame is available
+    */
+   template<typename... Args>
+   T *start(Args... args) {
+      for (int index=0; index<N; index++) {
+         if (!inUse[index]) {
+            inUse[index] = true;
+            T *coroutine = new (frames[index]) T(args...);
+            Async::start(coroutine, this);
+            return coroutine;
+         }
+      }
+      return nullptr;
+   }
+
+   /**
+    * Release frame of completed coroutine
+    *
+    * @param[in] coroutine Coroutine that has completed
+    */
+   virtual void release(Coroutine *coroutine) override {
+      T *frame = static_cast<T*>(coroutine);
+      frame->~T();
+      inUse[((uint8_t*)frame - frames[0])/sizeof(T)] = false;
+   }
+
+   /**
+    * Get number of frames in use
+    *
+    * @return Number of active coroutines from this pool
+    */
+   int getActiveCount() const {
+      int count = 0;
+      for (int index=0; index<N; index++) {
+         if (inUse[index]) {
+            count++;
+         }
+      }
+      return count;
+   }
+};
+
+#endif /* SOURCES_ASYNC_H_ */
@@ -0,0 +1,204 @@
+/*
+ * Configuration.cpp
+ *
+ *  Persistent calibration and tuning record
+ */
+
+#include "Configuration.h"
+#include "Ruby.h"
+#include "pid.h"
+
+using namespace USBDM;
+
+namespace {
+
+/** Identifies a configuration record (upper half of first word) */
+constexpr uint32_t MAGIC = 0x52420000;   // "RB"
+
+/**
+ * Layout of record in FlexRAM
+ *
+ * Words are committed in order so the CRC is written last.
+ * An interrupted save is detected by the CRC check on load.
+ */
+struct StoredConfiguration {
+   uint32_t          id;        // MAGIC | VERSION
+   uint32_t          length;    // Size of data in bytes
+   ConfigurationData data;
+   uint32_t          crc;       // CRC-32 of data
+};
+
+static_assert(sizeof(ConfigurationData)%sizeof(uint32_t) == 0, "ConfigurationData must be a multiple of 4 bytes");
+
+using ConfigurationRecord = NonvolatileRecord<StoredConfiguration>;
+
+/** Record in FlexRAM */
+__attribute__ ((section(".flexRAM")))
+ConfigurationRecord::Storage storage;
+
+/** RAM shadow of record */
+ConfigurationRecord record(storage);
+
+/** Indicates the EEPROM was initialised */
+bool available = false;
+
+/** Call-back for save in progress */
+Configuration::SaveCallback saveCallback = nullptr;
+
+}
+
+const ConfigurationData Configuration::defaults = {
+      /* indexOffset        */ { 0, 0 },
+      /* kp                 */ { 5.0f, 5.0f },
+      /* ki                 */ { 0.1f, 0.1f },
+      /* kd                 */ { 0.01f, 0.01f },
+      /* settleTolerance    */ { STEADY_STATE_TOLERANCE, STEADY_STATE_TOLERANCE },
+      // Original controller structure
+      /* antiWindup         */ { PID::AntiWindup_Clamp, PID::AntiWindup_Clamp },
+      /* trackingGain       */ { 0.0f, 0.0f },
+      /* derivativeFilter   */ { 0.0f, 0.0f },
+      /* proportionalWeight */ { 1.0f, 1.0f },
+      /* derivativeWeight   */ { 0.0f, 0.0f },
+      /* modelGain          */ { 0.0f, 0.0f },
+      /* modelTimeConstant  */ { 0.0f, 0.0f },
+      /* modelFriction      */ { 0.0f, 0.0f },
+      /* gripperCloseTime   */ Gripper1::DEFAULT_OPERATE_DELAY,
+      /* gripperOpenTime    */ Gripper1::DEFAULT_RELEASE_DELAY,
+};
+
+ConfigurationData Configuration::data  = defaults;
+bool              Configuration::valid = false;
+
+/*
+ * Calculate CRC-32 (IEEE 802.3)
+ */
+uint32_t Configuration::calculateCrc(const void *data, unsigned length) {
+   const uint8_t *bytes = static_cast<const uint8_t *>(data);
+   uint32_t crc = 0xFFFFFFFF;
+   while (length-- > 0) {
+      crc ^= *bytes++;
+      for (int bit=0; bit<8; bit++) {
+         crc = (crc>>1)^((crc&1)?0xEDB88320:0);
+      }
+   }
+   return ~crc;
+}
+
+/*
+ * Initialise the EEPROM and load the configuration record
+ */
+bool Configuration::load() {
+   data  = defaults;
+   valid = false;
+
+   FlashDriverError_t rc = initialiseEeprom();
+   if ((rc != FLASH_ERR_OK) && (rc != FLASH_ERR_NEW_EEPROM)) {
+      console.writeln("EEPROM initialisation failed");
+      return false;
+   }
+   available = true;
+   record.load();
+
+   if (rc == FLASH_ERR_NEW_EEPROM) {
+      // Freshly partitioned - contents are blank
+      return false;
+   }
+   const StoredConfiguration &stored = record.get();
+
+   if (stored.id != (MAGIC|VERSION)) {
+      return false;
+   }
+   if (stored.length != sizeof(ConfigurationData)) {
+      return false;
+   }
+   if (stored.crc != calculateCrc(&stored.data, sizeof(ConfigurationData))) {
+      return false;
+   }
+   data  = stored.data;
+   valid = true;
+   return true;
+}
+
+/*
+ * Executed by record.poll() when a commit completes
+ */
+static void commitComplete(FlashDriverError_t rc) {
+   Configuration::SaveCallback callback = saveCallback;
+   saveCallback = nullptr;
+   if (callback != nullptr) {
+      callback((rc == FLASH_ERR_OK) && (record.get().id == (MAGIC|Configuration::VERSION)));
+   }
+}
+
+/*
+ * Write the configuration record
+ */
+bool Configuration::save(SaveCallback callback) {
+   if (!available) {
+      return false;
+   }
+   record.set(&StoredConfiguration::id,     MAGIC|VERSION);
+   record.set(&StoredConfiguration::length, (uint32_t)sizeof(ConfigurationData));
+   record.set(&StoredConfiguration::data,   data);
+   record.set(&StoredConfiguration::crc,    calculateCrc(&data, sizeof(ConfigurationData)));
+
+   saveCallback = callback;
+   record.commit(commitComplete);
+   valid = true;
+   return true;
+}
+
+/*
+ * Invalidate the stored record
+ */
+void Configuration::erase() {
+   valid = false;
+   if (!available) {
+      return;
+   }
+   record.set(&StoredConfiguration::id, (uint32_t)0);
+   record.commit(commitComplete);
+}
+
+/*
+ * Indicates the EEPROM was initialised by load()
+ */
+bool Configuration::isEepromAvailable() {
+   return available;
+}
+
+/*
+ * Advance a save or erase in progress
+ */
+bool Configuration::poll() {
+   return record.poll();
+}
+
+/*
+ * Write the configuration to the console
+ */
+void Configuration::report() {
+   static const char *const antiWindupNames[] = {"clamp", "back-calculation", "conditional"};
+   console.write("Configuration V").write(VERSION).writeln(valid?" (stored)":" (not stored)");
+   for (int motor=0; motor<2; motor++) {
+      console.write("Motor ").write(motor+1).
+         write(": index offset = ").write(data.indexOffset[motor]).
+         write(", kp = ").write(data.kp[motor]).
+         write(", ki = ").write(data.ki[motor]).
+         write(", kd = ").write(data.kd[motor]).
+         write(", settle = ").writeln(data.settleTolerance[motor]);
+      console.write("Motor ").write(motor+1).
+         write(": anti-windup = ").write(antiWindupNames[(data.antiWindup[motor]<3)?data.antiWindup[motor]:0]).
+         write(" (tracking = ").write(data.trackingGain[motor]).
+         write("/s), derivative filter = ").write(data.derivativeFilter[motor]*1000).
+         write(" ms, weights = ").write(data.proportionalWeight[motor]).
+         write("/").writeln(data.derivativeWeight[motor]);
+      if (data.modelGain[motor] > 0) {
+         console.write("Motor ").write(motor+1).
+            write(": model gain = ").write(data.modelGain[motor]).
+            write(" ticks/s/%, time constant = ").write(data.modelTimeConstant[motor]*1000).
+            write(" ms, friction = ").write(data.modelFriction[motor]).writeln(" %");
+      }
+   }
+   console.write("Gripper close/open = ").write(data.gripperCloseTime).write("/").write(data.gripperOpenTime).writeln(" ms");
+}
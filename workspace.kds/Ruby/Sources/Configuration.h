@@ -0,0 +1,141 @@
+/*
+ * Configuration.h
+ *
+ *  Persistent calibration and tuning record
+ */
+
+#ifndef SOURCES_CONFIGURATION_H_
+#define SOURCES_CONFIGURATION_H_
+
+#include <stdint.h>
+#include "flash.h"
+
+/**
+ * Calibration and tuning values that persist across resets
+ *
+ * Only 4-byte members so the record maps directly onto FlexRAM words.
+ * Increment Configuration::VERSION when the layout changes.
+ */
+struct ConfigurationData {
+   int32_t  indexOffset[2];        //!< Encoder position of the index relative to home for each motor (ticks)
+   float    kp[2];                 //!< PID proportional gain for each motor
+   float    ki[2];                 //!< PID integral gain for each motor
+   float    kd[2];                 //!< PID derivative gain for each motor
+   int32_t  settleTolerance[2];    //!< Average error at which a move is taken to have finished for each motor (ticks)
+   uint32_t antiWindup[2];         //!< PID::AntiWindup method for each motor
+   float    trackingGain[2];       //!< Back-calculation tracking gain for each motor (1/s)
+   float    derivativeFilter[2];   //!< Derivative filter time constant for each motor (s, 0 => unfiltered)
+   float    proportionalWeight[2]; //!< Setpoint weight in proportional term for each motor
+   float    derivativeWeight[2];   //!< Setpoint weight in derivative term for each motor
+   float    modelGain[2];          //!< Identified velocity gain for each motor (ticks/s per % output, 0 => not identified)
+   float    modelTimeConstant[2];  //!< Identified mechanical time constant for each motor (s)
+   float    modelFriction[2];      //!< Identified Coulomb friction for each motor (% output)
+   uint32_t gripperCloseTime;      //!< Time allowed for gripper solenoid to close (ms)
+   uint32_t gripperOpenTime;       //!< Time allowed for gripper solenoid to open (ms)
+};
+
+/**
+ * Versioned, CRC checked configuration record stored in FlexNVM EEPROM
+ *
+ * The record is held in FlexRAM (EEPROM emulation) using USBDM::NonvolatileRecord.
+ * A RAM copy (Configuration::data) is used at run-time and written back by save().
+ * Saving does not block - poll() completes the write in the background.
+ *
+ * @note In debug builds Flash::initialiseEeprom() does not partition the FlexNVM so
+ *       the record only survives while powered.
+ */
+class Configuration : private USBDM::Flash {
+
+private:
+   Configuration() = delete;
+   Configuration(const Configuration&) = delete;
+
+   /** Indicates data was loaded from a valid record */
+   static bool valid;
+
+public:
+   /**
+    * Type for call-back executed when a save completes
+    *
+    * @param[in] success true => record written and verified
+    */
+   typedef void (*SaveCallback)(bool success);
+
+   /** Record layout version - increment when ConfigurationData changes */
+   static constexpr uint16_t VERSION = 4;
+
+   /** Values used when there is no valid record */
+   static const ConfigurationData defaults;
+
+   /** Run-time copy of the configuration */
+   static ConfigurationData data;
+
+   /**
+    * Initialise the EEPROM and load the configuration record
+    *
+    * @return true  => Valid record loaded
+    * @return false => Record missing, corrupt or old version - defaults loaded
+    */
+   static bool load();
+
+   /**
+    * Start writing the configuration record\n
+    * Only words that have changed are written to reduce EEPROM wear.\n
+    * Returns immediately - poll() must be called to complete the write.
+    *
+    * @param[in] callback Call-back executed from poll() on completion (may be nullptr)
+    *
+    * @return true  => Write started
+    * @return false => EEPROM not available
+    */
+   static bool save(SaveCallback callback=nullptr);
+
+   /**
+    * Invalidate the stored record\n
+    * Defaults (and interactive calibration) will be used after the next reset.\n
+    * Returns immediately - poll() must be called to complete the write.
+    */
+   static void erase();
+
+   /**
+    * Advance a save or erase in progress\n
+    * Should be called regularly e.g. from a periodic task.
+    *
+    * @return true => Write in progress
+    */
+   static bool poll();
+
+   /**
+    * Indicates the configuration was loaded from a valid record or has been saved
+    *
+    * @return true => valid
+    */
+   static bool isValid() {
+      return valid;
+   }
+
+   /**
+    * Indicates the EEPROM was initialised by load()
+    *
+    * @return true => Records may be kept in FlexRAM
+    */
+   static bool isEepromAvailable();
+
+   /**
+    * Write the configuration to the console
+    */
+   static void report();
+
+   /**
+    * Calculate CRC-32 (IEEE 802.3)\n
+    * Also used by other records kept in the EEPROM
+    *
+    * @param[in] data   Data to check
+    * @param[in] length Number of bytes
+    *
+    * @return CRC
+    */
+   static uint32_t calculateCrc(const void *data, unsigned length);
+};
+
+#endif /* SOURCES_CONFIGURATION_H_ */
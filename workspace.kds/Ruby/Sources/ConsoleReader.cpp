@@ -0,0 +1,94 @@
+/*
+ * ConsoleReader.cpp
+ *
+ *  Interrupt driven console reception
+ */
+
+#include "ConsoleReader.h"
+#include "Async.h"
+#include "console.h"
+#include "MemoryMonitor.h"
+#include "StaticContainers.h"
+#include "Priorities.h"
+
+using namespace USBDM;
+
+namespace {
+
+/** Characters received by ISR (single producer/consumer so no locking needed) */
+RingBuffer<char, ConsoleReader::RX_QUEUE_SIZE> rxQueue;
+
+}
+
+Scheduler::TaskId     ConsoleReader::listener      = Scheduler::NO_TASK;
+Scheduler::EventFlags ConsoleReader::listenerEvent = 0;
+
+/*
+ * UART receive call-back - called from UART ISR
+ */
+void ConsoleReader::rxCallback(uint8_t status) {
+   MemoryMonitor::sampleIsrEntry(MemoryMonitor::Isr_ConsoleRx);
+
+   if (status & UART_S1_RDRF_MASK) {
+      rxQueue.enQueue(console.uart->D);
+      if (listener != Scheduler::NO_TASK) {
+         Scheduler::postEvent(listener, listenerEvent);
+      }
+      Async::notify();
+   }
+   else if (status & (UART_S1_FE_MASK|UART_S1_OR_MASK|UART_S1_PF_MASK|UART_S1_NF_MASK)) {
+      // Discard character to clear error
+      (void)console.uart->D;
+   }
+}
+
+/*
+ * Enable interrupt driven reception
+ */
+void ConsoleReader::enable(Scheduler::TaskId task, Scheduler::EventFlags event) {
+   listener      = task;
+   listenerEvent = event;
+
+   Console::setRxTxCallback(rxCallback);
+   console.enableInterrupt(UartInterrupt_RxFull);
+   Console::enableNvicInterrupts(true, IrqPriority_Comms);
+}
+
+/*
+ * Check if a character is available
+ */
+bool ConsoleReader::isCharAvailable() {
+   return !rxQueue.isEmpty();
+}
+
+/*
+ * Read a received character (non-blocking)
+ */
+int ConsoleReader::readCharNoBlock() {
+   if (rxQueue.isEmpty()) {
+      return -1;
+   }
+   char ch = rxQueue.deQueue();
+   if (ch == '\r') {
+      ch = '\n';
+   }
+   console.write(ch);
+   return (uint8_t)ch;
+}
+
+/*
+ * Assemble a '\n' terminated frame from received characters (non-blocking)
+ */
+bool ConsoleReader::readFrame(char *buffer, unsigned size, unsigned &length) {
+   int ch;
+   while ((ch = readCharNoBlock()) >= 0) {
+      if (ch == '\n') {
+         buffer[(length<size)?length:(size-1)] = '\0';
+         return true;
+      }
+      if (length < (size-1)) {
+         buffer[length++] = (char)ch;
+      }
+   }
+   return false;
+}
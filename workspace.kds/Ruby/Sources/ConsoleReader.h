@@ -0,0 +1,87 @@
+/*
+ * ConsoleReader.h
+ *
+ *  Interrupt driven console reception
+ */
+
+#ifndef SOURCES_CONSOLEREADER_H_
+#define SOURCES_CONSOLEREADER_H_
+
+#include "hardware.h"
+#include "Scheduler.h"
+
+/**
+ * Interrupt driven reception for the console UART
+ *
+ * Once enabled, received characters are queued by the UART ISR and the
+ * listening task and any coroutines are woken.
+ * The blocking console.readChar() etc. must not be used while enabled.
+ *
+ * Example:
+ * @code
+ *  // In a Coroutine
+ *  CO_AWAIT(ConsoleReader::readFrame(frame, sizeof(frame), frameLength));
+ *  console.write("Received ").writeln(frame);
+ *  frameLength = 0;
+ * @endcode
+ */
+class ConsoleReader {
+
+private:
+   ConsoleReader() = delete;
+   ConsoleReader(const ConsoleReader&) = delete;
+
+   /** Task woken when characters are received */
+   static Scheduler::TaskId    listener;
+
+   /** Event posted to listener */
+   static Scheduler::EventFlags listenerEvent;
+
+   /** UART receive call-back - called from UART ISR */
+   static void rxCallback(uint8_t status);
+
+public:
+   /** Size of receive queue */
+   static constexpr int RX_QUEUE_SIZE = 64;
+
+   /**
+    * Enable interrupt driven reception
+    *
+    * @param[in] task  Task to wake when characters are received (may be Scheduler::NO_TASK)
+    * @param[in] event Event to post to task
+    */
+   static void enable(Scheduler::TaskId task, Scheduler::EventFlags event);
+
+   /**
+    * Check if a character is available
+    *
+    * @return true => readCharNoBlock() will return a character
+    */
+   static bool isCharAvailable();
+
+   /**
+    * Read a received character (non-blocking)\n
+    * The character is echoed.
+    *
+    * @return <0  No character available
+    * @return >=0 Character read
+    */
+   static int readCharNoBlock();
+
+   /**
+    * Assemble a '\\n' terminated frame from received characters (non-blocking)\n
+    * Suitable for use with CO_AWAIT().
+    *
+    * @param[out]   buffer  Buffer for frame (null terminated without '\\n')
+    * @param[in]    size    Size of buffer
+    * @param[inout] length  Characters assembled so far - set to zero before reading a new frame
+    *
+    * @return true  => Complete frame in buffer
+    * @return false => Frame incomplete
+    *
+    * @note Characters that do not fit in the buffer are discarded
+    */
+   static bool readFrame(char *buffer, unsigned size, unsigned &length);
+};
+
+#endif /* SOURCES_CONSOLEREADER_H_ */
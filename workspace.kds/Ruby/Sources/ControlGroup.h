@@ -0,0 +1,262 @@
+/*
+ * ControlGroup.h
+ *
+ *  Synchronised sampling and output of the axes run by the control ISR
+ */
+
+#ifndef SOURCES_CONTROLGROUP_H_
+#define SOURCES_CONTROLGROUP_H_
+
+#include "hardware.h"
+#include "RamFunction.h"
+
+/**
+ * Axes sampled and updated together by the control ISR
+ *
+ * sample() reads all encoder counters back-to-back with interrupts disabled so the
+ * controllers of every axis see the positions at the same instant (within a few bus
+ * cycles - the span is measured). The controllers take their input from
+ * getPositionAsFloat<index>() and stage their outputs with setSpeed<index>().
+ *
+ * commit() then writes all staged outputs together. The motors share the driver FTM and
+ * in edge-aligned PWM the FTM loads every channel's buffered CnV at the same counter
+ * overflow, so the writes are made in one burst within a single PWM period. If the
+ * counter is within 1/COMMIT_GUARD_FRACTION of the period end the commit waits for the
+ * overflow rather than let the burst straddle two loads. All axes then change output
+ * at the same PWM edge, one period after the commit.
+ *
+ * Example:
+ * @code
+ *  using ControlGroup = ControlGroup_T<USBDM::Ftm0Info, Motor1, Motor2>;
+ *
+ *  PID_T<ControlGroup::getPositionAsFloat<0>, ControlGroup::setSpeed<0>> pid1(...);
+ *  PID_T<ControlGroup::getPositionAsFloat<1>, ControlGroup::setSpeed<1>> pid2(...);
+ *
+ *  // Control ISR
+ *  ControlGroup::sample();
+ *  pid1.update();
+ *  pid2.update();
+ *  ControlGroup::commit();
+ * @endcode
+ *
+ * @tparam DriverFTM Info for the FTM generating the PWM of all the motors
+ * @tparam Motors    Motors in the group (as Motor<>) - index 0 is the first
+ */
+template<class DriverFTM, class... Motors>
+class ControlGroup_T {
+
+public:
+   /** Number of axes */
+   static constexpr unsigned AXES = sizeof...(Motors);
+
+   /** A commit in the last 1/COMMIT_GUARD_FRACTION of the PWM period waits for the next period */
+   static constexpr unsigned COMMIT_GUARD_FRACTION = 8;
+
+private:
+   ControlGroup_T() = delete;
+   ControlGroup_T(const ControlGroup_T&) = delete;
+
+   static_assert(AXES <= 32, "Pending outputs are a 32-bit mask");
+
+   using Timer = USBDM::FtmBase_T<DriverFTM>;
+
+   /** Positions at the last sample() */
+   static int16_t positions[AXES];
+
+   /** Outputs staged since the last commit() */
+   static float outputs[AXES];
+
+   /** Mask of staged outputs */
+   static uint32_t pending;
+
+   /** CPU cycles from the first to the last encoder read (last and worst) */
+   static volatile uint32_t latchCycles;
+   static volatile uint32_t maxLatchCycles;
+
+   /** Commits made and commits that waited for the next PWM period */
+   static volatile uint32_t commits;
+   static volatile uint32_t delayedCommits;
+
+   /**
+    * Read the encoders of the axes from index on (end of group)
+    */
+   template<unsigned index>
+   RAMFUNC_INLINE static void readCounts(int16_t[]) {
+   }
+
+   /**
+    * Read the encoders of the axes from index on
+    *
+    * @param[out] counts Encoder counts of the group
+    */
+   template<unsigned index, class Motor, class... Rest>
+   RAMFUNC_INLINE static void readCounts(int16_t counts[]) {
+      counts[index] = Motor::Encoder::getPosition();
+      readCounts<index+1, Rest...>(counts);
+   }
+
+   /**
+    * Convert the counts of the axes from index on to positions (end of group)
+    */
+   template<unsigned index>
+   RAMFUNC_INLINE static void convertCounts(const int16_t[]) {
+   }
+
+   /**
+    * Convert the counts of the axes from index on to positions
+    *
+    * @param[in] counts Encoder counts of the group
+    */
+   template<unsigned index, class Motor, class... Rest>
+   RAMFUNC_INLINE static void convertCounts(const int16_t counts[]) {
+      positions[index] = Motor::positionFromCount(counts[index]);
+      convertCounts<index+1, Rest...>(counts);
+   }
+
+   /**
+    * Write the staged outputs of the axes from index on (end of group)
+    */
+   template<unsigned index>
+   RAMFUNC_INLINE static void writeOutputs() {
+   }
+
+   /**
+    * Write the staged outputs of the axes from index on to the motors
+    */
+   template<unsigned index, class Motor, class... Rest>
+   RAMFUNC_INLINE static void writeOutputs() {
+      if (pending&(1U<<index)) {
+         Motor::setSpeed(outputs[index]);
+      }
+      writeOutputs<index+1, Rest...>();
+   }
+
+public:
+   /**
+    * Sample the positions of all axes\n
+    * Call from the control ISR before the controllers are updated.
+    */
+   RAMFUNC_INLINE static void sample() {
+      int16_t counts[AXES];
+      uint32_t startTime;
+      uint32_t endTime;
+      {
+         CriticalSection cs;
+         startTime = DWT->CYCCNT;
+         readCounts<0, Motors...>(counts);
+         endTime = DWT->CYCCNT;
+      }
+      convertCounts<0, Motors...>(counts);
+      latchCycles = endTime - startTime;
+      if (latchCycles > maxLatchCycles) {
+         maxLatchCycles = latchCycles;
+      }
+   }
+
+   /**
+    * Get the position of an axis at the last sample()\n
+    * For use as PID_T input function.
+    *
+    * @tparam index Axis index in the group
+    *
+    * @return Position from shaft encoder
+    */
+   template<unsigned index>
+   RAMFUNC_INLINE static float getPositionAsFloat() {
+      static_assert(index < AXES, "Axis not in group");
+      return positions[index];
+   }
+
+   /**
+    * Stage the output of an axis until commit()\n
+    * For use as PID_T output function.
+    *
+    * @tparam index Axis index in the group
+    *
+    * @param[in] speed Speed to set motor -100.0...100.0 (as Motor::setSpeed())
+    */
+   template<unsigned index>
+   RAMFUNC_INLINE static void setSpeed(float speed) {
+      static_assert(index < AXES, "Axis not in group");
+      outputs[index] = speed;
+      pending |= (1U<<index);
+   }
+
+   /**
+    * Write all staged outputs so they take effect at the same PWM period\n
+    * Call from the control ISR after the controllers are updated.
+    * Axes without a staged output are left unchanged.
+    */
+   RAMFUNC_INLINE static void commit() {
+      if (pending == 0) {
+         return;
+      }
+      uint32_t modulo = Timer::tmr->MOD;
+      uint32_t guard  = modulo-(modulo/COMMIT_GUARD_FRACTION);
+      CriticalSection cs;
+      if (Timer::tmr->CNT >= guard) {
+         // Wait for the overflow so every CnV is loaded at the same period
+         delayedCommits = delayedCommits+1;
+         while (Timer::tmr->CNT >= guard) {
+         }
+      }
+      writeOutputs<0, Motors...>();
+      pending = 0;
+      commits = commits+1;
+   }
+
+   /**
+    * Run a call-back every divisor PWM periods from the driver FTM overflow\n
+    * The call-back starts at the beginning of a PWM period so sample() is at a fixed point in
+    * the PWM cycle and the outputs written by commit() are loaded at the end of the same
+    * period - the latency from sample to output is one PWM period.\n
+    * The driver FTM must already be running.
+    *
+    * @param[in] callback     Call-back (the control ISR)
+    * @param[in] divisor      PWM periods between calls (1..32)
+    * @param[in] nvicPriority Interrupt priority (shared with the FTM fault interrupt)
+    */
+   static void setPeriodCallback(USBDM::FtmCallbackFunction callback, unsigned divisor, uint32_t nvicPriority) {
+      // TOF is only set every NUMTOF+1 overflows
+      Timer::tmr->CONF = (Timer::tmr->CONF&~FTM_CONF_NUMTOF_MASK)|FTM_CONF_NUMTOF(divisor-1);
+      Timer::setTimerOverflowCallback(callback);
+      // The FTM handler passes on the channel flags set by every PWM match - they are not used
+      Timer::setChannelCallback(Timer::ignoreChannelCallback);
+      Timer::enableTimerOverflowInterrupts();
+      Timer::enableNvicInterrupts(true, nvicPriority);
+   }
+
+   /**
+    * Report sampling skew and commit statistics on the console and restart the worst-case measurement
+    */
+   static void report() {
+      USBDM::console.write("Control group: latch cycles: last = ").write(latchCycles).
+            write(", max = ").write(maxLatchCycles).
+            write(", commits = ").write(commits).
+            write(", delayed = ").writeln(delayedCommits);
+      maxLatchCycles = 0;
+   }
+};
+
+template<class DriverFTM, class... Motors>
+int16_t ControlGroup_T<DriverFTM, Motors...>::positions[AXES] = {};
+
+template<class DriverFTM, class... Motors>
+float ControlGroup_T<DriverFTM, Motors...>::outputs[AXES] = {};
+
+template<class DriverFTM, class... Motors>
+uint32_t ControlGroup_T<DriverFTM, Motors...>::pending = 0;
+
+template<class DriverFTM, class... Motors>
+volatile uint32_t ControlGroup_T<DriverFTM, Motors...>::latchCycles = 0;
+
+template<class DriverFTM, class... Motors>
+volatile uint32_t ControlGroup_T<DriverFTM, Motors...>::maxLatchCycles = 0;
+
+template<class DriverFTM, class... Motors>
+volatile uint32_t ControlGroup_T<DriverFTM, Motors...>::commits = 0;
+
+template<class DriverFTM, class... Motors>
+volatile uint32_t ControlGroup_T<DriverFTM, Motors...>::delayedCommits = 0;
+
+#endif /* SOURCES_CONTROLGROUP_H_ */
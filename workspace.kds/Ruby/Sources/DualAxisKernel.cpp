@@ -0,0 +1,339 @@
+/*
+ * DualAxisKernel.cpp
+ *
+ *  Fixed-point position controller for both axes using the Cortex-M4 SIMD instructions
+ */
+
+#include <math.h>
+#include <new>
+#include "hardware.h"
+#include "pid.h"
+#include "Trajectory.h"
+#include "DualAxisKernel.h"
+
+using namespace USBDM;
+
+namespace {
+
+/** Control samples for each move of the test sequence */
+constexpr unsigned MOVE_SAMPLES = 600;
+
+/** Moves in the test sequence - alternately a step and a profiled move */
+constexpr unsigned MOVES = 8;
+
+/** Targets of the test sequence (axis 2 moves the other way) */
+constexpr int16_t TARGETS[4] = {QUARTERROTATIONTICKS, 0, -QUARTERROTATIONTICKS, 0};
+
+/** Model used for the test feedforward (close to the identified motors) */
+constexpr float TEST_GAIN          = 400.0f;
+constexpr float TEST_TIME_CONSTANT = 8e-3f;
+constexpr float TEST_FRICTION      = 1.0f;
+
+/** Positions seen by the test controllers */
+int16_t testPosition[2];
+
+/**
+ * Test controller input - as Motor::getPositionAsFloat()
+ */
+template<unsigned index>
+float testInput() {
+   return testPosition[index];
+}
+
+/**
+ * Test controller output - discarded (PID_T::getOutput() is used)
+ */
+template<unsigned index>
+void testOutput(float) {
+}
+
+using TestPid1 = PID_T<testInput<0>, testOutput<0>>;
+using TestPid2 = PID_T<testInput<1>, testOutput<1>>;
+
+/** Storage for the test controllers (too large for the stack) */
+alignas(TestPid1) uint8_t testPid1Storage[sizeof(TestPid1)];
+alignas(TestPid2) uint8_t testPid2Storage[sizeof(TestPid2)];
+
+/** Execution time of one calculation for both axes */
+struct Timing {
+   uint64_t total;   //!< Sum over the test sequence (cycles)
+   uint32_t max;     //!< Worst case (cycles)
+
+   void add(uint32_t cycles) {
+      total += cycles;
+      if (cycles > max) {
+         max = cycles;
+      }
+   }
+};
+
+/**
+ * Write a timing to the console
+ *
+ * @param[in] name    Name of calculation
+ * @param[in] timing  Timing
+ * @param[in] samples Number of calculations timed
+ */
+void report(const char *name, const Timing &timing, unsigned samples) {
+   console.write(name).
+         write(" cycles: mean = ").write((unsigned)(timing.total/samples)).
+         write(", max = ").writeln(timing.max);
+}
+
+/**
+ * Move a test position towards the setpoint with some noise
+ *
+ * @param[in]     setpoint Setpoint (ticks)
+ * @param[in,out] position Position (ticks)
+ * @param[in]     lag      Fraction of the error removed each sample is 1/lag
+ * @param[in,out] lfsr     Noise generator state (16-bit maximal length sequence)
+ */
+void follow(int16_t setpoint, int16_t &position, int lag, uint16_t &lfsr) {
+   lfsr = (lfsr>>1)^((lfsr&1)?0xB400:0);
+   position = (int16_t)(position+(setpoint-position)/lag+(int)(lfsr&3)-1);
+}
+
+}
+
+/*
+ * Recalculate the fixed-point gains from the configured tunings
+ */
+bool DualAxisKernel::calculateGains() {
+   // Largest integral fraction that holds the larger ki*T in a halfword
+   float largestKi = ((ki[0] > ki[1])?ki[0]:ki[1])*sampleTime;
+   integralFraction = MAX_INTEGRAL_FRACTION;
+   while ((integralFraction > 0) && (ldexpf(largestKi, OUTPUT_FRACTION+integralFraction) >= INT16_MAX+0.5f)) {
+      integralFraction--;
+   }
+   integralLimit = outputLimit<<integralFraction;
+
+   bool success = true;
+   for (unsigned index=0; index<2; index++) {
+      float proportional = ldexpf(kp[index], OUTPUT_FRACTION);
+      float derivative   = ldexpf(kd[index]/sampleTime, OUTPUT_FRACTION);
+      float integralGain = ldexpf(ki[index]*sampleTime, OUTPUT_FRACTION+integralFraction);
+      if ((proportional >= INT16_MAX+0.5f) || (derivative >= INT16_MAX+0.5f) || (integralGain >= INT16_MAX+0.5f)) {
+         kp[index] = 0;
+         ki[index] = 0;
+         kd[index] = 0;
+         proportionalDerivativeGains[index] = 0;
+         integralGains[index]               = 0;
+         success = false;
+         continue;
+      }
+      int16_t sign = encoderAndMotorMatchDirection[index]?1:-1;
+      proportionalDerivativeGains[index] = pack(
+            (int16_t)(sign*(int32_t)(proportional+0.5f)),
+            (int16_t)(sign*(int32_t)(derivative+0.5f)));
+      integralGains[index] = pack((int16_t)(sign*(int32_t)(integralGain+0.5f)), 0);
+   }
+   return success;
+}
+
+/*
+ * Change tunings of an axis
+ */
+bool DualAxisKernel::setTunings(unsigned axis, float Kp, float Ki, float Kd, bool encoderAndMotorMatchDirection) {
+   unsigned index = axis-1;
+   if ((index > 1) || (Kp < 0) || (Ki < 0) || (Kd < 0)) {
+      return false;
+   }
+   kp[index] = Kp;
+   ki[index] = Ki;
+   kd[index] = Kd;
+   this->encoderAndMotorMatchDirection[index] = encoderAndMotorMatchDirection;
+   return calculateGains();
+}
+
+/*
+ * Get proportional constant used for an axis
+ */
+float DualAxisKernel::getKp(unsigned axis) const {
+   int16_t gain = axis1(proportionalDerivativeGains[axis-1]);
+   return ldexpf((gain < 0)?-gain:gain, -(int)OUTPUT_FRACTION);
+}
+
+/*
+ * Get integral constant used for an axis
+ */
+float DualAxisKernel::getKi(unsigned axis) const {
+   int16_t gain = axis1(integralGains[axis-1]);
+   return ldexpf((gain < 0)?-gain:gain, -(int)(OUTPUT_FRACTION+integralFraction))/sampleTime;
+}
+
+/*
+ * Get differential constant used for an axis
+ */
+float DualAxisKernel::getKd(unsigned axis) const {
+   int16_t gain = axis2(proportionalDerivativeGains[axis-1]);
+   return ldexpf((gain < 0)?-gain:gain, -(int)OUTPUT_FRACTION)*sampleTime;
+}
+
+/*
+ * PID calculation for both axes using the SIMD instructions
+ */
+RAMFUNC uint32_t DualAxisKernel::update(uint32_t setpoints, uint32_t positions, uint32_t feedforwards) {
+   // Both axes at once
+   uint32_t errors      = __QSUB16(setpoints, positions);
+   uint32_t derivatives = __QSUB16(lastPositions, positions);
+   lastPositions = positions;
+
+   // {error, derivative} of each axis
+   uint32_t terms1 = __PKHBT(errors, derivatives, 16);
+   uint32_t terms2 = __PKHTB(derivatives, errors, 16);
+
+   // Integral is limited after the output is calculated (as PID_T)
+   int32_t integral1 = __QADD(integral[0], (int32_t)__SMUAD(integralGains[0], terms1));
+   int32_t integral2 = __QADD(integral[1], (int32_t)__SMUAD(integralGains[1], terms2));
+
+   int32_t output1 = __QADD((int32_t)__SMUAD(proportionalDerivativeGains[0], terms1), integral1>>integralFraction);
+   int32_t output2 = __QADD((int32_t)__SMUAD(proportionalDerivativeGains[1], terms2), integral2>>integralFraction);
+   output1 = __QADD(output1, (int16_t)feedforwards);
+   output2 = __QADD(output2, (int16_t)(feedforwards>>16));
+
+   integral[0] = clamp(integral1, integralLimit);
+   integral[1] = clamp(integral2, integralLimit);
+
+   return __PKHBT(clamp(output1, outputLimit), clamp(output2, outputLimit), 16);
+}
+
+/*
+ * PID calculation for both axes without the SIMD instructions
+ */
+RAMFUNC uint32_t DualAxisKernel::updateScalar(uint32_t setpoints, uint32_t positions, uint32_t feedforwards) {
+   int16_t outputs[2];
+   for (unsigned index=0; index<2; index++) {
+      unsigned shift = 16*index;
+      int32_t position     = (int16_t)(positions>>shift);
+      int32_t error        = saturate16((int16_t)(setpoints>>shift)-position);
+      int32_t derivative   = saturate16((int16_t)(lastPositions>>shift)-position);
+      int32_t feedforward  = (int16_t)(feedforwards>>shift);
+      int32_t kp           = (int16_t)proportionalDerivativeGains[index];
+      int32_t kd           = (int16_t)(proportionalDerivativeGains[index]>>16);
+      int32_t ki           = (int16_t)integralGains[index];
+
+      int32_t sum    = saturate32((int64_t)integral[index]+ki*error);
+      int32_t output = saturate32((int64_t)(kp*error+kd*derivative)+(sum>>integralFraction));
+      output = saturate32((int64_t)output+feedforward);
+
+      integral[index] = clamp(sum, integralLimit);
+      outputs[index]  = (int16_t)clamp(output, outputLimit);
+   }
+   lastPositions = positions;
+   return pack(outputs[0], outputs[1]);
+}
+
+/*
+ * Compare update() and updateScalar() with two PID_T controllers
+ */
+bool DualAxisKernel::benchmark() const {
+   float limit = outputLimit*OUTPUT_LSB;
+
+   // Controllers being compared all start from the same state
+   DualAxisKernel simd   = *this;
+   DualAxisKernel scalar = *this;
+   TestPid1 *pid1 = new (testPid1Storage) TestPid1(getKp(1), getKi(1), getKd(1), sampleTime, -limit, +limit, encoderAndMotorMatchDirection[0]);
+   TestPid2 *pid2 = new (testPid2Storage) TestPid2(getKp(2), getKi(2), getKd(2), sampleTime, -limit, +limit, encoderAndMotorMatchDirection[1]);
+   pid1->setFeedforward(TEST_GAIN, TEST_TIME_CONSTANT, TEST_FRICTION);
+   pid2->setFeedforward(TEST_GAIN, TEST_TIME_CONSTANT, TEST_FRICTION);
+
+   testPosition[0] = 0;
+   testPosition[1] = 0;
+   pid1->setSetpoint(0);
+   pid2->setSetpoint(0);
+   pid1->enable(true);
+   pid2->enable(true);
+   simd.reset(0);
+   scalar.reset(0);
+
+   Trajectory trajectory1(sampleTime);
+   Trajectory trajectory2(sampleTime);
+   Trajectory::Limits limits = Trajectory::getLimits(TEST_GAIN, TEST_TIME_CONSTANT, TEST_FRICTION, limit);
+
+   Timing   pidTiming       = {};
+   Timing   scalarTiming    = {};
+   Timing   simdTiming      = {};
+   unsigned mismatches      = 0;
+   float    maxDifference   = 0;
+   uint16_t lfsr            = 0xACE1;
+
+   for (unsigned move=0; move<MOVES; move++) {
+      int16_t target = TARGETS[move%4];
+      if ((move%2) == 0) {
+         pid1->setSetpoint(target);
+         pid2->setSetpoint(-target);
+      }
+      else {
+         trajectory1.start(pid1->getSetpoint(), target, limits);
+         trajectory2.start(pid2->getSetpoint(), -target, limits);
+      }
+      for (unsigned sample=0; sample<MOVE_SAMPLES; sample++) {
+         // The kernel only takes whole ticks
+         Trajectory::Reference reference;
+         if (trajectory1.next(reference)) {
+            pid1->setReference(roundf(reference.position), reference.velocity, reference.acceleration);
+         }
+         if (trajectory2.next(reference)) {
+            pid2->setReference(roundf(reference.position), reference.velocity, reference.acceleration);
+         }
+         uint32_t cycles;
+         {
+            CriticalSection cs;
+            uint32_t startTime = DWT->CYCCNT;
+            pid2->update();
+            pid1->update();
+            cycles = DWT->CYCCNT - startTime;
+         }
+         pidTiming.add(cycles);
+
+         uint32_t setpoints    = pack((int16_t)pid1->getSetpoint(), (int16_t)pid2->getSetpoint());
+         uint32_t positions    = pack(testPosition[0], testPosition[1]);
+         uint32_t feedforwards = pack(fromOutput(pid1->getFeedforward()), fromOutput(pid2->getFeedforward()));
+         uint32_t scalarOutputs;
+         uint32_t simdOutputs;
+         {
+            CriticalSection cs;
+            uint32_t startTime = DWT->CYCCNT;
+            scalarOutputs = scalar.updateScalar(setpoints, positions, feedforwards);
+            cycles = DWT->CYCCNT - startTime;
+         }
+         scalarTiming.add(cycles);
+         {
+            CriticalSection cs;
+            uint32_t startTime = DWT->CYCCNT;
+            simdOutputs = simd.update(setpoints, positions, feedforwards);
+            cycles = DWT->CYCCNT - startTime;
+         }
+         simdTiming.add(cycles);
+
+         if (simdOutputs != scalarOutputs) {
+            mismatches++;
+         }
+         float difference1 = fabsf(toOutput(axis1(simdOutputs))-(float)pid1->getOutput());
+         float difference2 = fabsf(toOutput(axis2(simdOutputs))-(float)pid2->getOutput());
+         if (difference1 > maxDifference) {
+            maxDifference = difference1;
+         }
+         if (difference2 > maxDifference) {
+            maxDifference = difference2;
+         }
+         follow((int16_t)pid1->getSetpoint(), testPosition[0], 8,  lfsr);
+         follow((int16_t)pid2->getSetpoint(), testPosition[1], 12, lfsr);
+      }
+   }
+   pid1->~TestPid1();
+   pid2->~TestPid2();
+
+   unsigned samples = MOVES*MOVE_SAMPLES;
+   bool     success = (mismatches == 0) && (maxDifference < ERROR_BOUND);
+   console.write("Dual-axis kernel: samples = ").write(samples).
+         write(", integral fraction = ").write(integralFraction).
+         write(", SIMD/scalar mismatches = ").write(mismatches).
+         write(", max difference from PID_T = ").write(maxDifference*1000).
+         write(" m% (bound ").write(ERROR_BOUND*1000).
+         writeln(success?" m%) OK":" m%) FAILED");
+   report("PID_T x2 ", pidTiming,    samples);
+   report("Scalar   ", scalarTiming, samples);
+   report("SIMD     ", simdTiming,   samples);
+   return success;
+}
@@ -0,0 +1,321 @@
+/*
+ * DualAxisKernel.h
+ *
+ *  Fixed-point position controller for both axes using the Cortex-M4 SIMD instructions
+ */
+
+#ifndef SOURCES_DUALAXISKERNEL_H_
+#define SOURCES_DUALAXISKERNEL_H_
+
+#include <stdint.h>
+#include "derivative.h"
+#include "RamFunction.h"
+
+/**
+ * PID calculation for both axes in one pass
+ *
+ * The per-axis values are packed in halfword pairs (axis 1 in the low halfword, axis 2
+ * in the high halfword) so the errors and derivatives of both axes are formed by one
+ * saturating __QSUB16 each. Each axis' error and derivative are then repacked
+ * (__PKHBT/__PKHTB) and multiplied by its {kp, kd} and {ki, 0} gain pairs with the dual
+ * multiply-accumulate __SMUAD. The integrals are kept in 32 bits (__QADD) as ki is too
+ * small for a halfword.
+ *
+ * Formats:
+ *  - Setpoints, positions, errors and derivatives are whole ticks
+ *  - Outputs and feedforwards are Q10 (1/1024 %)
+ *  - kp and kd/T are Q10 (1/1024 % per tick) so kp, kd/T < 32
+ *  - The integral and ki*T are Q(10+integralFraction) with the fraction chosen by
+ *    setTunings() as large as the larger ki allows (at most MAX_INTEGRAL_FRACTION)
+ *
+ * The calculation is that of PID_T::update() with the default options (clamped integral,
+ * unfiltered derivative on the input, no setpoint weighting). The direction of each
+ * motor is folded into its gains so the integral is held in the output direction.
+ *
+ * Error bound:\n
+ * Given the gains returned by getKp(), getKi() and getKd() (the configured gains rounded to
+ * the fixed-point resolution) the error, derivative, P, D and integral terms are exact.
+ * The only differences from the floating-point calculation are the truncation of the
+ * integral to Q10 (< 1 LSB) and the rounding of the feedforward to Q10 (<= 0.5 LSB). The
+ * output limit does not increase a difference so |output - PID_T output| < ERROR_BOUND
+ * as long as |setpoint-position| and |position change| < 32768 ticks (always the case for
+ * positions within +/-FULLROTATIONTICKS).
+ *
+ * update() and updateScalar() give identical results - updateScalar() is the same
+ * calculation without the SIMD instructions for comparison.
+ *
+ * Example:
+ * @code
+ *  DualAxisKernel kernel(pidInterval, outputLimit);
+ *
+ *  kernel.setTunings(1, kp, ki, kd, false);
+ *  kernel.setTunings(2, kp, ki, kd, true);
+ *  kernel.reset(DualAxisKernel::pack(position1, position2));
+ *
+ *  // Control ISR (setpoints in whole ticks)
+ *  uint32_t outputs = kernel.update(
+ *        DualAxisKernel::pack(setpoint1, setpoint2),
+ *        DualAxisKernel::pack(position1, position2),
+ *        0);
+ *  Motor1::setSpeed(DualAxisKernel::toOutput(DualAxisKernel::axis1(outputs)));
+ *  Motor2::setSpeed(DualAxisKernel::toOutput(DualAxisKernel::axis2(outputs)));
+ * @endcode
+ */
+class DualAxisKernel {
+
+public:
+   /** Fraction bits of outputs, kp and kd/T */
+   static constexpr unsigned OUTPUT_FRACTION = 10;
+
+   /** Output units per LSB */
+   static constexpr float OUTPUT_LSB = 1.0f/(1<<OUTPUT_FRACTION);
+
+   /** Largest integral fraction (the integral and one increment still fit in 32 bits) */
+   static constexpr unsigned MAX_INTEGRAL_FRACTION = 15;
+
+   /** Largest difference from the floating-point calculation with the same gains (output units) */
+   static constexpr float ERROR_BOUND = 1.5f*OUTPUT_LSB;
+
+   /** Largest output limit, kp and kd/T (a halfword of Q10) */
+   static constexpr float MAX_GAIN = 32.0f;
+
+private:
+   /** Control sample interval (s) */
+   const float sampleTime;
+
+   /** Output limit (Q10) */
+   const int32_t outputLimit;
+
+   /** Configured tunings (as PID_T::setTunings()) */
+   float kp[2] = {0, 0};
+   float ki[2] = {0, 0};
+   float kd[2] = {0, 0};
+
+   /** Motor direction of each axis (as PID_T) */
+   bool encoderAndMotorMatchDirection[2] = {true, true};
+
+   /** {kp, kd/T} of each axis including the motor direction (Q10) */
+   uint32_t proportionalDerivativeGains[2] = {0, 0};
+
+   /** {ki*T, 0} of each axis including the motor direction (Q(10+integralFraction)) */
+   uint32_t integralGains[2] = {0, 0};
+
+   /** Fraction bits of integral */
+   unsigned integralFraction = MAX_INTEGRAL_FRACTION;
+
+   /** Integral limit (output limit in Q(10+integralFraction)) */
+   int32_t integralLimit = 0;
+
+   /** Integral of each axis in output direction (Q(10+integralFraction)) */
+   int32_t integral[2] = {0, 0};
+
+   /** Positions of the last update (pair) */
+   uint32_t lastPositions = 0;
+
+   /**
+    * Limit a value to +/-limit
+    *
+    * @param[in] value Value
+    * @param[in] limit Limit (> 0)
+    *
+    * @return Limited value
+    */
+   RAMFUNC_INLINE static int32_t clamp(int32_t value, int32_t limit) {
+      return (value > limit)?limit:((value < -limit)?-limit:value);
+   }
+
+   /**
+    * Limit a value to a signed halfword (as the saturating instructions)
+    *
+    * @param[in] value Value
+    *
+    * @return Limited value
+    */
+   RAMFUNC_INLINE static int32_t saturate16(int32_t value) {
+      return (value > INT16_MAX)?INT16_MAX:((value < INT16_MIN)?INT16_MIN:value);
+   }
+
+   /**
+    * Limit a value to a signed word (as the saturating instructions)
+    *
+    * @param[in] value Value
+    *
+    * @return Limited value
+    */
+   RAMFUNC_INLINE static int32_t saturate32(int64_t value) {
+      return (value > INT32_MAX)?INT32_MAX:((value < INT32_MIN)?INT32_MIN:(int32_t)value);
+   }
+
+   /**
+    * Recalculate the fixed-point gains from the configured tunings
+    *
+    * @return false => a gain is too large for the fixed-point formats
+    */
+   bool calculateGains();
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] sampleTime  Interval between calls to update() (s)
+    * @param[in] outputLimit Output is limited to +/-outputLimit (< MAX_GAIN)
+    */
+   DualAxisKernel(float sampleTime, float outputLimit) :
+      sampleTime(sampleTime), outputLimit(saturate16((int32_t)(outputLimit*(1<<OUTPUT_FRACTION)+0.5f))) {
+      calculateGains();
+   }
+
+   /**
+    * Pack a value for each axis into a halfword pair
+    *
+    * @param[in] axis1 Value for axis 1 (low halfword)
+    * @param[in] axis2 Value for axis 2 (high halfword)
+    *
+    * @return Pair
+    */
+   RAMFUNC_INLINE static uint32_t pack(int16_t axis1, int16_t axis2) {
+      return ((uint32_t)(uint16_t)axis2<<16)|(uint16_t)axis1;
+   }
+
+   /**
+    * Get the axis 1 value of a pair
+    *
+    * @param[in] pair Pair
+    *
+    * @return Value
+    */
+   static int16_t axis1(uint32_t pair) {
+      return (int16_t)pair;
+   }
+
+   /**
+    * Get the axis 2 value of a pair
+    *
+    * @param[in] pair Pair
+    *
+    * @return Value
+    */
+   static int16_t axis2(uint32_t pair) {
+      return (int16_t)(pair>>16);
+   }
+
+   /**
+    * Convert an output or feedforward to Q10 (rounded)
+    *
+    * @param[in] output Output (%)
+    *
+    * @return Q10 value
+    */
+   static int16_t fromOutput(float output) {
+      return (int16_t)saturate16((int32_t)((output*(1<<OUTPUT_FRACTION))+((output >= 0)?0.5f:-0.5f)));
+   }
+
+   /**
+    * Convert a Q10 output to a speed (as Motor::setSpeed())
+    *
+    * @param[in] output Q10 value
+    *
+    * @return Output (%)
+    */
+   static float toOutput(int16_t output) {
+      return output*OUTPUT_LSB;
+   }
+
+   /**
+    * Change tunings of an axis\n
+    * Parameters are as PID_T::setTunings(). The gains used are rounded to the
+    * fixed-point resolution - see getKp(), getKi(), getKd().
+    *
+    * @param[in] axis                          Axis (1 or 2)
+    * @param[in] Kp                            Proportional constant
+    * @param[in] Ki                            Integral constant
+    * @param[in] Kd                            Differential constant
+    * @param[in] encoderAndMotorMatchDirection Defines if the encoder and motor use the same direction of rotation
+    *
+    * @return false => a gain is negative or too large for the fixed-point formats (gains of the axis are cleared)
+    */
+   bool setTunings(unsigned axis, float Kp, float Ki, float Kd, bool encoderAndMotorMatchDirection);
+
+   /**
+    * Get proportional constant used for an axis
+    *
+    * @param[in] axis Axis (1 or 2)
+    *
+    * @return Kp rounded to the fixed-point resolution
+    */
+   float getKp(unsigned axis) const;
+
+   /**
+    * Get integral constant used for an axis
+    *
+    * @param[in] axis Axis (1 or 2)
+    *
+    * @return Ki rounded to the fixed-point resolution
+    */
+   float getKi(unsigned axis) const;
+
+   /**
+    * Get differential constant used for an axis
+    *
+    * @param[in] axis Axis (1 or 2)
+    *
+    * @return Kd rounded to the fixed-point resolution
+    */
+   float getKd(unsigned axis) const;
+
+   /**
+    * Get the fraction bits of the integral
+    *
+    * @return Fraction bits
+    */
+   unsigned getIntegralFraction() const {
+      return integralFraction;
+   }
+
+   /**
+    * Restart both controllers (as PID_T::enable() with zero output)
+    *
+    * @param[in] positions Current positions (pair)
+    */
+   void reset(uint32_t positions) {
+      integral[0]   = 0;
+      integral[1]   = 0;
+      lastPositions = positions;
+   }
+
+   /**
+    * PID calculation for both axes using the SIMD instructions\n
+    * Call every sampleTime.
+    *
+    * @param[in] setpoints    Setpoints (pair, ticks)
+    * @param[in] positions    Positions (pair, ticks)
+    * @param[in] feedforwards Feedforwards in the output direction (pair, Q10) as PID_T::getFeedforward()
+    *
+    * @return Outputs (pair, Q10)
+    */
+   RAMFUNC uint32_t update(uint32_t setpoints, uint32_t positions, uint32_t feedforwards);
+
+   /**
+    * PID calculation for both axes without the SIMD instructions\n
+    * Same results as update().
+    *
+    * @param[in] setpoints    Setpoints (pair, ticks)
+    * @param[in] positions    Positions (pair, ticks)
+    * @param[in] feedforwards Feedforwards in the output direction (pair, Q10) as PID_T::getFeedforward()
+    *
+    * @return Outputs (pair, Q10)
+    */
+   RAMFUNC uint32_t updateScalar(uint32_t setpoints, uint32_t positions, uint32_t feedforwards);
+
+   /**
+    * Compare update() and updateScalar() with two PID_T controllers using the same
+    * (rounded) gains on a generated test sequence and report the differences and
+    * execution times on the console\n
+    * Interrupts are disabled around each measured calculation.
+    *
+    * @return true => update() and updateScalar() agree and differ from PID_T by less than ERROR_BOUND
+    */
+   bool benchmark() const;
+};
+
+#endif /* SOURCES_DUALAXISKERNEL_H_ */
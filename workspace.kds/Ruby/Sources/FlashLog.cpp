@@ -0,0 +1,241 @@
+/*
+ * FlashLog.cpp
+ *
+ *  Append-only fault and statistics log in program flash
+ */
+
+#include "FlashLog.h"
+#include "Scheduler.h"
+
+using namespace USBDM;
+
+extern "C" {
+/* Defined by the linker */
+extern uint8_t __flash_log_start__[];
+extern uint8_t __flash_log_end__[];
+}
+
+RingBuffer<FlashLog::Record, FlashLog::QUEUE_SIZE> FlashLog::queue;
+
+FlashLog::Record   *FlashLog::head          = nullptr;
+uint32_t            FlashLog::nextSequence  = 0;
+FlashLog::Record    FlashLog::current;
+unsigned            FlashLog::phrase        = 0;
+bool                FlashLog::eraseRequired = false;
+FlashLog::State     FlashLog::state         = State_Idle;
+volatile uint32_t   FlashLog::droppedCount  = 0;
+uint32_t            FlashLog::failedCount   = 0;
+bool                FlashLog::initialised   = false;
+
+namespace {
+
+/** Names for dump() - order must match FlashLog::Event */
+const char *const eventNames[] = {
+      "?",
+      "Boot",
+      "Stop",
+      "Shutdown",
+      "Calibrated",
+      "IndexNotFound",
+      "Move",
+      "OverCurrent",
+      "Jam",
+      "JamRecovered",
+};
+
+}
+
+/*
+ * Get first record of sector
+ */
+FlashLog::Record *FlashLog::sectorStart(unsigned sector) {
+   return reinterpret_cast<Record *>(__flash_log_start__+sector*programFlashSectorSize);
+}
+
+/*
+ * Get number of sectors in log region
+ */
+unsigned FlashLog::sectorCount() {
+   return (__flash_log_end__-__flash_log_start__)/programFlashSectorSize;
+}
+
+/*
+ * Move head to the start of the following sector (wrapping)
+ */
+void FlashLog::advanceSector() {
+   unsigned sector = (reinterpret_cast<uint8_t *>(head)-__flash_log_start__)/programFlashSectorSize;
+   head          = sectorStart((sector+1)%sectorCount());
+   eraseRequired = true;
+}
+
+/*
+ * Find the end of the log
+ */
+void FlashLog::initialise() {
+   // Newest sector has the largest starting sequence number
+   int      newest         = -1;
+   uint32_t newestSequence = 0;
+   for (unsigned sector=0; sector<sectorCount(); sector++) {
+      uint32_t sequence = sectorStart(sector)->sequence;
+      if ((sequence != BLANK_SEQUENCE) && ((newest < 0) || (sequence > newestSequence))) {
+         newest         = sector;
+         newestSequence = sequence;
+      }
+   }
+   if (newest < 0) {
+      // Empty log - erase first sector in case of partial contents
+      head          = sectorStart(0);
+      nextSequence  = 0;
+      eraseRequired = true;
+   }
+   else {
+      // Records are written in order so search for the first blank slot
+      Record   *records = sectorStart(newest);
+      unsigned  low     = 1;
+      unsigned  high    = RECORDS_PER_SECTOR;
+      while (low < high) {
+         unsigned mid = (low+high)/2;
+         if (records[mid].sequence == BLANK_SEQUENCE) {
+            high = mid;
+         }
+         else {
+            low = mid+1;
+         }
+      }
+      nextSequence  = records[low-1].sequence+1;
+      head          = records+low;
+      eraseRequired = false;
+      if (low >= RECORDS_PER_SECTOR) {
+         head = records;
+         advanceSector();
+      }
+   }
+   state       = State_Idle;
+   initialised = true;
+}
+
+/*
+ * Queue a record for writing
+ */
+bool FlashLog::log(Event event, uint8_t axis, int16_t error, int32_t position) {
+   Record record;
+   record.sequence  = BLANK_SEQUENCE;
+   record.timestamp = Scheduler::getTime();
+   record.event     = event;
+   record.axis      = axis;
+   record.error     = error;
+   record.position  = position;
+
+   // May have several producers (tasks and ISRs)
+   CriticalSection cs;
+   if (!queue.enQueue(record)) {
+      droppedCount = droppedCount + 1;
+      return false;
+   }
+   return true;
+}
+
+/*
+ * Advance writing of queued records
+ */
+bool FlashLog::poll() {
+   if (!initialised) {
+      return false;
+   }
+   if (!isReady()) {
+      // Erase, program or EEPROM update in progress
+      return true;
+   }
+   switch (state) {
+      case State_Idle:
+         break;
+
+      case State_Erasing:
+         state = State_Idle;
+         if (getCommandResult() == FLASH_ERR_OK) {
+            eraseRequired = false;
+         }
+         else {
+            failedCount++;
+         }
+         break;
+
+      case State_Programming:
+         if (getCommandResult() != FLASH_ERR_OK) {
+            // Abandon record - slot is not blank
+            failedCount++;
+            phrase = PHRASES_PER_RECORD;
+         }
+         else {
+            phrase++;
+         }
+         if (phrase < PHRASES_PER_RECORD) {
+            startProgramPhrase(
+                  reinterpret_cast<const uint8_t *>(&current)+phrase*programFlashPhraseSize,
+                  reinterpret_cast<uint8_t *>(head)+phrase*programFlashPhraseSize);
+            return true;
+         }
+         state = State_Idle;
+         queue.deQueue();
+         head++;
+         if (((reinterpret_cast<uint8_t *>(head)-__flash_log_start__)%programFlashSectorSize) == 0) {
+            head--;
+            advanceSector();
+         }
+         break;
+   }
+   if (queue.isEmpty()) {
+      return false;
+   }
+   if (eraseRequired) {
+      startEraseSector(reinterpret_cast<uint8_t *>(head));
+      state = State_Erasing;
+      return true;
+   }
+   current          = queue.peek();
+   current.sequence = nextSequence++;
+   phrase           = 0;
+   startProgramPhrase(reinterpret_cast<const uint8_t *>(&current), reinterpret_cast<uint8_t *>(head));
+   state = State_Programming;
+   return true;
+}
+
+/*
+ * Write all queued records
+ */
+void FlashLog::flush() {
+   while (poll()) {
+      __asm__("nop");
+   }
+}
+
+/*
+ * Write the log to the console (oldest first)
+ */
+void FlashLog::dump() {
+   if (!initialised) {
+      return;
+   }
+   unsigned headSector = (reinterpret_cast<uint8_t *>(head)-__flash_log_start__)/programFlashSectorSize;
+
+   // The sector at head is the oldest if it is waiting to be erased, otherwise the newest
+   unsigned first = eraseRequired?headSector:(headSector+1)%sectorCount();
+
+   console.writeln("Seq\tTime(ms)\tEvent\tAxis\tError\tPosition");
+   for (unsigned index=0; index<sectorCount(); index++) {
+      const Record *records = sectorStart((first+index)%sectorCount());
+      for (unsigned slot=0; slot<RECORDS_PER_SECTOR; slot++) {
+         const Record &record = records[slot];
+         if (record.sequence == BLANK_SEQUENCE) {
+            continue;
+         }
+         const char *name = (record.event < (sizeof(eventNames)/sizeof(eventNames[0])))?eventNames[record.event]:"?";
+         console.write(record.sequence).write('\t').write(record.timestamp).write('\t').
+               write(name).write('\t').write(record.axis).write('\t').
+               write(record.error).write('\t').writeln(record.position);
+      }
+   }
+   console.write("Queued = ").write(queue.size()).
+         write(", Dropped = ").write(droppedCount).
+         write(", Failed = ").writeln(failedCount);
+}
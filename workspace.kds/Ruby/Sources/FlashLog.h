@@ -0,0 +1,168 @@
+/*
+ * FlashLog.h
+ *
+ *  Append-only fault and statistics log in program flash
+ */
+
+#ifndef SOURCES_FLASHLOG_H_
+#define SOURCES_FLASHLOG_H_
+
+#include <stdint.h>
+#include "flash.h"
+#include "StaticContainers.h"
+
+/**
+ * Append-only log of fixed-size binary records in a reserved program flash region
+ *
+ * - The region (flashLog in the memory map) is used as a ring of sectors.
+ *   When the current sector fills, the oldest sector is erased and reused so
+ *   every sector is erased equally often (wear levelling).
+ * - Records carry an incrementing sequence number. On start-up initialise() reads
+ *   the first record of each sector to find the newest sector and then binary
+ *   searches that sector for the first blank slot.
+ * - log() only queues a record and may be called from an ISR.
+ *   poll() starts one flash command at a time and returns without waiting.
+ *   The region is in a different flash block from the code so execution continues
+ *   while the flash is busy.
+ *
+ * Tools/DecodeFlashLog.py decodes a binary dump of the region.
+ */
+class FlashLog : private USBDM::Flash {
+
+public:
+   /** Logged events - values are stored in flash, do not renumber */
+   enum Event : uint8_t {
+      Event_Boot          = 1,  //!< Reset - error = reset source (RCM SRS1:SRS0)
+      Event_Stop          = 2,  //!< stopHere() entered
+      Event_Shutdown      = 3,  //!< shutDown() entered
+      Event_Calibrated    = 4,  //!< Motor homed - position = index offset
+      Event_IndexNotFound = 5,  //!< Encoder index search failed
+      Event_Move          = 6,  //!< Quarter turn complete - error = final error, position = final position
+      Event_OverCurrent   = 7,  //!< Bridge outputs tripped - position = position at trip
+      Event_Jam           = 8,  //!< Move jammed - error = JamDetector::Fault, position = position at jam
+      Event_JamRecovered  = 9,  //!< Jam recovery finished - error = retries used (-1 => failed), position = final position
+   };
+
+   /** Record layout - 16 bytes (2 phrases) */
+   struct Record {
+      uint32_t sequence;   //!< Incrementing record number (0xFFFFFFFF => blank)
+      uint32_t timestamp;  //!< Scheduler time (ms)
+      uint8_t  event;      //!< Event
+      uint8_t  axis;       //!< Axis (0 => none)
+      int16_t  error;      //!< Event specific error value
+      int32_t  position;   //!< Event specific position (encoder ticks)
+   };
+
+   static_assert((sizeof(Record)%programFlashPhraseSize) == 0, "Record must be a whole number of phrases");
+
+   /** Number of records that may be waiting to be written */
+   static constexpr unsigned QUEUE_SIZE = 16;
+
+private:
+   FlashLog() = delete;
+   FlashLog(const FlashLog&) = delete;
+
+   static constexpr uint32_t BLANK_SEQUENCE     = 0xFFFFFFFF;
+   static constexpr unsigned RECORDS_PER_SECTOR = programFlashSectorSize/sizeof(Record);
+   static constexpr unsigned PHRASES_PER_RECORD = sizeof(Record)/programFlashPhraseSize;
+
+   /** Progress of flash operation */
+   enum State : uint8_t {
+      State_Idle,
+      State_Erasing,
+      State_Programming,
+   };
+
+   /** Records waiting to be written */
+   static RingBuffer<Record, QUEUE_SIZE> queue;
+
+   /** Next blank slot */
+   static Record *head;
+
+   /** Sequence number for next record */
+   static uint32_t nextSequence;
+
+   /** Record being written */
+   static Record current;
+
+   /** Phrase of current record being written */
+   static unsigned phrase;
+
+   /** Indicates the sector at head must be erased before use */
+   static bool eraseRequired;
+
+   /** Flash operation in progress */
+   static State state;
+
+   /** Records discarded because the queue was full */
+   static volatile uint32_t droppedCount;
+
+   /** Failed flash commands */
+   static uint32_t failedCount;
+
+   /** Indicates initialise() has been called */
+   static bool initialised;
+
+   /**
+    * Get first record of sector
+    *
+    * @param[in] sector Sector number within log region
+    *
+    * @return Pointer to record
+    */
+   static Record *sectorStart(unsigned sector);
+
+   /**
+    * Get number of sectors in log region
+    */
+   static unsigned sectorCount();
+
+   /**
+    * Move head to the start of the following sector (wrapping)
+    */
+   static void advanceSector();
+
+public:
+   /**
+    * Find the end of the log
+    *
+    * @note Reads at most one record per sector plus a binary search of one sector
+    */
+   static void initialise();
+
+   /**
+    * Queue a record for writing
+    *
+    * @param[in] event    Event
+    * @param[in] axis     Axis (0 => none)
+    * @param[in] error    Event specific error value
+    * @param[in] position Event specific position
+    *
+    * @return false => Queue full, record discarded
+    *
+    * @note May be called from an ISR
+    */
+   static bool log(Event event, uint8_t axis=0, int16_t error=0, int32_t position=0);
+
+   /**
+    * Advance writing of queued records\n
+    * Starts the next flash command when the previous one has completed.
+    *
+    * @return true => Records are waiting to be written
+    */
+   static bool poll();
+
+   /**
+    * Write all queued records
+    *
+    * @note Blocks - for use on shut down
+    */
+   static void flush();
+
+   /**
+    * Write the log to the console (oldest first)
+    */
+   static void dump();
+};
+
+#endif /* SOURCES_FLASHLOG_H_ */
@@ -10,6 +10,7 @@
 
 #include "hardware.h"
 #include "console.h"
+#include "Scheduler.h"
 
 /**
  * @tparam DriverFTM    Describes FTM used to drive solenoid e.g. Ftm0Info
@@ -29,15 +30,34 @@ class Gripper {
 private:
    /** Duty cycle for solenoid on (percent) */
    static constexpr int SOLENOID_PWM_VALUE     = 100;
+
    /** Solenoid movement delay - closing (ms) */
-   static constexpr int SOLENOID_OPERATE_DELAY = 100;
+   static uint32_t operateDelay;
    /** Solenoid movement delay - Opening (ms) */
-   static constexpr int SOLENOID_RELEASE_DELAY = 100;
+   static uint32_t releaseDelay;
 
    using Timer  = USBDM::FtmBase_T<DriverFTM>;
    using Driver = USBDM::FtmChannel_T<DriverFTM,channel>;
 
+   /** Scheduler time (ms) at which the current solenoid movement completes */
+   static uint32_t movementDeadline;
+
 public:
+   /** Default solenoid movement delay - closing (ms) */
+   static constexpr uint32_t DEFAULT_OPERATE_DELAY = 100;
+   /** Default solenoid movement delay - Opening (ms) */
+   static constexpr uint32_t DEFAULT_RELEASE_DELAY = 100;
+
+   /**
+    * Set solenoid movement delays
+    *
+    * @param[in] closeMs Time allowed for solenoid to close (ms)
+    * @param[in] openMs  Time allowed for solenoid to open (ms)
+    */
+   static void setTiming(uint32_t closeMs, uint32_t openMs) {
+      operateDelay = closeMs;
+      releaseDelay = openMs;
+   }
 
    /**
     * Initialise the Gripper
@@ -76,21 +96,51 @@ public:
    }
 
    /**
-    * Close Gripper
-    * Note: incorporates a delay waiting for solenoid to move
-    *
-    * @return true => OK, false => failed to close
+    * Start closing Gripper (non-blocking)
+    * Use isMoving() to determine when the solenoid has moved
     */
-   static bool close() {
+   static void startClose() {
       // Power solenoid
 
 	  //Initial 5V
 	  Driver::configure(USBDM::FtmChMode_Disabled, USBDM::FtmChannelAction_None);//Has to be turned off to allow the 5V pull up to pull to 5V, any less than 5V fails to close claw
 
-	  USBDM::waitMS(SOLENOID_OPERATE_DELAY);//TODO replace with a non blocking steady state functionality
+	  movementDeadline = Scheduler::getTime() + operateDelay;
 
 	  //TODO add PWM
+   }
+
+   /**
+    * Start opening Gripper (non-blocking)
+    * Use isMoving() to determine when the solenoid has moved
+    */
+   static void startOpen() {
+      // Release solenoid
+	  Driver::configure(USBDM::FtmChMode_PwmHighTruePulses, USBDM::FtmChannelAction_None);//TODO remove when the PWM has been implemented replacing turning of the pin
+      Driver::setDutyCycle(0);
+
+      movementDeadline = Scheduler::getTime() + releaseDelay;
+   }
+
+   /**
+    * Indicates if the solenoid is still moving after startOpen()/startClose()
+    *
+    * @return true => still moving
+    */
+   static bool isMoving() {
+      return (int32_t)(Scheduler::getTime() - movementDeadline) < 0;
+   }
+
+   /**
+    * Close Gripper
+    * Note: incorporates a delay waiting for solenoid to move
+    *
+    * @return true => OK, false => failed to close
+    */
+   static bool close() {
+      startClose();
 
+      USBDM::waitMS(operateDelay);
 
       return true;
    }
@@ -102,14 +152,22 @@ public:
     * @return true => OK, false => failed to open
     */
    static bool open() {
-      // Release solenoid
-	  Driver::configure(USBDM::FtmChMode_PwmHighTruePulses, USBDM::FtmChannelAction_None);//TODO remove when the PWM has been implemented replacing turning of the pin
-      Driver::setDutyCycle(0);
+      startOpen();
 
-      USBDM::waitMS(SOLENOID_RELEASE_DELAY);//TODO replace with a non blocking steady state functionality
+      USBDM::waitMS(releaseDelay);
 
       return true;
    }
 
 };
+
+template<class DriverFTM, int channel, class OpenSensor, class CloseSensor>
+uint32_t Gripper<DriverFTM, channel, OpenSensor, CloseSensor>::movementDeadline = 0;
+
+template<class DriverFTM, int channel, class OpenSensor, class CloseSensor>
+uint32_t Gripper<DriverFTM, channel, OpenSensor, CloseSensor>::operateDelay = DEFAULT_OPERATE_DELAY;
+
+template<class DriverFTM, int channel, class OpenSensor, class CloseSensor>
+uint32_t Gripper<DriverFTM, channel, OpenSensor, CloseSensor>::releaseDelay = DEFAULT_RELEASE_DELAY;
+
 #endif /* PROJECT_HEADERS_GRIPPER_H_ */
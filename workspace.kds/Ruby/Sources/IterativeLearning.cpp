@@ -0,0 +1,235 @@
+/*
+ * IterativeLearning.cpp
+ *
+ *  Learned feedforward for repeated quarter-turn moves
+ */
+
+#include <math.h>
+#include "IterativeLearning.h"
+#include "Configuration.h"
+#include "Scheduler.h"
+
+using namespace USBDM;
+
+namespace {
+
+/** Identifies a profile record (upper half of first word) */
+constexpr uint32_t MAGIC = 0x494C0000;   // "IL"
+
+/** Record layout version - increment when ProfileData changes */
+constexpr uint16_t VERSION = 1;
+
+/**
+ * Layout of record in FlexRAM
+ */
+struct StoredProfiles {
+   uint32_t                       id;        // MAGIC | VERSION
+   uint32_t                       crc;       // CRC-32 of profiles
+   IterativeLearning::ProfileData profiles;
+};
+
+using ProfileRecord = NonvolatileRecord<StoredProfiles>;
+
+/** Record in FlexRAM */
+__attribute__ ((section(".flexRAM")))
+ProfileRecord::Storage storage;
+
+/** RAM shadow of record */
+ProfileRecord profileRecord(storage);
+
+}
+
+IterativeLearning::Settings IterativeLearning::settings = {
+      /* enabled    */ true,
+      /* gain       */ 0.002f,
+      /* forgetting */ 0.99f,
+      /* lead       */ 1,
+};
+
+IterativeLearning::ProfileData IterativeLearning::profiles = {};
+bool                           IterativeLearning::valid    = false;
+
+/*
+ * Add the learned correction to the controller output
+ */
+RAMFUNC float IterativeLearning::apply(float output) {
+   unsigned bin = sampleCount/samplesPerBin;
+   if (recording && settings.enabled && (bin < BINS)) {
+      output += profiles.correction[axis][moveType][bin]*(1/SCALE);
+      if (output > outputLimit) {
+         output = outputLimit;
+      }
+      else if (output < -outputLimit) {
+         output = -outputLimit;
+      }
+   }
+   return output;
+}
+
+/*
+ * Record the tracking error
+ */
+RAMFUNC void IterativeLearning::record(float error) {
+   if (!recording) {
+      return;
+   }
+   unsigned bin = sampleCount/samplesPerBin;
+   if (bin < BINS) {
+      errorSum[bin] += error;
+      sampleCount = sampleCount+1;
+   }
+}
+
+/*
+ * Start recording a move and applying its correction
+ */
+void IterativeLearning::startMove(MoveType type) {
+   recording = false;
+   // The control ISR only uses the state while recording
+   __DMB();
+   for (unsigned bin=0; bin<BINS; bin++) {
+      errorSum[bin] = 0;
+   }
+   moveType    = type;
+   sampleCount = 0;
+   startTime   = Scheduler::getTime();
+   __DMB();
+   recording   = true;
+}
+
+/*
+ * Move has settled - update the profile from the recorded errors
+ */
+void IterativeLearning::endMove() {
+   if (!recording) {
+      return;
+   }
+   recording = false;
+   __DMB();
+
+   Statistics &stats   = statistics[moveType];
+   int16_t (&profile)[BINS] = profiles.correction[axis][moveType];
+
+   unsigned bins = sampleCount/samplesPerBin;
+
+   // Mean error in each complete bin
+   float errorSquared = 0;
+   for (unsigned bin=0; bin<bins; bin++) {
+      errorSum[bin] *= (1.0f/samplesPerBin);
+      errorSquared  += errorSum[bin]*errorSum[bin];
+   }
+   stats.executions++;
+   stats.rmsError   = (bins>0)?sqrtf(errorSquared/bins):0;
+   stats.settleTime = Scheduler::getTime()-startTime;
+   if (stats.executions == 1) {
+      stats.firstRmsError  = stats.rmsError;
+      stats.bestSettleTime = stats.settleTime;
+   }
+   else if (stats.settleTime < stats.bestSettleTime) {
+      stats.bestSettleTime = stats.settleTime;
+   }
+   if (!settings.enabled) {
+      return;
+   }
+   // Learning step - in place as each bin only uses errors from later bins
+   for (unsigned bin=0; bin<BINS; bin++) {
+      unsigned source = bin+settings.lead;
+      float    error  = (source<bins)?errorSum[source]:0;
+      errorSum[bin] = profile[bin]*(1/SCALE) + settings.gain*direction*error;
+   }
+   // Low-pass filter and forgetting then store
+   float changeSquared = 0;
+   float previous      = errorSum[0];
+   for (unsigned bin=0; bin<BINS; bin++) {
+      float current = errorSum[bin];
+      float next    = errorSum[(bin<BINS-1)?bin+1:bin];
+      float value   = settings.forgetting*(0.25f*previous+0.5f*current+0.25f*next);
+      previous = current;
+      if (value > outputLimit) {
+         value = outputLimit;
+      }
+      else if (value < -outputLimit) {
+         value = -outputLimit;
+      }
+      float change = value-profile[bin]*(1/SCALE);
+      changeSquared += change*change;
+      profile[bin] = (int16_t)lroundf(value*SCALE);
+   }
+   stats.rmsChange = sqrtf(changeSquared/BINS);
+}
+
+/*
+ * Discard the learned profiles and statistics of this axis
+ */
+void IterativeLearning::reset() {
+   recording = false;
+   for (unsigned type=0; type<MOVE_TYPES; type++) {
+      for (unsigned bin=0; bin<BINS; bin++) {
+         profiles.correction[axis][type][bin] = 0;
+      }
+      statistics[type] = Statistics();
+   }
+}
+
+/*
+ * Write the convergence statistics to the console
+ */
+void IterativeLearning::report() const {
+   static const char *const names[MOVE_TYPES] = {"+90", "-90"};
+   for (unsigned type=0; type<MOVE_TYPES; type++) {
+      const Statistics &stats = statistics[type];
+      console.write("Axis ").write(axis+1).write(" ").write(names[type]).
+            write(": moves = ").write(stats.executions).
+            write(", rms error = ").write(stats.rmsError).
+            write(" (first ").write(stats.firstRmsError).
+            write("), settle = ").write(stats.settleTime).
+            write(" ms (best ").write(stats.bestSettleTime).
+            write(" ms), change = ").writeln(stats.rmsChange);
+   }
+}
+
+/*
+ * Load the profiles from the EEPROM
+ */
+bool IterativeLearning::load() {
+   profiles = ProfileData();
+   valid    = false;
+   if (!Configuration::isEepromAvailable()) {
+      return false;
+   }
+   profileRecord.load();
+
+   const StoredProfiles &stored = profileRecord.get();
+   if (stored.id != (MAGIC|VERSION)) {
+      return false;
+   }
+   if (stored.crc != Configuration::calculateCrc(&stored.profiles, sizeof(ProfileData))) {
+      return false;
+   }
+   profiles = stored.profiles;
+   valid    = true;
+   return true;
+}
+
+/*
+ * Start writing the profiles
+ */
+bool IterativeLearning::save() {
+   if (!Configuration::isEepromAvailable()) {
+      return false;
+   }
+   // Only the changed words are written
+   profileRecord.set(&StoredProfiles::id,       MAGIC|VERSION);
+   profileRecord.set(&StoredProfiles::profiles, profiles);
+   profileRecord.set(&StoredProfiles::crc,      Configuration::calculateCrc(&profiles, sizeof(ProfileData)));
+   profileRecord.commit();
+   valid = true;
+   return true;
+}
+
+/*
+ * Advance a save in progress
+ */
+bool IterativeLearning::poll() {
+   return profileRecord.poll();
+}
@@ -0,0 +1,246 @@
+/*
+ * IterativeLearning.h
+ *
+ *  Learned feedforward for repeated quarter-turn moves
+ */
+
+#ifndef SOURCES_ITERATIVELEARNING_H_
+#define SOURCES_ITERATIVELEARNING_H_
+
+#include <stdint.h>
+#include "RamFunction.h"
+
+/**
+ * Iterative learning control (ILC) layered on a PID position loop
+ *
+ * Every quarter turn of an axis in one direction is the same move, so the tracking
+ * error of one execution predicts the error of the next. A correction profile is held
+ * for each axis and move type (forward/reverse) as a series of bins measured from the
+ * start of the move. The correction for the current bin is added to the PID output and
+ * the error in each bin is recorded. When the move has settled the profile is updated:
+ *
+ *    u[k] = forgetting * smooth(u[k] + gain * direction * e[k+lead])
+ *
+ * where lead compensates the delay between output and measured error and smooth()
+ * is a 3-tap low-pass filter that keeps the learning stable at high frequencies.
+ *
+ * Profiles persist in the EEPROM alongside Configuration.
+ *
+ * Example:
+ * @code
+ *  IterativeLearning ilc1(pidInterval, 0, false, 30);
+ *
+ *  // PID output function
+ *  void motor1Output(float output) {
+ *     Motor1::setSpeed(ilc1.apply(output));
+ *  }
+ *
+ *  // Control ISR after pid1.update()
+ *  ilc1.record(pid1.getError());
+ *
+ *  // Task
+ *  ilc1.startMove(IterativeLearning::Move_Forward);
+ *  pid1.setSetpoint(pid1.getSetpoint()+QUARTERROTATIONTICKS);
+ *  ...
+ *  ilc1.endMove();   // On steady state
+ * @endcode
+ */
+class IterativeLearning {
+
+public:
+   /** Number of axes with profiles */
+   static constexpr unsigned AXES = 2;
+
+   /** Move types learned for each axis */
+   enum MoveType : uint8_t {
+      Move_Forward = 0,  //!< +90 degrees
+      Move_Reverse = 1,  //!< -90 degrees
+   };
+
+   /** Number of MoveType values */
+   static constexpr unsigned MOVE_TYPES = 2;
+
+   /** Number of bins in each profile */
+   static constexpr unsigned BINS = 128;
+
+   /** Time covered by each bin (s) - 512 ms profile at any control rate */
+   static constexpr float BIN_TIME = 4e-3f;
+
+   /** Stored profile units per unit of controller output */
+   static constexpr float SCALE = 1000.0f;
+
+   /** Learned corrections - values are stored in EEPROM */
+   struct ProfileData {
+      int16_t correction[AXES][MOVE_TYPES][BINS];  //!< Correction (output*SCALE)
+   };
+
+   static_assert(sizeof(ProfileData)%sizeof(uint32_t) == 0, "ProfileData must be a multiple of 4 bytes");
+
+   /** Learning parameters (shared by all axes) */
+   struct Settings {
+      bool     enabled;      //!< Apply and update corrections
+      float    gain;         //!< Learning gain (output per tick of error)
+      float    forgetting;   //!< Decay applied on each update (<=1)
+      unsigned lead;         //!< Bins between a correction and the error it affects
+   };
+
+   /** Convergence statistics for a move type */
+   struct Statistics {
+      uint32_t executions;      //!< Moves learned from
+      uint32_t settleTime;      //!< Last time from start to steady state (ms)
+      uint32_t bestSettleTime;  //!< Shortest time from start to steady state (ms)
+      float    rmsError;        //!< Last RMS tracking error over the profile (ticks)
+      float    firstRmsError;   //!< RMS tracking error of the first execution (ticks)
+      float    rmsChange;       //!< RMS change of the profile by the last update (output)
+   };
+
+   /** Learning parameters */
+   static Settings settings;
+
+private:
+   /** Index of axis in ProfileData */
+   const uint8_t axis;
+
+   /** Sign relating controller output to error reduction */
+   const float direction;
+
+   /** Limit on corrected output */
+   const float outputLimit;
+
+   /** Control samples in each bin */
+   const unsigned samplesPerBin;
+
+   /** Recording a move */
+   volatile bool recording = false;
+
+   /** Move being recorded */
+   MoveType moveType = Move_Forward;
+
+   /** Control samples since start of move */
+   volatile unsigned sampleCount = 0;
+
+   /** Scheduler time at start of move */
+   uint32_t startTime = 0;
+
+   /** Error accumulated in each bin of current move */
+   float errorSum[BINS];
+
+   /** Statistics for each move type */
+   Statistics statistics[MOVE_TYPES] = {};
+
+   /** Profiles for all axes */
+   static ProfileData profiles;
+
+   /** Indicates profiles were loaded from a valid record */
+   static bool valid;
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] sampleTime                    Interval between calls to record() (s)
+    * @param[in] axis                          Index of axis in ProfileData (0..AXES-1)
+    * @param[in] encoderAndMotorMatchDirection Defines if the encoder and motor use the same direction of rotation (as PID_T)
+    * @param[in] outputLimit                   Largest magnitude of corrected output
+    */
+   IterativeLearning(float sampleTime, uint8_t axis, bool encoderAndMotorMatchDirection, float outputLimit) :
+      axis(axis), direction(encoderAndMotorMatchDirection?1:-1), outputLimit(outputLimit),
+      samplesPerBin((sampleTime < BIN_TIME)?(unsigned)(BIN_TIME/sampleTime+0.5f):1) {
+   }
+
+   /**
+    * Add the learned correction to the controller output\n
+    * Call from the PID output function.
+    *
+    * @param[in] output Controller output
+    *
+    * @return Corrected output
+    */
+   RAMFUNC float apply(float output);
+
+   /**
+    * Record the tracking error\n
+    * Call from the control ISR after the controller update.
+    *
+    * @param[in] error Controller error (setpoint-input)
+    */
+   RAMFUNC void record(float error);
+
+   /**
+    * Start recording a move and applying its correction
+    *
+    * @param[in] type Move type
+    */
+   void startMove(MoveType type);
+
+   /**
+    * Move has settled - update the profile from the recorded errors
+    */
+   void endMove();
+
+   /**
+    * Stop recording without learning (e.g. move jammed)
+    */
+   void abortMove() {
+      recording = false;
+   }
+
+   /**
+    * Get convergence statistics for a move type
+    *
+    * @param[in] type Move type
+    *
+    * @return Statistics
+    */
+   const Statistics &getStatistics(MoveType type) const {
+      return statistics[type];
+   }
+
+   /**
+    * Discard the learned profiles and statistics of this axis
+    */
+   void reset();
+
+   /**
+    * Write the convergence statistics to the console
+    */
+   void report() const;
+
+   /**
+    * Load the profiles from the EEPROM
+    *
+    * @return true  => Valid record loaded
+    * @return false => Record missing or corrupt - profiles cleared
+    *
+    * @note Configuration::load() must be called first to initialise the EEPROM
+    */
+   static bool load();
+
+   /**
+    * Start writing the profiles\n
+    * Returns immediately - poll() must be called to complete the write.
+    *
+    * @return true  => Write started
+    * @return false => EEPROM not available
+    */
+   static bool save();
+
+   /**
+    * Advance a save in progress\n
+    * Should be called regularly e.g. from a periodic task.
+    *
+    * @return true => Write in progress
+    */
+   static bool poll();
+
+   /**
+    * Indicates the profiles were loaded from a valid record or have been saved
+    *
+    * @return true => valid
+    */
+   static bool isValid() {
+      return valid;
+   }
+};
+
+#endif /* SOURCES_ITERATIVELEARNING_H_ */
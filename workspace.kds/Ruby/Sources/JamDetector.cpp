@@ -0,0 +1,70 @@
+/*
+ * JamDetector.cpp
+ *
+ *  Per-axis stall and jam detection run from the control loop
+ */
+
+#include "JamDetector.h"
+
+/*
+ * Latch fault
+ */
+RAMFUNC void JamDetector::trip(Fault reason, float position, float error) {
+   fault         = reason;
+   faultPosition = position;
+   faultError    = error;
+   armed         = false;
+   faultCounts[reason]++;
+}
+
+/*
+ * Check the axis - call from the control loop after the controller update
+ */
+RAMFUNC bool JamDetector::update(float setpoint, float position, float output) {
+   if (!armed) {
+      return false;
+   }
+   float error = setpoint-position;
+
+   // Encoder steps are coarse at low speed so filter the speed
+   speed += 0.125f*((position-lastPosition)-speed);
+   lastPosition = position;
+
+   float absOutput = (output<0)?-output:output;
+   float absSpeed  = (speed<0)?-speed:speed;
+   float absError  = (error<0)?-error:error;
+
+   if ((absOutput >= saturation) && (absSpeed < stallSpeed)) {
+      if (++stallCount >= stallSamples) {
+         trip(Fault_Stall, position, error);
+         return true;
+      }
+   }
+   else {
+      stallCount = 0;
+   }
+   if (absError > followingError) {
+      if (++followingCount >= followingSamples) {
+         trip(Fault_FollowingError, position, error);
+         return true;
+      }
+   }
+   else {
+      followingCount = 0;
+   }
+   // Backwards before reaching the target (overshoot returns are excluded)
+   if (((error*direction) > 0) && ((speed*direction) < -reversalSpeed)) {
+      if (++reversalCount >= reversalSamples) {
+         trip(Fault_Reversal, position, error);
+         return true;
+      }
+   }
+   else {
+      reversalCount = 0;
+   }
+   if (++moveCount >= moveSamples) {
+      trip(Fault_Timeout, position, error);
+      return true;
+   }
+   return false;
+}
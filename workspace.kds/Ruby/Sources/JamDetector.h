@@ -0,0 +1,272 @@
+/*
+ * JamDetector.h
+ *
+ *  Per-axis stall and jam detection run from the control loop
+ */
+
+#ifndef SOURCES_JAMDETECTOR_H_
+#define SOURCES_JAMDETECTOR_H_
+
+#include <stdint.h>
+#include "derivative.h"
+#include "RamFunction.h"
+
+/**
+ * Monitors a position controller during a move and flags a jam
+ *
+ * update() is called from the control ISR after the PID update. While armed it checks:
+ * - Stall           - Output saturated with (almost) no movement
+ * - Following error - Error larger than any commanded move
+ * - Reversal        - Axis running backwards before reaching the target
+ * - Timeout         - Move not completed in the allowed time
+ *
+ * Each condition must persist for its time limit before it is reported.
+ * The detector disarms itself on the first fault so the fault is reported once.
+ *
+ * Example:
+ * @code
+ *  JamDetector jam1(pidInterval, jamLimits);
+ *
+ *  // Control ISR
+ *  pid1.update();
+ *  if (jam1.update(pid1.getSetpoint(), pid1.getInput(), pid1.getOutput())) {
+ *     pid1.setSetpoint(pid1.getInput());   // Hold position
+ *  }
+ *
+ *  // Start of move
+ *  jam1.arm(pid1.getSetpoint(), pid1.getSetpoint()+QUARTERROTATIONTICKS);
+ * @endcode
+ */
+class JamDetector {
+
+public:
+   /** Detected condition */
+   enum Fault : uint8_t {
+      Fault_None           = 0,  //!< No fault
+      Fault_Stall          = 1,  //!< Saturated output without movement
+      Fault_FollowingError = 2,  //!< Error exceeded limit
+      Fault_Reversal       = 3,  //!< Moving away from the target
+      Fault_Timeout        = 4,  //!< Move took too long
+   };
+
+   /** Number of Fault values */
+   static constexpr unsigned NUM_FAULTS = 5;
+
+   /** Detection thresholds */
+   struct Limits {
+      float    saturation;          //!< |output| at or above this is treated as saturated
+      float    stallSpeed;          //!< Speed below which a saturated axis is stalled (ticks/s)
+      uint32_t stallTime;           //!< Time stalled before fault (ms)
+      float    followingError;      //!< Largest allowed |error| (ticks)
+      uint32_t followingTime;       //!< Time error exceeded before fault (ms)
+      float    reversalSpeed;       //!< Backwards speed treated as a reversal (ticks/s)
+      uint32_t reversalTime;        //!< Time reversed before fault (ms)
+      uint32_t moveTime;            //!< Longest allowed move (ms)
+   };
+
+private:
+   /** Control loop interval (s) */
+   const float sampleTime;
+
+   /** Thresholds converted to samples */
+   float    saturation;
+   float    stallSpeed;
+   uint32_t stallSamples;
+   float    followingError;
+   uint32_t followingSamples;
+   float    reversalSpeed;
+   uint32_t reversalSamples;
+   uint32_t moveSamples;
+
+   /** Monitoring a move */
+   volatile bool armed = false;
+
+   /** Latched fault */
+   volatile Fault fault = Fault_None;
+
+   /** Move direction (+1/-1) */
+   float direction = 1;
+
+   /** Position at start of move */
+   float startPosition = 0;
+
+   /** Position on the previous sample */
+   float lastPosition = 0;
+
+   /** Filtered speed (ticks/sample) */
+   float speed = 0;
+
+   /** Condition persistence counters (samples) */
+   uint32_t stallCount     = 0;
+   uint32_t followingCount = 0;
+   uint32_t reversalCount  = 0;
+   uint32_t moveCount      = 0;
+
+   /** Position and error when the fault was detected */
+   float faultPosition = 0;
+   float faultError    = 0;
+
+   /** Number of each fault detected */
+   uint32_t faultCounts[NUM_FAULTS] = {};
+
+   /**
+    * Convert ms to samples (at least 1)
+    */
+   uint32_t toSamples(uint32_t ms) const {
+      uint32_t samples = (uint32_t)((ms/1000.0f)/sampleTime);
+      return (samples==0)?1:samples;
+   }
+
+   /**
+    * Latch fault
+    */
+   RAMFUNC void trip(Fault reason, float position, float error);
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] sampleTime Interval at which update() is called (s)
+    * @param[in] limits     Detection thresholds
+    */
+   JamDetector(float sampleTime, const Limits &limits) : sampleTime(sampleTime) {
+      setLimits(limits);
+   }
+
+   /**
+    * Change detection thresholds
+    *
+    * @param[in] limits Detection thresholds
+    */
+   void setLimits(const Limits &limits) {
+      saturation       = limits.saturation;
+      stallSpeed       = limits.stallSpeed*sampleTime;
+      stallSamples     = toSamples(limits.stallTime);
+      followingError   = limits.followingError;
+      followingSamples = toSamples(limits.followingTime);
+      reversalSpeed    = limits.reversalSpeed*sampleTime;
+      reversalSamples  = toSamples(limits.reversalTime);
+      moveSamples      = toSamples(limits.moveTime);
+   }
+
+   /**
+    * Start monitoring a move\n
+    * Clears any latched fault.
+    *
+    * @param[in] start  Position at start of move (ticks)
+    * @param[in] target Target position (ticks)
+    */
+   void arm(float start, float target) {
+      armed          = false;
+      // The control ISR only uses the state while armed
+      __DMB();
+      direction      = (target>=start)?1:-1;
+      startPosition  = start;
+      lastPosition   = start;
+      speed          = 0;
+      stallCount     = 0;
+      followingCount = 0;
+      reversalCount  = 0;
+      moveCount      = 0;
+      fault          = Fault_None;
+      __DMB();
+      armed          = true;
+   }
+
+   /**
+    * Stop monitoring (move complete)
+    */
+   void disarm() {
+      armed = false;
+   }
+
+   /**
+    * Check the axis - call from the control loop after the controller update
+    *
+    * @param[in] setpoint Controller setpoint
+    * @param[in] position Controller input
+    * @param[in] output   Controller output
+    *
+    * @return true => A fault has just been detected
+    */
+   RAMFUNC bool update(float setpoint, float position, float output);
+
+   /**
+    * Get latched fault
+    *
+    * @return Fault_None if no fault detected since arm()
+    */
+   Fault getFault() const {
+      return fault;
+   }
+
+   /**
+    * Clear latched fault
+    */
+   void clearFault() {
+      fault = Fault_None;
+   }
+
+   /**
+    * Indicates a move is being monitored
+    *
+    * @return true => armed
+    */
+   bool isArmed() const {
+      return armed;
+   }
+
+   /**
+    * Get position at start of the monitored move
+    *
+    * @return Position (ticks)
+    */
+   float getStartPosition() const {
+      return startPosition;
+   }
+
+   /**
+    * Get position when the fault was detected
+    *
+    * @return Position (ticks)
+    */
+   float getFaultPosition() const {
+      return faultPosition;
+   }
+
+   /**
+    * Get error when the fault was detected
+    *
+    * @return Error (ticks)
+    */
+   float getFaultError() const {
+      return faultError;
+   }
+
+   /**
+    * Get number of times a fault has been detected
+    *
+    * @param[in] reason Fault to count
+    *
+    * @return Count since reset
+    */
+   uint32_t getFaultCount(Fault reason) const {
+      return faultCounts[reason];
+   }
+
+   /**
+    * Get description of fault
+    *
+    * @param[in] reason Fault
+    *
+    * @return Pointer to static string
+    */
+   static const char *getFaultName(Fault reason) {
+      static const char *const names[NUM_FAULTS] = {
+            "none", "stall", "following error", "reversal", "timeout",
+      };
+      return (reason<NUM_FAULTS)?names[reason]:"?";
+   }
+};
+
+#endif /* SOURCES_JAMDETECTOR_H_ */
@@ -0,0 +1,95 @@
+/*
+ * MemoryMonitor.cpp
+ *
+ *  Stack and RAM high-water marks
+ */
+
+#include "MemoryMonitor.h"
+#include "hardware.h"
+
+using namespace USBDM;
+
+extern "C" {
+/* Defined by the linker */
+extern uint32_t __data_start__[];
+extern uint32_t __bss_end__[];
+extern uint32_t __HeapBase[];
+extern uint32_t __HeapLimit[];
+extern uint32_t __StackLimit[];
+extern uint32_t __StackTop[];
+
+/* Heap high-water mark from newlib_stubs.c */
+uint32_t heap_getHighWaterMark(void);
+}
+
+volatile uint32_t MemoryMonitor::isrMinEntryStackPointer[Isr_Count] = {
+      UINT32_MAX, UINT32_MAX, UINT32_MAX,
+};
+
+namespace {
+
+/** Names for report - order must match IsrId */
+const char *const isrNames[MemoryMonitor::Isr_Count] = {
+      "controller",
+      "tick",
+      "consoleRx",
+};
+
+}
+
+/*
+ * Get stack high-water mark
+ */
+uint32_t MemoryMonitor::getStackUsed() {
+   // Stack grows down so scan up from the limit for the first overwritten word
+   const uint32_t *p = __StackLimit;
+   while ((p < __StackTop) && (*p == STACK_PAINT_VALUE)) {
+      p++;
+   }
+   return (uint32_t)((uintptr_t)__StackTop - (uintptr_t)p);
+}
+
+/*
+ * Get stack size
+ */
+uint32_t MemoryMonitor::getStackSize() {
+   return (uint32_t)((uintptr_t)__StackTop - (uintptr_t)__StackLimit);
+}
+
+/*
+ * Get heap high-water mark
+ */
+uint32_t MemoryMonitor::getHeapUsed() {
+   return heap_getHighWaterMark();
+}
+
+/*
+ * Get heap size
+ */
+uint32_t MemoryMonitor::getHeapSize() {
+   return (uint32_t)((uintptr_t)__HeapLimit - (uintptr_t)__HeapBase);
+}
+
+/*
+ * Get maximum stack depth on entry to an interrupt handler
+ */
+uint32_t MemoryMonitor::getIsrEntryDepth(IsrId isr) {
+   uint32_t sp = isrMinEntryStackPointer[isr];
+   if (sp == UINT32_MAX) {
+      return 0;
+   }
+   return (uint32_t)(uintptr_t)__StackTop - sp;
+}
+
+/*
+ * Write memory usage to the console
+ */
+void MemoryMonitor::report() {
+   console.write("Data+BSS = ").write((uint32_t)((uintptr_t)__bss_end__ - (uintptr_t)__data_start__)).writeln(" bytes");
+   console.write("Heap     = ").write(getHeapUsed()).write(" / ").write(getHeapSize()).writeln(" bytes");
+   console.write("Stack    = ").write(getStackUsed()).write(" / ").write(getStackSize()).writeln(" bytes");
+   console.writeln("ISR\tEntry depth(bytes)");
+   for (int isr=0; isr<Isr_Count; isr++) {
+      console.write(isrNames[isr]).write('\t').writeln(getIsrEntryDepth((IsrId)isr));
+   }
+}
@@ -0,0 +1,109 @@
+/*
+ * MemoryMonitor.h
+ *
+ *  Stack and RAM high-water marks
+ */
+
+#ifndef SOURCES_MEMORYMONITOR_H_
+#define SOURCES_MEMORYMONITOR_H_
+
+#include <stdint.h>
+#include "derivative.h"
+#include "RamFunction.h"
+
+/**
+ * Reports RAM usage
+ *
+ * - Stack : The startup code paints the stack with STACK_PAINT_VALUE.
+ *           The high-water mark is found by scanning for the deepest overwritten word.
+ * - Heap  : High-water mark tracked by _sbrk().
+ * - ISRs  : Stack depth is sampled on entry to instrumented interrupt handlers.
+ *           This is the stack already in use when the handler starts (main() and any
+ *           interrupts it pre-empted), not the stack the handler itself uses - that is
+ *           only included in the overall stack high-water mark.
+ *
+ * All interrupt handlers and main() share the main stack (MSP).
+ */
+class MemoryMonitor {
+
+public:
+   /** Value written to unused stack by startup code (startup_ARMLtdGCC.S) */
+   static constexpr uint32_t STACK_PAINT_VALUE = 0xC5C5C5C5;
+
+   /** Instrumented interrupt handlers */
+   enum IsrId {
+      Isr_Controller,   //!< PID control loop (PIT channel 0)
+      Isr_SchedulerTick,//!< Scheduler tick (PIT channel 1)
+      Isr_ConsoleRx,    //!< Console receive (UART0)
+      Isr_Count,
+   };
+
+private:
+   MemoryMonitor() = delete;
+   MemoryMonitor(const MemoryMonitor&) = delete;
+
+   /** Lowest MSP seen on entry to each handler */
+   static volatile uint32_t isrMinEntryStackPointer[Isr_Count];
+
+public:
+   /**
+    * Record stack depth on entry to an interrupt handler\n
+    * The stack used by the handler itself is not included.
+    *
+    * @param[in] isr Handler being entered
+    *
+    * @note Call at the start of the handler or call-back
+    */
+   RAMFUNC_INLINE static void sampleIsrEntry(IsrId isr) {
+      uint32_t sp = __get_MSP();
+      if (sp < isrMinEntryStackPointer[isr]) {
+         isrMinEntryStackPointer[isr] = sp;
+      }
+   }
+
+   /**
+    * Get stack high-water mark
+    *
+    * @return Maximum bytes of stack used since reset
+    */
+   static uint32_t getStackUsed();
+
+   /**
+    * Get stack size
+    *
+    * @return Size of stack region in bytes
+    */
+   static uint32_t getStackSize();
+
+   /**
+    * Get heap high-water mark
+    *
+    * @return Bytes allocated from the heap since reset
+    */
+   static uint32_t getHeapUsed();
+
+   /**
+    * Get heap size
+    *
+    * @return Space available for heap in bytes
+    */
+   static uint32_t getHeapSize();
+
+   /**
+    * Get maximum stack depth on entry to an interrupt handler
+    *
+    * @param[in] isr Handler
+    *
+    * @return Stack depth in bytes at entry (0 if handler has not run)
+    */
+   static uint32_t getIsrEntryDepth(IsrId isr);
+
+   /**
+    * Write memory usage to the console
+    *
+    * @note Safe to call from a fault handler
+    */
+   static void report();
+};
+
+#endif /* SOURCES_MEMORYMONITOR_H_ */
@@ -10,6 +10,8 @@
 
 #include "hardware.h"
 #include <string.h>
+#include "RamFunction.h"
+#include "Priorities.h"
 
 /**
  *
@@ -36,10 +38,26 @@ private:
    using Motor_A = USBDM::FtmChannel_T<DriverFTM, ChannelA>;
    using Motor_B = USBDM::FtmChannel_T<DriverFTM, ChannelB>;
 
+   //! Speed to use when searching for the index
+   static constexpr int INDEX_SEARCH_SPEED = 20;
+   //! Longest time allowed to search for the index (ms)
+   static constexpr int MAX_INDEX_SEARCH_WAIT = 2000;
+   //! Encoder counts in one revolution
+   static constexpr int TICKS_PER_REVOLUTION = 8192;
+
+   //! Raw encoder count at the home position (reported as position 0)
+   static int16_t homePosition;
+
+   //! Raw encoder count at start of index search
+   static int16_t searchStart;
+
 public:
    using Encoder    = USBDM::QuadEncoder_T<EncoderFTM>;
    using EncoderFtm = USBDM::FtmBase_T<EncoderFTM>;
 
+   //! FTM fault input connected to the bridge driver error flag (see OverCurrentTrip_T)
+   static constexpr uint8_t FAULT_INPUT = FaultInputNum;
+
 public:
 
    /**
@@ -68,16 +86,10 @@ public:
       Encoder::resetPosition();
       Encoder::setTimerOverflowCallback(toiHandler);
       Encoder::enableTimerOverflowInterrupts();
+      Encoder::enableNvicInterrupts(true, IrqPriority_Encoder);
    }
 
-   // Handler for encoder overflow
-   static void faultHandler() {
-      // Fault
-      setSpeed(0);
-      USBDM::setAndCheckErrorCode(USBDM::E_ERROR);
-   }
-
-   // Handler for encoder overflow
+   // Handler for encoder overflow (runs from flash with the USBDM FTM dispatcher)
    static void toiHandler() {
       if (EncoderFtm::tmr->QDCTRL&FTM_QDCTRL_TOFDIR_MASK) {
          // Overflowed top
@@ -124,26 +136,89 @@ public:
 //         fn();
 //      }
 
-      // Enable fault inputs after 1ms so bridges have reset
-      USBDM::waitMS(1);
-      // Active-low fault inputs with filtering
-//      Ftm::template enableFault<FaultInputNum>(false, true);
-      Timer::setFaultCallback(faultHandler);
-      Timer::enableFaultInterrupt();
-
       bool calibrated = USBDM::waitMS(MAX_CALIBRATE_WAIT, fn);
       Encoder::resetPosition();//mark index
+      homePosition = 0;
       setSpeed(0);
 
       return calibrated;
    }
 
+   /*
+    * Used by findIndex() - stops on index or after one revolution
+    */
+   static bool indexSearchDone() {
+      int16_t travel = (int16_t)(Encoder::getPosition() - searchStart);
+      return EncoderIndex::read() || (travel >= TICKS_PER_REVOLUTION) || (travel <= -TICKS_PER_REVOLUTION);
+   }
+
+   /**
+    * Turn slowly until the encoder index is found (at most one revolution)
+    *
+    * @param[out] indexCount Raw encoder count at which the index was detected
+    *
+    * @return true => OK, false => Failed to find index location
+    */
+   static bool findIndex(int16_t &indexCount) {
+      searchStart = Encoder::getPosition();
+      setSpeed(INDEX_SEARCH_SPEED);
+
+      USBDM::waitMS(MAX_INDEX_SEARCH_WAIT, indexSearchDone);
+      indexCount = Encoder::getPosition();
+      bool found = EncoderIndex::read();
+      setSpeed(0);
+
+      return found;
+   }
+
+   /**
+    * Make the current position the home position (position 0)
+    */
+   static void setHome() {
+      homePosition = Encoder::getPosition();
+   }
+
+   /**
+    * Re-home against the encoder index using a stored offset
+    *
+    * @param[in] indexOffset Position of the index relative to home (encoder ticks)
+    *
+    * @return true => OK, false => Failed to find index location
+    *
+    * @note The motor is left near the index - the position controller returns it to home (0)
+    */
+   static bool rehome(int indexOffset) {
+      int16_t indexCount;
+      if (!findIndex(indexCount)) {
+         return false;
+      }
+      homePosition = (int16_t)(indexCount - indexOffset);
+      return true;
+   }
+
+   /**
+    * Measure position of the index relative to the current home position\n
+    * The result may be stored and used with rehome() after a reset.
+    *
+    * @param[out] indexOffset Position of the index relative to home (encoder ticks)
+    *
+    * @return true => OK, false => Failed to find index location
+    */
+   static bool measureIndexOffset(int &indexOffset) {
+      int16_t indexCount;
+      if (!findIndex(indexCount)) {
+         return false;
+      }
+      indexOffset = (int16_t)(indexCount - homePosition);
+      return true;
+   }
+
    /*
     * Set motor speed
     *
     * speed Speed to set motor -100.0...100.0
     */
-   static void setSpeed(float speed) {
+   RAMFUNC_INLINE static void setSpeed(float speed) {
       if (speed<-100.0) {
          speed = -100.0;
       }
@@ -173,7 +248,18 @@ public:
     * @return Position from shaft encoder
     */
    static int getPosition() {
-      return Encoder::getPosition();
+      return (int16_t)(Encoder::getPosition() - homePosition);
+   }
+
+   /**
+    * Convert an encoder count read earlier (e.g. by ControlGroup_T) to a position
+    *
+    * @param[in] count Raw encoder count (as Encoder::getPosition())
+    *
+    * @return Position relative to home
+    */
+   RAMFUNC_INLINE static int16_t positionFromCount(int16_t count) {
+      return (int16_t)(count - homePosition);
    }
 
    /*
@@ -181,10 +267,16 @@ public:
     *
     * @return Position from shaft encoder
     */
-   static float getPositionAsFloat() {
-      return (float)Encoder::getPosition();
+   RAMFUNC_INLINE static float getPositionAsFloat() {
+      return (float)(int16_t)(Encoder::getPosition() - homePosition);
    }
 
 };
 
+template <class DriverFTM, uint8_t ChannelA, uint8_t ChannelB, int FaultInputNum, class EncoderFTM, class EncoderIndex>
+int16_t Motor<DriverFTM, ChannelA, ChannelB, FaultInputNum, EncoderFTM, EncoderIndex>::homePosition = 0;
+
+template <class DriverFTM, uint8_t ChannelA, uint8_t ChannelB, int FaultInputNum, class EncoderFTM, class EncoderIndex>
+int16_t Motor<DriverFTM, ChannelA, ChannelB, FaultInputNum, EncoderFTM, EncoderIndex>::searchStart = 0;
+
 #endif /* PROJECT_HEADERS_MOTOR_H_ */
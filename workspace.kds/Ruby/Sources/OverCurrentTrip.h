@@ -0,0 +1,376 @@
+/*
+ * OverCurrentTrip.h
+ *
+ *  Hardware PWM shutdown on bridge fault or over-current
+ */
+
+#ifndef SOURCES_OVERCURRENTTRIP_H_
+#define SOURCES_OVERCURRENTTRIP_H_
+
+#include "hardware.h"
+#include "cmp.h"
+#include "Priorities.h"
+#include "Scheduler.h"
+
+/**
+ * Comparator that may be routed to FTM0 fault input n (SIM_SOPT4.FTM0FLTn)
+ */
+template<uint8_t inputNum> struct TripComparator;
+template<> struct TripComparator<0> { using Cmp = USBDM::Cmp0; };
+template<> struct TripComparator<1> { using Cmp = USBDM::Cmp1; };
+template<> struct TripComparator<2> { using Cmp = USBDM::Cmp2; };
+
+/**
+ * Over-current protection using the FTM fault inputs
+ *
+ * Each fault input is driven either by a pin (e.g. bridge driver error flag) or by an
+ * analogue comparator comparing a current-sense voltage against its 6-bit DAC.
+ * A fault forces all protected PWM channel pairs to their safe (inactive) state in
+ * hardware within a few bus clocks - software is not involved.
+ *
+ * The fault interrupt counts the trip against the axis owning the input and schedules
+ * a re-arm. poll() re-enables the outputs once the fault has cleared and the back-off
+ * delay has elapsed. The delay doubles on each consecutive trip and an axis that keeps
+ * tripping is locked out until reset().
+ *
+ * @note All channels of the FTM share the fault block so a trip on one axis also
+ *       stops the other axes on the same FTM. Counters identify the axis that tripped.
+ *
+ * @tparam DriverFTM Info for FTM driving the bridges
+ */
+template<class DriverFTM>
+class OverCurrentTrip_T {
+
+public:
+   /**
+    * Type for call-back executed from the fault interrupt
+    *
+    * @param[in] axis Axis that tripped
+    */
+   typedef void (*TripCallback)(unsigned axis);
+
+   /** Number of FTM fault inputs */
+   static constexpr unsigned NUM_INPUTS = 4;
+
+   /**
+    * Delay before first re-arm attempt (ms)\n
+    * Doubles with each consecutive trip - 10, 20, 40, 80 then 160 ms before the lock-out.
+    */
+   static constexpr uint32_t REARM_DELAY = 10;
+
+   /** Consecutive trips before the input is locked out (no further re-arm) */
+   static constexpr unsigned MAX_CONSECUTIVE_TRIPS = 6;
+
+   /** Time without a trip before the consecutive count is cleared (ms) */
+   static constexpr uint32_t STABLE_TIME = 2000;
+
+   /** Trip counters for an input */
+   struct Statistics {
+      uint32_t trips;         //!< Total trips
+      uint32_t rearms;        //!< Successful re-arms
+      uint32_t lastTrip;      //!< Time of last trip (ms)
+      uint8_t  consecutive;   //!< Trips without a stable period between
+      uint8_t  axis;          //!< Axis owning the input (0 => unused)
+      bool     lockedOut;     //!< Too many consecutive trips - reset() required
+   };
+
+private:
+   OverCurrentTrip_T() = delete;
+   OverCurrentTrip_T(const OverCurrentTrip_T&) = delete;
+
+   using Timer = USBDM::FtmBase_T<DriverFTM>;
+
+   /** Counters indexed by fault input */
+   static Statistics statistics[NUM_INPUTS];
+
+   /** Inputs that have tripped and are waiting to be re-armed (FMS.FAULTFn bits) */
+   static volatile uint8_t pendingInputs;
+
+   /** Time at which re-arm may be attempted (ms) */
+   static volatile uint32_t rearmTime;
+
+   /** Executed from the fault interrupt */
+   static TripCallback tripCallback;
+
+   /**
+    * Re-arm delay for a number of consecutive trips
+    *
+    * @param[in] consecutive Number of consecutive trips (>=1)
+    *
+    * @return Delay in ms
+    */
+   static uint32_t backoff(unsigned consecutive) {
+      return REARM_DELAY<<(consecutive-1);
+   }
+
+   /**
+    * FTM fault interrupt\n
+    * The outputs are already disabled by hardware.
+    * The fault flags are left set so the outputs stay off until poll() re-arms them.
+    * Runs from flash with the USBDM FTM dispatcher - it is only reached on a trip.
+    */
+   static void faultHandler() {
+      // Outputs remain disabled while FAULTF is set - stop interrupts until re-armed
+      Timer::enableFaultInterrupt(false);
+
+      uint32_t now    = Scheduler::getTime();
+      uint8_t  inputs = Timer::tmr->FMS&(FTM_FMS_FAULTF0_MASK|FTM_FMS_FAULTF1_MASK|FTM_FMS_FAULTF2_MASK|FTM_FMS_FAULTF3_MASK);
+      uint32_t delay  = REARM_DELAY;
+
+      for (unsigned input=0; input<NUM_INPUTS; input++) {
+         if ((inputs & (1<<input)) == 0) {
+            continue;
+         }
+         Statistics &stats = statistics[input];
+         if ((now-stats.lastTrip) > STABLE_TIME) {
+            stats.consecutive = 0;
+         }
+         stats.trips++;
+         stats.lastTrip = now;
+         if (++stats.consecutive >= MAX_CONSECUTIVE_TRIPS) {
+            stats.lockedOut = true;
+         }
+         uint32_t inputDelay = backoff(stats.consecutive);
+         if (inputDelay > delay) {
+            delay = inputDelay;
+         }
+         if (tripCallback != nullptr) {
+            tripCallback(stats.axis);
+         }
+      }
+      pendingInputs = pendingInputs|inputs;
+      rearmTime     = now+delay;
+   }
+
+   /**
+    * Configure fault input polarity and filter without changing the pin mapping
+    *
+    * @param[in] inputNum     Fault input (0..3)
+    * @param[in] polarity     Polarity of fault input
+    * @param[in] filterEnable Whether to enable the FTM input filter
+    */
+   static void configureFaultInput(unsigned inputNum, USBDM::Polarity polarity, bool filterEnable) {
+      if (polarity) {
+         Timer::tmr->FLTPOL &= ~(1<<inputNum);
+      }
+      else {
+         Timer::tmr->FLTPOL |= (1<<inputNum);
+      }
+      if (filterEnable) {
+         Timer::tmr->FLTCTRL |= (1<<(inputNum+FTM_FLTCTRL_FFLTR0EN_SHIFT));
+      }
+      else {
+         Timer::tmr->FLTCTRL &= ~(1<<(inputNum+FTM_FLTCTRL_FFLTR0EN_SHIFT));
+      }
+      Timer::tmr->FLTCTRL |= (1<<inputNum);
+   }
+
+public:
+   /**
+    * Use a pin (e.g. bridge driver error flag) as a fault input for an axis
+    *
+    * @tparam inputNum FTM fault input (0..3)
+    *
+    * @param[in] axis         Axis protected (1..)
+    * @param[in] polarity     Polarity of fault signal
+    * @param[in] filterEnable Whether to enable the FTM input filter
+    */
+   template<uint8_t inputNum>
+   static void addPinInput(unsigned axis, USBDM::Polarity polarity=USBDM::ActiveLow, bool filterEnable=true) {
+      static_assert(inputNum<NUM_INPUTS, "Illegal fault input");
+
+      if (inputNum < 3) {
+         // Select FTM0_FLTn pin rather than comparator
+         SIM->SOPT4 &= ~(SIM_SOPT4_FTM0FLT0_MASK<<inputNum);
+      }
+      Timer::template enableFault<inputNum>(polarity, filterEnable);
+      statistics[inputNum].axis = axis;
+   }
+
+   /**
+    * Use an analogue comparator on a current-sense voltage as a fault input for an axis\n
+    * Comparator n drives fault input n. The comparator output goes high when the
+    * sense voltage exceeds the DAC level.
+    *
+    * @tparam inputNum FTM fault input and comparator number (0..2)
+    *
+    * @param[in] axis       Axis protected (1..)
+    * @param[in] senseInput Comparator input connected to the current-sense signal
+    * @param[in] dacLevel   Trip level (0..63) see dacLevel()
+    */
+   template<uint8_t inputNum>
+   static void addComparatorInput(unsigned axis, USBDM::Cmp0Input senseInput, uint8_t dacLevel) {
+      using namespace USBDM;
+      using Cmp = typename TripComparator<inputNum>::Cmp;
+
+      Cmp::configure(CmpPower_HighSpeed, CmpHysteresis_1);
+      Cmp::enableNvicInterrupts(false);
+      Cmp::configureDac(dacLevel, CmpDacSource_Vdd);
+      Cmp::selectInputs(senseInput, Cmp0Input_DacRef);
+      // A short filter rejects switching spikes at the PWM edges
+      Cmp::setInputFiltered(CmpFilterSamples_3, CmpFilterClockSource_internal, 1);
+
+      // Select comparator rather than FTM0_FLTn pin
+      SIM->SOPT4 |= (SIM_SOPT4_FTM0FLT0_MASK<<inputNum);
+      configureFaultInput(inputNum, ActiveHigh, false);
+      Timer::tmr->MODE |= FTM_MODE_FAULTM(2);
+      statistics[inputNum].axis = axis;
+   }
+
+   /**
+    * Calculate comparator DAC level for a trip current
+    *
+    * @param[in] current   Trip current (A)
+    * @param[in] senseGain Current-sense output (V/A)
+    * @param[in] reference DAC reference voltage (V)
+    *
+    * @return DAC level (0..63)
+    */
+   static constexpr uint8_t dacLevel(float current, float senseGain, float reference=3.3) {
+      return ((current*senseGain*64/reference) >= 64)?63:
+            ((current*senseGain*64/reference) < 1)?0:
+                  (uint8_t)(current*senseGain*64/reference)-1;
+   }
+
+   /**
+    * Enable hardware shutdown of channel pairs\n
+    * The FTM interrupt is enabled at IrqPriority_Control (it also carries the control ISR
+    * when that runs from the PWM overflow).
+    *
+    * @param[in] channelPairs Bit mask of channel pairs to protect (bit n => channels 2n, 2n+1)
+    * @param[in] callback     Executed from the fault interrupt on each trip (may be nullptr)
+    */
+   static void enable(uint8_t channelPairs, TripCallback callback=nullptr) {
+      static constexpr uint32_t faultEnableMasks[] = {
+            FTM_COMBINE_FAULTEN0_MASK, FTM_COMBINE_FAULTEN1_MASK, FTM_COMBINE_FAULTEN2_MASK, FTM_COMBINE_FAULTEN3_MASK,
+      };
+      uint32_t combine = Timer::tmr->COMBINE;
+      for (unsigned pair=0; pair<4; pair++) {
+         if (channelPairs & (1<<pair)) {
+            combine |= faultEnableMasks[pair];
+         }
+      }
+      Timer::tmr->COMBINE = combine;
+
+      tripCallback  = callback;
+      pendingInputs = 0;
+
+      // Clear stale flags (inputs may have been active while bridges reset)
+      (void)Timer::tmr->FMS;
+      Timer::tmr->FMS = 0;
+
+      Timer::setFaultCallback(faultHandler);
+      // The FTM handler passes on the channel flags set by every PWM match - they are not used
+      Timer::setChannelCallback(Timer::ignoreChannelCallback);
+      Timer::enableFaultInterrupt();
+      Timer::enableNvicInterrupts(true, IrqPriority_Control);
+   }
+
+   /**
+    * Re-arm outputs after a trip\n
+    * Should be called regularly from a task
+    *
+    * @return true => Outputs are disabled by a trip
+    */
+   static bool poll() {
+      if (pendingInputs == 0) {
+         return false;
+      }
+      for (unsigned input=0; input<NUM_INPUTS; input++) {
+         if ((pendingInputs & (1<<input)) && statistics[input].lockedOut) {
+            return true;
+         }
+      }
+      if ((int32_t)(Scheduler::getTime()-rearmTime) < 0) {
+         return true;
+      }
+      // Flags only clear once the fault inputs are inactive
+      (void)Timer::tmr->FMS;
+      Timer::tmr->FMS = 0;
+      if (Timer::tmr->FMS & FTM_FMS_FAULTF_MASK) {
+         rearmTime = Scheduler::getTime()+REARM_DELAY;
+         return true;
+      }
+      CriticalSection cs;
+      for (unsigned input=0; input<NUM_INPUTS; input++) {
+         if (pendingInputs & (1<<input)) {
+            statistics[input].rearms++;
+         }
+      }
+      // Outputs resume at the start of the next PWM period
+      pendingInputs = 0;
+      Timer::enableFaultInterrupt();
+      return false;
+   }
+
+   /**
+    * Clear lock-out and re-arm immediately (if the fault has cleared)
+    */
+   static void reset() {
+      for (unsigned input=0; input<NUM_INPUTS; input++) {
+         statistics[input].lockedOut   = false;
+         statistics[input].consecutive = 0;
+      }
+      rearmTime = Scheduler::getTime();
+      poll();
+   }
+
+   /**
+    * Indicates outputs are disabled by a trip
+    *
+    * @return true => tripped
+    */
+   static bool isTripped() {
+      return pendingInputs != 0;
+   }
+
+   /**
+    * Get number of trips for an axis
+    *
+    * @param[in] axis Axis (1..)
+    *
+    * @return Total trips on all inputs owned by the axis
+    */
+   static uint32_t getTripCount(unsigned axis) {
+      uint32_t count = 0;
+      for (unsigned input=0; input<NUM_INPUTS; input++) {
+         if (statistics[input].axis == axis) {
+            count += statistics[input].trips;
+         }
+      }
+      return count;
+   }
+
+   /**
+    * Write trip counters to the console
+    */
+   static void report() {
+      using namespace USBDM;
+      for (unsigned input=0; input<NUM_INPUTS; input++) {
+         const Statistics &stats = statistics[input];
+         if (stats.axis == 0) {
+            continue;
+         }
+         console.write("Axis ").write(stats.axis).write(" (fault ").write(input).
+               write("): trips = ").write(stats.trips).
+               write(", re-arms = ").write(stats.rearms).
+               write(", consecutive = ").write(stats.consecutive).
+               writeln(stats.lockedOut?" LOCKED OUT":"");
+      }
+      console.writeln(isTripped()?"Outputs disabled":"Outputs enabled");
+   }
+};
+
+template<class DriverFTM>
+typename OverCurrentTrip_T<DriverFTM>::Statistics OverCurrentTrip_T<DriverFTM>::statistics[OverCurrentTrip_T<DriverFTM>::NUM_INPUTS];
+
+template<class DriverFTM>
+volatile uint8_t OverCurrentTrip_T<DriverFTM>::pendingInputs = 0;
+
+template<class DriverFTM>
+volatile uint32_t OverCurrentTrip_T<DriverFTM>::rearmTime = 0;
+
+template<class DriverFTM>
+typename OverCurrentTrip_T<DriverFTM>::TripCallback OverCurrentTrip_T<DriverFTM>::tripCallback = nullptr;
+
+#endif /* SOURCES_OVERCURRENTTRIP_H_ */
@@ -0,0 +1,85 @@
+/*
+ * Priorities.h
+ *
+ *  Interrupt priority map and critical sections that only mask the interrupts they must
+ */
+
+#ifndef SOURCES_PRIORITIES_H_
+#define SOURCES_PRIORITIES_H_
+
+#include "hardware.h"
+
+/**
+ * Interrupt priorities (lower value is higher priority)
+ *
+ * Every interrupt the firmware enables uses its level from this map so an ISR is only
+ * delayed by interrupts more urgent than itself:
+ *  - Control - controller() from the PIT (or the PWM overflow when CONTROL_PWM_DIVISOR > 0)
+ *              and the bridge fault - FTM0 is enabled by OverCurrentTrip_T::enable()
+ *  - Encoder - quadrature counter overflow
+ *  - Comms   - console reception
+ *  - Tick    - scheduler time base
+ *
+ * Logging (FlashLog, telemetry) and console output are done by tasks in thread mode below
+ * every interrupt - no ISR writes to the console.
+ */
+enum IrqPriority : uint32_t {
+   IrqPriority_Control = NvicPriority_High,
+   IrqPriority_Encoder = NvicPriority_MidHigh,
+   IrqPriority_Comms   = NvicPriority_Normal,
+   IrqPriority_Tick    = NvicPriority_Low,
+};
+
+/**
+ * Critical section that masks interrupts at a priority and below using BASEPRI
+ *
+ * Data shared with an ISR is protected at the priority of that ISR so more urgent
+ * interrupts keep running. The PRIMASK CriticalSection is only needed for data shared
+ * with an interrupt above IrqPriority_Control.
+ * BASEPRI is only ever raised so a section may be nested in one at a higher priority.
+ *
+ * Example:
+ * @code
+ *  {
+ *     // Scheduler state is also changed by the console ISR - the control ISR may still run
+ *     CriticalSection_T<IrqPriority_Comms> cs;
+ *     ...
+ *  }
+ * @endcode
+ *
+ * @tparam priority Highest priority masked (as IrqPriority)
+ */
+template<uint32_t priority>
+class CriticalSection_T {
+
+   static_assert((priority > 0) && (priority < (1U<<__NVIC_PRIO_BITS)), "BASEPRI can't mask this priority");
+
+private:
+   CriticalSection_T(const CriticalSection_T&) = delete;
+
+   /** BASEPRI on entry */
+   const uint32_t basepri;
+
+public:
+   /**
+    * Constructor - Enter critical section
+    */
+   CriticalSection_T() : basepri(__get_BASEPRI()) {
+      __set_BASEPRI_MAX(priority<<(8-__NVIC_PRIO_BITS));
+   }
+
+   /**
+    * Destructor - Exit critical section
+    */
+   ~CriticalSection_T() {
+      __set_BASEPRI(basepri);
+   }
+};
+
+/** Protects data shared with the control ISR */
+using ControlCriticalSection = CriticalSection_T<IrqPriority_Control>;
+
+/** Protects data shared with the console ISR - the control ISR still runs */
+using CommsCriticalSection = CriticalSection_T<IrqPriority_Comms>;
+
+#endif /* SOURCES_PRIORITIES_H_ */
@@ -0,0 +1,71 @@
+/*
+ * RamFunction.h
+ *
+ *  Execute-from-RAM placement for time critical code
+ */
+
+#ifndef SOURCES_RAMFUNCTION_H_
+#define SOURCES_RAMFUNCTION_H_
+
+/**
+ * Set to 0 to leave RAMFUNC code in flash e.g. to compare execution times
+ */
+#ifndef USE_RAM_FUNCTIONS
+#define USE_RAM_FUNCTIONS 1
+#endif
+
+#if USE_RAM_FUNCTIONS
+/**
+ * Place function in the .ramfunc section
+ *
+ * The section is located in SRAM_L (code bus) and copied from flash by the startup
+ * code (system-gcc.cpp) before any constructors run.
+ * This avoids flash wait-states and flash cache misses so execution time is shorter
+ * and deterministic.
+ *
+ * Calls from flash are made as long calls as RAM is out of range of a BL instruction.
+ * Calls from RAM to functions in flash go through linker generated veneers so callees
+ * on the hot path should also be RAMFUNC or RAMFUNC_INLINE.
+ *
+ * Only use on functions defined out of line in a .cpp file. The section attribute is
+ * ignored on template instantiations, and in-class (inline) definitions are emitted in
+ * their own sections which conflict with .ramfunc.
+ *
+ * Example:
+ * @code
+ * RAMFUNC void controller() {
+ *    ...
+ * }
+ * @endcode
+ */
+#ifdef __arm__
+#define RAMFUNC __attribute__((section(".ramfunc"), long_call, noinline))
+#else
+// Host compile check of the firmware (ruby_target_check) - long_call is ARM only
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#endif
+
+/**
+ * Inline a template or in-class function into its callers
+ *
+ * Used for hot-path members of class templates (PID_T, Motor, ControlGroup_T) which
+ * can't be placed with RAMFUNC. They run from RAM as part of the RAMFUNC function
+ * that calls them (e.g. controller()). Calls from elsewhere are inlined into flash.
+ *
+ * Example:
+ * @code
+ * template<...>
+ * class PID_T {
+ *    RAMFUNC_INLINE void update() {
+ *       ...
+ *    }
+ * };
+ * @endcode
+ */
+#define RAMFUNC_INLINE inline __attribute__((always_inline))
+#else
+#define RAMFUNC
+#define RAMFUNC_INLINE inline
+#endif
+
+#endif /* SOURCES_RAMFUNCTION_H_ */
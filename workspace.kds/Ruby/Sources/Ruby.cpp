@@ -15,36 +15,52 @@
 #define PROJECT_MAIN_
 
 #include <stdio.h>
-#include <random>
+#include <stdlib.h>
 #include <string.h>
-#include <vector>
 
 
 #include "system.h"
 #include "derivative.h"
 #include "delay.h"
-#include "Hardware.h"
+#include "hardware.h"
 #include "Ruby.h"
 #include "pdb.h"
 #include "pit.h"
 #include "pid.h"
-
-#define STEADY_STATE_TOLERANCE (((FULLROTATIONTICKS)/(360)) * ((3)/(3)))
+#include "Scheduler.h"
+#include "Async.h"
+#include "ConsoleReader.h"
+#include "StaticContainers.h"
+#include "MemoryMonitor.h"
+#include "RamFunction.h"
+#include "Configuration.h"
+#include "FlashLog.h"
+#include "JamDetector.h"
+#include "IterativeLearning.h"
+#include "SystemIdentification.h"
+#include "Trajectory.h"
+#include "DualAxisKernel.h"
+#include "Priorities.h"
+#include "SetpointHandoff.h"
 
 using namespace USBDM;
 
+//Most actions a single command can expand to (rewind/fast-forward sequence + move)
+constexpr unsigned MAX_ACTIONS_PER_COMMAND = 5;
+
 //Used to distribute interpreted commands
-std::vector<int> interpretedActions;
+RingBuffer<int, 32*MAX_ACTIONS_PER_COMMAND> interpretedActions;
 
 //Holds a list of chars read from the pc
-std::vector<char> readCommands;
+RingBuffer<char, 64> readCommands;
 
-//represents the offset from the index to the initial position of each motor (in encoder ticks)
-constexpr int motor1InitialOffset = -401;
-constexpr int motor2InitialOffset = -2581;
 
 
 void stopHere() {
+   // Nothing else will run so write the log now
+   FlashLog::log(FlashLog::Event_Stop);
+   FlashLog::flush();
+
    for(;;) {
       console.writeln("Stopped");
 #ifdef DEBUG_BUILD
@@ -60,6 +76,9 @@ void shutDown(void) {
    Motor1::setSpeed(0);
    Motor2::setSpeed(0);
 
+   FlashLog::log(FlashLog::Event_Shutdown, 1, 0, Motor1::getPosition());
+   FlashLog::log(FlashLog::Event_Shutdown, 2, 0, Motor2::getPosition());
+
    console.writeln("System Failure");
 
    uint32_t oldM1Position = 0;
@@ -144,24 +163,158 @@ static void testEncoders() {
 }
 #endif
 
-static constexpr float pidInterval  = 500 * us;
+/** Control loop interval - PWM_PERIOD multiple when locked to the PWM */
+static constexpr float pidInterval  = (CONTROL_PWM_DIVISOR > 0)?CONTROL_PWM_DIVISOR*PWM_PERIOD:500 * us;
 static constexpr float kp           = 0.01f;
 static constexpr float ki           = 0.000f;
 static constexpr float kd           = 00.1f*pidInterval;
+static constexpr float outputLimit  = 30;
+
+
+/** Learned feedforward for quarter turns */
+IterativeLearning ilc1(pidInterval, 0, false, outputLimit);
+IterativeLearning ilc2(pidInterval, 1, true,  outputLimit);
+
+/** PID output with learned correction added (written by ControlGroup::commit()) */
+RAMFUNC void motor1Output(float speed) {
+   ControlGroup::setSpeed<0>(ilc1.apply(speed));
+}
 
+/** PID output with learned correction added (written by ControlGroup::commit()) */
+RAMFUNC void motor2Output(float speed) {
+   ControlGroup::setSpeed<1>(ilc2.apply(speed));
+}
+
+/** Both controllers work from the positions latched by ControlGroup::sample() */
+PID_T<ControlGroup::getPositionAsFloat<0>, motor1Output> pid1(kp, ki, kd, pidInterval, -outputLimit, +outputLimit, false);
+PID_T<ControlGroup::getPositionAsFloat<1>, motor2Output> pid2(kp, ki, kd, pidInterval, -outputLimit, +outputLimit, true);
+
+/** Move profiles followed with model feedforward once a motor has been identified */
+Trajectory trajectory1(pidInterval);
+Trajectory trajectory2(pidInterval);
+
+/** Moves posted by the tasks and started by controller() */
+SetpointHandoff handoff1;
+SetpointHandoff handoff2;
+
+/** Jam detection thresholds (shared by both axes) */
+const JamDetector::Limits jamLimits = {
+      /* saturation     */ 28,
+      /* stallSpeed     */ 1000,                                           // ticks/s
+      /* stallTime      */ 100,                                            // ms
+      /* followingError */ QUARTERROTATIONTICKS+(FULLROTATIONTICKS/16),    // ticks
+      /* followingTime  */ 20,                                             // ms
+      /* reversalSpeed  */ 2000,                                           // ticks/s
+      /* reversalTime   */ 50,                                             // ms
+      /* moveTime       */ 3000,                                           // ms
+};
+
+JamDetector jam1(pidInterval, jamLimits);
+JamDetector jam2(pidInterval, jamLimits);
 
-PID_T<Motor1::getPositionAsFloat, Motor1::setSpeed> pid1(kp, ki, kd, pidInterval, -30, +30, false);
-PID_T<Motor2::getPositionAsFloat, Motor2::setSpeed> pid2(kp, ki, kd, pidInterval, -30, +30, true);
+/** Open-loop response measurement (one axis at a time) */
+SystemIdentification identification(pidInterval);
+
+/** Execution time of controller() in CPU cycles (USE_RAM_FUNCTIONS selects RAM or flash) */
+volatile uint32_t controllerCycles    = 0;
+volatile uint32_t controllerMaxCycles = 0;
+
+/**
+ * Start the move posted for an axis (if any)\n
+ * Only controller() changes the setpoint so the tasks never have to mask the control ISR.
+ *
+ * @param[in,out] handoff    Moves posted for the axis
+ * @param[in,out] pid        Controller of the axis
+ * @param[in,out] trajectory Profile of the axis
+ */
+template<class Pid>
+RAMFUNC_INLINE void startPostedMove(SetpointHandoff &handoff, Pid &pid, Trajectory &trajectory) {
+   SetpointHandoff::Request request;
+   if (!handoff.take(request)) {
+      return;
+   }
+   if (request.limits.maxVelocity > 0) {
+      trajectory.start(pid.getSetpoint(), request.target, request.limits);
+   }
+   else {
+      trajectory.stop();
+      pid.setSetpoint(request.target);
+   }
+}
 
 /**
  * Debug PID call-back
  * Uses TpA to check timing.
  */
-void controller() {
+RAMFUNC void controller() {
+   uint32_t startTime = DWT->CYCCNT;
+   MemoryMonitor::sampleIsrEntry(MemoryMonitor::Isr_Controller);
    TpA::set();
+   // Both axes are controlled from positions taken at the same instant
+   ControlGroup::sample();
+   startPostedMove(handoff2, pid2, trajectory2);
+   startPostedMove(handoff1, pid1, trajectory1);
+   Trajectory::Reference reference;
+   if (trajectory2.next(reference)) {
+      pid2.setReference(reference.position, reference.velocity, reference.acceleration);
+   }
+   if (trajectory1.next(reference)) {
+      pid1.setReference(reference.position, reference.velocity, reference.acceleration);
+   }
    pid2.update();
    pid1.update();
+   ilc1.record(pid1.getError());
+   ilc2.record(pid2.getError());
+   // Controller of the axis being identified is disabled
+   if (identification.isRunning()) {
+      if (identification.getAxis() == 1) {
+         ControlGroup::setSpeed<0>(identification.update(ControlGroup::getPositionAsFloat<0>()));
+      }
+      else {
+         ControlGroup::setSpeed<1>(identification.update(ControlGroup::getPositionAsFloat<1>()));
+      }
+   }
+   // Hold position on a jam so the motor is not left driving into it
+   if (jam1.update(pid1.getSetpoint(), pid1.getInput(), pid1.getOutput())) {
+      trajectory1.stop();
+      pid1.setSetpoint(pid1.getInput());
+   }
+   if (jam2.update(pid2.getSetpoint(), pid2.getInput(), pid2.getOutput())) {
+      trajectory2.stop();
+      pid2.setSetpoint(pid2.getInput());
+   }
+   // Outputs of both axes change at the same PWM period
+   ControlGroup::commit();
    TpA::clear();
+   uint32_t elapsed = DWT->CYCCNT - startTime;
+   controllerCycles = elapsed;
+   if (elapsed > controllerMaxCycles) {
+      controllerMaxCycles = elapsed;
+   }
+}
+
+/**
+ * Report controller() execution time and axis synchronisation and restart the worst-case measurements
+ */
+void reportControllerTiming() {
+   console.write(USE_RAM_FUNCTIONS?"RAM":"Flash").
+      write(" controller cycles: last = ").write(controllerCycles).
+      write(", max = ").writeln(controllerMaxCycles);
+   controllerMaxCycles = 0;
+   ControlGroup::report();
+}
+
+/**
+ * Compare the dual-axis fixed-point kernel with PID_T using the current tunings
+ */
+void benchmarkKernel() {
+   DualAxisKernel kernel(pidInterval, outputLimit);
+   if (!kernel.setTunings(1, pid1.getKp(), pid1.getKi(), pid1.getKd(), false) ||
+       !kernel.setTunings(2, pid2.getKp(), pid2.getKi(), pid2.getKd(), true)) {
+      console.writeln("Tunings out of range for the dual-axis kernel");
+      return;
+   }
+   kernel.benchmark();
 }
 
 using Timer = Pit;
@@ -171,10 +324,16 @@ using TimerChannel = PitChannel<0>;
  * Configure PID timer call-back
  */
 void initialisePids() {
+#if CONTROL_PWM_DIVISOR > 0
+   // Motors must be initialised first (FTM0 running)
+   ControlGroup::setPeriodCallback(controller, CONTROL_PWM_DIVISOR, IrqPriority_Control);
+   console.write("Control loop locked to PWM: ").write((unsigned)(1/pidInterval+0.5f)).writeln(" Hz");
+#else
    Timer::configure(PitDebugMode_Stop);
    TimerChannel::setCallback(controller);
    TimerChannel::configure(pidInterval, PitChannelIrq_Enable);
-   TimerChannel::enableNvicInterrupts(true, NvicPriority_Normal);
+   TimerChannel::enableNvicInterrupts(true, IrqPriority_Control);
+#endif
 
    pid1.setSetpoint(0);
    pid1.enable(false);//initialise turned off
@@ -224,19 +383,47 @@ static void calibrate() {
       shutDown();
    }
 
+   if (Configuration::isValid()) {
+      // Home positions are known relative to the index - no operator needed
+      console.writeln("Rehoming motors");
+      if (Motor1::rehome(Configuration::data.indexOffset[0]) &&
+          Motor2::rehome(Configuration::data.indexOffset[1])) {
+         FlashLog::log(FlashLog::Event_Calibrated, 1, 0, Configuration::data.indexOffset[0]);
+         FlashLog::log(FlashLog::Event_Calibrated, 2, 0, Configuration::data.indexOffset[1]);
+         return;
+      }
+      FlashLog::log(FlashLog::Event_IndexNotFound);
+      console.writeln("Index not found - manual calibration required");
+   }
+
    console.writeln("Calibrating");
    console.write("Position gripper 1: Press any key to continue!");
    console.readChar();
 
-   Motor1::Encoder::resetPosition();//Zero motor 1
+   Motor1::setHome();//Zero motor 1
 
    console.write("\nPosition gripper 2: Press any key to continue!");
    console.readChar();
 
-   Motor2::Encoder::resetPosition();//Zero motor 1
+   Motor2::setHome();//Zero motor 2
 
    console.write("\n\n");
 
+   // Record index positions so following resets can rehome automatically
+   int indexOffset1, indexOffset2;
+   if (!Motor1::measureIndexOffset(indexOffset1) || !Motor2::measureIndexOffset(indexOffset2)) {
+      FlashLog::log(FlashLog::Event_IndexNotFound);
+      console.writeln("Failed to find motor index");
+      shutDown();
+   }
+   FlashLog::log(FlashLog::Event_Calibrated, 1, 0, indexOffset1);
+   FlashLog::log(FlashLog::Event_Calibrated, 2, 0, indexOffset2);
+   Configuration::data.indexOffset[0] = indexOffset1;
+   Configuration::data.indexOffset[1] = indexOffset2;
+   if (!Configuration::save()) {
+      console.writeln("Failed to save configuration");
+   }
+
    /*console.writeln("Calibrating motor 1");
       if (!Motor1::calibrate()) {
 	  console.writeln(Motor1::getPosition());
@@ -354,6 +541,32 @@ void testGrippers() {
    }
 }
 
+/**
+ * Records an over-current trip\n
+ * Called from the FTM fault interrupt - the bridge outputs are already off
+ *
+ * @param[in] axis Axis that tripped
+ */
+RAMFUNC void overCurrentTrip(unsigned axis) {
+   int32_t position = (axis == 1)?Motor1::getPosition():Motor2::getPosition();
+   FlashLog::log(FlashLog::Event_OverCurrent, axis, 0, position);
+}
+
+/**
+ * Enable hardware shutdown of the bridges on the driver error flags
+ */
+void initialiseProtection() {
+   // Bridges need 1ms after enabling before the error flags are valid
+   waitMS(1);
+
+   // Active-low error flags with filtering
+   BridgeProtection::addPinInput<Motor1::FAULT_INPUT>(1, ActiveLow, true);
+   BridgeProtection::addPinInput<Motor2::FAULT_INPUT>(2, ActiveLow, true);
+
+   // Motor channels 2,3 and 4,5 (grippers are not protected)
+   BridgeProtection::enable((1<<1)|(1<<2), overCurrentTrip);
+}
+
 /**
  * Initialise system
  */
@@ -367,6 +580,19 @@ void initialise() {
 
    checkMotorSupply();
 
+   // Reset source from RCM is logged to help diagnose unexpected restarts
+   FlashLog::initialise();
+   FlashLog::log(FlashLog::Event_Boot, 0, (RCM->SRS1<<8)|RCM->SRS0);
+
+   if (!Configuration::load()) {
+      console.writeln("No stored configuration - using defaults");
+   }
+   if (!IterativeLearning::load()) {
+      console.writeln("No learned move profiles");
+   }
+   Gripper1::setTiming(Configuration::data.gripperCloseTime, Configuration::data.gripperOpenTime);
+   Gripper2::setTiming(Configuration::data.gripperCloseTime, Configuration::data.gripperOpenTime);
+
    Gripper1::initialise();
    Gripper2::initialise();
 
@@ -375,8 +601,12 @@ void initialise() {
 
    Motor1::Encoder::resetPosition();
 
+   initialiseProtection();
+
    console.writeln(Motor1::getPosition());
 
+   Scheduler::initialise();
+
    initialisePids();
 
    calibrate();
@@ -394,17 +624,262 @@ float motor2Position() {
    return position;
 };
 
+//Controls periodic reporting of axis state by the telemetry task
+bool telemetryEnabled = false;
+
+//Starts the demonstration sequence
+void startDemo();
+void reportJams();
+
+//Starts identification of a motor
+void startIdentification(int axis);
+
+/*
+ * Reports completion of a configuration save
+ */
+void configurationSaved(bool success)
+{
+	console.writeln(success?"Configuration saved":"Failed to save configuration");
+}
+
+/*
+ * Save the current PID tunings with the calibration
+ * The EEPROM is written in the background by configurationTask()
+ */
+void saveConfiguration()
+{
+	Configuration::data.kp[0] = pid1.getKp();
+	Configuration::data.ki[0] = pid1.getKi();
+	Configuration::data.kd[0] = pid1.getKd();
+	Configuration::data.kp[1] = pid2.getKp();
+	Configuration::data.ki[1] = pid2.getKi();
+	Configuration::data.kd[1] = pid2.getKd();
+
+	Configuration::report();
+
+	if(!Configuration::save(configurationSaved))
+	{
+		console.writeln("Failed to save configuration");
+	}
+
+	//Learned move profiles are kept with the configuration
+	IterativeLearning::save();
+}
+
+/*
+ * Loads the anti-windup, derivative filter and setpoint weights of a motor into its controller
+ */
+void applyControllerOptions(int axis)
+{
+	const ConfigurationData &data = Configuration::data;
+	PID::AntiWindup antiWindup = (PID::AntiWindup)data.antiWindup[axis-1];
+
+	//Controller uses the options from its interrupt
+	ControlCriticalSection cs;
+	if(axis == 1)
+	{
+		pid1.setAntiWindup(antiWindup, data.trackingGain[0]);
+		pid1.setDerivativeFilter(data.derivativeFilter[0]);
+		pid1.setSetpointWeights(data.proportionalWeight[0], data.derivativeWeight[0]);
+	}
+	else
+	{
+		pid2.setAntiWindup(antiWindup, data.trackingGain[1]);
+		pid2.setDerivativeFilter(data.derivativeFilter[1]);
+		pid2.setSetpointWeights(data.proportionalWeight[1], data.derivativeWeight[1]);
+	}
+}
+
+//Tuning record being received after a 'k' command
+bool     tuningRecordPending = false;
+char     tuningRecord[64];
+unsigned tuningRecordLength  = 0;
+
+/*
+ * Parse a decimal number e.g. "12", "-0.5" or "1.2e-05" as written by %g
+ * Used instead of strtof() which allocates from the heap (not available in a HEAP_FREE_BUILD)
+ * end is set as for strtof() i.e. to text if no number was found
+ */
+static float parseDecimal(const char *text, char **end)
+{
+	const char *next = text;
+	while((*next == ' ') || (*next == '\t'))
+	{
+		next++;
+	}
+	bool negative = (*next == '-');
+	if((*next == '-') || (*next == '+'))
+	{
+		next++;
+	}
+
+	//Digits beyond those a uint32_t holds only scale the value
+	uint32_t mantissa = 0;
+	int      exponent = 0;
+	bool     digits   = false;
+	for(; (*next >= '0') && (*next <= '9'); next++)
+	{
+		digits = true;
+		if(mantissa < 100000000)
+		{
+			mantissa = 10*mantissa + (*next - '0');
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+	if(*next == '.')
+	{
+		for(next++; (*next >= '0') && (*next <= '9'); next++)
+		{
+			digits = true;
+			if(mantissa < 100000000)
+			{
+				mantissa = 10*mantissa + (*next - '0');
+				exponent--;
+			}
+		}
+	}
+	if(!digits)
+	{
+		*end = const_cast<char *>(text);
+		return 0;
+	}
+	if((*next == 'e') || (*next == 'E'))
+	{
+		const char *power = next + 1;
+		bool negativePower = (*power == '-');
+		if((*power == '-') || (*power == '+'))
+		{
+			power++;
+		}
+		if((*power >= '0') && (*power <= '9'))
+		{
+			int value = 0;
+			for(; (*power >= '0') && (*power <= '9'); power++)
+			{
+				if(value < 100)
+				{
+					value = 10*value + (*power - '0');
+				}
+			}
+			exponent += negativePower?-value:value;
+			next = power;
+		}
+	}
+	*end = const_cast<char *>(next);
+
+	float result = mantissa;
+	for(; exponent > 0; exponent--)
+	{
+		result *= 10;
+	}
+	for(; exponent < 0; exponent++)
+	{
+		result /= 10;
+	}
+	return negative?-result:result;
+}
+
+/*
+ * Apply a tuning record e.g. from the host tuning tool (ruby_tune)
+ * Format: <motor> <kp> <ki> <kd> <settle tolerance> [<anti-windup> <tracking gain> <derivative filter> <p weight> <d weight>]
+ * The optional fields select the controller options (anti-windup 0 clamp, 1 back-calculation, 2 conditional)
+ * The tunings are used immediately - 'w' saves them
+ */
+void loadTuning(const char *record)
+{
+	const char *start = record;
+	char       *end;
+	bool        valid = true;
+
+	long axis = strtol(start, &end, 10);
+	valid = valid && (end != start);
+	start = end;
+
+	float tunings[3];
+	for(float &tuning : tunings)
+	{
+		tuning = parseDecimal(start, &end);
+		valid  = valid && (end != start) && (tuning >= 0);
+		start  = end;
+	}
+
+	long tolerance = strtol(start, &end, 10);
+	valid = valid && (end != start) && (tolerance > 0);
+	start = end;
+
+	//Controller options are only changed if given
+	while((*start == ' ') || (*start == '\r'))
+	{
+		start++;
+	}
+	bool hasOptions = (*start != '\0');
+
+	long  antiWindup = 0;
+	float options[4] = {};
+	if(hasOptions)
+	{
+		antiWindup = strtol(start, &end, 10);
+		valid = valid && (end != start) && (antiWindup >= PID::AntiWindup_Clamp) && (antiWindup <= PID::AntiWindup_Conditional);
+		start = end;
+
+		for(float &option : options)
+		{
+			option = parseDecimal(start, &end);
+			valid  = valid && (end != start) && (option >= 0);
+			start  = end;
+		}
+		//Setpoint weights
+		valid = valid && (options[2] <= 1) && (options[3] <= 1);
+	}
+
+	if(!valid || ((axis != 1) && (axis != 2)))
+	{
+		console.writeln("Invalid tuning record");
+		return;
+	}
+
+	Configuration::data.kp[axis-1]              = tunings[0];
+	Configuration::data.ki[axis-1]              = tunings[1];
+	Configuration::data.kd[axis-1]              = tunings[2];
+	Configuration::data.settleTolerance[axis-1] = tolerance;
+
+	if(hasOptions)
+	{
+		Configuration::data.antiWindup[axis-1]         = antiWindup;
+		Configuration::data.trackingGain[axis-1]       = options[0];
+		Configuration::data.derivativeFilter[axis-1]   = options[1];
+		Configuration::data.proportionalWeight[axis-1] = options[2];
+		Configuration::data.derivativeWeight[axis-1]   = options[3];
+		applyControllerOptions(axis);
+	}
+
+	{
+		//Controller uses the tunings from its interrupt
+		ControlCriticalSection cs;
+		if(axis == 1)
+		{
+			pid1.setTunings(tunings[0], tunings[1], tunings[2]);
+		}
+		else
+		{
+			pid2.setTunings(tunings[0], tunings[1], tunings[2]);
+		}
+	}
+
+	Configuration::report();
+}
+
 bool readFromPC()
 {
 	bool result = false;
 
-	/*Not standard library,
-	 *Add readCharNoBlock method by copying readChar and changing check for (ch < 0)
-	 *Return NULL instead of looping
-	 */
-	int ch = console.readCharNoBlock();
+	//Characters are queued by the UART interrupt, returns -1 if none available
+	int ch = ConsoleReader::readCharNoBlock();
 
-	if(ch == NULL)
+	if(ch < 0)
 	{
 		result = false;
 	}
@@ -419,34 +894,434 @@ bool readFromPC()
 			stopHere();
 		}
 
-		else//Set outputs if not recognised as a command
+		else if(readCharacter == 't')//Toggle telemetry
+		{
+			telemetryEnabled = !telemetryEnabled;
+		}
+
+		else if(readCharacter == 'r')//Report task run-times
+		{
+			Scheduler::report();
+		}
+
+		else if(readCharacter == 'c')//Report control loop execution time
+		{
+			reportControllerTiming();
+		}
+
+		else if(readCharacter == 'w')//Save current tunings and calibration
+		{
+			saveConfiguration();
+		}
+
+		else if(readCharacter == 'k')//Load tuning record (rest of line)
+		{
+			tuningRecordLength  = 0;
+			tuningRecordPending = true;
+		}
+
+		else if(readCharacter == 'x')//Discard stored configuration (manual calibration on next reset)
+		{
+			Configuration::erase();
+			console.writeln("Configuration erased");
+		}
+
+		else if(readCharacter == 'l')//Dump the fault and move log
+		{
+			FlashLog::dump();
+		}
+
+		else if(readCharacter == 'm')//Report memory usage
+		{
+			MemoryMonitor::report();
+		}
+
+		else if(readCharacter == 'o')//Report over-current trips
+		{
+			BridgeProtection::report();
+		}
+
+		else if(readCharacter == 'O')//Clear over-current lock-out
+		{
+			BridgeProtection::reset();
+			BridgeProtection::report();
+		}
+
+		else if(readCharacter == 'i')//Report learned move convergence
+		{
+			ilc1.report();
+			ilc2.report();
+		}
+
+		else if(readCharacter == 'I')//Discard learned move profiles
+		{
+			ilc1.reset();
+			ilc2.reset();
+			console.writeln("Learned profiles cleared");
+		}
+
+		else if(readCharacter == 'j')//Report jams detected
+		{
+			reportJams();
+		}
+
+		else if(readCharacter == 'd')//Run demonstration sequence
+		{
+			startDemo();
+		}
+
+		else if(readCharacter == 'p')//Identify motor 1 and seed its tunings
+		{
+			startIdentification(1);
+		}
+
+		else if(readCharacter == 'P')//Identify motor 2 and seed its tunings
+		{
+			startIdentification(2);
+		}
+
+		else if(readCharacter == 'e')//Export records of the last identification
+		{
+			identification.dump();
+		}
+
+		else if(readCharacter == 'E')//Select identification excitation
 		{
-			readCommands.push_back(readCharacter);
+			SystemIdentification::settings.excitation =
+					(SystemIdentification::settings.excitation == SystemIdentification::Excitation_Prbs)?
+							SystemIdentification::Excitation_Chirp:SystemIdentification::Excitation_Prbs;
+			console.writeln((SystemIdentification::settings.excitation == SystemIdentification::Excitation_Prbs)?
+					"PRBS excitation":"Chirp excitation");
+		}
+
+		else if(readCharacter == 'v')//Check and time the dual-axis kernel against the controllers
+		{
+			benchmarkKernel();
+		}
 
+		else//Set outputs if not recognised as a command
+		{
 			console.writeln();
 
-			/*int i = 0;
-			while(i < readCommands.size())
+			if(readCommands.enQueue(readCharacter))
 			{
-				console.write(readCommands[i]);
-
-				i += 1;
+				result = true;
 			}
 
-			console.writeln();//*/
-
-			result = true;
+			else
+			{
+				console.writeln("Command buffer full");
+			}
 		}
 	}
 
 	return result;
 }
 
-enum TrackerState {Turning1, Turning2, Gripping1, Gripping2, Free, Stopped};
+enum TrackerState {Turning1, Turning2, Gripping1, Gripping2, Recovering1, Recovering2, Free, Stopped};
 
 TrackerState currentTrackedState = Free;
 
-u_int PIDUpdaterIndex = 0;
+/*
+ * Actions taken to clear a jammed axis
+ */
+struct JamRecoveryPolicy
+{
+	bool     regrip;        //Open and re-close the axis gripper after backing off
+	uint32_t settleTime;    //Pause after backing off and after re-gripping (ms)
+	uint32_t backOffTime;   //Longest wait for the back off to reach steady state (ms)
+	unsigned retries;       //Attempts at the move before giving up
+};
+
+JamRecoveryPolicy jamPolicy = {true, 200, 2000, 2};
+
+/*
+ * Clears a jam on one axis: back off to the start of the move, re-grip and retry
+ * Runs as a coroutine so the other tasks continue while it waits
+ */
+template<class Pid, class Grip>
+class JamRecovery : public Coroutine
+{
+public:
+	JamRecovery(Pid &pid, SetpointHandoff &handoff, JamDetector &detector, uint8_t axis) :
+		pid(pid), handoff(handoff), detector(detector), axis(axis)
+	{
+	}
+
+	/*
+	 * Start recovery of the faulted move
+	 * target is the setpoint of the move that jammed
+	 */
+	void start(float target)
+	{
+		this->target  = target;
+		startPosition = detector.getStartPosition();
+		attempt       = 0;
+		succeeded     = false;
+		Async::start(this);
+	}
+
+	bool isRunning() const
+	{
+		return Async::isActive(this);
+	}
+
+	bool hasSucceeded() const
+	{
+		return succeeded;
+	}
+
+	virtual bool resume() override
+	{
+		CO_BEGIN();
+
+		for(;;)
+		{
+			console.write("Jam on axis ").write(axis).write(": ").write(JamDetector::getFaultName(detector.getFault())).
+					write(" at ").write((int)detector.getFaultPosition()).
+					write(", error ").writeln((int)detector.getFaultError());
+			FlashLog::log(FlashLog::Event_Jam, axis, detector.getFault(), (int32_t)detector.getFaultPosition());
+
+			//Back off to where the move started
+			handoff.post(startPosition);
+			CO_AWAIT_TIMEOUT(!handoff.isPending() && pid.getIsSteadyState(Configuration::data.settleTolerance[axis-1]), jamPolicy.backOffTime);
+			CO_DELAY(jamPolicy.settleTime);
+
+			if(jamPolicy.regrip)
+			{
+				Grip::startOpen();
+				CO_AWAIT(!Grip::isMoving());
+				CO_DELAY(jamPolicy.settleTime);
+				Grip::startClose();
+				CO_AWAIT(!Grip::isMoving());
+			}
+
+			if(attempt >= jamPolicy.retries)
+			{
+				break;
+			}
+			attempt++;
+
+			//Retry the move
+			detector.arm(startPosition, target);
+			handoff.post(target);
+			CO_AWAIT((detector.getFault() != JamDetector::Fault_None) || (!handoff.isPending() && pid.getIsSteadyState(Configuration::data.settleTolerance[axis-1])));
+
+			if(detector.getFault() == JamDetector::Fault_None)
+			{
+				detector.disarm();
+				succeeded = true;
+				break;
+			}
+		}
+
+		if(succeeded)
+		{
+			console.write("Jam cleared on axis ").write(axis).write(" after ").write(attempt).writeln(" retries");
+			FlashLog::log(FlashLog::Event_JamRecovered, axis, attempt, (int32_t)pid.getInput());
+		}
+		else
+		{
+			//Axis is left holding at the start of the move - later moves assumed it completed
+			interpretedActions.clear();
+			console.write("Jam not cleared on axis ").write(axis).writeln(" - operator required");
+			FlashLog::log(FlashLog::Event_JamRecovered, axis, -1, (int32_t)pid.getInput());
+		}
+
+		CO_END();
+	}
+
+private:
+	Pid             &pid;
+	SetpointHandoff &handoff;
+	JamDetector     &detector;
+	const uint8_t axis;
+
+	float    startPosition = 0;
+	float    target        = 0;
+	unsigned attempt       = 0;
+	bool     succeeded     = false;
+};
+
+JamRecovery<decltype(pid1), Gripper1> jamRecovery1(pid1, handoff1, jam1, 1);
+JamRecovery<decltype(pid2), Gripper2> jamRecovery2(pid2, handoff2, jam2, 2);
+
+/*
+ * Report jams detected since reset
+ */
+void reportJams()
+{
+	for(unsigned fault=JamDetector::Fault_Stall; fault<JamDetector::NUM_FAULTS; fault++)
+	{
+		console.write(JamDetector::getFaultName((JamDetector::Fault)fault)).
+				write(": axis 1 = ").write(jam1.getFaultCount((JamDetector::Fault)fault)).
+				write(", axis 2 = ").writeln(jam2.getFaultCount((JamDetector::Fault)fault));
+	}
+}
+
+/*
+ * Loads the identified model of a motor into its controller
+ * Without a model the feedforward is zero and moves step the setpoint
+ */
+void applyModel(int axis)
+{
+	float gain         = Configuration::data.modelGain[axis-1];
+	float timeConstant = Configuration::data.modelTimeConstant[axis-1];
+	float friction     = Configuration::data.modelFriction[axis-1];
+
+	//Controller uses the feedforward from its interrupt
+	ControlCriticalSection cs;
+	if(axis == 1)
+	{
+		pid1.setFeedforward(gain, timeConstant, friction);
+	}
+	else
+	{
+		pid2.setFeedforward(gain, timeConstant, friction);
+	}
+}
+
+/*
+ * Starts a move of an axis to target
+ * Follows a profile the motor can track once it has been identified, otherwise steps the setpoint
+ * The move is handed to the control interrupt which starts it at its next sample
+ */
+void startMove(SetpointHandoff &handoff, int axis, float target)
+{
+	float gain = Configuration::data.modelGain[axis-1];
+
+	if(gain > 0)
+	{
+		handoff.post(target, Trajectory::getLimits(gain, Configuration::data.modelTimeConstant[axis-1],
+				Configuration::data.modelFriction[axis-1], outputLimit));
+	}
+
+	else
+	{
+		handoff.post(target);
+	}
+}
+
+/*
+ * Drives a motor open-loop to measure its response then fits a model and seeds the tunings
+ * The fitted model is kept in the configuration - 'w' saves it with the seeded tunings
+ */
+class IdentifySequence : public Coroutine
+{
+public:
+	IdentifySequence(int axis) : axis(axis)
+	{
+	}
+
+	virtual bool resume() override
+	{
+		CO_BEGIN();
+
+		{
+			//Controller is disabled before the ISR starts driving the motor
+			ControlCriticalSection cs;
+			if(axis == 1)
+			{
+				pid1.enable(false);
+				identification.start(1, false, Motor1::getPositionAsFloat());
+			}
+			else
+			{
+				pid2.enable(false);
+				identification.start(2, true, Motor2::getPositionAsFloat());
+			}
+		}
+
+		CO_AWAIT(!identification.isRunning());
+
+		//Return to the position held before the run
+		if(axis == 1)
+		{
+			pid1.enable(true);
+		}
+		else
+		{
+			pid2.enable(true);
+		}
+
+		if(!identification.fit(model))
+		{
+			console.write("Motor ").write(axis).writeln(" identification failed");
+		}
+
+		else
+		{
+			SystemIdentification::report(axis, model);
+
+			float kp, ki, kd;
+			SystemIdentification::seedTunings(model, kp, ki, kd);
+
+			Configuration::data.modelGain[axis-1]         = model.gain;
+			Configuration::data.modelTimeConstant[axis-1] = model.timeConstant;
+			Configuration::data.modelFriction[axis-1]     = model.friction;
+			Configuration::data.kp[axis-1]                = kp;
+			Configuration::data.ki[axis-1]                = ki;
+			Configuration::data.kd[axis-1]                = kd;
+
+			applyModel(axis);
+
+			{
+				//Controller uses the tunings from its interrupt
+				ControlCriticalSection cs;
+				if(axis == 1)
+				{
+					pid1.setTunings(kp, ki, kd);
+				}
+				else
+				{
+					pid2.setTunings(kp, ki, kd);
+				}
+			}
+
+			Configuration::report();
+		}
+
+		CO_END();
+	}
+
+private:
+	//Motor being identified
+	const int axis;
+
+	//Fitted model
+	SystemIdentification::Model model = {};
+};
+
+//Only one axis is identified at a time
+CoroutinePool<IdentifySequence, 1> identifyPool;
+
+/*
+ * Indicates a motor is being identified
+ * Moves are held off until the controller has been re-enabled
+ */
+bool isIdentifying()
+{
+	return identifyPool.getActiveCount() > 0;
+}
+
+void startIdentification(int axis)
+{
+	if(isIdentifying())
+	{
+		console.writeln("Identification already running");
+	}
+
+	else if((currentTrackedState != Free) || !interpretedActions.isEmpty())
+	{
+		console.writeln("Identification needs the axes to be idle");
+	}
+
+	else
+	{
+		console.write("Identifying motor ").writeln(axis);
+		identifyPool.start(axis);
+	}
+}
 
 /*
  * Updates the pids and grippers as well as checking for steady states before updating them.
@@ -473,6 +1348,12 @@ bool ControlUpdate(int actionArgument)
 
 	bool steadyStateFound = false;
 
+	//Motor is being driven open-loop
+	if(isIdentifying())
+	{
+		return false;
+	}
+
 	if(currentTrackedState == Stopped)
 	{
 		stopHere();
@@ -482,22 +1363,68 @@ bool ControlUpdate(int actionArgument)
 	//Seperate cheks to save resources
 	if(currentTrackedState == Turning1)
 	{
-		steadyStateFound = pid1.getIsSteadyState(STEADY_STATE_TOLERANCE);
+		if(jam1.getFault() != JamDetector::Fault_None)
+		{
+			//Move will never settle - recover and retry (not learned from)
+			ilc1.abortMove();
+			jamRecovery1.start(pid1.getSetpoint());
+			currentTrackedState = Recovering1;
+		}
+
+		else
+		{
+			steadyStateFound = !handoff1.isPending() && !trajectory1.isRunning() && pid1.getIsSteadyState(Configuration::data.settleTolerance[0]);
+		}
+
+		if(steadyStateFound)
+		{
+			jam1.disarm();
+			ilc1.endMove();
+			FlashLog::log(FlashLog::Event_Move, 1, (int16_t)pid1.getError(), Motor1::getPosition());
+		}
 	}
 
 	if(currentTrackedState == Turning2)
 	{
-		steadyStateFound = pid2.getIsSteadyState(STEADY_STATE_TOLERANCE);
+		if(jam2.getFault() != JamDetector::Fault_None)
+		{
+			//Move will never settle - recover and retry (not learned from)
+			ilc2.abortMove();
+			jamRecovery2.start(pid2.getSetpoint());
+			currentTrackedState = Recovering2;
+		}
+
+		else
+		{
+			steadyStateFound = !handoff2.isPending() && !trajectory2.isRunning() && pid2.getIsSteadyState(Configuration::data.settleTolerance[1]);
+		}
+
+		if(steadyStateFound)
+		{
+			jam2.disarm();
+			ilc2.endMove();
+			FlashLog::log(FlashLog::Event_Move, 2, (int16_t)pid2.getError(), Motor2::getPosition());
+		}
+	}
+
+	if(currentTrackedState == Recovering1)
+	{
+		steadyStateFound = !jamRecovery1.isRunning();
+	}
+
+	if(currentTrackedState == Recovering2)
+	{
+		steadyStateFound = !jamRecovery2.isRunning();
 	}
 
 	if(currentTrackedState == Gripping1)
 	{
-		steadyStateFound = true;//Current configuration grippers are steady after return from call to open/close
+		steadyStateFound = !Gripper1::isMoving();
 	}
 
 	if(currentTrackedState == Gripping2)
 	{
-		steadyStateFound = true;//Current configuration grippers are steady after return from call to open/close
+		steadyStateFound = !Gripper2::isMoving();
 	}
 
 
@@ -532,7 +1459,10 @@ bool ControlUpdate(int actionArgument)
 
 		actionToComplete = actionArgument;
 
-		console.write("Actioning ").writeln(actionToComplete);
+		if(actionToComplete != 0)
+		{
+			console.write("Actioning ").writeln(actionToComplete);
+		}
 
 		if(actionToComplete == 0)
 		{
@@ -543,7 +1473,11 @@ bool ControlUpdate(int actionArgument)
 		{
 			currentTrackedState = Turning1;
 
-			pid1.setSetpoint(pid1.getSetpoint() + QUARTERROTATIONTICKS);
+			jam1.arm(pid1.getSetpoint(), pid1.getSetpoint() + QUARTERROTATIONTICKS);
+
+			ilc1.startMove(IterativeLearning::Move_Forward);
+
+			startMove(handoff1, 1, pid1.getSetpoint() + QUARTERROTATIONTICKS);
 
 			result = true;
 		}
@@ -552,7 +1486,11 @@ bool ControlUpdate(int actionArgument)
 		{
 			currentTrackedState = Turning1;
 
-			pid1.setSetpoint(pid1.getSetpoint() - QUARTERROTATIONTICKS);
+			jam1.arm(pid1.getSetpoint(), pid1.getSetpoint() - QUARTERROTATIONTICKS);
+
+			ilc1.startMove(IterativeLearning::Move_Reverse);
+
+			startMove(handoff1, 1, pid1.getSetpoint() - QUARTERROTATIONTICKS);
 
 			result = true;
 		}
@@ -561,7 +1499,11 @@ bool ControlUpdate(int actionArgument)
 		{
 			currentTrackedState = Turning2;
 
-			pid2.setSetpoint(pid2.getSetpoint() + QUARTERROTATIONTICKS);
+			jam2.arm(pid2.getSetpoint(), pid2.getSetpoint() + QUARTERROTATIONTICKS);
+
+			ilc2.startMove(IterativeLearning::Move_Forward);
+
+			startMove(handoff2, 2, pid2.getSetpoint() + QUARTERROTATIONTICKS);
 
 			result = true;
 		}
@@ -570,7 +1512,11 @@ bool ControlUpdate(int actionArgument)
 		{
 			currentTrackedState = Turning2;
 
-			pid2.setSetpoint(pid2.getSetpoint() - QUARTERROTATIONTICKS);
+			jam2.arm(pid2.getSetpoint(), pid2.getSetpoint() - QUARTERROTATIONTICKS);
+
+			ilc2.startMove(IterativeLearning::Move_Reverse);
+
+			startMove(handoff2, 2, pid2.getSetpoint() - QUARTERROTATIONTICKS);
 
 			result = true;
 		}
@@ -579,7 +1525,7 @@ bool ControlUpdate(int actionArgument)
 		{
 			currentTrackedState = Gripping1;
 
-			Gripper1::close();
+			Gripper1::startClose();
 
 			result = true;
 		}
@@ -588,7 +1534,7 @@ bool ControlUpdate(int actionArgument)
 		{
 			currentTrackedState = Gripping2;
 
-			Gripper2::close();
+			Gripper2::startClose();
 
 			result = true;
 		}
@@ -597,7 +1543,7 @@ bool ControlUpdate(int actionArgument)
 		{
 			currentTrackedState = Gripping1;
 
-			Gripper1::open();
+			Gripper1::startOpen();
 
 			result = true;
 		}
@@ -605,7 +1551,7 @@ bool ControlUpdate(int actionArgument)
 		else if(actionToComplete == -4) //Open gripper2
 		{
 			currentTrackedState = Gripping2;
-			Gripper2::open();
+			Gripper2::startOpen();
 
 			result = true;
 		}
@@ -621,8 +1567,6 @@ int plannedOffsetMotor2 = 0;
 int constexpr MAXPLANNEDOFFSET = 3;
 int constexpr MINPLANNEDOFFSET = -MAXPLANNEDOFFSET;
 
-u_int commandInterpreterIndex = 0;
-
 /*
  *Reads the next entry from commands if one exists and converts it to an interpreted set of commands
  *
@@ -639,12 +1583,11 @@ bool interpretCommand()
 
 	bool result = false;
 
-	if(commandInterpreterIndex < readCommands.size())
+	if(!readCommands.isEmpty())
 	{
-		char toInterpret = readCommands[commandInterpreterIndex];
-		commandInterpreterIndex ++;
+		char toInterpret = readCommands.deQueue();
 
-		std::vector<int> commands;
+		StaticVector<int, 1> commands;
 
 		if(toInterpret == 'a')
 		{
@@ -679,9 +1622,9 @@ bool interpretCommand()
 						const int *precalc = fastforward1;//Pointer to a (const int) not a constatn pointer to an int
 
 						u_int j = 0;
-						while(j < sizeof(precalc))
+						while(j < sizeof(fastforward1)/sizeof(fastforward1[0]))
 						{
-							interpretedActions.push_back(precalc[j]);
+							interpretedActions.enQueue(precalc[j]);
 
 							j += 1;
 						}
@@ -689,7 +1632,7 @@ bool interpretCommand()
 						plannedOffsetMotor1 += 2;//two moves in fastforward
 					}
 
-					interpretedActions.push_back(commands[i]);
+					interpretedActions.enQueue(commands[i]);
 
 					plannedOffsetMotor1 -= 1;
 				}
@@ -701,9 +1644,9 @@ bool interpretCommand()
 						const int *precalc = rewind1;//Pointer to a (const int) not a constatn pointer to an int
 
 						u_int j = 0;
-						while(j < sizeof(precalc))
+						while(j < sizeof(rewind1)/sizeof(rewind1[0]))
 						{
-							interpretedActions.push_back(precalc[j]);
+							interpretedActions.enQueue(precalc[j]);
 
 							j += 1;
 						}
@@ -711,7 +1654,7 @@ bool interpretCommand()
 						plannedOffsetMotor1 -= 2;//two moves in rewind
 					}
 
-					interpretedActions.push_back(commands[i]);
+					interpretedActions.enQueue(commands[i]);
 
 					plannedOffsetMotor1 += 1;
 				}
@@ -723,9 +1666,9 @@ bool interpretCommand()
 						const int *precalc = fastforward2;//Pointer to a (const int) not a constatn pointer to an int
 
 						u_int j = 0;
-						while(j < sizeof(precalc))
+						while(j < sizeof(fastforward2)/sizeof(fastforward2[0]))
 						{
-							interpretedActions.push_back(precalc[j]);
+							interpretedActions.enQueue(precalc[j]);
 
 							j += 1;
 						}
@@ -733,7 +1676,7 @@ bool interpretCommand()
 						plannedOffsetMotor2 += 2;//two moves in fastforward
 					}
 
-					interpretedActions.push_back(commands[i]);
+					interpretedActions.enQueue(commands[i]);
 
 					plannedOffsetMotor2 -= 1;
 				}
@@ -745,9 +1688,9 @@ bool interpretCommand()
 						const int *precalc = rewind2;//Pointer to a (const int) not a constatn pointer to an int
 
 						u_int j = 0;
-						while(j < sizeof(precalc))
+						while(j < sizeof(rewind2)/sizeof(rewind2[0]))
 						{
-							interpretedActions.push_back(precalc[j]);
+							interpretedActions.enQueue(precalc[j]);
 
 							j += 1;
 						}
@@ -755,7 +1698,7 @@ bool interpretCommand()
 						plannedOffsetMotor2 -= 2;//two moves in rewind
 					}
 
-					interpretedActions.push_back(commands[i]);
+					interpretedActions.enQueue(commands[i]);
 
 					plannedOffsetMotor2 += 1;
 				}
@@ -768,90 +1711,230 @@ bool interpretCommand()
 	return result;
 }
 
-// C++ program to demonstrate
-// accessing of data members
+//Event posted to the interpreter task when a command has been read
+constexpr Scheduler::EventFlags EVENT_COMMAND_READ = Scheduler::EVENT_USER;
+
+//Event posted to the motion task when new actions have been interpreted
+constexpr Scheduler::EventFlags EVENT_ACTIONS_READY = Scheduler::EVENT_USER;
+
+//Event posted to the comms task by the UART receive interrupt
+constexpr Scheduler::EventFlags EVENT_CHARACTER_RECEIVED = Scheduler::EVENT_USER;
 
-void thread1()
+Scheduler::TaskId interpreterTaskId = Scheduler::NO_TASK;
+Scheduler::TaskId motionTaskId      = Scheduler::NO_TASK;
+Scheduler::TaskId commsTaskId       = Scheduler::NO_TASK;
+
+/*
+ * Sequences interpreted actions through ControlUpdate()
+ * Runs periodically to check for steady state and when new actions are available
+ */
+void motionTask(Scheduler::EventFlags)
 {
-	//Reading from PC
-	readFromPC();
+	int action = 0;
 
-	//Check PIDs
-	ControlUpdate(0);
+	if(!interpretedActions.isEmpty())
+	{
+		action = interpretedActions.peek();
+	}
 
-	//Interpret commands
-	interpretCommand();
+	//ControlUpdate() only accepts the action once the previous one has completed
+	if(ControlUpdate(action) && (action != 0))
+	{
+		interpretedActions.deQueue();
 
-	//Check PIDs
-	ControlUpdate(0);
+		//Room may now be available for waiting commands
+		if(!readCommands.isEmpty())
+		{
+			Scheduler::postEvent(interpreterTaskId, EVENT_COMMAND_READ);
+		}
+	}
 }
 
-int main() {
-   console.writeln("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");//clear screen
+/*
+ * Reads characters from the PC
+ * Woken by the UART receive interrupt
+ */
+void commsTask(Scheduler::EventFlags)
+{
+	//Drain all characters received since the last run
+	while(ConsoleReader::isCharAvailable())
+	{
+		if(tuningRecordPending)
+		{
+			if(ConsoleReader::readFrame(tuningRecord, sizeof(tuningRecord), tuningRecordLength))
+			{
+				tuningRecordPending = false;
+				loadTuning(tuningRecord);
+			}
+		}
 
-   console.writeln("Starting");
+		else if(readFromPC())
+		{
+			Scheduler::postEvent(interpreterTaskId, EVENT_COMMAND_READ);
+		}
+	}
+}
 
-   console.write("Core clock = ").writeln(::SystemCoreClock);
-   console.write("Bus clock  = ").writeln(::SystemBusClock);
+/*
+ * Converts read commands into actions
+ * Commands are left queued until there is room for all the actions they may produce
+ */
+void interpreterTask(Scheduler::EventFlags)
+{
+	while(!readCommands.isEmpty() && (interpretedActions.getFreeCount() >= MAX_ACTIONS_PER_COMMAND))
+	{
+		interpretCommand();
+	}
 
-   initialise();
+	Scheduler::postEvent(motionTaskId, EVENT_ACTIONS_READY);
+}
 
-//   while(true)
-//   {
-//	   thread1();
-//   }
+/*
+ * Reports axis state when enabled
+ */
+void telemetryTask(Scheduler::EventFlags)
+{
+	if(telemetryEnabled)
+	{
+		console.write(Motor1::getPosition()).write(", ").write(pid1.getError()).write(", ").write(pid1.getFeedforward()).write(", ").
+				write(Motor2::getPosition()).write(", ").write(pid2.getError()).write(", ").writeln(pid2.getFeedforward());
+	}
+}
 
+/*
+ * Completes EEPROM writes started by Configuration::save() and IterativeLearning::save()
+ * One word is written per FlexRAM update so the other tasks are not held up
+ */
+void configurationTask(Scheduler::EventFlags)
+{
+	Configuration::poll();
+	IterativeLearning::poll();
+}
 
-pid1.setTunings(5.0f, 0.1f, 0.01f);
-pid1.enable(true);
-pid1.setSetpoint(0);
+/*
+ * Writes queued log records to flash
+ * Each erase or program is started and left to complete in the background
+ */
+void logTask(Scheduler::EventFlags)
+{
+	FlashLog::poll();
+}
 
-  pid2.setTunings(5.0f, 0.1f, 0.01f);
-  pid2.enable(true);
-  pid2.setSetpoint(0);
+/*
+ * Re-arms the bridge outputs after an over-current trip once the back-off has elapsed
+ */
+void protectionTask(Scheduler::EventFlags)
+{
+	BridgeProtection::poll();
+}
 
-  //demo
-  console.readChar();
-  Gripper1::close();
-  console.readChar();
-  Gripper2::close();
-  console.readChar();
+/*
+ * Add tasks to the scheduler
+ * Motion has the highest priority so a move is never delayed by communication
+ */
+void initialiseTasks()
+{
+	//                                 Function         Name           Pri  Period(ms)
+	motionTaskId      = Scheduler::addTask(motionTask,      "motion",      0,   10);
+	commsTaskId       = Scheduler::addTask(commsTask,       "comms",       1);
+	interpreterTaskId = Scheduler::addTask(interpreterTask, "interpreter", 2);
+	                    Scheduler::addTask(telemetryTask,   "telemetry",   3,   100);
+	                    Scheduler::addTask(configurationTask, "config",    4,   5);
+	                    Scheduler::addTask(logTask,         "log",         4,   5);
+	                    Scheduler::addTask(protectionTask,  "protection",  1,   5);
+
+	//Coroutines run below the interpreter but ahead of telemetry
+	Async::initialise(3);
+
+	//Received characters now wake the comms task
+	ConsoleReader::enable(commsTaskId, EVENT_CHARACTER_RECEIVED);
+}
 
-  //Demo
+/*
+ * Step-by-step demonstration
+ * Written linearly as a coroutine so other tasks keep running while it waits
+ */
+class DemoSequence : public Coroutine
+{
+public:
+	virtual bool resume() override
+	{
+		CO_BEGIN();
 
-  while(!ControlUpdate(1));
+		//Close grippers
+		CO_AWAIT(ControlUpdate(3));
+		CO_AWAIT(ControlUpdate(0));
+		CO_AWAIT(ControlUpdate(4));
+		CO_AWAIT(ControlUpdate(0));
+		CO_DELAY(STEP_DELAY);
 
-  while(!ControlUpdate(0));
+		CO_AWAIT(ControlUpdate(1));
+		CO_AWAIT(ControlUpdate(0));
+		CO_DELAY(STEP_DELAY);
 
-  console.readChar();
+		CO_AWAIT(ControlUpdate(1));
+		CO_AWAIT(ControlUpdate(0));
+		CO_DELAY(STEP_DELAY);
 
-  while(!ControlUpdate(1));
+		CO_AWAIT(ControlUpdate(-3));
+		CO_AWAIT(ControlUpdate(0));
+		CO_DELAY(STEP_DELAY);
 
-  while(!ControlUpdate(0));
+		CO_AWAIT(ControlUpdate(-1));
+		CO_AWAIT(ControlUpdate(0));
+		CO_DELAY(STEP_DELAY);
 
-  console.readChar();
+		CO_AWAIT(ControlUpdate(-1));
+		CO_AWAIT(ControlUpdate(0));
+		CO_DELAY(STEP_DELAY);
 
-  while(!ControlUpdate(-3));
+		CO_AWAIT(ControlUpdate(3));
+		CO_AWAIT(ControlUpdate(0));
 
-  while(!ControlUpdate(0));
+		console.writeln("Demo complete");
 
-  console.readChar();
+		CO_END();
+	}
 
-  while(!ControlUpdate(-1));
+private:
+	//Pause between steps (ms)
+	static constexpr uint32_t STEP_DELAY = 1000;
+};
 
-  while(!ControlUpdate(0));
+//Only one demonstration may run at a time
+CoroutinePool<DemoSequence, 1> demoPool;
 
-  console.readChar();
+void startDemo()
+{
+	if(demoPool.start() == nullptr)
+	{
+		console.writeln("Demo already running");
+	}
+}
 
-  while(!ControlUpdate(-1));
+int main() {
+   console.writeln("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");//clear screen
 
-  while(!ControlUpdate(0));
+   console.writeln("Starting");
 
-  console.readChar();
+   console.write("Core clock = ").writeln(::SystemCoreClock);
+   console.write("Bus clock  = ").writeln(::SystemBusClock);
 
-  while(!ControlUpdate(3));
+   initialise();
+
+pid1.setTunings(Configuration::data.kp[0], Configuration::data.ki[0], Configuration::data.kd[0]);
+applyModel(1);
+applyControllerOptions(1);
+pid1.enable(true);
+pid1.setSetpoint(0);
+
+  pid2.setTunings(Configuration::data.kp[1], Configuration::data.ki[1], Configuration::data.kd[1]);
+  applyModel(2);
+  applyControllerOptions(2);
+  pid2.enable(true);
+  pid2.setSetpoint(0);
 
-  while(!ControlUpdate(0));
+  initialiseTasks();
 
 //while(true)
 //{
@@ -870,9 +1953,9 @@ pid1.setSetpoint(0);
 //	}
 //}
 
-  console.writeln("Blocking");
+  console.writeln("Running");
 
-  console.readChar();
+  Scheduler::run();
 
    return 0;
 }
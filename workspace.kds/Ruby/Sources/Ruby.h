@@ -10,12 +10,25 @@
 
 #include "hardware.h"
 #include "dac.h"
+#include "AdcScan.h"
+#include "OverCurrentTrip.h"
 
 /** Motor/solenoid PWM period - define before Motor/Gripper includes */
 static constexpr float PWM_PERIOD  = 100 * USBDM::us; // 100 us + 10kHz
 
+/**
+ * Set to N > 0 to run the control loop from the motor PWM (FTM0) overflow every N PWM periods
+ * e.g. 1 => 10 kHz, 2 => 5 kHz. Positions are then sampled at a fixed point in the PWM
+ * cycle and the outputs are loaded at the end of the same cycle.
+ * 0 runs the control loop from the PIT every 500 us.
+ */
+#ifndef CONTROL_PWM_DIVISOR
+#define CONTROL_PWM_DIVISOR 0
+#endif
+
 #include "Motor.h"
 #include "Gripper.h"
+#include "ControlGroup.h"
 
 /*
  * Pin mapping
@@ -24,6 +37,12 @@ static constexpr float PWM_PERIOD  = 100 * USBDM::us; // 100 us + 10kHz
 using Motor1 = Motor<USBDM::Ftm0Info, 2,  3,   3, USBDM::Ftm1Info, USBDM::GpioA<5>>;
 using Motor2 = Motor<USBDM::Ftm0Info, 4,  5,   0, USBDM::Ftm2Info, USBDM::GpioB<3>>;
 
+/** Motors sampled and updated together by the control ISR (index 0 => Motor1) */
+using ControlGroup = ControlGroup_T<USBDM::Ftm0Info, Motor1, Motor2>;
+
+/** Hardware PWM shutdown on bridge driver error flags (FTM0 fault inputs) */
+using BridgeProtection = OverCurrentTrip_T<USBDM::Ftm0Info>;
+
 //                              FTM     Channel    OpenSensor       CloseSensor
 using Gripper1 = Gripper<USBDM::Ftm0Info, 7, USBDM::GpioE<0>, USBDM::GpioE<1>>;
 using Gripper2 = Gripper<USBDM::Ftm0Info, 1, USBDM::GpioC<0>, USBDM::GpioC<1>>;
@@ -32,20 +51,28 @@ using Gripper2 = Gripper<USBDM::Ftm0Info, 1, USBDM::GpioC<0>, USBDM::GpioC<1>>;
 using TpA = USBDM::Gpio_p54;
 using TpB = USBDM::Gpio_p56;
 
-class MotorSupplySensor : public USBDM::Adc1Channel<4> {
+/** Motor supply voltage divider input */
+using MotorSupplyInput = USBDM::Adc1Channel<4>;
+
+/** Background conversion of ADC1 inputs (8 scans buffered) */
+using Adc1Inputs = AdcScan<8, MotorSupplyInput>;
+
+class MotorSupplySensor {
 
 private:
    static constexpr float CALIB_FACTOR  = (11*3.3)/1024.0;  /* Ratio of external voltage to ADC reading 10K:1K divider - TBC */
    static constexpr float MINIMUM_LEVEL = 10.0;             /* Minimum supply voltage for motor */
+   static constexpr float SCAN_PERIOD   = 1*USBDM::ms;      /* Interval between conversions */
 
 public:
    /**
-    * Read Motor voltage using ADC
+    * Read Motor voltage\n
+    * Average of the buffered background conversions - does not block
     *
     * @return Voltage as float
     */
    static float motorVoltage() {
-      return readAnalogue()*CALIB_FACTOR;
+      return Adc1Inputs::average(0)*CALIB_FACTOR;
    }
    /**
     * Checks if motor voltage meets the minimum required
@@ -56,11 +83,17 @@ public:
       return (motorVoltage() > MINIMUM_LEVEL);
    }
 
+   /**
+    * Configure ADC and start background conversions\n
+    * Waits until the conversion buffer has filled
+    */
    static void initialise() {
-      configure(USBDM::AdcResolution_10bit_se, USBDM::AdcClockSource_Bus, USBDM::AdcClockDivider_8);
+      MotorSupplyInput::configure(USBDM::AdcResolution_10bit_se, USBDM::AdcClockSource_Bus, USBDM::AdcClockDivider_8);
       USBDM::waitMS(50);
-      calibrate();
-      setAveraging(USBDM::AdcAveraging_32);
+      MotorSupplyInput::calibrate();
+      MotorSupplyInput::setAveraging(USBDM::AdcAveraging_4);
+      Adc1Inputs::start(SCAN_PERIOD);
+      USBDM::waitMS(Adc1Inputs::SIZE*SCAN_PERIOD/USBDM::ms+1);
    }
 };
 
@@ -0,0 +1,244 @@
+/*
+ * Scheduler.cpp
+ *
+ *  Cooperative run-to-completion scheduler
+ */
+
+#include "Scheduler.h"
+#include "system.h"
+#include "pit.h"
+#include "MemoryMonitor.h"
+#include "Priorities.h"
+
+using namespace USBDM;
+
+/** PIT channel providing the 1 ms scheduler tick */
+using TickTimerChannel = PitChannel<1>;
+
+namespace {
+
+/** Task control block */
+struct Task {
+   Scheduler::TaskFunction    function;
+   volatile Scheduler::EventFlags events;
+   volatile uint32_t          countdown;   // ms until next EVENT_TIMER (0 => stopped)
+   volatile uint32_t          period;      // Reload value for countdown (0 => one-shot)
+   Scheduler::TaskStatistics  statistics;
+};
+
+/** Task table (indexed by TaskId) */
+Task tasks[Scheduler::MAX_TASKS];
+
+/** Number of tasks in use */
+int taskCount = 0;
+
+/** TaskIds sorted by priority - dispatch order */
+Scheduler::TaskId dispatchOrder[Scheduler::MAX_TASKS];
+
+/** Cycles spent sleeping or with nothing to do */
+uint64_t idleCycles = 0;
+
+/**
+ * Check if any task has pending events
+ *
+ * @return true if a task is ready
+ */
+bool isAnyTaskReady() {
+   for (int index=0; index<taskCount; index++) {
+      if (tasks[index].events != 0) {
+         return true;
+      }
+   }
+   return false;
+}
+
+}
+
+volatile uint32_t Scheduler::milliseconds = 0;
+
+/*
+ * Initialise the scheduler and start the 1 ms timer tick
+ */
+void Scheduler::initialise() {
+   // Enable DWT cycle counter for run-time accounting
+   CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+   DWT->CYCCNT       = 0;
+   DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+   Pit::configure(PitDebugMode_Stop);
+   TickTimerChannel::setCallback(tick);
+   TickTimerChannel::configure(1*ms, PitChannelIrq_Enable);
+   TickTimerChannel::enableNvicInterrupts(true, IrqPriority_Tick);
+}
+
+/*
+ * Timer tick - called from PIT ISR
+ */
+void Scheduler::tick() {
+   MemoryMonitor::sampleIsrEntry(MemoryMonitor::Isr_SchedulerTick);
+
+   milliseconds = milliseconds + 1;
+
+   for (int index=0; index<taskCount; index++) {
+      Task &task = tasks[index];
+      CommsCriticalSection cs;
+      if ((task.countdown != 0) && (--task.countdown == 0)) {
+         task.countdown = task.period;
+         task.events    = task.events | EVENT_TIMER;
+      }
+   }
+}
+
+/*
+ * Add a task
+ */
+Scheduler::TaskId Scheduler::addTask(TaskFunction function, const char *name, uint8_t priority, uint32_t periodMs) {
+   CommsCriticalSection cs;
+
+   if (taskCount >= MAX_TASKS) {
+      return NO_TASK;
+   }
+   TaskId id   = taskCount++;
+   Task  &task = tasks[id];
+
+   task.function             = function;
+   task.events               = 0;
+   task.countdown            = periodMs;
+   task.period               = periodMs;
+   task.statistics.name      = name;
+   task.statistics.priority  = priority;
+   task.statistics.runCount  = 0;
+   task.statistics.maxCycles = 0;
+   task.statistics.totalCycles = 0;
+
+   // Insert into dispatch order after tasks of same or higher priority
+   int position = id;
+   while ((position > 0) && (tasks[dispatchOrder[position-1]].statistics.priority > priority)) {
+      dispatchOrder[position] = dispatchOrder[position-1];
+      position--;
+   }
+   dispatchOrder[position] = id;
+
+   return id;
+}
+
+/*
+ * (Re)start the timer of a task
+ */
+void Scheduler::setTimer(TaskId id, uint32_t delayMs, uint32_t periodMs) {
+   usbdm_assert((id>=0) && (id<taskCount), "Illegal task");
+
+   CommsCriticalSection cs;
+   tasks[id].countdown = delayMs;
+   tasks[id].period    = periodMs;
+}
+
+/*
+ * Post events to a task
+ */
+void Scheduler::postEvent(TaskId id, EventFlags events) {
+   usbdm_assert((id>=0) && (id<taskCount), "Illegal task");
+
+   CommsCriticalSection cs;
+   tasks[id].events = tasks[id].events | events;
+}
+
+/*
+ * Dispatch the highest priority ready task (if any)
+ */
+bool Scheduler::runOnce() {
+   for (int index=0; index<taskCount; index++) {
+      Task &task = tasks[dispatchOrder[index]];
+      EventFlags events;
+      {
+         CommsCriticalSection cs;
+         events      = task.events;
+         task.events = 0;
+      }
+      if (events == 0) {
+         continue;
+      }
+      uint32_t startTime = DWT->CYCCNT;
+
+      task.function(events);
+
+      uint32_t elapsed = DWT->CYCCNT - startTime;
+      task.statistics.runCount++;
+      task.statistics.totalCycles += elapsed;
+      if (elapsed > task.statistics.maxCycles) {
+         task.statistics.maxCycles = elapsed;
+      }
+      return true;
+   }
+   return false;
+}
+
+/*
+ * Run the scheduler
+ */
+void Scheduler::run() {
+   for(;;) {
+      if (runOnce()) {
+         continue;
+      }
+      uint32_t startTime = DWT->CYCCNT;
+
+      // Interrupts are masked so an event posted after the check still wakes the WFI
+      __disable_irq();
+      if (!isAnyTaskReady()) {
+         __WFI();
+      }
+      __enable_irq();
+
+      idleCycles += DWT->CYCCNT - startTime;
+   }
+}
+
+/*
+ * Get run-time accounting for a task
+ */
+const Scheduler::TaskStatistics &Scheduler::getStatistics(TaskId id) {
+   usbdm_assert((id>=0) && (id<taskCount), "Illegal task");
+
+   return tasks[id].statistics;
+}
+
+/*
+ * Get cycles spent with no task ready
+ */
+uint64_t Scheduler::getIdleCycles() {
+   return idleCycles;
+}
+
+/*
+ * Clear run-time accounting for all tasks
+ */
+void Scheduler::resetStatistics() {
+   for (int index=0; index<taskCount; index++) {
+      tasks[index].statistics.runCount    = 0;
+      tasks[index].statistics.maxCycles   = 0;
+      tasks[index].statistics.totalCycles = 0;
+   }
+   idleCycles = 0;
+}
+
+/*
+ * Write run-time accounting for all tasks to the console
+ */
+void Scheduler::report() {
+   // Cycles per microsecond
+   uint32_t cyclesPerUs = ::SystemCoreClock/1000000;
+
+   console.write("Time = ").write(milliseconds).writeln(" ms");
+   console.writeln("Task\tPri\tRuns\tTotal(us)\tMax(us)");
+   for (int index=0; index<taskCount; index++) {
+      const TaskStatistics &statistics = tasks[dispatchOrder[index]].statistics;
+      console.
+         write(statistics.name).write('\t').
+         write(statistics.priority).write('\t').
+         write(statistics.runCount).write('\t').
+         write((uint32_t)(statistics.totalCycles/cyclesPerUs)).write('\t').
+         writeln(statistics.maxCycles/cyclesPerUs);
+   }
+   console.write("Idle = ").write((uint32_t)(idleCycles/cyclesPerUs)).writeln(" us");
+}
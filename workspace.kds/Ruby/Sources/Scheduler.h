@@ -0,0 +1,165 @@
+/*
+ * Scheduler.h
+ *
+ *  Cooperative run-to-completion scheduler
+ */
+
+#ifndef SOURCES_SCHEDULER_H_
+#define SOURCES_SCHEDULER_H_
+
+#include <stdint.h>
+#include "hardware.h"
+
+/**
+ * Cooperative run-to-completion scheduler
+ *
+ * Tasks are ordinary functions that are dispatched when one or more of their event
+ * flags are set and must return promptly (no busy-waiting).
+ * Flags are set by the task's timer (EVENT_TIMER) or by postEvent() which may be called from an ISR
+ * at IrqPriority_Comms or below (the scheduler state is protected at that level so the control
+ * ISR is never held off by the scheduler).
+ * When several tasks are ready the one with the highest priority (lowest value) is dispatched first.
+ * Time spent in each task is measured with the DWT cycle counter.
+ *
+ * Example:
+ * @code
+ *  void telemetryTask(Scheduler::EventFlags events) {
+ *     console.writeln(Motor1::getPosition());
+ *  }
+ *
+ *  Scheduler::initialise();
+ *  Scheduler::addTask(telemetryTask, "telemetry", 3, 100); // Every 100 ms
+ *  Scheduler::run();
+ * @endcode
+ */
+class Scheduler {
+
+public:
+   /** Bit-mask of events delivered to a task */
+   typedef uint32_t EventFlags;
+
+   /** Task entry point - called with the events that made it ready */
+   typedef void (*TaskFunction)(EventFlags events);
+
+   /** Handle used to refer to a task */
+   typedef int TaskId;
+
+   /** Task timer expired */
+   static constexpr EventFlags EVENT_TIMER = (1<<0);
+   /** First event flag available for application use */
+   static constexpr EventFlags EVENT_USER  = (1<<1);
+
+   /** Maximum number of tasks */
+   static constexpr int    MAX_TASKS = 8;
+   /** Returned by addTask() when there is no room for the task */
+   static constexpr TaskId NO_TASK   = -1;
+
+   /** Run-time accounting for a task */
+   struct TaskStatistics {
+      const char *name;          //!< Name given to addTask()
+      uint8_t     priority;      //!< Priority (0 = highest)
+      uint32_t    runCount;      //!< Number of times dispatched
+      uint32_t    maxCycles;     //!< Longest single execution (core clock cycles)
+      uint64_t    totalCycles;   //!< Total execution time (core clock cycles)
+   };
+
+private:
+   Scheduler() = delete;
+   Scheduler(const Scheduler&) = delete;
+
+   /** Time since initialise() in milliseconds */
+   static volatile uint32_t milliseconds;
+
+   /** Timer tick - called from PIT ISR */
+   static void tick();
+
+public:
+   /**
+    * Initialise the scheduler and start the 1 ms timer tick
+    */
+   static void initialise();
+
+   /**
+    * Add a task
+    *
+    * @param[in] function  Function to call when the task is ready
+    * @param[in] name      Name used when reporting
+    * @param[in] priority  Priority (0 = highest)
+    * @param[in] periodMs  Period for EVENT_TIMER in milliseconds (0 => not periodic)
+    *
+    * @return Id of task or NO_TASK if the task table is full
+    */
+   static TaskId addTask(TaskFunction function, const char *name, uint8_t priority, uint32_t periodMs=0);
+
+   /**
+    * (Re)start the timer of a task
+    *
+    * @param[in] task     Task to modify
+    * @param[in] delayMs  Milliseconds until next EVENT_TIMER (0 => stop timer)
+    * @param[in] periodMs Period after the first event (0 => one-shot)
+    */
+   static void setTimer(TaskId task, uint32_t delayMs, uint32_t periodMs=0);
+
+   /**
+    * Post events to a task
+    *
+    * @param[in] task   Task to make ready
+    * @param[in] events Event flags to set
+    *
+    * @note May be called from an ISR at IrqPriority_Comms or below
+    */
+   static void postEvent(TaskId task, EventFlags events);
+
+   /**
+    * Dispatch the highest priority ready task (if any)
+    *
+    * @return true  => A task was run
+    * @return false => No tasks were ready
+    */
+   static bool runOnce();
+
+   /**
+    * Run the scheduler\n
+    * The processor sleeps while no tasks are ready
+    *
+    * @note Does not return
+    */
+   static void __attribute__((noreturn)) run();
+
+   /**
+    * Get time since the scheduler was initialised
+    *
+    * @return Time in milliseconds
+    */
+   static uint32_t getTime() {
+      return milliseconds;
+   }
+
+   /**
+    * Get run-time accounting for a task
+    *
+    * @param[in] task Task to query
+    *
+    * @return Statistics for task
+    */
+   static const TaskStatistics &getStatistics(TaskId task);
+
+   /**
+    * Get cycles spent with no task ready
+    *
+    * @return Idle time in core clock cycles
+    */
+   static uint64_t getIdleCycles();
+
+   /**
+    * Clear run-time accounting for all tasks
+    */
+   static void resetStatistics();
+
+   /**
+    * Write run-time accounting for all tasks to the console
+    */
+   static void report();
+};
+
+#endif /* SOURCES_SCHEDULER_H_ */
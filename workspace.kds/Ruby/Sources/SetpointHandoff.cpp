@@ -0,0 +1,21 @@
+/*
+ * SetpointHandoff.cpp
+ *
+ *  Lock-free passing of moves from the tasks to the control ISR
+ */
+
+#include "SetpointHandoff.h"
+
+/*
+ * Take the last move posted
+ */
+RAMFUNC bool SetpointHandoff::take(Request &request) {
+   uint32_t current = sequence;
+   if ((current == taken) || (current&1)) {
+      return false;
+   }
+   __DMB();
+   request = this->request;
+   taken   = current;
+   return true;
+}
@@ -0,0 +1,109 @@
+/*
+ * SetpointHandoff.h
+ *
+ *  Lock-free passing of moves from the tasks to the control ISR
+ */
+
+#ifndef SOURCES_SETPOINTHANDOFF_H_
+#define SOURCES_SETPOINTHANDOFF_H_
+
+#include "hardware.h"
+#include "RamFunction.h"
+#include "Trajectory.h"
+
+/**
+ * Single-slot mailbox of the move for one axis
+ *
+ * A task posts the move and the control ISR takes it at its next sample and starts it
+ * (PID_T::setSetpoint() or Trajectory::start()) so the controller state is only changed
+ * by the ISR. Neither side waits or masks interrupts.
+ *
+ * post() makes the sequence odd while it writes the request. take() ignores an odd
+ * sequence - the ISR has interrupted post() and the request will be taken at the next
+ * sample. A newer post() replaces a request that has not been taken.
+ * There must only be one task posting to a mailbox at a time.
+ *
+ * Example:
+ * @code
+ *  SetpointHandoff handoff1;
+ *
+ *  // Task
+ *  handoff1.post(pid1.getSetpoint()+QUARTERROTATIONTICKS);
+ *
+ *  // Control ISR before pid1.update()
+ *  SetpointHandoff::Request request;
+ *  if (handoff1.take(request)) {
+ *     pid1.setSetpoint(request.target);
+ *  }
+ * @endcode
+ */
+class SetpointHandoff {
+
+public:
+   /** Move for the ISR to start */
+   struct Request {
+      float              target;   //!< Position at end of move (ticks)
+      Trajectory::Limits limits;   //!< Profile limits - zero steps the setpoint to target
+   };
+
+private:
+   /** Odd while post() is writing request, even once complete */
+   volatile uint32_t sequence = 0;
+
+   /** Sequence of the last request taken */
+   volatile uint32_t taken = 0;
+
+   /** Last request posted */
+   Request request = {};
+
+public:
+   /**
+    * Post a move that steps the setpoint\n
+    * Call from a task.
+    *
+    * @param[in] target Position at end of move (ticks)
+    */
+   void post(float target) {
+      post(target, {0, 0});
+   }
+
+   /**
+    * Post a move that follows a profile\n
+    * Call from a task.
+    *
+    * @param[in] target Position at end of move (ticks)
+    * @param[in] limits Profile limits
+    */
+   void post(float target, const Trajectory::Limits &limits) {
+      uint32_t start = sequence;
+      sequence = start+1;
+      __DMB();
+      request.target = target;
+      request.limits = limits;
+      __DMB();
+      sequence = start+2;
+   }
+
+   /**
+    * Indicates a move has been posted but not yet taken by the ISR\n
+    * The controller setpoint and steady state don't reflect the move until it is taken.
+    *
+    * @return true => Move pending
+    */
+   bool isPending() const {
+      return sequence != taken;
+   }
+
+   /**
+    * Take the last move posted\n
+    * Call from the control ISR.
+    *
+    * @param[out] request Move to start
+    *
+    * @return true  => New move in request
+    * @return false => Nothing posted since the last take (or post() was interrupted)
+    */
+   RAMFUNC bool take(Request &request);
+};
+
+#endif /* SOURCES_SETPOINTHANDOFF_H_ */
@@ -0,0 +1,398 @@
+/*
+ * StaticContainers.h
+ *
+ *  Fixed-capacity containers sized at compile time (no heap)
+ */
+
+#ifndef SOURCES_STATICCONTAINERS_H_
+#define SOURCES_STATICCONTAINERS_H_
+
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include "hardware.h"
+#include "system.h"
+
+/**
+ * Vector with fixed capacity
+ *
+ * Elements are stored in-place so T must be default constructible and copyable.
+ *
+ * @tparam T  Type of elements
+ * @tparam N  Capacity
+ */
+template<class T, unsigned N>
+class StaticVector {
+
+private:
+   T        elements[N];
+   unsigned count = 0;
+
+public:
+   /**
+    * Add element to end
+    *
+    * @param[in] element Element to add
+    *
+    * @return true  => Element added
+    * @return false => Vector full, element discarded
+    */
+   bool push_back(const T &element) {
+      if (count >= N) {
+         return false;
+      }
+      elements[count++] = element;
+      return true;
+   }
+
+   /**
+    * Remove element from end (if any)
+    */
+   void pop_back() {
+      if (count > 0) {
+         count--;
+      }
+   }
+
+   /**
+    * Remove element, moving following elements down
+    *
+    * @param[in] index Index of element to remove (ignored if out of range)
+    */
+   void erase(unsigned index) {
+      if (index >= count) {
+         return;
+      }
+      for (unsigned sub=index+1; sub<count; sub++) {
+         elements[sub-1] = elements[sub];
+      }
+      count--;
+   }
+
+   /** Remove all elements */
+   void clear()                           { count = 0; }
+
+   /** @return Number of elements */
+   unsigned size() const                  { return count; }
+
+   /** @return Maximum number of elements */
+   static constexpr unsigned capacity()   { return N; }
+
+   /** @return true => no elements */
+   bool isEmpty() const                   { return count == 0; }
+
+   /** @return true => at capacity */
+   bool isFull() const                    { return count >= N; }
+
+   T       &operator[](unsigned index)       { return elements[index]; }
+   const T &operator[](unsigned index) const { return elements[index]; }
+
+   T       *begin()       { return elements; }
+   T       *end()         { return elements+count; }
+   const T *begin() const { return elements; }
+   const T *end()   const { return elements+count; }
+};
+
+/**
+ * Ring buffer with fixed capacity
+ *
+ * Safe without locking for a single producer and a single consumer
+ * e.g. an ISR adding elements and a task removing them.
+ *
+ * @tparam T  Type of elements
+ * @tparam N  Capacity
+ */
+template<class T, unsigned N>
+class RingBuffer {
+
+private:
+   // One slot is left empty to distinguish full from empty
+   static constexpr unsigned SIZE = N+1;
+
+   T                 buffer[SIZE];
+   volatile unsigned head = 0;      // Next element to remove (changed by consumer only)
+   volatile unsigned tail = 0;      // Next free slot         (changed by producer only)
+
+   static unsigned advance(unsigned index) {
+      return (index+1 >= SIZE)?0:index+1;
+   }
+
+public:
+   /**
+    * Add element (producer)
+    *
+    * @param[in] element Element to add
+    *
+    * @return true  => Element added
+    * @return false => Buffer full, element discarded
+    */
+   bool enQueue(const T &element) {
+      unsigned next = advance(tail);
+      if (next == head) {
+         return false;
+      }
+      buffer[tail] = element;
+      // Element must be written before it is made visible to the consumer
+      __DMB();
+      tail = next;
+      return true;
+   }
+
+   /**
+    * Remove element (consumer)
+    *
+    * @return Element removed
+    *
+    * @note Buffer must not be empty
+    */
+   T deQueue() {
+      T element = buffer[head];
+      __DMB();
+      head = advance(head);
+      return element;
+   }
+
+   /**
+    * Get oldest element without removing it (consumer)
+    *
+    * @return Reference to element
+    *
+    * @note Buffer must not be empty
+    */
+   const T &peek() const {
+      return buffer[head];
+   }
+
+   /**
+    * Remove all elements (consumer)
+    */
+   void clear() {
+      head = tail;
+   }
+
+   /** @return Number of elements */
+   unsigned size() const {
+      unsigned h = head;
+      unsigned t = tail;
+      return (t>=h)?(t-h):(SIZE-h+t);
+   }
+
+   /** @return Number of free slots */
+   unsigned getFreeCount() const          { return N-size(); }
+
+   /** @return Maximum number of elements */
+   static constexpr unsigned capacity()   { return N; }
+
+   /** @return true => no elements */
+   bool isEmpty() const                   { return head == tail; }
+
+   /** @return true => at capacity */
+   bool isFull() const                    { return advance(tail) == head; }
+};
+
+/**
+ * Pool of objects with fixed capacity
+ *
+ * Objects are constructed in place on allocate() and destroyed on release().
+ *
+ * @tparam T  Type of objects
+ * @tparam N  Number of objects
+ */
+template<class T, unsigned N>
+class ObjectPool {
+
+private:
+   alignas(T) uint8_t storage[N][sizeof(T)];
+   bool               inUse[N] = {};
+
+public:
+   /**
+    * Construct an object from the pool
+    *
+    * @param[in] args Arguments for constructor of T
+    *
+    * @return Pointer to object or nullptr if pool exhausted
+    */
+   template<typename... Args>
+   T *allocate(Args... args) {
+      CriticalSection cs;
+      for (unsigned index=0; index<N; index++) {
+         if (!inUse[index]) {
+            inUse[index] = true;
+            return new (storage[index]) T(args...);
+         }
+      }
+      return nullptr;
+   }
+
+   /**
+    * Destroy object and return it to the pool
+    *
+    * @param[in] object Object obtained from allocate()
+    */
+   void release(T *object) {
+      unsigned index = ((uint8_t*)object - storage[0])/sizeof(T);
+      if ((index >= N) || !inUse[index]) {
+         USBDM::setAndCheckErrorCode(USBDM::E_ILLEGAL_PARAM);
+         return;
+      }
+      object->~T();
+      CriticalSection cs;
+      inUse[index] = false;
+   }
+
+   /** @return Number of objects allocated */
+   unsigned getUsedCount() const {
+      unsigned used = 0;
+      for (unsigned index=0; index<N; index++) {
+         if (inUse[index]) {
+            used++;
+         }
+      }
+      return used;
+   }
+
+   /** @return Number of objects in pool */
+   static constexpr unsigned capacity()   { return N; }
+};
+
+/**
+ * Link embedded in objects held by an IntrusiveList
+ *
+ * Example:
+ * @code
+ * class Move : public IntrusiveListNode<Move> {
+ *    ...
+ * };
+ * IntrusiveList<Move> pendingMoves;
+ * @endcode
+ *
+ * @tparam T  Type of object containing the link
+ */
+template<class T>
+class IntrusiveListNode {
+
+   template<class> friend class IntrusiveList;
+
+private:
+   T *next = nullptr;
+   T *prev = nullptr;
+};
+
+/**
+ * Doubly linked list of objects that contain their own links
+ *
+ * No storage is allocated. An object may only be in one list at a time.
+ *
+ * @tparam T  Type of objects - must inherit from IntrusiveListNode<T>
+ */
+template<class T>
+class IntrusiveList {
+
+private:
+   T        *first = nullptr;
+   T        *last  = nullptr;
+   unsigned  count = 0;
+
+   static IntrusiveListNode<T> &node(T *object) {
+      return *static_cast<IntrusiveListNode<T>*>(object);
+   }
+
+public:
+   /**
+    * Add object to end of list
+    *
+    * @param[in] object Object to add
+    */
+   void pushBack(T *object) {
+      node(object).next = nullptr;
+      node(object).prev = last;
+      if (last != nullptr) {
+         node(last).next = object;
+      }
+      else {
+         first = object;
+      }
+      last = object;
+      count++;
+   }
+
+   /**
+    * Add object to start of list
+    *
+    * @param[in] object Object to add
+    */
+   void pushFront(T *object) {
+      node(object).prev = nullptr;
+      node(object).next = first;
+      if (first != nullptr) {
+         node(first).prev = object;
+      }
+      else {
+         last = object;
+      }
+      first = object;
+      count++;
+   }
+
+   /**
+    * Remove object from list
+    *
+    * @param[in] object Object to remove (must be in this list)
+    */
+   void remove(T *object) {
+      T *next = node(object).next;
+      T *prev = node(object).prev;
+      if (prev != nullptr) {
+         node(prev).next = next;
+      }
+      else {
+         first = next;
+      }
+      if (next != nullptr) {
+         node(next).prev = prev;
+      }
+      else {
+         last = prev;
+      }
+      node(object).next = nullptr;
+      node(object).prev = nullptr;
+      count--;
+   }
+
+   /**
+    * Remove and return first object
+    *
+    * @return First object or nullptr if list empty
+    */
+   T *popFront() {
+      T *object = first;
+      if (object != nullptr) {
+         remove(object);
+      }
+      return object;
+   }
+
+   /** @return First object or nullptr */
+   T *front() const                    { return first; }
+
+   /** @return Last object or nullptr */
+   T *back() const                     { return last; }
+
+   /**
+    * Get object following another
+    *
+    * @param[in] object Object in list
+    *
+    * @return Next object or nullptr at end of list
+    */
+   static T *next(T *object)           { return node(object).next; }
+
+   /** @return Number of objects in list */
+   unsigned size() const               { return count; }
+
+   /** @return true => list empty */
+   bool isEmpty() const                { return first == nullptr; }
+};
+
+#endif /* SOURCES_STATICCONTAINERS_H_ */
@@ -0,0 +1,269 @@
+/*
+ * SystemIdentification.cpp
+ *
+ *  Measures the response of a motor to seed the position controller
+ */
+
+#include <math.h>
+#include "hardware.h"
+#include "pid.h"
+#include "SystemIdentification.h"
+
+using namespace USBDM;
+
+namespace {
+
+/** Number of model parameters (a, b1, b0, c) */
+constexpr unsigned PARAMETERS = 4;
+
+/** Feedback taps of 8-bit maximal length LFSR (x^8+x^6+x^5+x^4+1) */
+constexpr uint8_t LFSR_TAPS = 0xB8;
+
+/** Relative amplitude of PRBS levels selected by the upper LFSR bits */
+constexpr float PRBS_LEVELS[4] = {1.0f, 0.6f, 0.35f, 0.15f};
+
+/** Fewest records accepted by fit() */
+constexpr unsigned MIN_SAMPLES = SystemIdentification::SAMPLES/4;
+
+constexpr float PI = 3.14159265f;
+
+/**
+ * Sign of velocity
+ *
+ * @param[in] velocity Velocity
+ *
+ * @return -1, 0 or +1
+ */
+inline double sign(double velocity) {
+   return (velocity>0)?1:((velocity<0)?-1:0);
+}
+
+/**
+ * Solve linear equations by Gaussian elimination with partial pivoting
+ *
+ * @param[in,out] matrix   Coefficients (destroyed)
+ * @param[in,out] vector   Right-hand side on entry, solution on exit
+ *
+ * @return false => equations are singular
+ */
+bool solve(double (&matrix)[PARAMETERS][PARAMETERS], double (&vector)[PARAMETERS]) {
+   for (unsigned column=0; column<PARAMETERS; column++) {
+      unsigned pivot = column;
+      for (unsigned row=column+1; row<PARAMETERS; row++) {
+         if (fabs(matrix[row][column]) > fabs(matrix[pivot][column])) {
+            pivot = row;
+         }
+      }
+      if (fabs(matrix[pivot][column]) < 1e-12) {
+         return false;
+      }
+      if (pivot != column) {
+         for (unsigned index=0; index<PARAMETERS; index++) {
+            double temp = matrix[column][index];
+            matrix[column][index] = matrix[pivot][index];
+            matrix[pivot][index]  = temp;
+         }
+         double temp = vector[column];
+         vector[column] = vector[pivot];
+         vector[pivot]  = temp;
+      }
+      for (unsigned row=column+1; row<PARAMETERS; row++) {
+         double factor = matrix[row][column]/matrix[column][column];
+         for (unsigned index=column; index<PARAMETERS; index++) {
+            matrix[row][index] -= factor*matrix[column][index];
+         }
+         vector[row] -= factor*vector[column];
+      }
+   }
+   for (unsigned row=PARAMETERS; row-->0;) {
+      double sum = vector[row];
+      for (unsigned index=row+1; index<PARAMETERS; index++) {
+         sum -= matrix[row][index]*vector[index];
+      }
+      vector[row] = sum/matrix[row][row];
+   }
+   return true;
+}
+
+}
+
+SystemIdentification::Settings SystemIdentification::settings = {
+      /* excitation     */ Excitation_Prbs,
+      /* amplitude      */ 20.0f,
+      /* prbsHold       */ 4,
+      /* chirpStart     */ 2.0f,
+      /* chirpEnd       */ 50.0f,
+      /* travelLimit    */ FULLROTATIONTICKS,
+      /* closedLoopTime */ 4e-3f,
+};
+
+/*
+ * Start an identification run
+ */
+void SystemIdentification::start(uint8_t axis, bool encoderAndMotorMatchDirection, float position) {
+   running = false;
+   float recordTime = decimation*sampleTime;
+
+   this->axis    = axis;
+   direction     = encoderAndMotorMatchDirection?1:-1;
+   excitation    = settings.excitation;
+   count         = 0;
+   subSample     = 0;
+   startPosition = position;
+   output        = 0;
+   lfsr          = 1;
+   phase         = 0;
+   frequency     = settings.chirpStart*recordTime;
+   running       = true;
+}
+
+/*
+ * Calculate the output for the next record
+ */
+RAMFUNC float SystemIdentification::excite() {
+   if (excitation == Excitation_Chirp) {
+      float value = settings.amplitude*sinf(2*PI*phase);
+      phase += frequency;
+      if (phase >= 1.0f) {
+         phase -= 1.0f;
+      }
+      frequency += (settings.chirpEnd-settings.chirpStart)*(decimation*sampleTime)/SAMPLES;
+      return value;
+   }
+   if ((count%settings.prbsHold) == 0) {
+      lfsr = (lfsr>>1)^((lfsr&1)?LFSR_TAPS:0);
+   }
+   // Level varies so friction is not confused with gain (sgn(v) would follow sgn(u))
+   float value = settings.amplitude*PRBS_LEVELS[(lfsr>>1)&3];
+   return (lfsr&1)?value:-value;
+}
+
+/*
+ * Record the position and calculate the motor output
+ */
+RAMFUNC float SystemIdentification::update(float position) {
+   if (!running) {
+      return 0;
+   }
+   if (subSample == 0) {
+      float travel = position-startPosition;
+      if ((count >= SAMPLES) || (travel > settings.travelLimit) || (travel < -settings.travelLimit)) {
+         running = false;
+         output  = 0;
+         return 0;
+      }
+      output = excite();
+      samples[count].position = (int16_t)travel;
+      samples[count].output   = (int16_t)(output*SCALE);
+      count = count+1;
+   }
+   if (++subSample >= decimation) {
+      subSample = 0;
+   }
+   return direction*output;
+}
+
+/*
+ * Fit the model to the records of the last run
+ */
+bool SystemIdentification::fit(Model &model) const {
+   unsigned records = count;
+   if (running || (records < MIN_SAMPLES)) {
+      return false;
+   }
+   // Velocity over record interval k is p[k+1]-p[k] (ticks/record) driven by u[k]
+   double normal[PARAMETERS][PARAMETERS] = {};
+   double vector[PARAMETERS]             = {};
+   double velocitySquared                = 0;
+   for (unsigned k=1; k+2<records; k++) {
+      double previous = samples[k].position-samples[k-1].position;
+      double velocity = samples[k+1].position-samples[k].position;
+      double next     = samples[k+2].position-samples[k+1].position;
+      // Direction at the start of the next interval is extrapolated from earlier records
+      // (sgn(next) would correlate with the noise being fitted)
+      double regressor[PARAMETERS] = {
+            velocity,
+            samples[k+1].output*(1/SCALE),
+            samples[k].output*(1/SCALE),
+            -sign(1.5*velocity-0.5*previous),
+      };
+      for (unsigned row=0; row<PARAMETERS; row++) {
+         for (unsigned column=0; column<PARAMETERS; column++) {
+            normal[row][column] += regressor[row]*regressor[column];
+         }
+         vector[row] += regressor[row]*next;
+      }
+      velocitySquared += next*next;
+   }
+   // solve() destroys its arguments - the originals are needed for the residual
+   double matrix[PARAMETERS][PARAMETERS];
+   double rhs[PARAMETERS];
+   for (unsigned row=0; row<PARAMETERS; row++) {
+      for (unsigned column=0; column<PARAMETERS; column++) {
+         matrix[row][column] = normal[row][column];
+      }
+      rhs[row] = vector[row];
+   }
+   if (!solve(matrix, rhs)) {
+      return false;
+   }
+   // Residual from the normal equations: |y|^2 - 2*theta.X'y + theta.X'X.theta
+   double residualSquared = velocitySquared;
+   for (unsigned row=0; row<PARAMETERS; row++) {
+      residualSquared -= 2*rhs[row]*vector[row];
+      for (unsigned column=0; column<PARAMETERS; column++) {
+         residualSquared += rhs[row]*normal[row][column]*rhs[column];
+      }
+   }
+   double a        = rhs[0];
+   double b        = rhs[1]+rhs[2];
+   double c        = rhs[3];
+   double interval = decimation*sampleTime;
+   if ((a <= 0) || (a >= 1) || (b <= 0) || (velocitySquared <= 0)) {
+      return false;
+   }
+   model.gain         = (float)(b/(1-a)/interval);
+   model.timeConstant = (float)(-interval/log(a));
+   model.friction     = (c > 0)?(float)(c/b):0.0f;
+   model.fitError     = (float)sqrt(((residualSquared>0)?residualSquared:0)/velocitySquared);
+   return true;
+}
+
+/*
+ * Write the records of the last run to the console
+ */
+void SystemIdentification::dump() const {
+   unsigned records = count;
+   console.write("Identification axis ").write(axis).
+         write(": records = ").write(records).
+         write(", interval = ").write((unsigned)(decimation*sampleTime*1e6f+0.5f)).
+         write(" us, excitation = ").writeln((excitation == Excitation_Chirp)?"chirp":"PRBS");
+   for (unsigned k=0; k<records; k++) {
+      console.write(k).write(", ").write(samples[k].position).write(", ").writeln(samples[k].output);
+   }
+}
+
+/*
+ * Calculate position controller tunings from a model
+ */
+void SystemIdentification::seedTunings(const Model &model, float &kp, float &ki, float &kd) {
+   float gain           = model.gain*settings.closedLoopTime;
+   float integralTime   = 4*settings.closedLoopTime;
+   float derivativeTime = model.timeConstant;
+
+   // Series form PI(1+sTd) converted to the parallel form used by PID_T
+   kp = (1+derivativeTime/integralTime)/gain;
+   ki = 1/(gain*integralTime);
+   kd = derivativeTime/gain;
+}
+
+/*
+ * Write a model to the console
+ */
+void SystemIdentification::report(unsigned axis, const Model &model) {
+   console.write("Motor ").write(axis).
+         write(" model: gain = ").write(model.gain).
+         write(" ticks/s/%, time constant = ").write(model.timeConstant*1000).
+         write(" ms, friction = ").write(model.friction).
+         write(" %, fit error = ").writeln(model.fitError);
+}
@@ -0,0 +1,258 @@
+/*
+ * SystemIdentification.h
+ *
+ *  Measures the response of a motor to seed the position controller
+ */
+
+#ifndef SOURCES_SYSTEMIDENTIFICATION_H_
+#define SOURCES_SYSTEMIDENTIFICATION_H_
+
+#include <stdint.h>
+#include "RamFunction.h"
+
+/**
+ * Open-loop identification of an axis
+ *
+ * While running, the position controller of the axis is disabled and the motor is
+ * driven directly from the control ISR with a PRBS (pseudo-random binary sequence)
+ * or chirp (swept sine) excitation. Every RECORD_INTERVAL the position and the output
+ * applied until the next record are stored in RAM.
+ *
+ * The records are fitted by least squares to a first-order velocity model with
+ * Coulomb friction:
+ *
+ *    tau * dv/dt = -v + gain * (u - friction * sgn(v))
+ *
+ * where v is the encoder velocity (ticks/s) and u is the output (%) in the controller's
+ * direction (positive output increases the position). Averaged over a record interval
+ * the model becomes
+ *
+ *    v[k+1] = a*v[k] + b1*u[k+1] + b0*u[k] - c*sgn(w[k+1])
+ *
+ * with gain = (b0+b1)/(1-a), tau = -T/ln(a) and friction = c/(b0+b1). w[k+1] is the
+ * velocity at the start of the interval extrapolated from v[k] and v[k-1].
+ * The PRBS level is also varied so the friction term is not confused with the gain.
+ *
+ * The run stops early if the axis travels further than Settings::travelLimit
+ * so it may be run with the gripper open or holding the cube.
+ *
+ * Example:
+ * @code
+ *  SystemIdentification identification(pidInterval);
+ *
+ *  // Task
+ *  pid1.enable(false);
+ *  identification.start(1, false, Motor1::getPositionAsFloat());
+ *
+ *  // Control ISR
+ *  if (identification.isRunning()) {
+ *     Motor1::setSpeed(identification.update(Motor1::getPositionAsFloat()));
+ *  }
+ *
+ *  // Task once !identification.isRunning()
+ *  pid1.enable(true);
+ *  SystemIdentification::Model model;
+ *  if (identification.fit(model)) {
+ *     ...
+ *  }
+ * @endcode
+ */
+class SystemIdentification {
+
+public:
+   /** Maximum number of records */
+   static constexpr unsigned SAMPLES = 1024;
+
+   /** Interval between records (s) - 2 s run at any control rate */
+   static constexpr float RECORD_INTERVAL = 2e-3f;
+
+   /** Stored output units per unit of output */
+   static constexpr float SCALE = 100.0f;
+
+   /** Excitation applied to the motor */
+   enum Excitation : uint8_t {
+      Excitation_Prbs  = 0,  //!< +/-amplitude at four levels switched by an 8-bit maximal length sequence
+      Excitation_Chirp = 1,  //!< amplitude*sin() with frequency swept linearly over the run
+   };
+
+   /** Identification parameters (shared by all axes) */
+   struct Settings {
+      Excitation excitation;     //!< Excitation to apply
+      float      amplitude;      //!< Output amplitude (%)
+      unsigned   prbsHold;       //!< Records each PRBS bit is held for
+      float      chirpStart;     //!< Chirp start frequency (Hz)
+      float      chirpEnd;       //!< Chirp end frequency (Hz)
+      int32_t    travelLimit;    //!< Largest distance from the start position before stopping (ticks)
+      float      closedLoopTime; //!< Closed-loop time constant requested from seedTunings() (s)
+   };
+
+   /** One record */
+   struct Sample {
+      int16_t position;          //!< Position relative to start (ticks)
+      int16_t output;            //!< Output until the next record (output*SCALE, controller direction)
+   };
+
+   /** Fitted model */
+   struct Model {
+      float gain;                //!< Steady-state velocity per unit of output (ticks/s per %)
+      float timeConstant;        //!< Mechanical time constant (s)
+      float friction;            //!< Output needed to overcome Coulomb friction (%)
+      float fitError;            //!< RMS residual relative to RMS velocity
+   };
+
+   /** Identification parameters */
+   static Settings settings;
+
+private:
+   /** Control sample interval (s) */
+   const float sampleTime;
+
+   /** Control samples in each record */
+   const unsigned decimation;
+
+   /** Axis being identified (1 or 2) */
+   uint8_t axis = 0;
+
+   /** Motor direction relative to the encoder (as PID_T) */
+   float direction = 1;
+
+   /** Excitation used for the recorded run */
+   Excitation excitation = Excitation_Prbs;
+
+   /** Excitation running */
+   volatile bool running = false;
+
+   /** Number of records made */
+   volatile unsigned count = 0;
+
+   /** Control samples since the last record */
+   unsigned subSample = 0;
+
+   /** Position at start (ticks) */
+   float startPosition = 0;
+
+   /** Current output (controller direction) */
+   float output = 0;
+
+   /** PRBS generator state */
+   uint8_t lfsr = 1;
+
+   /** Chirp phase (cycles) and frequency (cycles/record) */
+   float phase     = 0;
+   float frequency = 0;
+
+   /** Recorded response */
+   Sample samples[SAMPLES];
+
+   /**
+    * Calculate the output for the next record
+    *
+    * @return Output (controller direction)
+    */
+   RAMFUNC float excite();
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] sampleTime Interval between calls to update() (s)
+    */
+   SystemIdentification(float sampleTime) :
+      sampleTime(sampleTime),
+      decimation((sampleTime < RECORD_INTERVAL)?(unsigned)(RECORD_INTERVAL/sampleTime+0.5f):1) {
+   }
+
+   /**
+    * Start an identification run\n
+    * The controller for the axis must be disabled first.
+    *
+    * @param[in] axis                          Axis being identified (1 or 2)
+    * @param[in] encoderAndMotorMatchDirection Defines if the encoder and motor use the same direction of rotation (as PID_T)
+    * @param[in] position                      Current position of the axis
+    */
+   void start(uint8_t axis, bool encoderAndMotorMatchDirection, float position);
+
+   /**
+    * Record the position and calculate the motor output\n
+    * Call from the control ISR while isRunning().
+    *
+    * @param[in] position Position of the axis
+    *
+    * @return Motor speed (as Motor::setSpeed()) - 0 once the run has finished
+    */
+   RAMFUNC float update(float position);
+
+   /**
+    * Stop the run (records made so far are kept)
+    */
+   void stop() {
+      running = false;
+   }
+
+   /**
+    * Indicates a run is in progress
+    *
+    * @return true => motor is being driven by update()
+    */
+   RAMFUNC_INLINE bool isRunning() const {
+      return running;
+   }
+
+   /**
+    * Get axis of the last run
+    *
+    * @return 1 or 2 (0 if never run)
+    */
+   RAMFUNC_INLINE uint8_t getAxis() const {
+      return axis;
+   }
+
+   /**
+    * Get number of records made by the last run
+    *
+    * @return Number of records
+    */
+   unsigned getSampleCount() const {
+      return count;
+   }
+
+   /**
+    * Fit the model to the records of the last run\n
+    * Takes a few ms - call from a task.
+    *
+    * @param[out] model Fitted model
+    *
+    * @return true  => model is valid
+    * @return false => too few records or no stable first-order fit
+    */
+   bool fit(Model &model) const;
+
+   /**
+    * Write the records of the last run to the console for fitting on a host\n
+    * Format: one "record, position, output" line per record after a header line
+    */
+   void dump() const;
+
+   /**
+    * Calculate position controller tunings from a model\n
+    * SIMC rule for an integrating process with lag - the derivative cancels the lag
+    * and the closed loop approaches a first-order response with time constant
+    * Settings::closedLoopTime.
+    *
+    * @param[in]  model Fitted model
+    * @param[out] kp    Proportional gain (as PID_T::setTunings())
+    * @param[out] ki    Integral gain (as PID_T::setTunings())
+    * @param[out] kd    Derivative gain (as PID_T::setTunings())
+    */
+   static void seedTunings(const Model &model, float &kp, float &ki, float &kd);
+
+   /**
+    * Write a model to the console
+    *
+    * @param[in] axis  Axis the model belongs to (1 or 2)
+    * @param[in] model Model
+    */
+   static void report(unsigned axis, const Model &model);
+};
+
+#endif /* SOURCES_SYSTEMIDENTIFICATION_H_ */
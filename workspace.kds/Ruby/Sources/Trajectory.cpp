@@ -0,0 +1,44 @@
+/*
+ * Trajectory.cpp
+ *
+ *  Trapezoidal move profile used as the reference for model feedforward
+ */
+
+#include "Trajectory.h"
+
+/*
+ * Advance the profile by one sample
+ */
+RAMFUNC bool Trajectory::next(Reference &reference) {
+   if (!running) {
+      return false;
+   }
+   time += sampleTime;
+   float position, speed, rate;
+   if (time >= moveEnd) {
+      position = distance;
+      speed    = 0;
+      rate     = 0;
+      running  = false;
+   }
+   else if (time < accelerationEnd) {
+      position = 0.5f*acceleration*time*time;
+      speed    = acceleration*time;
+      rate     = acceleration;
+   }
+   else if (time < cruiseEnd) {
+      position = velocity*(time-0.5f*accelerationEnd);
+      speed    = velocity;
+      rate     = 0;
+   }
+   else {
+      float remaining = moveEnd-time;
+      position = distance-0.5f*acceleration*remaining*remaining;
+      speed    = acceleration*remaining;
+      rate     = -acceleration;
+   }
+   reference.position     = from+direction*position;
+   reference.velocity     = direction*speed;
+   reference.acceleration = direction*rate;
+   return true;
+}
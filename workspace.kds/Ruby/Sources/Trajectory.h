@@ -0,0 +1,175 @@
+/*
+ * Trajectory.h
+ *
+ *  Trapezoidal move profile used as the reference for model feedforward
+ */
+
+#ifndef SOURCES_TRAJECTORY_H_
+#define SOURCES_TRAJECTORY_H_
+
+#include <math.h>
+#include "RamFunction.h"
+
+/**
+ * Generates position, velocity and acceleration references for a move
+ *
+ * The profile accelerates at maxAcceleration to maxVelocity, cruises, then decelerates
+ * so it arrives at the target with zero velocity. Short moves never reach maxVelocity
+ * (triangular profile). next() is called from the control ISR once per sample and the
+ * reference is passed to PID_T::setReference() so the feedforward provides most of the
+ * output and the feedback only corrects the tracking error.
+ *
+ * Example:
+ * @code
+ *  Trajectory trajectory1(pidInterval);
+ *
+ *  // Task
+ *  trajectory1.start(pid1.getSetpoint(), pid1.getSetpoint()+QUARTERROTATIONTICKS,
+ *        Trajectory::getLimits(gain, timeConstant, friction, 30));
+ *
+ *  // Control ISR before pid1.update()
+ *  Trajectory::Reference reference;
+ *  if (trajectory1.next(reference)) {
+ *     pid1.setReference(reference.position, reference.velocity, reference.acceleration);
+ *  }
+ * @endcode
+ */
+class Trajectory {
+
+public:
+   /** Share of the output limit used for velocity feedforward at the cruise speed */
+   static constexpr float VELOCITY_SHARE = 0.8f;
+
+   /** Share of the output limit used for acceleration feedforward */
+   static constexpr float ACCELERATION_SHARE = 0.15f;
+
+   /** Profile limits */
+   struct Limits {
+      float maxVelocity;         //!< Cruise speed (ticks/s)
+      float maxAcceleration;     //!< Acceleration and deceleration (ticks/s^2)
+   };
+
+   /** Reference for one sample */
+   struct Reference {
+      float position;            //!< Position (ticks)
+      float velocity;            //!< Velocity (ticks/s)
+      float acceleration;        //!< Acceleration (ticks/s^2)
+   };
+
+private:
+   /** Interval between calls to next() (s) */
+   const float sampleTime;
+
+   /** Profile running */
+   volatile bool running = false;
+
+   /** Start position and direction of move */
+   float from      = 0;
+   float direction = 1;
+
+   /** Distance of move (ticks) */
+   float distance = 0;
+
+   /** Peak velocity and acceleration (magnitudes) */
+   float velocity     = 0;
+   float acceleration = 0;
+
+   /** End of acceleration, start of deceleration and end of move (s) */
+   float accelerationEnd = 0;
+   float cruiseEnd       = 0;
+   float moveEnd         = 0;
+
+   /** Time since start (s) */
+   float time = 0;
+
+public:
+   /**
+    * Constructor
+    *
+    * @param[in] sampleTime Interval between calls to next() (s)
+    */
+   Trajectory(float sampleTime) : sampleTime(sampleTime) {
+   }
+
+   /**
+    * Calculate profile limits the motor can follow from its identified model\n
+    * At the end of acceleration the feedforward is
+    * (VELOCITY_SHARE+ACCELERATION_SHARE)*outputLimit leaving the rest for feedback.
+    *
+    * @param[in] gain         Steady-state velocity per unit of output (ticks/s per %)
+    * @param[in] timeConstant Mechanical time constant (s)
+    * @param[in] friction     Output needed to overcome Coulomb friction (%)
+    * @param[in] outputLimit  Controller output limit (%)
+    *
+    * @return Limits
+    */
+   static Limits getLimits(float gain, float timeConstant, float friction, float outputLimit) {
+      Limits limits;
+      limits.maxVelocity     = gain*(VELOCITY_SHARE*outputLimit-friction);
+      limits.maxAcceleration = gain*ACCELERATION_SHARE*outputLimit/timeConstant;
+      return limits;
+   }
+
+   /**
+    * Start a move
+    *
+    * @param[in] start  Position at start (usually the current setpoint)
+    * @param[in] target Position at end
+    * @param[in] limits Profile limits
+    */
+   void start(float start, float target, const Limits &limits) {
+      running      = false;
+      from         = start;
+      direction    = (target >= start)?1:-1;
+      distance     = fabsf(target-start);
+      velocity     = limits.maxVelocity;
+      acceleration = limits.maxAcceleration;
+      if ((velocity <= 0) || (acceleration <= 0)) {
+         // Motor can't follow a profile - step to the target
+         accelerationEnd = 0;
+         cruiseEnd       = 0;
+         moveEnd         = 0;
+      }
+      else {
+         if (distance*acceleration < velocity*velocity) {
+            // Triangular - maximum velocity is not reached
+            velocity = sqrtf(distance*acceleration);
+         }
+         accelerationEnd = velocity/acceleration;
+         cruiseEnd       = (velocity>0)?distance/velocity:0;
+         moveEnd         = cruiseEnd+accelerationEnd;
+      }
+      time         = 0;
+      running      = true;
+   }
+
+   /**
+    * Stop the profile (e.g. on a jam)\n
+    * The last reference is left as the setpoint.
+    */
+   RAMFUNC_INLINE void stop() {
+      running = false;
+   }
+
+   /**
+    * Indicates the profile has not reached the target
+    *
+    * @return true => next() is producing references
+    */
+   bool isRunning() const {
+      return running;
+   }
+
+   /**
+    * Advance the profile by one sample\n
+    * Call from the control ISR.
+    *
+    * @param[out] reference Reference for this sample
+    *
+    * @return true  => reference is valid
+    * @return false => profile not running
+    */
+   RAMFUNC bool next(Reference &reference);
+};
+
+#endif /* SOURCES_TRAJECTORY_H_ */
@@ -39,6 +39,7 @@ static constexpr uint8_t  F_PGMPART     =  0x80;
 /** A23 == 1 => indicates DATA flash */
 static constexpr uint32_t DATA_ADDRESS_FLAG    = (1<<23);
 
+#if defined(__arm__)
 /**
  * Launch & wait for Flash command to complete
  *
@@ -94,7 +95,32 @@ FlashDriverError_t Flash::executeFlashCommand() {
    (*fp)();
    enableInterrupts();
 
-   // Handle any errors
+   return getCommandResult();
+}
+#else
+/**
+ * Launch & wait for Flash command to complete
+ *
+ * @note Host build - the command is completed by the FTFE model so there is
+ *       no need to run from RAM
+ */
+FlashDriverError_t Flash::executeFlashCommand() {
+   disableInterrupts();
+   launchFlashCommand();
+   while ((FTFE->FSTAT & FTFE_FSTAT_CCIF_MASK) == 0) {
+   }
+   enableInterrupts();
+
+   return getCommandResult();
+}
+#endif
+
+/**
+ * Get result of last Flash command
+ *
+ * @return Error code, 0 => no error
+ */
+FlashDriverError_t Flash::getCommandResult() {
    if ((FTFE->FSTAT & FTFE_FSTAT_FPVIOL_MASK ) != 0) {
       return FLASH_ERR_PROG_FPVIOL;
    }
@@ -171,10 +197,22 @@ FlashDriverError_t Flash::partitionFlash(uint8_t eeprom, uint8_t partition) {
  * @return Error code
  */
 FlashDriverError_t Flash::programPhrase(const uint8_t *data, uint8_t *address) {
+   loadProgramPhrase(data, address);
+   FlashDriverError_t rc = executeFlashCommand();
+   return rc;
+}
+
+/**
+ * Load command registers to program phrase
+ *
+ * @param[in]  data       Location of data to program
+ * @param[out] address    Memory address to program - must be phrase boundary
+ */
+void Flash::loadProgramPhrase(const uint8_t *data, uint8_t *address) {
    FTFE->FCCOB0 = F_PGM8;
-   FTFE->FCCOB1 = (uint8_t)(((uint32_t)address)>>16);
-   FTFE->FCCOB2 = (uint8_t)(((uint32_t)address)>>8);
-   FTFE->FCCOB3 = (uint8_t)(((uint32_t)address));
+   FTFE->FCCOB1 = (uint8_t)(((uint32_t)(uintptr_t)address)>>16);
+   FTFE->FCCOB2 = (uint8_t)(((uint32_t)(uintptr_t)address)>>8);
+   FTFE->FCCOB3 = (uint8_t)(((uint32_t)(uintptr_t)address));
    FTFE->FCCOB7 = *data++;
    FTFE->FCCOB6 = *data++;
    FTFE->FCCOB5 = *data++;
@@ -183,8 +221,6 @@ FlashDriverError_t Flash::programPhrase(const uint8_t *data, uint8_t *address) {
    FTFE->FCCOBA = *data++;
    FTFE->FCCOB9 = *data++;
    FTFE->FCCOB8 = *data++;
-   FlashDriverError_t rc = executeFlashCommand();
-   return rc;
 }
 
 /**
@@ -198,16 +234,16 @@ FlashDriverError_t Flash::programPhrase(const uint8_t *data, uint8_t *address) {
  */
 FlashDriverError_t Flash::programRange(const uint8_t *data, uint8_t *address, uint32_t size) {
    unsigned phraseSize;
-   if ((uint32_t)address >= 0x10000000) {
+   if ((uint32_t)(uintptr_t)address >= 0x10000000) {
       // DFLASH
-      address = (uint8_t*)((uint32_t)address | DATA_ADDRESS_FLAG);
+      address = (uint8_t*)(uintptr_t)((uint32_t)(uintptr_t)address | DATA_ADDRESS_FLAG);
       phraseSize = dataFlashPhraseSize;
    }
    else {
       // PFLASH
       phraseSize = programFlashPhraseSize;
    }
-   assert((((uint32_t)address)&(phraseSize-1)) == 0);
+   assert((((uint32_t)(uintptr_t)address)&(phraseSize-1)) == 0);
    assert((size&(phraseSize-1)) == 0);
 
    while (size>0) {
@@ -230,14 +266,65 @@ FlashDriverError_t Flash::programRange(const uint8_t *data, uint8_t *address, ui
  * @return Error code
  */
 FlashDriverError_t Flash::eraseSector(uint8_t *address) {
-   FTFE->FCCOB0 = F_ERSSCR;
-   FTFE->FCCOB1 = (uint8_t)(((uint32_t)address)>>16);
-   FTFE->FCCOB2 = (uint8_t)(((uint32_t)address)>>8);
-   FTFE->FCCOB3 = (uint8_t)(((uint32_t)address));
+   loadEraseSector(address);
    FlashDriverError_t rc = executeFlashCommand();
    return rc;
 }
 
+/**
+ * Load command registers to erase sector
+ *
+ * @param[in]  address    Memory address to erase - must be sector boundary
+ */
+void Flash::loadEraseSector(uint8_t *address) {
+   FTFE->FCCOB0 = F_ERSSCR;
+   FTFE->FCCOB1 = (uint8_t)(((uint32_t)(uintptr_t)address)>>16);
+   FTFE->FCCOB2 = (uint8_t)(((uint32_t)(uintptr_t)address)>>8);
+   FTFE->FCCOB3 = (uint8_t)(((uint32_t)(uintptr_t)address));
+}
+
+/**
+ * Launch Flash command without waiting for completion
+ */
+void Flash::launchFlashCommand() {
+   // Clear previous errors and start command
+   FTFE->FSTAT = FTFE_FSTAT_RDCOLERR_MASK|FTFE_FSTAT_ACCERR_MASK|FTFE_FSTAT_FPVIOL_MASK;
+   FTFE->FSTAT = FTFE_FSTAT_CCIF_MASK;
+}
+
+/**
+ * Start programming a phrase to Flash memory
+ *
+ * @param[in]  data       Location of data to program
+ * @param[out] address    Memory address to program - must be phrase boundary
+ *
+ * @return Error code
+ */
+FlashDriverError_t Flash::startProgramPhrase(const uint8_t *data, uint8_t *address) {
+   if (!isReady()) {
+      return FLASH_ERR_PROG_ACCERR;
+   }
+   loadProgramPhrase(data, address);
+   launchFlashCommand();
+   return FLASH_ERR_OK;
+}
+
+/**
+ * Start erasing a sector of Flash memory
+ *
+ * @param[in]  address    Memory address to erase - must be sector boundary
+ *
+ * @return Error code
+ */
+FlashDriverError_t Flash::startEraseSector(uint8_t *address) {
+   if (!isReady()) {
+      return FLASH_ERR_PROG_ACCERR;
+   }
+   loadEraseSector(address);
+   launchFlashCommand();
+   return FLASH_ERR_OK;
+}
+
 /**
  * Program a range of bytes to Flash memory
  *
@@ -248,16 +335,16 @@ FlashDriverError_t Flash::eraseSector(uint8_t *address) {
  */
 FlashDriverError_t Flash::eraseRange(uint8_t *address, uint32_t size) {
    unsigned sectorSize;
-   if ((uint32_t)address >= 0x10000000) {
+   if ((uint32_t)(uintptr_t)address >= 0x10000000) {
       // DFLASH
-      address = (uint8_t*)((uint32_t)address | DATA_ADDRESS_FLAG);
+      address = (uint8_t*)(uintptr_t)((uint32_t)(uintptr_t)address | DATA_ADDRESS_FLAG);
       sectorSize = dataFlashSectorSize;
    }
    else {
       // PFLASH
       sectorSize = programFlashSectorSize;
    }
-   assert((((uint32_t)address)&(sectorSize-1)) == 0);
+   assert((((uint32_t)(uintptr_t)address)&(sectorSize-1)) == 0);
    assert((size&(sectorSize-1)) == 0);
 
    while (size>0) {
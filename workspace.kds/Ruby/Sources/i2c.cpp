@@ -6,6 +6,7 @@
  * @date     13 April 2016
  */
 #include "i2c.h"
+#include "system.h"
  /*
  * *****************************
  * *** DO NOT EDIT THIS FILE ***
@@ -67,14 +68,11 @@ uint8_t I2c::getBPSValue(uint32_t bps, uint32_t clockFrequency) {
  * Start Rx/Tx sequence by sending address byte
  *
  * @param[in]  address - address of slave to access
+ *
+ * @note The bus must be idle
  */
 void I2c::sendAddress(uint8_t address) {
-   // Wait for bus idle
-   while ((i2c->S & I2C_S_BUSY_MASK) != 0) {
-      __asm("nop");
-   }
-
-   addressedDevice = address;
+   addressedDevice = address&~1;
 
    // Configure for Tx of address
    i2c->C1 = i2cMode|I2C_C1_IICEN_MASK|I2C_C1_TX_MASK;
@@ -86,6 +84,113 @@ void I2c::sendAddress(uint8_t address) {
    i2c->D  = I2C_D_DATA(address);
 }
 
+/**
+ * Set up state machine for the transaction at the head of the queue
+ *
+ * @return Address byte to send (including R/W bit)
+ */
+uint8_t I2c::loadTransaction() {
+   I2cTransaction *transaction = queueHead;
+
+   errorCode        = E_NO_ERROR;
+   txDataPtr        = transaction->txData;
+   txBytesRemaining = transaction->txSize;
+   rxDataPtr        = transaction->rxData;
+   rxBytesRemaining = transaction->rxSize;
+   addressedDevice  = transaction->address&~1;
+
+   if ((txBytesRemaining == 0) && (rxBytesRemaining > 0)) {
+      // Receive only - send address with READ bit set
+      state = i2c_rxAddress;
+      return addressedDevice|1;
+   }
+   // Send address byte at start and move to data transmission
+   state = i2c_txData;
+   return addressedDevice;
+}
+
+/**
+ * Start the transaction at the head of the queue with a START
+ * If the bus is busy the START is deferred until a STOP is detected.
+ */
+void I2c::startQueue() {
+   // Clear stale STOP detection before checking the bus
+   i2c->FLT |= I2C_FLT_STOPF_MASK;
+   if ((i2c->S & I2C_S_BUSY_MASK) != 0) {
+      // Another master (or our last STOP) still has the bus - continue on STOP detection
+      state = i2c_waitBusFree;
+      i2c->FLT |= I2C_FLT_SSIE_MASK;
+      return;
+   }
+   sendAddress(loadTransaction());
+}
+
+/**
+ * End the bus phase of the current transaction
+ * Generates a REPEATED-START if another transaction is queued otherwise a STOP.
+ *
+ * @return true => REPEATED-START generated
+ */
+bool I2c::stopOrRestart() {
+   if ((queueHead == nullptr) || (queueHead->next == nullptr)) {
+      // Generate STOP
+      state = i2c_idle;
+      i2c->C1 = i2cMode|I2C_C1_IICEN_MASK;
+      return false;
+   }
+#if defined(MCU_MKL25Z4)
+   // Temporarily clear MULT - see KL25 errata e6070
+   uint8_t temp = i2c->F;
+   i2c->F&=~I2C_F_MULT(3);
+#endif
+   // Generate REPEATED-START
+   i2c->C1 = i2cMode|I2C_C1_IICEN_MASK|I2C_C1_MST_MASK|I2C_C1_TX_MASK|I2C_C1_RSTA_MASK;
+#if defined(MCU_MKL25Z4)
+   // Restore MULT
+   i2c->F = temp;
+#endif
+#if defined(MCU_MKL27Z4) || defined(MCU_MKL27Z644) || defined(MCU_MKL43Z4)
+   // This is a nasty hack
+   // It seems these chips need a delay after asserting repeated start
+   for (int i=0; i<20; i++) {
+      __asm__ volatile("nop");
+   }
+#endif
+   return true;
+}
+
+/**
+ * Complete the transaction at the head of the queue and execute its callback
+ *
+ * @param[in]  restarted Indicates a REPEATED-START has been generated for the next transaction
+ */
+void I2c::completeTransaction(bool restarted) {
+   I2cTransaction *transaction = queueHead;
+   if (transaction == nullptr) {
+      state = i2c_idle;
+      return;
+   }
+   queueHead = transaction->next;
+   if (queueHead == nullptr) {
+      queueTail = nullptr;
+   }
+   transaction->next      = nullptr;
+   transaction->errorCode = errorCode;
+
+   if (restarted) {
+      // Send address of next transaction to continue after the REPEATED-START
+      i2c->D = loadTransaction();
+   }
+   else if (queueHead != nullptr) {
+      // Bus was released (e.g. lost arbitration)
+      startQueue();
+   }
+   transaction->complete = true;
+   if (transaction->callback != nullptr) {
+      transaction->callback(*transaction);
+   }
+}
+
 /**
  * I2C state-machine based interrupt handler
  */
@@ -95,8 +200,18 @@ void I2c::poll(void) {
       i2c->S = I2C_S_ARBL_MASK|I2C_S_IICIF_MASK;
       errorCode = E_LOST_ARBITRATION;
       state = i2c_idle;
-      // Generate STOP
+      // Generate STOP (hardware has already released the bus)
       i2c->C1 = i2cMode|I2C_C1_IICEN_MASK;
+      completeTransaction(false);
+      return;
+   }
+   if (state == i2c_waitBusFree) {
+      if ((i2c->FLT & I2C_FLT_STOPF_MASK) != 0) {
+         // Bus released - clear STOPF and interrupt flag
+         i2c->FLT = (i2c->FLT|I2C_FLT_STOPF_MASK)&~I2C_FLT_SSIE_MASK;
+         i2c->S   = I2C_S_IICIF_MASK;
+         startQueue();
+      }
       return;
    }
    if ((i2c->S & I2C_S_IICIF_MASK) == 0) {
@@ -108,11 +223,11 @@ void I2c::poll(void) {
    // i2c_txData* +-> i2c_idle
    //             +-> i2c_rxAddress -> i2c_rxData* +-> i2c_idle
    //                                              *-> i2c_txData
+   // Each transition to i2c_idle may instead REPEATED-START the next queued transaction
 
    switch (state) {
    case i2c_idle:
    default:
-      state = i2c_idle;
       break;
 
    case i2c_txData:
@@ -120,9 +235,7 @@ void I2c::poll(void) {
       if ((i2c->S & I2C_S_RXAK_MASK) != 0) {
          // No ACK on last Tx data byte
          errorCode = E_NO_ACK;
-         state = i2c_idle;
-         // Generate STOP
-         i2c->C1 = i2cMode|I2C_C1_IICEN_MASK;
+         completeTransaction(stopOrRestart());
          return;
       }
       if (txBytesRemaining-- == 0) {
@@ -155,9 +268,7 @@ void I2c::poll(void) {
          }
          else {
             // Complete
-            state = i2c_idle;
-            // Generate stop signal
-            i2c->C1 = i2cMode|I2C_C1_IICEN_MASK|I2C_C1_TXAK_MASK;
+            completeTransaction(stopOrRestart());
             return;
          }
       }
@@ -172,9 +283,7 @@ void I2c::poll(void) {
       if ((i2c->S & I2C_S_RXAK_MASK) != 0) {
          // No ACK on Tx read address byte
          errorCode = E_NO_ACK;
-         state = i2c_idle;
-         // Generate STOP
-         i2c->C1 = i2cMode|I2C_C1_IICEN_MASK;
+         completeTransaction(stopOrRestart());
          return;
       }
       // Switch to data reception & trigger reception
@@ -195,10 +304,11 @@ void I2c::poll(void) {
    case i2c_rxData:
       // Just receive data bytes until complete
       if (--rxBytesRemaining == 0) {
-         // Received last byte - complete
-         state = i2c_idle;
-         // Generate STOP
-         i2c->C1 = i2cMode|I2C_C1_IICEN_MASK;
+         // Received last byte - STOP or REPEATED-START (Tx mode) before reading so no further byte is clocked
+         bool restarted = stopOrRestart();
+         *rxDataPtr++ = i2c->D;
+         completeTransaction(restarted);
+         return;
       }
       else if (rxBytesRemaining == 1) {
          // Received 2nd last byte (don't acknowledge the last byte to follow)
@@ -213,6 +323,35 @@ void I2c::poll(void) {
    }
 }
 
+/**
+ * Queue a transaction
+ *
+ * @param[in]  transaction Transaction to queue
+ *
+ * @return E_NO_ERROR on success
+ */
+ErrorCode I2c::submit(I2cTransaction &transaction) {
+   CriticalSection cs;
+
+   if (!transaction.complete) {
+      return E_ILLEGAL_PARAM;
+   }
+   transaction.complete  = false;
+   transaction.errorCode = E_NO_ERROR;
+   transaction.next      = nullptr;
+
+   if (queueHead == nullptr) {
+      queueHead = &transaction;
+      queueTail = &transaction;
+      startQueue();
+   }
+   else {
+      queueTail->next = &transaction;
+      queueTail       = &transaction;
+   }
+   return E_NO_ERROR;
+}
+
 /**
  * Transmit message
  *
@@ -223,31 +362,7 @@ void I2c::poll(void) {
  * @return E_NO_ERROR on success
  */
 ErrorCode I2c::transmit(uint8_t address, uint16_t size, const uint8_t data[]) {
-#ifdef __CMSIS_RTOS
-   startTransaction();
-#endif
-
-   errorCode = E_NO_ERROR;
-
-   rxBytesRemaining = 0;
-
-   // Send address byte at start and move to data transmission
-   state = i2c_txData;
-
-   // Set up transmit data
-   txDataPtr        = data;
-   txBytesRemaining = size;
-
-   sendAddress(address);
-   waitWhileBusy();
-
-   ErrorCode tErrorCode = errorCode;
-
-#ifdef __CMSIS_RTOS
-   endTransaction();
-#endif
-
-   return tErrorCode;
+   return txRx(address, size, data, 0, nullptr);
 }
 
 /**
@@ -260,30 +375,7 @@ ErrorCode I2c::transmit(uint8_t address, uint16_t size, const uint8_t data[]) {
  * @return E_NO_ERROR on success
  */
 ErrorCode I2c::receive(uint8_t address, uint16_t size,  uint8_t data[]) {
-#ifdef __CMSIS_RTOS
-   startTransaction();
-#endif
-   errorCode = E_NO_ERROR;
-
-   txBytesRemaining = 0;
-
-   // Send address byte at start and move to data reception
-   state = i2c_rxAddress;
-
-   // Set up receive data
-   rxDataPtr        = data;
-   rxBytesRemaining = size;
-
-   sendAddress(address|1);
-   waitWhileBusy();
-
-   ErrorCode tErrorCode = errorCode;
-
-#ifdef __CMSIS_RTOS
-   endTransaction();
-#endif
-
-   return tErrorCode;
+   return txRx(address, 0, nullptr, size, data);
 }
 
 /**
@@ -302,27 +394,17 @@ ErrorCode I2c::txRx(uint8_t address, uint16_t txSize, const uint8_t txData[], ui
 #ifdef __CMSIS_RTOS
    startTransaction();
 #endif
-   errorCode = E_NO_ERROR;
-
-   // Send address byte at start and move to data transmission
-   state = i2c_txData;
-
-   // Set up transmit and receive data
-   rxDataPtr        = rxData;
-   rxBytesRemaining = rxSize;
-   txDataPtr        = txData;
-   txBytesRemaining = txSize;
 
-   sendAddress(address);
-   waitWhileBusy();
+   I2cTransaction transaction(address, txSize, txData, rxSize, rxData);
 
-   ErrorCode tErrorCode = errorCode;
+   submit(transaction);
+   waitForTransaction(transaction);
 
 #ifdef __CMSIS_RTOS
    endTransaction();
 #endif
 
-   return tErrorCode;
+   return transaction.errorCode;
 }
 
 /**
@@ -8,16 +8,31 @@
 #ifndef PROJECT_HEADERS_PID_H_
 #define PROJECT_HEADERS_PID_H_
 
+#include <stdint.h>
 #include <time.h>
+#include "RamFunction.h"
 
 #define FULLROTATIONTICKS (8192)
 #define QUARTERROTATIONTICKS (FULLROTATIONTICKS/4)
 #define SAMPLES_FOR_AVERAGE (400)
 
+// Interval between errors kept for the average (s) - faster controllers keep every Nth error
+#define AVERAGE_INTERVAL (500e-6)
+
+// Average error allowed when a move is taken to have finished (ticks)
+#define STEADY_STATE_TOLERANCE (((FULLROTATIONTICKS)/(360)) * ((3)/(3)))
+
 class PID {
 public:
    typedef float  InFunction();
    typedef void   OutFunction(float);
+
+   /** Method used to stop the integral winding up while the output is limited */
+   enum AntiWindup : uint8_t {
+      AntiWindup_Clamp           = 0,  //!< Integral only limited to the output range (always applied)
+      AntiWindup_BackCalculation = 1,  //!< Integral driven towards the limited output by the tracking gain
+      AntiWindup_Conditional     = 2,  //!< Integral held while the error would drive the output further into the limit
+   };
 };
 
 /**
@@ -39,21 +54,41 @@ private:
    double ki;                 // Integral Tuning Parameter
    double kd;                 // Derivative Tuning Parameter
 
+   double kv = 0;             // Velocity feedforward (output per tick/s)
+   double ka = 0;             // Acceleration feedforward (output per tick/s^2)
+   double kf = 0;             // Friction feedforward (output)
+
+   AntiWindup antiWindup     = AntiWindup_Clamp;
+   double trackingGain       = 0;  // Back-calculation gain (per sample)
+   double derivativeFilter   = 0;  // Derivative filter pole (0 => unfiltered)
+   double proportionalWeight = 1;  // Setpoint weight in proportional term
+   double derivativeWeight   = 0;  // Setpoint weight in derivative term (0 => derivative on input)
+   double offsetDecay        = 0;  // Per-sample decay of setpointOffset
+
    bool   enabled;            // Enable for controller
 
-   double integral;           // Integral accumulation term
+   double integral      = 0;  // Integral accumulation term
+
+   double currentInput  = 0;  // Current input sample
+   double currentOutput = 0;  // Current output
+   double setpoint      = 0;  // Setpoint for controller
+   double currentError  = 0;
+
+   double referenceVelocity     = 0;  // Velocity of setpoint (ticks/s)
+   double referenceAcceleration = 0;  // Acceleration of setpoint (ticks/s^2)
+   double currentFeedforward    = 0;  // Feedforward part of current output
 
-   double lastInput;          // Last input sample
-   double currentInput;       // Current input sample
-   double currentOutput;      // Current output
-   double setpoint;           // Setpoint for controller
-   double currentError;
+   double setpointOffset        = 0;  // Part of setpoint changes withheld from proportional term
+   double lastDerivativeInput   = 0;  // Last weighted error used by derivative
+   double filteredDerivative    = 0;  // Filtered change of weighted error per sample
 
    double eMMD;				  // A multiplier used to handle inequalites in the direction of the motor and the encoder
 
    bool averageErrorReady = false;
    int averageErrorRecord[SAMPLES_FOR_AVERAGE];
    int averageErrorRecordIndex;
+   int averageDecimation;     // Samples for each error kept
+   int averageSkip = 0;       // Samples since last error kept
 
 public:
 
@@ -88,6 +123,9 @@ public:
 
       averageErrorRecordIndex = 0;
       averageErrorReady = false;
+
+      // Average covers the same time at any sample rate
+      averageDecimation = (sampleTime < AVERAGE_INTERVAL)?(int)(AVERAGE_INTERVAL/sampleTime + 0.5):1;
    }
 
    /**
@@ -101,8 +139,11 @@ public:
 
 	  if(enable != enabled) {
          // Just enabled
-         currentInput = inputFn();
-         integral     = currentOutput;
+         currentInput        = inputFn();
+         integral            = currentOutput;
+         lastDerivativeInput = derivativeWeight*setpoint - currentInput;
+         filteredDerivative  = 0;
+         setpointOffset      = 0;
       }
       enabled = enable;
    }
@@ -122,16 +163,17 @@ public:
     * Should be called \ref sampleTime interval.
     * This would usually be done by a timer call-back or similar.
     */
-   void update() {
+   RAMFUNC_INLINE void update() {
       if(!enabled) {
          return;
       }
 
       // Update input samples & error
-      lastInput = currentInput;
       currentInput = inputFn();
       currentError = setpoint - currentInput;
 
+      // Integral is never allowed beyond what the output can use
+      double lastIntegral = integral;
       integral += (ki * currentError);
       if(integral > outMax) {
          integral = outMax;
@@ -139,26 +181,56 @@ public:
       else if(integral < outMin) {
          integral = outMin;
       }
-      double dInput = (currentInput - lastInput);
-
-//      if ((dInput>=-3) && (dInput<=3)) {
-//         // Calculate PID Output
-//         currentOutput = kp * currentError + integral - (kd/10) * dInput;
-//      }
-//      else {
-         // Calculate PID Output
-         currentOutput = eMMD*(kp * currentError + integral - kd * dInput);//Negative 1 is for the difference in direction between encoder and motors. The motors negative direction is the encoders positive direction
-//      }
+
+      // Derivative of weighted error (derivativeWeight*setpoint - input) through first-order filter
+      double derivativeInput = derivativeWeight*setpoint - currentInput;
+      filteredDerivative  = derivativeFilter*filteredDerivative + (1-derivativeFilter)*(derivativeInput - lastDerivativeInput);
+      lastDerivativeInput = derivativeInput;
+
+      // Model feedforward from the reference - zero unless setFeedforward() and setReference() are used
+      double feedforward = kv * referenceVelocity + ka * referenceAcceleration;
+      if(referenceVelocity > 0) {
+         feedforward += kf;
+      }
+      else if(referenceVelocity < 0) {
+         feedforward -= kf;
+      }
+      currentFeedforward = eMMD*feedforward;
+
+      // Calculate PID Output
+      double proportional = currentError - setpointOffset;
+      setpointOffset *= offsetDecay;
+      double unlimited    = eMMD*(kp * proportional + integral + kd * filteredDerivative + feedforward);//Negative 1 is for the difference in direction between encoder and motors. The motors negative direction is the encoders positive direction
+      currentOutput = unlimited;
       if(currentOutput > outMax) {
          currentOutput = outMax;
       }
       else if(currentOutput < outMin) {
          currentOutput = outMin;
       }
+      if(antiWindup == AntiWindup_BackCalculation) {
+         integral += trackingGain * eMMD * (currentOutput - unlimited);
+      }
+      else if((antiWindup == AntiWindup_Conditional) && (eMMD * currentError * (unlimited - currentOutput) > 0)) {
+         // Limited and this step would wind further into the limit
+         integral = lastIntegral;
+      }
+      if(integral > outMax) {
+         integral = outMax;
+      }
+      else if(integral < outMin) {
+         integral = outMin;
+      }
       // Update output
       outputFn(currentOutput);
 
       //Update average
+      if(++averageSkip < averageDecimation)
+      {
+    	  return;
+      }
+      averageSkip = 0;
+
       if(averageErrorRecordIndex >= SAMPLES_FOR_AVERAGE)
       {
     	  averageErrorRecordIndex = 0;
@@ -186,14 +258,150 @@ public:
       kp = Kp;
       ki = Ki * sampleTime;
       kd = Kd / sampleTime;
+
+      // Weighted part of a setpoint change decays with the integral time Kp/Ki
+      offsetDecay = ((kp > 0) && (ki < kp))?1 - ki/kp:0;
+      if (ki <= 0) {
+         // Would never decay
+         setpointOffset = 0;
+      }
    }
 
    /**
-    * Change setpoint of controller
+    * Withhold part of a setpoint change from the proportional term
+    *
+    * @param change Change of setpoint
+    */
+   RAMFUNC_INLINE void weightSetpointChange(double change) {
+      if (ki > 0) {
+         setpointOffset += (1 - proportionalWeight) * change;
+      }
+   }
+
+   /**
+    * Select anti-windup method
+    *
+    * @param mode         Method
+    * @param trackingGain Rate the integral tracks the limited output for AntiWindup_BackCalculation (1/s)
+    */
+   void setAntiWindup(AntiWindup mode, double trackingGain = 0) {
+      if (trackingGain<0) {
+         USBDM::setAndCheckErrorCode(USBDM::E_ILLEGAL_PARAM);
+      }
+      antiWindup         = mode;
+      this->trackingGain = trackingGain * sampleTime;
+   }
+
+   /**
+    * Set derivative filter\n
+    * The derivative is passed through a first-order low-pass filter to reduce encoder quantisation noise
+    *
+    * @param timeConstant Filter time constant (s), 0 => unfiltered
+    */
+   void setDerivativeFilter(double timeConstant) {
+      if (timeConstant<0) {
+         USBDM::setAndCheckErrorCode(USBDM::E_ILLEGAL_PARAM);
+      }
+      derivativeFilter = timeConstant / (timeConstant + sampleTime);
+   }
+
+   /**
+    * Set setpoint weights\n
+    * Only proportionalWeight of a setpoint change acts on the proportional term at first. The rest is
+    * passed on with the integral time Kp/Ki so it does not have to be held by the (limited) integral
+    * as it would with the textbook form kp*(b*setpoint - input). This needs integral action.\n
+    * The derivative term acts on (derivativeWeight*setpoint - input).
+    * The integral always acts on the full error.
+    *
+    * @param proportional Setpoint weight for proportional term (1 => error)
+    * @param derivative   Setpoint weight for derivative term (0 => derivative on input only)
+    */
+   void setSetpointWeights(double proportional, double derivative) {
+      if (proportional<0 || proportional>1 || derivative<0 || derivative>1) {
+         USBDM::setAndCheckErrorCode(USBDM::E_ILLEGAL_PARAM);
+      }
+      proportionalWeight  = proportional;
+      derivativeWeight    = derivative;
+      setpointOffset      = 0;
+      lastDerivativeInput = derivativeWeight*setpoint - currentInput;
+   }
+
+   /**
+    * Get anti-windup method
+    *
+    * @return Method
+    */
+   AntiWindup getAntiWindup() {
+      return antiWindup;
+   }
+
+   /**
+    * Get back-calculation tracking gain
+    *
+    * @return Gain (1/s)
+    */
+   double getTrackingGain() {
+      return trackingGain/sampleTime;
+   }
+
+   /**
+    * Get derivative filter time constant
+    *
+    * @return Time constant (s)
+    */
+   double getDerivativeFilter() {
+      return derivativeFilter*sampleTime/(1-derivativeFilter);
+   }
+
+   /**
+    * Get setpoint weight for proportional term
+    *
+    * @return Weight
+    */
+   double getProportionalWeight() {
+      return proportionalWeight;
+   }
+
+   /**
+    * Get setpoint weight for derivative term
+    *
+    * @return Weight
+    */
+   double getDerivativeWeight() {
+      return derivativeWeight;
+   }
+
+   /**
+    * Set the plant model used for feedforward\n
+    * The output needed to follow the reference is
+    * (velocity + timeConstant * acceleration)/gain + friction * sgn(velocity)
+    *
+    * @param gain         Steady-state velocity per unit of output (ticks/s per output unit), 0 => no feedforward
+    * @param timeConstant Mechanical time constant (s)
+    * @param friction     Output needed to overcome Coulomb friction
+    */
+   void setFeedforward(double gain, double timeConstant, double friction) {
+      if (gain<0 || timeConstant<0 || friction<0) {
+         USBDM::setAndCheckErrorCode(USBDM::E_ILLEGAL_PARAM);
+      }
+      if (gain <= 0) {
+         kv = 0;
+         ka = 0;
+         kf = 0;
+         return;
+      }
+      kv = 1 / gain;
+      ka = timeConstant / gain;
+      kf = friction;
+   }
+
+   /**
+    * Change setpoint of controller\n
+    * A step - the reference velocity and acceleration are cleared
     *
     * @param value Value to set
     */
-   void setSetpoint(double value) {
+   RAMFUNC_INLINE void setSetpoint(double value) {
       averageErrorReady = false;//Discontinuity breaks average
 
 	   if (value > FULLROTATIONTICKS) {
@@ -202,7 +410,32 @@ public:
       if (value < -FULLROTATIONTICKS) {
          return;
       }
-      setpoint = value;
+      weightSetpointChange(value - setpoint);
+      setpoint              = value;
+      referenceVelocity     = 0;
+      referenceAcceleration = 0;
+   }
+
+   /**
+    * Follow a reference trajectory\n
+    * Call before each update() while the reference is moving e.g. with Trajectory::next().\n
+    * The error average is not reset so steady state may be reported as soon as the reference stops.
+    *
+    * @param position     Setpoint
+    * @param velocity     Velocity of setpoint (ticks/s)
+    * @param acceleration Acceleration of setpoint (ticks/s^2)
+    */
+   RAMFUNC_INLINE void setReference(double position, double velocity, double acceleration) {
+      if (position > FULLROTATIONTICKS) {
+         return;
+      }
+      if (position < -FULLROTATIONTICKS) {
+         return;
+      }
+      weightSetpointChange(position - setpoint);
+      setpoint              = position;
+      referenceVelocity     = velocity;
+      referenceAcceleration = acceleration;
    }
 
    /**
@@ -210,7 +443,7 @@ public:
     *
     * @return Current setpoint
     */
-   double getSetpoint() {
+   RAMFUNC_INLINE double getSetpoint() {
       return setpoint;
    }
 
@@ -219,7 +452,7 @@ public:
     *
     * @return Last input sample
     */
-   double getInput() {
+   RAMFUNC_INLINE double getInput() {
       return currentInput;
    }
 
@@ -228,16 +461,25 @@ public:
     *
     * @return Last output sample
     */
-   double getOutput() {
+   RAMFUNC_INLINE double getOutput() {
       return currentOutput;
    }
 
+   /**
+    * Get feedforward part of output
+    *
+    * @return Last feedforward (in output direction)
+    */
+   double getFeedforward() {
+      return currentFeedforward;
+   }
+
    /**
     * Get error of controller
     *
     * @return Last error calculation
     */
-   double getError() {
+   RAMFUNC_INLINE double getError() {
       return currentError;
    }
 
@@ -30,6 +30,7 @@ static const char *messages[] {
       "Program has terminated",
       "Clock initialisation failed",
       "Callback already installed",
+      "Resource not available",
 };
 
 /**
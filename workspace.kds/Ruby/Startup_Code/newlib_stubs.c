@@ -146,6 +146,7 @@ int _lseek(int file __attribute__((unused)), int ptr __attribute__((unused)), in
    return 0;
 }
 
+#ifndef HEAP_FREE_BUILD
 /*
  * Used by sbrk
  */
@@ -184,6 +185,38 @@ caddr_t _sbrk(int incr) {
    return prev_heap_end;
 }
 
+/**
+ * Get heap high-water mark
+ *
+ * @return Bytes allocated by _sbrk() since reset (the heap never shrinks)
+ */
+uint32_t heap_getHighWaterMark(void) {
+   extern char __HeapBase;   /* Defined by the linker */
+
+   if (heap_end == NULL) {
+      return 0;
+   }
+   return (uint32_t)(heap_end - &__HeapBase);
+}
+#else
+/*
+ * Heap-free build (HEAP_FREE_BUILD defined)
+ *
+ * _sbrk() is deliberately not provided so any use of malloc(), operator new,
+ * std::vector etc. fails to link with "undefined reference to `_sbrk'".
+ * Use the containers in StaticContainers.h instead.
+ */
+
+/**
+ * Get heap high-water mark
+ *
+ * @return 0 as there is no heap
+ */
+uint32_t heap_getHighWaterMark(void) {
+   return 0;
+}
+#endif
+
 /**
  * stat
  *
@@ -6,6 +6,7 @@
  *  Created on: 25/5/2017
  */
 #include <stdlib.h>
+#include <string.h>
 #include "hardware.h"
 
 /* Prevents the exception handling name demangling code getting pulled in */
@@ -14,6 +15,54 @@ namespace __gnu_cxx {
         USBDM::setAndCheckErrorCode(USBDM::E_TERMINATED);
     }
 }
+extern "C" {
+/* Defined by the linker - see .ramfunc in Linker-rom.ld */
+extern uint32_t __ramfunc_load__[];
+extern uint32_t __ramfunc_start__[];
+extern uint32_t __ramfunc_end__[];
+
+/* Flash vector table */
+extern uint32_t __VECTOR_TABLE[];
+extern uint32_t __VECTOR_TABLE_END[];
+}
+
+#ifdef RAM_VECTOR_TABLE
+/*
+ * Vector table copy in RAM (define RAM_VECTOR_TABLE)
+ *
+ * Vector fetches then avoid flash wait-states on exception entry.
+ * Alignment must be at least the table size rounded up to a power of 2.
+ */
+static constexpr unsigned RAM_VECTOR_TABLE_ENTRIES = 128;
+
+__attribute__((section(".m_interrupts_ram"), aligned(4*RAM_VECTOR_TABLE_ENTRIES)))
+static uint32_t ramVectorTable[RAM_VECTOR_TABLE_ENTRIES];
+#endif
+
+/*
+ * Copy RAM functions (and optionally the vector table) from flash
+ *
+ * Runs as the first constructor so RAMFUNC code may be used by SystemInit()
+ * and all other constructors.
+ */
+__attribute__((constructor(101)))
+static void ramInitialise() {
+   memcpy(__ramfunc_start__, __ramfunc_load__, (char *)__ramfunc_end__ - (char *)__ramfunc_start__);
+
+#ifdef RAM_VECTOR_TABLE
+   size_t size = (char *)__VECTOR_TABLE_END - (char *)__VECTOR_TABLE;
+   if (size > sizeof(ramVectorTable)) {
+      USBDM::setAndCheckErrorCode(USBDM::E_TOO_LARGE);
+   }
+   memcpy(ramVectorTable, __VECTOR_TABLE, size);
+   SCB->VTOR = (uint32_t)ramVectorTable;
+#endif
+
+   // Make sure the copied code is visible to instruction fetches
+   __DSB();
+   __ISB();
+}
+
 extern "C" __attribute__((__weak__)) void __cxa_pure_virtual(void);
 extern "C" __attribute__((__weak__)) void __cxa_pure_virtual(void) {
     exit(1);
@@ -16,7 +16,11 @@
 #include "hardware.h"
 
 /*********** $start(VectorsIncludeFiles) *** Do not edit after this comment ****************/
+#include "dma.h"
+#include "ftm.h"
 #include "pit.h"
+#include "uart.h"
+#include "MemoryMonitor.h"
 /*********** $end(VectorsIncludeFiles)   *** Do not edit above this comment ***************/
 
 /*
@@ -134,6 +138,9 @@ void _HardFault_Handler(
    if (cfsr & 0x8000) console.write("BFAR = 0x").writeln(SCB->BFAR,  Radix_16);
    console.writeln("- Misc");
    console.write("LR/EXC_RETURN= 0x").writeln(execReturn,  Radix_16);
+   console.setPadding(Padding_None);
+   console.writeln("- Memory");
+   MemoryMonitor::report();
 #endif
 
    while (1) {
@@ -210,9 +217,6 @@ void UART3_Error_IRQHandler(void)             WEAK_DEFAULT_HANDLER;
 void ADC0_IRQHandler(void)                    WEAK_DEFAULT_HANDLER;
 void CMP0_IRQHandler(void)                    WEAK_DEFAULT_HANDLER;
 void CMP1_IRQHandler(void)                    WEAK_DEFAULT_HANDLER;
-void FTM0_IRQHandler(void)                    WEAK_DEFAULT_HANDLER;
-void FTM1_IRQHandler(void)                    WEAK_DEFAULT_HANDLER;
-void FTM2_IRQHandler(void)                    WEAK_DEFAULT_HANDLER;
 void CMT_IRQHandler(void)                     WEAK_DEFAULT_HANDLER;
 void RTC_Alarm_IRQHandler(void)               WEAK_DEFAULT_HANDLER;
 void RTC_Seconds_IRQHandler(void)             WEAK_DEFAULT_HANDLER;
@@ -275,23 +279,23 @@ VectorTable const __vector_table = {
       SysTick_Handler,                         /*   15,   -1  System Tick Timer                                                                */
 
                                                /* External Interrupts */
-      DMA0_IRQHandler,                         /*   16,    0  Direct memory access controller                                                  */
-      DMA1_IRQHandler,                         /*   17,    1  Direct memory access controller                                                  */
-      DMA2_IRQHandler,                         /*   18,    2  Direct memory access controller                                                  */
-      DMA3_IRQHandler,                         /*   19,    3  Direct memory access controller                                                  */
-      DMA4_IRQHandler,                         /*   20,    4  Direct memory access controller                                                  */
-      DMA5_IRQHandler,                         /*   21,    5  Direct memory access controller                                                  */
-      DMA6_IRQHandler,                         /*   22,    6  Direct memory access controller                                                  */
-      DMA7_IRQHandler,                         /*   23,    7  Direct memory access controller                                                  */
-      DMA8_IRQHandler,                         /*   24,    8  Direct memory access controller                                                  */
-      DMA9_IRQHandler,                         /*   25,    9  Direct memory access controller                                                  */
-      DMA10_IRQHandler,                        /*   26,   10  Direct memory access controller                                                  */
-      DMA11_IRQHandler,                        /*   27,   11  Direct memory access controller                                                  */
-      DMA12_IRQHandler,                        /*   28,   12  Direct memory access controller                                                  */
-      DMA13_IRQHandler,                        /*   29,   13  Direct memory access controller                                                  */
-      DMA14_IRQHandler,                        /*   30,   14  Direct memory access controller                                                  */
-      DMA15_IRQHandler,                        /*   31,   15  Direct memory access controller                                                  */
-      DMA_Error_IRQHandler,                    /*   32,   16  Direct memory access controller                                                  */
+      USBDM::Dma0::irq0Handler,                /*   16,    0  Direct memory access controller                                                  */
+      USBDM::Dma0::irq1Handler,                /*   17,    1  Direct memory access controller                                                  */
+      USBDM::Dma0::irq2Handler,                /*   18,    2  Direct memory access controller                                                  */
+      USBDM::Dma0::irq3Handler,                /*   19,    3  Direct memory access controller                                                  */
+      USBDM::Dma0::irq4Handler,                /*   20,    4  Direct memory access controller                                                  */
+      USBDM::Dma0::irq5Handler,                /*   21,    5  Direct memory access controller                                                  */
+      USBDM::Dma0::irq6Handler,                /*   22,    6  Direct memory access controller                                                  */
+      USBDM::Dma0::irq7Handler,                /*   23,    7  Direct memory access controller                                                  */
+      USBDM::Dma0::irq8Handler,                /*   24,    8  Direct memory access controller                                                  */
+      USBDM::Dma0::irq9Handler,                /*   25,    9  Direct memory access controller                                                  */
+      USBDM::Dma0::irq10Handler,               /*   26,   10  Direct memory access controller                                                  */
+      USBDM::Dma0::irq11Handler,               /*   27,   11  Direct memory access controller                                                  */
+      USBDM::Dma0::irq12Handler,               /*   28,   12  Direct memory access controller                                                  */
+      USBDM::Dma0::irq13Handler,               /*   29,   13  Direct memory access controller                                                  */
+      USBDM::Dma0::irq14Handler,               /*   30,   14  Direct memory access controller                                                  */
+      USBDM::Dma0::irq15Handler,               /*   31,   15  Direct memory access controller                                                  */
+      USBDM::Dma0::irqErrorHandler,            /*   32,   16  Direct memory access controller                                                  */
       MCM_IRQHandler,                          /*   33,   17  Miscellaneous Control Module                                                     */
       FTF_Command_IRQHandler,                  /*   34,   18  Flash Memory Interface                                                           */
       FTF_ReadCollision_IRQHandler,            /*   35,   19  Flash Memory Interface                                                           */
@@ -306,7 +310,7 @@ VectorTable const __vector_table = {
       I2S0_Tx_IRQHandler,                      /*   44,   28  Synchronous Serial Interface                                                     */
       I2S0_Rx_IRQHandler,                      /*   45,   29  Synchronous Serial Interface                                                     */
       Default_Handler,                         /*   46,   30                                                                                   */
-      UART0_RxTx_IRQHandler,                   /*   47,   31  Serial Communication Interface                                                   */
+      USBDM::Uart0::irqRxTxHandler,            /*   47,   31  Serial Communication Interface                                                   */
       UART0_Error_IRQHandler,                  /*   48,   32  Serial Communication Interface                                                   */
       UART1_RxTx_IRQHandler,                   /*   49,   33  Serial Communication Interface                                                   */
       UART1_Error_IRQHandler,                  /*   50,   34  Serial Communication Interface                                                   */
@@ -317,9 +321,9 @@ VectorTable const __vector_table = {
       ADC0_IRQHandler,                         /*   55,   39  Analogue to Digital Converter                                                    */
       CMP0_IRQHandler,                         /*   56,   40  High-Speed Comparator                                                            */
       CMP1_IRQHandler,                         /*   57,   41  High-Speed Comparator                                                            */
-      FTM0_IRQHandler,                         /*   58,   42  FlexTimer Module                                                                 */
-      FTM1_IRQHandler,                         /*   59,   43  FlexTimer Module                                                                 */
-      FTM2_IRQHandler,                         /*   60,   44  FlexTimer Module                                                                 */
+      USBDM::Ftm0::irqHandler,                 /*   58,   42  FlexTimer Module                                                                 */
+      USBDM::Ftm1::irqHandler,                 /*   59,   43  FlexTimer Module                                                                 */
+      USBDM::Ftm2::irqHandler,                 /*   60,   44  FlexTimer Module                                                                 */
       CMT_IRQHandler,                          /*   61,   45  Carrier Modulator Transmitter                                                    */
       RTC_Alarm_IRQHandler,                    /*   62,   46  Real Time Clock                                                                  */
       RTC_Seconds_IRQHandler,                  /*   63,   47  Real Time Clock                                                                  */
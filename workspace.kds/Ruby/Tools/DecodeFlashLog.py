@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+DecodeFlashLog.py
+
+Decodes a binary dump of the FlashLog region (see Sources/FlashLog.h).
+
+Dump the region with the debugger e.g. from GDB:
+   dump binary memory flashlog.bin 0x000F8000 0x00100000
+
+Usage:
+   DecodeFlashLog.py flashlog.bin [--csv]
+"""
+
+import struct
+import sys
+
+# Must match FlashLog::Record
+RECORD_FORMAT = "<IIBBhi"
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+
+BLANK_SEQUENCE = 0xFFFFFFFF
+
+# Must match FlashLog::Event
+EVENT_NAMES = {
+    1: "Boot",
+    2: "Stop",
+    3: "Shutdown",
+    4: "Calibrated",
+    5: "IndexNotFound",
+    6: "Move",
+    7: "OverCurrent",
+    8: "Jam",
+    9: "JamRecovered",
+}
+
+# RCM SRS1:SRS0 bits for Boot records
+RESET_SOURCES = [
+    (0x0001, "WAKEUP"),
+    (0x0002, "LVD"),
+    (0x0004, "LOC"),
+    (0x0008, "LOL"),
+    (0x0020, "WDOG"),
+    (0x0040, "PIN"),
+    (0x0080, "POR"),
+    (0x0200, "LOCKUP"),
+    (0x0400, "SW"),
+    (0x0800, "MDM_AP"),
+    (0x2000, "SACKERR"),
+]
+
+
+def decode(data):
+    """Return records sorted oldest first"""
+    records = []
+    for offset in range(0, len(data) - RECORD_SIZE + 1, RECORD_SIZE):
+        fields = struct.unpack_from(RECORD_FORMAT, data, offset)
+        if fields[0] == BLANK_SEQUENCE:
+            continue
+        records.append(fields)
+    records.sort(key=lambda record: record[0])
+    return records
+
+
+def describe(event, error):
+    if event == 1:
+        sources = [name for mask, name in RESET_SOURCES if (error & 0xFFFF) & mask]
+        return "|".join(sources)
+    return ""
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    csv = "--csv" in argv[2:]
+    with open(argv[1], "rb") as file:
+        records = decode(file.read())
+
+    separator = "," if csv else "\t"
+    print(separator.join(["Seq", "Time(ms)", "Event", "Axis", "Error", "Position", "Notes"]))
+    for sequence, timestamp, event, axis, error, position in records:
+        print(separator.join([
+            str(sequence),
+            str(timestamp),
+            EVENT_NAMES.get(event, "?(%d)" % event),
+            str(axis),
+            str(error),
+            str(position),
+            describe(event, error),
+        ]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))